@@ -0,0 +1,344 @@
+//***************************************************************************** */
+//  Content-addressed, deduplicated backup store for DroneEngage config files
+//
+//  Layout (default: <config dir>/.config_backups):
+//      objects/<sha256>   one copy of every distinct file version
+//      index              "<epoch> <sha256> <size> <file path>" per line, oldest first
+//      lock               flock() target serialising writers (threads and processes)
+//
+//  A backup of content that is already the newest version of that file costs
+//  nothing; content seen before costs one index line. Old index entries are
+//  pruned by count and age, and objects no longer referenced are deleted.
+//  Files are keyed by their canonical absolute path, so several modules can
+//  share one --backup-dir.
+//
+//***************************************************************************** */
+
+#ifndef DE_BACKUP_STORE_HPP
+#define DE_BACKUP_STORE_HPP
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <ctime>
+#include <cstdint>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sha256.hpp"
+
+namespace de_config
+{
+
+struct BackupEntry
+{
+    long long epoch = 0;
+    std::string hash;
+    uint64_t size = 0;
+    std::string name;          // canonical absolute path
+};
+
+struct BackupPolicy
+{
+    size_t keep = 10;          // versions kept per file, 0 = unlimited
+    long long max_age_sec = 0; // versions older than this are dropped, 0 = never
+};
+
+class BackupStore
+{
+public:
+    explicit BackupStore(const std::string &dir) : m_dir(dir) {}
+
+    static std::string defaultDirFor(const std::string &file_path)
+    {
+        return (std::filesystem::absolute(file_path).parent_path() / ".config_backups").string();
+    }
+
+    static std::string nameOf(const std::string &file_path)
+    {
+        std::error_code ec;
+        const std::filesystem::path absolute = std::filesystem::absolute(file_path, ec);
+        const std::filesystem::path canonical = std::filesystem::weakly_canonical(absolute, ec);
+        return (ec ? absolute : canonical).lexically_normal().string();
+    }
+
+    const std::string &dir() const { return m_dir; }
+
+    /**
+     * @brief Records content as the newest version of file_path.
+     * @param stored Set to true if a new object was written to disk.
+     * @return False and sets error on failure.
+     */
+    bool save(const std::string &file_path, const std::string &content, const BackupPolicy &policy,
+              std::string &hash, bool &stored, std::string &error)
+    {
+        stored = false;
+        hash = Sha256::hex(content);
+        const std::string name = nameOf(file_path);
+
+        Lock lock;
+        if (!lockStore(lock, error)) return false;
+
+        std::vector<BackupEntry> entries;
+        if (!readIndex(entries, error)) return false;
+
+        // Same content as the newest version of this file: nothing to record
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+        {
+            if (it->name != name) continue;
+            if (it->hash == hash) return true;
+            break;
+        }
+
+        const std::string object_path = objectPath(hash);
+        std::error_code ec;
+        if (!std::filesystem::exists(object_path, ec))
+        {
+            if (!writeAtomically(object_path, content, error)) return false;
+            stored = true;
+        }
+
+        BackupEntry entry;
+        entry.epoch = static_cast<long long>(std::time(nullptr));
+        entry.hash = hash;
+        entry.size = content.size();
+        entry.name = name;
+        entries.push_back(entry);
+
+        std::vector<BackupEntry> dropped;
+        prune(entries, name, policy, dropped);
+        if (dropped.empty())
+        {
+            std::ofstream index(indexPath(), std::ios::app);
+            if (!index)
+            {
+                error = "cannot append to " + indexPath();
+                return false;
+            }
+            index << formatEntry(entry) << '\n';
+            return true;
+        }
+
+        if (!writeIndex(entries, error)) return false;
+        collectGarbage(entries, dropped);
+        return true;
+    }
+
+    /**
+     * @brief Lists the recorded versions of file_path, oldest first.
+     */
+    bool list(const std::string &file_path, std::vector<BackupEntry> &out, std::string &error)
+    {
+        const std::string name = nameOf(file_path);
+        Lock lock;
+        if (!lockStore(lock, error)) return false;
+        std::vector<BackupEntry> entries;
+        if (!readIndex(entries, error)) return false;
+        out.clear();
+        for (const auto &e : entries)
+        {
+            if (e.name == name) out.push_back(e);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finds a version of file_path.
+     * @param selector "" = newest version whose content differs from current_hash,
+     *                 "~N" = N-th newest version (~0 is the newest),
+     *                 otherwise a hash prefix.
+     */
+    bool resolve(const std::string &file_path, const std::string &selector, const std::string &current_hash,
+                 BackupEntry &found, std::string &error)
+    {
+        std::vector<BackupEntry> entries;
+        if (!list(file_path, entries, error)) return false;
+
+        if (selector.empty())
+        {
+            for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            {
+                if (it->hash != current_hash) { found = *it; return true; }
+            }
+            error = "no earlier version of " + file_path + " in " + m_dir;
+            return false;
+        }
+        if (selector[0] == '~')
+        {
+            const size_t n = std::strtoul(selector.c_str() + 1, nullptr, 10);
+            if (n >= entries.size())
+            {
+                error = "only " + std::to_string(entries.size()) + " version(s) of " + file_path + " recorded";
+                return false;
+            }
+            found = entries[entries.size() - 1 - n];
+            return true;
+        }
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+        {
+            if (it->hash.compare(0, selector.size(), selector) == 0) { found = *it; return true; }
+        }
+        error = "no version of " + file_path + " matches '" + selector + "'";
+        return false;
+    }
+
+    /**
+     * @brief Reads an object and verifies it against its hash.
+     */
+    bool load(const std::string &hash, std::string &content, std::string &error)
+    {
+        std::ifstream in(objectPath(hash), std::ios::binary);
+        if (!in)
+        {
+            error = "missing object " + hash;
+            return false;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        content = ss.str();
+        if (Sha256::hex(content) != hash)
+        {
+            error = "object " + hash + " is corrupt";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Lock
+    {
+        int fd = -1;
+        ~Lock()
+        {
+            if (fd != -1)
+            {
+                flock(fd, LOCK_UN);
+                close(fd);
+            }
+        }
+    };
+
+    std::string indexPath() const { return m_dir + "/index"; }
+    std::string objectPath(const std::string &hash) const { return m_dir + "/objects/" + hash; }
+
+    bool lockStore(Lock &lock, std::string &error)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(m_dir + "/objects", ec);
+        if (ec)
+        {
+            error = "cannot create " + m_dir + ": " + ec.message();
+            return false;
+        }
+        lock.fd = open((m_dir + "/lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (lock.fd == -1 || flock(lock.fd, LOCK_EX) == -1)
+        {
+            error = "cannot lock " + m_dir;
+            return false;
+        }
+        return true;
+    }
+
+    static std::string formatEntry(const BackupEntry &e)
+    {
+        return std::to_string(e.epoch) + " " + e.hash + " " + std::to_string(e.size) + " " + e.name;
+    }
+
+    bool readIndex(std::vector<BackupEntry> &entries, std::string &error)
+    {
+        (void)error;
+        entries.clear();
+        std::ifstream in(indexPath());
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream ls(line);
+            BackupEntry e;
+            if (!(ls >> e.epoch >> e.hash >> e.size)) continue;
+            ls.get();
+            std::getline(ls, e.name);
+            if (e.hash.size() == 64 && !e.name.empty()) entries.push_back(e);
+        }
+        return true;
+    }
+
+    bool writeIndex(const std::vector<BackupEntry> &entries, std::string &error)
+    {
+        std::string text;
+        for (const auto &e : entries) text += formatEntry(e) + "\n";
+        return writeAtomically(indexPath(), text, error);
+    }
+
+    static bool writeAtomically(const std::string &path, const std::string &content, std::string &error)
+    {
+        const std::string temp_path = path + ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                error = "cannot write " + temp_path;
+                return false;
+            }
+            out << content;
+            if (!out)
+            {
+                error = "short write to " + temp_path;
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec)
+        {
+            error = "cannot rename " + temp_path + ": " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    // Drops versions of one file beyond the policy; the newest version is always kept
+    static void prune(std::vector<BackupEntry> &entries, const std::string &name, const BackupPolicy &policy,
+                      std::vector<BackupEntry> &dropped)
+    {
+        const long long now = static_cast<long long>(std::time(nullptr));
+        size_t seen = 0;
+        std::vector<bool> remove(entries.size(), false);
+        for (size_t i = entries.size(); i-- > 0;)
+        {
+            if (entries[i].name != name) continue;
+            ++seen;
+            if (seen == 1) continue;
+            if (policy.keep > 0 && seen > policy.keep) remove[i] = true;
+            if (policy.max_age_sec > 0 && now - entries[i].epoch > policy.max_age_sec) remove[i] = true;
+        }
+        std::vector<BackupEntry> kept;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (remove[i]) dropped.push_back(entries[i]);
+            else kept.push_back(entries[i]);
+        }
+        entries.swap(kept);
+    }
+
+    void collectGarbage(const std::vector<BackupEntry> &entries, const std::vector<BackupEntry> &dropped)
+    {
+        std::set<std::string> live;
+        for (const auto &e : entries) live.insert(e.hash);
+        for (const auto &e : dropped)
+        {
+            if (live.count(e.hash)) continue;
+            std::error_code ec;
+            std::filesystem::remove(objectPath(e.hash), ec);
+        }
+    }
+
+    std::string m_dir;
+};
+
+} // namespace de_config
+
+#endif // DE_BACKUP_STORE_HPP
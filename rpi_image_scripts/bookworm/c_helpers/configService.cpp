@@ -0,0 +1,440 @@
+//g++ -o configService configService.cpp -std=c++17 -lstdc++fs
+//
+// Long-running config service for DroneEngage modules.
+// Watches the module config directories with inotify, keeps every parsed
+// config in memory and serves values over a local UNIX socket. When a file
+// changes (e.g. rewritten by updateConfig) subscribers receive the full set
+// of changed values as one CHANGE ... END block so they can hot-reload.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <filesystem>
+
+#include "json_patch.hpp"
+
+#define DEFAULT_CONFIG_ROOT "/home/pi/drone_engage"
+#define DEFAULT_SOCKET_PATH "/tmp/de_config_service.sock"
+#define DEFAULT_FILE_PATTERN "*.config.module.json"
+
+// Clients that fall this far behind are disconnected instead of buffering forever
+#define MAX_CLIENT_BACKLOG (1024 * 1024)
+
+// One parsed config file: its text and the span of every value by path
+struct ConfigDoc {
+    std::string content;
+    std::map<std::string, std::pair<size_t, size_t>> values; // path -> [begin, end)
+    std::set<std::string> leaves;                            // scalars and empty containers
+    unsigned long version = 0;
+};
+
+struct Client {
+    int fd = -1;
+    std::string in;
+    std::string out;
+    std::set<std::string> subscriptions; // file keys, "*" = all
+};
+
+volatile sig_atomic_t g_running = 1;
+
+void signal_handler(int signal_num) {
+    (void)signal_num;
+    g_running = 0;
+}
+
+// Function to parse a config into a ConfigDoc
+bool parseConfig(const std::string& content, ConfigDoc& doc, std::string& error) {
+    class Indexer : public de_config::JsonVisitor {
+    public:
+        explicit Indexer(ConfigDoc& d) : m_doc(d) {}
+        void leave(const de_config::JsonPath& path, de_config::JsonKind kind, size_t begin, size_t end) override {
+            const std::string key = de_config::joinPath(path);
+            m_doc.values[key] = std::make_pair(begin, end);
+            const bool container = (kind == de_config::JsonKind::Object || kind == de_config::JsonKind::Array);
+            if (!container || m_children.count(key) == 0) {
+                m_doc.leaves.insert(key);
+            }
+            if (!path.empty()) {
+                de_config::JsonPath parent(path.begin(), path.end() - 1);
+                m_children.insert(de_config::joinPath(parent));
+            }
+        }
+    private:
+        ConfigDoc& m_doc;
+        std::set<std::string> m_children; // containers that have at least one child
+    };
+
+    doc.content = content;
+    doc.values.clear();
+    doc.leaves.clear();
+    Indexer indexer(doc);
+    de_config::JsonScanner scanner(doc.content);
+    if (!scanner.scan(indexer)) {
+        error = scanner.error();
+        return false;
+    }
+    return true;
+}
+
+std::string valueOf(const ConfigDoc& doc, const std::string& path) {
+    auto it = doc.values.find(path);
+    if (it == doc.values.end()) return std::string();
+    return de_config::compactJson(doc.content, it->second.first, it->second.second);
+}
+
+class ConfigService {
+public:
+    ConfigService(const std::vector<std::string>& roots, const std::string& socket_path, const std::string& pattern)
+        : m_roots(roots), m_socket_path(socket_path), m_pattern(pattern) {}
+
+    ~ConfigService() {
+        for (auto& c : m_clients) close(c.fd);
+        if (m_listen_fd != -1) {
+            close(m_listen_fd);
+            unlink(m_socket_path.c_str());
+        }
+        if (m_inotify_fd != -1) close(m_inotify_fd);
+    }
+
+    bool start() {
+        m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify_fd == -1) {
+            std::cerr << "Error: inotify_init1 failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        for (const auto& root : m_roots) {
+            watchDirectory(root, true);
+        }
+
+        m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_listen_fd == -1) {
+            std::cerr << "Error: socket failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (m_socket_path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Error: Socket path too long: " << m_socket_path << std::endl;
+            return false;
+        }
+        std::strncpy(addr.sun_path, m_socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(m_socket_path.c_str());
+        if (bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(m_listen_fd, 16) == -1) {
+            std::cerr << "Error: Failed to listen on " << m_socket_path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        fcntl(m_listen_fd, F_SETFL, O_NONBLOCK);
+        std::cout << "Serving " << m_docs.size() << " config file(s) on " << m_socket_path << std::endl;
+        return true;
+    }
+
+    void run() {
+        while (g_running) {
+            std::vector<pollfd> fds;
+            fds.push_back({m_inotify_fd, POLLIN, 0});
+            fds.push_back({m_listen_fd, POLLIN, 0});
+            for (const auto& c : m_clients) {
+                short events = POLLIN;
+                if (!c.out.empty()) events |= POLLOUT;
+                fds.push_back({c.fd, events, 0});
+            }
+
+            if (poll(fds.data(), fds.size(), 1000) == -1) {
+                if (errno == EINTR) continue;
+                std::cerr << "Error: poll failed: " << strerror(errno) << std::endl;
+                return;
+            }
+
+            if (fds[0].revents & POLLIN) handleInotify();
+            if (fds[1].revents & POLLIN) acceptClients();
+
+            std::set<int> dead;
+            for (size_t i = 2; i < fds.size(); ++i) {
+                Client* c = findClient(fds[i].fd);
+                if (!c) continue;
+                if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) { dead.insert(c->fd); continue; }
+                if ((fds[i].revents & POLLIN) && !readClient(*c)) { dead.insert(c->fd); continue; }
+                if ((fds[i].revents & POLLOUT) && !flushClient(*c)) dead.insert(c->fd);
+            }
+            for (size_t i = 0; i < m_clients.size();) {
+                if (dead.count(m_clients[i].fd) || m_clients[i].out.size() > MAX_CLIENT_BACKLOG) {
+                    close(m_clients[i].fd);
+                    m_clients.erase(m_clients.begin() + i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+    }
+
+private:
+    // Function to watch a directory and load its configs; module folders one level down are watched too
+    void watchDirectory(const std::string& dir, bool descend) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+        int wd = inotify_add_watch(m_inotify_fd, dir.c_str(), mask & ~IN_ONLYDIR);
+        if (wd == -1) {
+            std::cerr << "Warning: Cannot watch " << dir << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        m_watches[wd] = dir;
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.is_directory(ec)) {
+                if (descend && entry.path().filename().string()[0] != '.') watchDirectory(entry.path().string(), false);
+            } else if (matches(entry.path().filename().string())) {
+                reload(entry.path().string());
+            }
+        }
+    }
+
+    bool matches(const std::string& name) const {
+        return fnmatch(m_pattern.c_str(), name.c_str(), 0) == 0;
+    }
+
+    // Config files are addressed by path relative to the watched root, e.g. de_comm/de_comm.config.module.json
+    std::string keyOf(const std::string& path) const {
+        for (const auto& root : m_roots) {
+            std::string prefix = root;
+            if (prefix.back() != '/') prefix += '/';
+            if (path.compare(0, prefix.size(), prefix) == 0) return path.substr(prefix.size());
+        }
+        return path;
+    }
+
+    void handleInotify() {
+        alignas(inotify_event) char buffer[8192];
+        while (true) {
+            ssize_t len = read(m_inotify_fd, buffer, sizeof(buffer));
+            if (len <= 0) return;
+            for (char* p = buffer; p < buffer + len;) {
+                const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                auto dir = m_watches.find(ev->wd);
+                if (dir == m_watches.end() || ev->len == 0) continue;
+                const std::string name = ev->name;
+                const std::string path = dir->second + "/" + name;
+
+                if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    bool is_root = false;
+                    for (const auto& root : m_roots) is_root |= (dir->second == root);
+                    if (is_root && name[0] != '.') watchDirectory(path, false);
+                    continue;
+                }
+                if (!matches(name)) continue;
+                if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) reload(path);
+                else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) remove(path);
+            }
+        }
+    }
+
+    // Function to re-read a file and notify subscribers of the values that changed
+    void reload(const std::string& path) {
+        std::ifstream ifs(path);
+        if (!ifs.is_open()) return;
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+
+        const std::string key = keyOf(path);
+        auto existing = m_docs.find(key);
+        if (existing != m_docs.end() && existing->second.content == ss.str()) return;
+
+        ConfigDoc doc;
+        std::string error;
+        if (!parseConfig(ss.str(), doc, error)) {
+            std::cerr << "Warning: Keeping previous version of " << key << ", parse failed: " << error << std::endl;
+            return;
+        }
+
+        std::vector<std::string> lines;
+        if (existing == m_docs.end()) {
+            for (const auto& leaf : doc.leaves) lines.push_back("SET " + leaf + " " + valueOf(doc, leaf));
+            doc.version = 1;
+        } else {
+            const ConfigDoc& old = existing->second;
+            for (const auto& leaf : doc.leaves) {
+                std::string value = valueOf(doc, leaf);
+                if (!old.leaves.count(leaf) || valueOf(old, leaf) != value) lines.push_back("SET " + leaf + " " + value);
+            }
+            for (const auto& leaf : old.leaves) {
+                if (!doc.leaves.count(leaf)) lines.push_back("DEL " + leaf);
+            }
+            doc.version = old.version + 1;
+        }
+
+        const bool first_load = (existing == m_docs.end());
+        m_docs[key] = std::move(doc);
+        if (lines.empty()) return;
+        std::cout << (first_load ? "Loaded " : "Reloaded ") << key << " (version " << m_docs[key].version << ", " << lines.size() << " value(s) changed)" << std::endl;
+        notify(key, m_docs[key].version, lines);
+    }
+
+    void remove(const std::string& path) {
+        const std::string key = keyOf(path);
+        auto it = m_docs.find(key);
+        if (it == m_docs.end()) return;
+        std::vector<std::string> lines;
+        for (const auto& leaf : it->second.leaves) lines.push_back("DEL " + leaf);
+        const unsigned long version = it->second.version + 1;
+        m_docs.erase(it);
+        std::cout << "Removed " << key << std::endl;
+        notify(key, version, lines);
+    }
+
+    // The whole change set is queued as one block so a subscriber never sees half an update
+    void notify(const std::string& key, unsigned long version, const std::vector<std::string>& lines) {
+        std::string block = "CHANGE " + key + " " + std::to_string(version) + " " + std::to_string(lines.size()) + "\n";
+        for (const auto& line : lines) block += line + "\n";
+        block += "END " + key + " " + std::to_string(version) + "\n";
+        for (auto& c : m_clients) {
+            if (c.subscriptions.count("*") || c.subscriptions.count(key)) {
+                c.out += block;
+                flushClient(c);
+            }
+        }
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) return;
+            Client c;
+            c.fd = fd;
+            m_clients.push_back(c);
+        }
+    }
+
+    Client* findClient(int fd) {
+        for (auto& c : m_clients) {
+            if (c.fd == fd) return &c;
+        }
+        return nullptr;
+    }
+
+    bool readClient(Client& c) {
+        char buffer[4096];
+        ssize_t len = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (len <= 0) return len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        c.in.append(buffer, len);
+        size_t nl;
+        while ((nl = c.in.find('\n')) != std::string::npos) {
+            std::string line = c.in.substr(0, nl);
+            c.in.erase(0, nl + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            handleRequest(c, line);
+        }
+        return c.in.size() < 65536 && flushClient(c);
+    }
+
+    bool flushClient(Client& c) {
+        while (!c.out.empty()) {
+            ssize_t sent = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            if (sent == -1) return errno == EAGAIN || errno == EWOULDBLOCK;
+            c.out.erase(0, sent);
+        }
+        return true;
+    }
+
+    // Requests: LIST | GET <file> [<path>] | VERSION <file> | SUB <file|*> | UNSUB <file|*>
+    void handleRequest(Client& c, const std::string& line) {
+        std::istringstream ls(line);
+        std::string cmd, key, path;
+        ls >> cmd >> key >> path;
+
+        if (cmd == "LIST") {
+            std::string files;
+            for (const auto& doc : m_docs) files += " " + doc.first;
+            c.out += "OK" + files + "\n";
+            return;
+        }
+        if (cmd == "SUB" || cmd == "UNSUB") {
+            if (key.empty()) { c.out += "ERR missing file\n"; return; }
+            if (cmd == "SUB") c.subscriptions.insert(key);
+            else c.subscriptions.erase(key);
+            c.out += "OK\n";
+            return;
+        }
+        if (cmd == "GET" || cmd == "VERSION") {
+            auto doc = m_docs.find(key);
+            if (doc == m_docs.end()) { c.out += "ERR unknown file " + key + "\n"; return; }
+            if (cmd == "VERSION") { c.out += "OK " + std::to_string(doc->second.version) + "\n"; return; }
+            if (!doc->second.values.count(path)) { c.out += "ERR unknown path " + path + "\n"; return; }
+            c.out += "OK " + valueOf(doc->second, path) + "\n";
+            return;
+        }
+        c.out += "ERR unknown command\n";
+    }
+
+    std::vector<std::string> m_roots;
+    std::string m_socket_path;
+    std::string m_pattern;
+    int m_inotify_fd = -1;
+    int m_listen_fd = -1;
+    std::map<int, std::string> m_watches;
+    std::map<std::string, ConfigDoc> m_docs;
+    std::vector<Client> m_clients;
+};
+
+void printUsage(const char* app) {
+    std::cerr << "Usage: " << app << " [--dir DIR]... [--socket PATH] [--pattern GLOB]" << std::endl;
+    std::cerr << "  --dir DIR       Config root; DIR and its module folders are watched (default " << DEFAULT_CONFIG_ROOT << ")" << std::endl;
+    std::cerr << "  --socket PATH   UNIX socket to serve on (default " << DEFAULT_SOCKET_PATH << ")" << std::endl;
+    std::cerr << "  --pattern GLOB  Config file name pattern (default " << DEFAULT_FILE_PATTERN << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> roots;
+    std::string socket_path = DEFAULT_SOCKET_PATH;
+    std::string pattern = DEFAULT_FILE_PATTERN;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--dir" || arg == "--socket" || arg == "--pattern") && (i + 1 >= argc || argv[i + 1][0] == '\0')) {
+            std::cerr << "Error: " << arg << " requires a value" << std::endl;
+            return 1;
+        }
+        if (arg == "--dir") {
+            std::string dir = argv[++i];
+            while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+            roots.push_back(dir);
+        } else if (arg == "--socket") {
+            socket_path = argv[++i];
+        } else if (arg == "--pattern") {
+            pattern = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (roots.empty()) roots.push_back(DEFAULT_CONFIG_ROOT);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    ConfigService service(roots, socket_path, pattern);
+    if (!service.start()) {
+        return 1;
+    }
+    service.run();
+    std::cout << "Config service stopped." << std::endl;
+    return 0;
+}
@@ -0,0 +1,183 @@
+//g++ -o deBackup deBackup.cpp -std=c++17 -O2 -lstdc++fs
+
+// Hardlinked backup generations for DroneEngage module folders (see module_backup.hpp).
+// Used by updates/sh_update_de_modules.sh and deUpdater before installing a module:
+// unchanged files are linked to the previous generation, so only changed files are
+// written. A generation can be verified against its manifest hashes and restored by
+// relinking it into place.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+
+#include "module_backup.hpp"
+
+#define DEFAULT_BASE_PATH "/home/pi/drone_engage"
+#define DEFAULT_BACKUP_DIR "/home/pi/drone_engage_backups"
+#define VERSION_DIR_NAME ".versions"
+#define DEFAULT_KEEP 3
+
+std::string trimVersion(const std::string& path) {
+    std::ifstream in(path);
+    std::string version;
+    std::getline(in, version);
+    while (!version.empty() && (version.back() == '\r' || version.back() == ' ')) version.pop_back();
+    return version;
+}
+
+std::string formatSize(uint64_t bytes) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    if (bytes >= (1u << 20)) ss << bytes / 1048576.0 << " MiB";
+    else ss << bytes / 1024.0 << " KiB";
+    return ss.str();
+}
+
+void printUsage(const char* app) {
+    std::cerr << "Usage: " << app << " [--base DIR] [--backup-dir DIR] [--keep N] <command> ..." << std::endl;
+    std::cerr << "  backup  <module> [--version V]   Record the installed module as a new generation" << std::endl;
+    std::cerr << "  list    [module]...              List generations" << std::endl;
+    std::cerr << "  verify  <module> [generation]    Check a generation against its manifest hashes" << std::endl;
+    std::cerr << "  restore <module> [generation]    Copy a generation into place (default: latest)" << std::endl;
+    std::cerr << "  Generation: name (or unique prefix), 'latest', or -N for the N-th before the latest." << std::endl;
+    std::cerr << "Example: " << app << " backup de_camera" << std::endl;
+    std::cerr << "Example: " << app << " restore de_camera -1" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string base = DEFAULT_BASE_PATH;
+    std::string backup_dir = DEFAULT_BACKUP_DIR;
+    size_t keep = DEFAULT_KEEP;
+    std::string version;
+    bool version_given = false;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--base" || arg == "--backup-dir" || arg == "--keep" || arg == "--version") && (i + 1 >= argc || argv[i + 1][0] == '\0')) {
+            std::cerr << "Error: " << arg << " requires a value" << std::endl;
+            return 1;
+        }
+        if (arg == "--base" || arg == "--backup-dir") {
+            std::string dir = argv[++i];
+            while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+            (arg == "--base" ? base : backup_dir) = dir;
+        } else if (arg == "--keep") {
+            keep = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--version") {
+            version = argv[++i];
+            version_given = true;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string command = args[0];
+    de_config::ModuleBackup store(backup_dir);
+    std::error_code ec;
+
+    if (command == "list") {
+        std::vector<std::string> modules(args.begin() + 1, args.end());
+        if (modules.empty()) {
+            for (const auto& entry : std::filesystem::directory_iterator(backup_dir, ec)) {
+                if (entry.is_directory(ec)) modules.push_back(entry.path().filename().string());
+            }
+            std::sort(modules.begin(), modules.end());
+        }
+        for (const auto& module : modules) {
+            const auto generations = store.list(module);
+            if (generations.empty()) continue;
+            std::cout << module << ":" << std::endl;
+            for (size_t i = generations.size(); i-- > 0;) {
+                const auto& gen = generations[i];
+                std::cout << "  " << std::left << std::setw(20) << gen.name << std::setw(12) << (gen.version.empty() ? "-" : gen.version)
+                          << std::right << std::setw(6) << gen.files << " files  " << formatSize(gen.bytes) << std::endl;
+            }
+        }
+        return 0;
+    }
+
+    if (args.size() < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const std::string module = args[1];
+    const std::string module_dir = base + "/" + module;
+    const std::string version_file = base + "/" VERSION_DIR_NAME "/" + module + ".version";
+
+    if (command == "backup") {
+        if (!std::filesystem::is_directory(module_dir, ec)) {
+            std::cerr << "Error: " << module_dir << " does not exist" << std::endl;
+            return 1;
+        }
+        if (!version_given) version = trimVersion(version_file);
+        const auto start = std::chrono::steady_clock::now();
+        de_config::BackupGeneration gen;
+        de_config::GenerationStats stats;
+        std::string error;
+        if (!store.create(module, module_dir, version, keep, gen, stats, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Backup " << module << "/" << gen.name << ": " << stats.files << " files, " << stats.linked << " linked ("
+                  << formatSize(stats.linked_bytes) << "), " << stats.copied << " copied (" << formatSize(stats.copied_bytes) << ") in "
+                  << static_cast<long>(ms) << " ms" << std::endl;
+        return 0;
+    }
+
+    de_config::BackupGeneration gen;
+    const std::string selector = args.size() > 2 ? args[2] : "latest";
+    if (!store.find(module, selector, gen)) {
+        std::cerr << "Error: no generation '" << selector << "' for " << module << " in " << backup_dir << std::endl;
+        return 1;
+    }
+
+    if (command == "verify") {
+        std::vector<std::string> bad;
+        std::string error;
+        if (!store.verify(gen, bad, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        for (const auto& path : bad) std::cout << "MISMATCH " << path << std::endl;
+        std::cout << module << "/" << gen.name << ": " << (bad.empty() ? "OK" : std::to_string(bad.size()) + " file(s) differ") << std::endl;
+        return bad.empty() ? 0 : 2;
+    }
+
+    if (command == "restore") {
+        const auto start = std::chrono::steady_clock::now();
+        std::string error;
+        if (!store.restore(gen, module_dir, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        if (!gen.version.empty()) {
+            std::filesystem::create_directories(base + "/" VERSION_DIR_NAME, ec);
+            std::ofstream(version_file) << gen.version << "\n";
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Restored " << module << " from " << gen.name << (gen.version.empty() ? "" : " (version " + gen.version + ")")
+                  << ": " << gen.files << " files in " << static_cast<long>(ms) << " ms" << std::endl;
+        return 0;
+    }
+
+    std::cerr << "Error: Unknown command " << command << std::endl;
+    printUsage(argv[0]);
+    return 1;
+}
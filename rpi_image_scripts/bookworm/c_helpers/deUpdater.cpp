@@ -0,0 +1,1030 @@
+//g++ -o deUpdater deUpdater.cpp -std=c++17 -O2 -lcurl -lz -lstdc++fs
+
+// Parallel OTA updater for DroneEngage modules (C++ counterpart of updates/sh_update_de_modules.sh).
+// All modules are checked and downloaded concurrently on one libcurl multi handle. Each
+// tarball is hashed and gunzipped while it streams in and its tar entries are written
+// straight into a staging directory, so the archive is never stored or read back. A module
+// is only swapped in (atomically, with renameat2 RENAME_EXCHANGE) once its SHA-256 matches.
+// When the server publishes a delta from the installed version (see de_delta.hpp), only the
+// delta is downloaded and the new tree is rebuilt from the installed one; any mismatch falls
+// back to the full tarball.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+#include <fcntl.h>    // For open, renameat2 flags
+#include <unistd.h>   // For write, close, geteuid
+#include <pwd.h>      // For the pi user
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include "sha256.hpp"
+#include "de_delta.hpp"
+#include "module_backup.hpp"
+
+#define DEFAULT_BASE_PATH "/home/pi/drone_engage"
+#define DEFAULT_BACKUP_DIR "/home/pi/drone_engage_backups"
+#define VERSION_DIR_NAME ".versions"
+#define STAGING_DIR_NAME ".de_update"   // inside the base path, so swaps stay on one filesystem
+#define BACKUPS_TO_KEEP 3              // backup generations per module
+#define DEFAULT_JOBS 8                  // concurrent transfers
+#define LATEST_TIMEOUT_SEC 10           // same as the script's curl --max-time 10
+#define STALL_TIMEOUT_SEC 30            // abort a download that makes no progress for this long
+#define MAX_DELTA_BYTES (256u << 20)    // deltas are buffered in memory and verified before use
+#define MODULE_OWNER "pi"
+
+const char* DEFAULT_MODULES[] = {"de_camera", "de_comm", "de_mavlink", "de_rpi_gpio", "de_tracking", "de_sdr"};
+
+// Log a timestamped line like the update script's logc()
+void logLine(std::ostream& os, const std::string& message) {
+    char when[16];
+    std::time_t now = std::time(nullptr);
+    std::strftime(when, sizeof(when), "%H:%M:%S", std::localtime(&now));
+    os << "[" << when << "] " << message << std::endl;
+}
+
+// Streaming tar (ustar/GNU/pax) extractor writing entries below a root directory
+class TarExtractor {
+public:
+    void reset(const std::string& root) {
+        m_root = root;
+        m_header_fill = 0;
+        m_remaining = 0;
+        m_padding = 0;
+        m_fd = -1;
+        m_mode = Mode::Header;
+        m_long_name.clear();
+        m_pax_path.clear();
+        m_error.clear();
+        m_files = 0;
+        m_ended = false;
+        m_symlinks.clear();
+    }
+
+    ~TarExtractor() { closeFile(); }
+
+    // Feed the next decompressed bytes; returns false on a malformed or unsafe archive
+    bool feed(const char* data, size_t size) {
+        while (size > 0 && m_error.empty()) {
+            if (m_ended) return true; // trailing zero blocks and padding
+            if (m_mode == Mode::Header) {
+                const size_t take = std::min(size, sizeof(m_header) - m_header_fill);
+                std::memcpy(m_header + m_header_fill, data, take);
+                m_header_fill += take;
+                data += take;
+                size -= take;
+                if (m_header_fill == sizeof(m_header)) {
+                    m_header_fill = 0;
+                    if (!startEntry()) break;
+                }
+                continue;
+            }
+            if (m_remaining > 0) {
+                const size_t take = static_cast<size_t>(std::min<uint64_t>(size, m_remaining));
+                if (!consumeData(data, take)) break;
+                m_remaining -= take;
+                data += take;
+                size -= take;
+                if (m_remaining == 0 && !finishEntry()) break;
+                continue;
+            }
+            const size_t take = static_cast<size_t>(std::min<uint64_t>(size, m_padding));
+            m_padding -= take;
+            data += take;
+            size -= take;
+            if (m_padding == 0) m_mode = Mode::Header;
+        }
+        return m_error.empty();
+    }
+
+    bool finish() {
+        if (m_error.empty() && (m_mode != Mode::Header || m_header_fill != 0) && !m_ended) {
+            m_error = "archive is truncated";
+        }
+        closeFile();
+        // Symlinks last, like GNU tar's delayed links: no entry can be written through one
+        for (const auto& entry : m_symlinks) {
+            if (!m_error.empty()) break;
+            if (!parentsAreDirectories(entry.first)) {
+                fail("symlink below a symlink in archive: " + entry.first);
+                break;
+            }
+            const std::string target = m_root + "/" + entry.first;
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::path(target).parent_path(), ec);
+            std::filesystem::remove(target, ec);
+            if (symlink(entry.second.c_str(), target.c_str()) != 0) fail("cannot create symlink " + target);
+        }
+        m_symlinks.clear();
+        return m_error.empty();
+    }
+
+    const std::string& error() const { return m_error; }
+    size_t files() const { return m_files; }
+
+private:
+    enum class Mode { Header, Data };
+    enum class Entry { File, LongName, PaxHeader, Skip };
+
+    static uint64_t parseOctal(const char* field, size_t size) {
+        // GNU base-256 encoding for large sizes
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            uint64_t value = 0;
+            for (size_t i = 1; i < size; ++i) value = (value << 8) | static_cast<unsigned char>(field[i]);
+            return value;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < size && field[i]; ++i) {
+            if (field[i] == ' ') continue;
+            if (field[i] < '0' || field[i] > '7') break;
+            value = value * 8 + (field[i] - '0');
+        }
+        return value;
+    }
+
+    static std::string field(const char* data, size_t size) {
+        return std::string(data, strnlen(data, size));
+    }
+
+    // Rejects absolute paths and ".." so an archive cannot write outside the staging root
+    bool safePath(const std::string& path) {
+        if (path.empty() || path[0] == '/') return false;
+        std::istringstream parts(path);
+        std::string part;
+        while (std::getline(parts, part, '/')) {
+            if (part == "..") return false;
+        }
+        return true;
+    }
+
+    // True if no existing component above rel (inside the root) is a symlink or a non-directory
+    bool parentsAreDirectories(const std::string& rel) const {
+        std::string prefix = m_root;
+        std::istringstream parts(rel);
+        std::string part;
+        std::vector<std::string> components;
+        while (std::getline(parts, part, '/')) {
+            if (!part.empty() && part != ".") components.push_back(part);
+        }
+        for (size_t i = 0; i + 1 < components.size(); ++i) {
+            prefix += "/" + components[i];
+            struct stat st;
+            if (lstat(prefix.c_str(), &st) != 0) return errno == ENOENT; // the rest gets created as directories
+            if (!S_ISDIR(st.st_mode)) return false;
+        }
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        m_error = message;
+        closeFile();
+        return false;
+    }
+
+    bool startEntry() {
+        bool zero = true;
+        for (char c : m_header) {
+            if (c) { zero = false; break; }
+        }
+        if (zero) {
+            m_ended = true;
+            return true;
+        }
+
+        unsigned int sum = 0;
+        for (size_t i = 0; i < sizeof(m_header); ++i) {
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(m_header[i]);
+        }
+        if (sum != parseOctal(m_header + 148, 8)) return fail("bad tar header checksum");
+
+        std::string path = field(m_header, 100);
+        if (std::memcmp(m_header + 257, "ustar", 5) == 0 && m_header[345]) {
+            path = field(m_header + 345, 155) + "/" + path;
+        }
+        if (!m_pax_path.empty()) path = m_pax_path;
+        if (!m_long_name.empty()) path = m_long_name;
+        const char type = m_header[156];
+        if (type != 'L' && type != 'x') {
+            m_long_name.clear();
+            m_pax_path.clear();
+        }
+
+        const uint64_t size = parseOctal(m_header + 124, 12);
+        const mode_t mode = static_cast<mode_t>(parseOctal(m_header + 100, 8)) & 0777;
+        m_mtime = static_cast<time_t>(parseOctal(m_header + 136, 12));
+        m_remaining = size;
+        m_padding = (512 - size % 512) % 512;
+        m_text.clear();
+        m_entry = Entry::Skip;
+
+        while (path.size() > 2 && path.compare(0, 2, "./") == 0) path.erase(0, 2);
+        if (type == 'L') {
+            m_entry = Entry::LongName;
+        } else if (type == 'x') {
+            m_entry = Entry::PaxHeader;
+        } else if (type == 'g' || path.empty() || path == "." || path == "./") {
+            m_entry = Entry::Skip;
+        } else if (!safePath(path)) {
+            return fail("unsafe path in archive: " + path);
+        } else if (!parentsAreDirectories(path)) {
+            return fail("path below a symlink or file in archive: " + path);
+        } else {
+            const std::string target = m_root + "/" + path;
+            std::error_code ec;
+            struct stat existing;
+            if (lstat(target.c_str(), &existing) == 0 && S_ISLNK(existing.st_mode)) {
+                return fail("archive entry replaces a symlink: " + path);
+            }
+            if (type == '5') {
+                std::filesystem::create_directories(target, ec);
+                if (ec) return fail("cannot create " + target + ": " + ec.message());
+                chmod(target.c_str(), mode | 0700);
+            } else if (type == '2' || type == '1') {
+                std::filesystem::create_directories(std::filesystem::path(target).parent_path(), ec);
+                std::string link = field(m_header + 157, 100);
+                while (link.size() > 2 && link.compare(0, 2, "./") == 0) link.erase(0, 2);
+                if (type == '2') {
+                    m_symlinks.emplace_back(path, link); // created by finish()
+                } else {
+                    // The source must be a regular file inside the root, reached without symlinks
+                    struct stat source;
+                    const std::string source_path = m_root + "/" + link;
+                    if (!safePath(link) || !parentsAreDirectories(link) || lstat(source_path.c_str(), &source) != 0 ||
+                        !S_ISREG(source.st_mode)) {
+                        return fail("unsafe hard link in archive: " + path + " -> " + link);
+                    }
+                    std::filesystem::remove(target, ec);
+                    if (::link(source_path.c_str(), target.c_str()) != 0) return fail("cannot create hard link " + target);
+                }
+            } else if (type == '0' || type == '\0' || type == '7') {
+                std::filesystem::create_directories(std::filesystem::path(target).parent_path(), ec);
+                m_fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, mode | 0600);
+                if (m_fd == -1) return fail("cannot create " + target + ": " + std::strerror(errno));
+                m_entry = Entry::File;
+                ++m_files;
+            }
+        }
+
+        m_mode = Mode::Data;
+        if (m_remaining == 0) return finishEntry();
+        return true;
+    }
+
+    bool consumeData(const char* data, size_t size) {
+        if (m_entry == Entry::File) {
+            while (size > 0) {
+                const ssize_t n = write(m_fd, data, size);
+                if (n <= 0) return fail(std::string("write failed: ") + std::strerror(errno));
+                data += n;
+                size -= static_cast<size_t>(n);
+            }
+        } else if (m_entry == Entry::LongName || m_entry == Entry::PaxHeader) {
+            if (m_text.size() + size > 1 << 20) return fail("oversized tar metadata");
+            m_text.append(data, size);
+        }
+        return true;
+    }
+
+    bool finishEntry() {
+        if (m_entry == Entry::File) {
+            // Keep the archive mtime like tar -x does
+            const struct timespec times[2] = {{m_mtime, 0}, {m_mtime, 0}};
+            futimens(m_fd, times);
+            closeFile();
+        } else if (m_entry == Entry::LongName) {
+            m_long_name = m_text.c_str();
+        } else if (m_entry == Entry::PaxHeader) {
+            // Records are "<length> key=value\n"
+            size_t pos = 0;
+            while (pos < m_text.size()) {
+                const size_t space = m_text.find(' ', pos);
+                if (space == std::string::npos) break;
+                const size_t length = std::strtoul(m_text.c_str() + pos, nullptr, 10);
+                if (length == 0 || pos + length > m_text.size()) break;
+                const std::string record = m_text.substr(space + 1, pos + length - space - 2);
+                if (record.compare(0, 5, "path=") == 0) m_pax_path = record.substr(5);
+                pos += length;
+            }
+        }
+        m_mode = Mode::Data;
+        if (m_padding == 0) m_mode = Mode::Header;
+        return true;
+    }
+
+    void closeFile() {
+        if (m_fd != -1) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    std::string m_root;
+    char m_header[512];
+    size_t m_header_fill = 0;
+    uint64_t m_remaining = 0;
+    uint64_t m_padding = 0;
+    int m_fd = -1;
+    time_t m_mtime = 0;
+    Mode m_mode = Mode::Header;
+    Entry m_entry = Entry::Skip;
+    std::string m_text;
+    std::string m_long_name;
+    std::string m_pax_path;
+    std::string m_error;
+    size_t m_files = 0;
+    bool m_ended = false;
+    std::vector<std::pair<std::string, std::string>> m_symlinks; // (path, target), created by finish()
+};
+
+// gunzip stage in front of the tar extractor
+class GzipTarStream {
+public:
+    GzipTarStream() { std::memset(&m_zs, 0, sizeof(m_zs)); }
+    ~GzipTarStream() { if (m_open) inflateEnd(&m_zs); }
+
+    bool begin(const std::string& root) {
+        if (m_open) inflateEnd(&m_zs);
+        std::memset(&m_zs, 0, sizeof(m_zs));
+        m_open = (inflateInit2(&m_zs, 16 + MAX_WBITS) == Z_OK); // 16: expect a gzip header
+        m_done = false;
+        m_error.clear();
+        m_tar.reset(root);
+        return m_open;
+    }
+
+    bool feed(const char* data, size_t size) {
+        if (!m_error.empty()) return false;
+        if (m_done) return true;
+        m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_zs.avail_in = static_cast<uInt>(size);
+        while (m_zs.avail_in > 0 && !m_done) {
+            m_zs.next_out = reinterpret_cast<Bytef*>(m_buffer);
+            m_zs.avail_out = sizeof(m_buffer);
+            const int rc = inflate(&m_zs, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+                m_error = std::string("gzip error: ") + (m_zs.msg ? m_zs.msg : "corrupt data");
+                return false;
+            }
+            const size_t produced = sizeof(m_buffer) - m_zs.avail_out;
+            if (produced && !m_tar.feed(m_buffer, produced)) {
+                m_error = m_tar.error();
+                return false;
+            }
+            if (rc == Z_STREAM_END) m_done = true;
+            if (rc == Z_BUF_ERROR && produced == 0) break;
+        }
+        return true;
+    }
+
+    bool finish() {
+        if (!m_error.empty()) return false;
+        if (!m_done) {
+            m_error = "gzip stream is truncated";
+            return false;
+        }
+        if (!m_tar.finish()) {
+            m_error = m_tar.error();
+            return false;
+        }
+        return true;
+    }
+
+    const std::string& error() const { return m_error; }
+    size_t files() const { return m_tar.files(); }
+
+private:
+    z_stream m_zs;
+    bool m_open = false;
+    bool m_done = false;
+    char m_buffer[64 * 1024];
+    std::string m_error;
+    TarExtractor m_tar;
+};
+
+enum class ModuleState {
+    Checking,   // waiting for _LATEST
+    Skipped,    // no _LATEST, or already installed
+    Downloading,
+    Verified,   // extracted to staging and hash matched; ready to swap in
+    Installed,
+    DryRun,
+    Failed
+};
+
+struct ModuleUpdate {
+    std::string name;
+    std::string local_version;
+    std::string version;
+    ModuleState state = ModuleState::Checking;
+    std::string message;
+
+    std::string staging_root;    // <base>/.de_update/<name>.<pid>
+    de_config::Sha256 sha;
+    GzipTarStream stream;
+    std::string expected_hash;
+    std::string actual_hash;
+    bool sum_done = false;
+    bool tarball_done = false;
+
+    enum class Delta { None, Pending, Abandoned } delta = Delta::None;
+    std::string delta_data;
+    std::string delta_hash;
+    bool delta_done = false;
+    bool delta_sum_done = false;
+    bool used_delta = false;
+    std::string delta_note;      // why the delta was not used
+    int dry_run_checks = 0;
+    uint64_t bytes = 0;
+    std::chrono::steady_clock::time_point started;
+    double download_ms = 0.0;
+};
+
+enum class TransferKind { Latest, Sum, Tarball, Delta, DeltaSum, HeadTarball, HeadSum };
+
+struct Transfer {
+    CURL* easy = nullptr;
+    ModuleUpdate* module = nullptr;
+    TransferKind kind;
+    std::string body;
+    std::string url;
+};
+
+struct UpdaterOptions {
+    std::string url_base;
+    std::string base = DEFAULT_BASE_PATH;
+    std::string backup_dir = DEFAULT_BACKUP_DIR;
+    std::vector<std::string> modules;  // empty = all installed + defaults
+    bool dry_run = false;
+    bool force = false;
+    bool backup = true;
+    bool delta = true;
+    long jobs = DEFAULT_JOBS;
+};
+
+std::string trim(const std::string& s) {
+    const size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return "";
+    const size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+size_t collectBody(char* data, size_t size, size_t nmemb, void* user) {
+    Transfer* t = static_cast<Transfer*>(user);
+    if (t->body.size() + size * nmemb > 4096) return 0; // _LATEST and .sha256 are tiny
+    t->body.append(data, size * nmemb);
+    return size * nmemb;
+}
+
+// Tarball bytes go through SHA-256 and gunzip+untar while they arrive
+size_t streamTarball(char* data, size_t size, size_t nmemb, void* user) {
+    Transfer* t = static_cast<Transfer*>(user);
+    ModuleUpdate* m = t->module;
+    const size_t n = size * nmemb;
+    if (m->state == ModuleState::Failed) return 0; // the staging directory is gone; abort the transfer
+    m->sha.update(data, n);
+    m->bytes += n;
+    if (!m->stream.feed(data, n)) return 0; // aborts the transfer
+    return n;
+}
+
+size_t collectDelta(char* data, size_t size, size_t nmemb, void* user) {
+    Transfer* t = static_cast<Transfer*>(user);
+    ModuleUpdate* m = t->module;
+    const size_t n = size * nmemb;
+    // Stop the body once the module failed or fell back to the full tarball
+    if (m->state == ModuleState::Failed || m->delta != ModuleUpdate::Delta::Pending) return 0;
+    if (m->delta_data.size() + n > MAX_DELTA_BYTES) return 0;
+    m->delta_data.append(data, n);
+    m->bytes += n;
+    return n;
+}
+
+// Function to queue one transfer on the multi handle
+void addTransfer(CURLM* multi, std::vector<std::unique_ptr<Transfer>>& transfers, ModuleUpdate* module,
+                 TransferKind kind, const std::string& url) {
+    std::unique_ptr<Transfer> t(new Transfer());
+    t->module = module;
+    t->kind = kind;
+    t->url = url;
+    t->easy = curl_easy_init();
+    curl_easy_setopt(t->easy, CURLOPT_URL, t->url.c_str());
+    curl_easy_setopt(t->easy, CURLOPT_PRIVATE, t.get());
+    curl_easy_setopt(t->easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(t->easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(t->easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(t->easy, CURLOPT_PIPEWAIT, 1L); // prefer multiplexing on an existing HTTP/2 connection
+    curl_easy_setopt(t->easy, CURLOPT_CONNECTTIMEOUT, static_cast<long>(LATEST_TIMEOUT_SEC));
+    if (kind == TransferKind::Tarball) {
+        curl_easy_setopt(t->easy, CURLOPT_WRITEFUNCTION, streamTarball);
+        curl_easy_setopt(t->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(t->easy, CURLOPT_LOW_SPEED_TIME, static_cast<long>(STALL_TIMEOUT_SEC));
+    } else if (kind == TransferKind::Delta) {
+        curl_easy_setopt(t->easy, CURLOPT_WRITEFUNCTION, collectDelta);
+        curl_easy_setopt(t->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(t->easy, CURLOPT_LOW_SPEED_TIME, static_cast<long>(STALL_TIMEOUT_SEC));
+    } else {
+        curl_easy_setopt(t->easy, CURLOPT_WRITEFUNCTION, collectBody);
+        curl_easy_setopt(t->easy, CURLOPT_TIMEOUT, static_cast<long>(LATEST_TIMEOUT_SEC));
+        if (kind == TransferKind::HeadTarball || kind == TransferKind::HeadSum) {
+            curl_easy_setopt(t->easy, CURLOPT_NOBODY, 1L);
+        }
+    }
+    curl_easy_setopt(t->easy, CURLOPT_WRITEDATA, t.get());
+    curl_multi_add_handle(multi, t->easy);
+    transfers.push_back(std::move(t));
+}
+
+void failModule(ModuleUpdate& m, const std::string& message) {
+    if (m.state == ModuleState::Failed) return;
+    m.state = ModuleState::Failed;
+    m.message = message;
+    logLine(std::cerr, "FAIL " + m.name + ": " + message);
+    if (!m.staging_root.empty()) {
+        std::error_code ec;
+        std::filesystem::remove_all(m.staging_root, ec);
+    }
+}
+
+// Function to check a downloaded module once both the tarball and its .sha256 are in
+void verifyModule(ModuleUpdate& m) {
+    if (!m.sum_done || !m.tarball_done || m.state != ModuleState::Downloading) return;
+    if (m.actual_hash != m.expected_hash) {
+        failModule(m, "checksum mismatch (expected " + m.expected_hash.substr(0, 12) + ", got " + m.actual_hash.substr(0, 12) + ")");
+        return;
+    }
+    std::error_code ec;
+    if (!std::filesystem::is_directory(m.staging_root + "/" + m.name, ec)) {
+        failModule(m, "archive does not contain a " + m.name + "/ directory");
+        return;
+    }
+    m.state = ModuleState::Verified;
+    if (!m.delta_note.empty()) m.message = "full tarball (" + m.delta_note + ")";
+    logLine(std::cout, "Checksum OK " + m.name + " " + m.version + " (" + std::to_string(m.stream.files()) + " files, " +
+                           std::to_string(m.bytes / 1024) + " KiB in " + std::to_string(static_cast<long>(m.download_ms)) + " ms)");
+}
+
+// Function to create an empty staging directory for a module
+bool prepareStaging(ModuleUpdate& m, const UpdaterOptions& options) {
+    m.staging_root = options.base + "/" + STAGING_DIR_NAME + "/" + m.name + "." + std::to_string(getpid());
+    std::error_code ec;
+    std::filesystem::remove_all(m.staging_root, ec);
+    std::filesystem::create_directories(m.staging_root, ec);
+    if (ec) {
+        failModule(m, "cannot prepare staging directory " + m.staging_root);
+        return false;
+    }
+    return true;
+}
+
+// Function to start the full tarball download: the checksum and the tarball are fetched at the same time
+void startFullDownload(CURLM* multi, std::vector<std::unique_ptr<Transfer>>& transfers, ModuleUpdate& m,
+                       const UpdaterOptions& options) {
+    if (!prepareStaging(m, options)) return;
+    if (!m.stream.begin(m.staging_root)) {
+        failModule(m, "cannot initialise gzip stream");
+        return;
+    }
+    const std::string stem = options.url_base + "/" + m.name + "_" + m.version;
+    addTransfer(multi, transfers, &m, TransferKind::Sum, stem + ".sha256");
+    addTransfer(multi, transfers, &m, TransferKind::Tarball, stem + ".tar.gz");
+}
+
+// Function to drop the delta path and download the full tarball instead
+void fallBackToFull(CURLM* multi, std::vector<std::unique_ptr<Transfer>>& transfers, ModuleUpdate& m,
+                    const UpdaterOptions& options, const std::string& why) {
+    if (m.delta != ModuleUpdate::Delta::Pending) return;
+    m.delta = ModuleUpdate::Delta::Abandoned;
+    m.delta_note = why;
+    m.delta_data.clear();
+    m.delta_data.shrink_to_fit();
+    logLine(std::cout, "Delta for " + m.name + " not used (" + why + "), downloading full tarball");
+    startFullDownload(multi, transfers, m, options);
+}
+
+// Function to verify a downloaded delta and rebuild the new module tree from the installed one
+void applyModuleDelta(CURLM* multi, std::vector<std::unique_ptr<Transfer>>& transfers, ModuleUpdate& m,
+                      const UpdaterOptions& options) {
+    if (!m.delta_done || !m.delta_sum_done || m.delta != ModuleUpdate::Delta::Pending) return;
+    m.download_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m.started).count();
+    if (de_config::Sha256::hex(m.delta_data) != m.delta_hash) {
+        fallBackToFull(multi, transfers, m, options, "delta checksum mismatch");
+        return;
+    }
+    if (!prepareStaging(m, options)) return;
+
+    de_config::DeltaHeader header{m.name, m.local_version, m.version};
+    de_config::DeltaStats stats;
+    std::string error;
+    if (!de_config::ModuleDelta::apply(m.delta_data, header, options.base + "/" + m.name, m.staging_root + "/" + m.name, stats, error)) {
+        fallBackToFull(multi, transfers, m, options, error);
+        return;
+    }
+    m.used_delta = true;
+    m.state = ModuleState::Verified;
+    m.message = "delta from " + m.local_version;
+    logLine(std::cout, "Delta OK " + m.name + " " + m.local_version + " -> " + m.version + " (" + std::to_string(stats.files) + " files, " +
+                           std::to_string(stats.copy_bytes / 1024) + " KiB reused, " + std::to_string(m.delta_data.size() / 1024) +
+                           " KiB downloaded in " + std::to_string(static_cast<long>(m.download_ms)) + " ms)");
+    m.delta_data.clear();
+    m.delta_data.shrink_to_fit();
+}
+
+// Function to handle a finished transfer and queue the module's next step
+void onTransferDone(CURLM* multi, std::vector<std::unique_ptr<Transfer>>& transfers, Transfer& t, CURLcode result,
+                    const UpdaterOptions& options) {
+    ModuleUpdate& m = *t.module;
+    const std::string url_base = options.url_base;
+    if (m.state == ModuleState::Failed) return;
+
+    switch (t.kind) {
+    case TransferKind::Latest: {
+        m.version = (result == CURLE_OK) ? trim(t.body) : "";
+        if (m.version.empty() || m.version.find_first_of("/ \n") != std::string::npos) {
+            m.state = ModuleState::Skipped;
+            m.message = "no _LATEST at " + t.url;
+            logLine(std::cout, "SKIP " + m.name + ": " + m.message);
+            return;
+        }
+        if (!options.force && m.local_version == m.version) {
+            m.state = ModuleState::Skipped;
+            m.message = "already at latest version " + m.version;
+            logLine(std::cout, "SKIP " + m.name + ": " + m.message);
+            return;
+        }
+        const std::string stem = url_base + "/" + m.name + "_" + m.version;
+        logLine(std::cout, "Updating " + m.name + " -> " + m.version);
+        if (options.dry_run) {
+            m.state = ModuleState::DryRun;
+            addTransfer(multi, transfers, &m, TransferKind::HeadTarball, stem + ".tar.gz");
+            addTransfer(multi, transfers, &m, TransferKind::HeadSum, stem + ".sha256");
+            return;
+        }
+        m.state = ModuleState::Downloading;
+        m.started = std::chrono::steady_clock::now();
+        std::error_code ec;
+        if (options.delta && !m.local_version.empty() && m.local_version != m.version &&
+            std::filesystem::is_directory(options.base + "/" + m.name, ec)) {
+            // Only the delta from the installed version; the tarball is fetched if it is missing or fails
+            const std::string delta = url_base + "/" + m.name + "_" + m.local_version + "_to_" + m.version + ".delta";
+            m.delta = ModuleUpdate::Delta::Pending;
+            addTransfer(multi, transfers, &m, TransferKind::DeltaSum, delta + ".sha256");
+            addTransfer(multi, transfers, &m, TransferKind::Delta, delta);
+            return;
+        }
+        startFullDownload(multi, transfers, m, options);
+        return;
+    }
+    case TransferKind::Delta:
+    case TransferKind::DeltaSum: {
+        if (m.delta != ModuleUpdate::Delta::Pending) return;
+        if (result != CURLE_OK) {
+            fallBackToFull(multi, transfers, m, options, std::string("no delta: ") + curl_easy_strerror(result));
+            return;
+        }
+        if (t.kind == TransferKind::DeltaSum) {
+            std::istringstream in(t.body);
+            in >> m.delta_hash;
+            std::transform(m.delta_hash.begin(), m.delta_hash.end(), m.delta_hash.begin(), ::tolower);
+            m.delta_sum_done = true;
+        } else {
+            m.delta_done = true;
+        }
+        applyModuleDelta(multi, transfers, m, options);
+        return;
+    }
+    case TransferKind::Sum: {
+        if (result != CURLE_OK) {
+            failModule(m, "download failed: " + t.url + " (" + curl_easy_strerror(result) + ")");
+            return;
+        }
+        std::istringstream in(t.body);
+        in >> m.expected_hash;
+        std::transform(m.expected_hash.begin(), m.expected_hash.end(), m.expected_hash.begin(), ::tolower);
+        if (m.expected_hash.size() != 64) {
+            failModule(m, "malformed checksum file " + t.url);
+            return;
+        }
+        m.sum_done = true;
+        verifyModule(m);
+        return;
+    }
+    case TransferKind::Tarball: {
+        m.download_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m.started).count();
+        if (result != CURLE_OK) {
+            const std::string why = m.stream.error().empty() ? curl_easy_strerror(result) : m.stream.error();
+            failModule(m, "download failed: " + t.url + " (" + why + ")");
+            return;
+        }
+        if (!m.stream.finish()) {
+            failModule(m, "extract failed: " + m.stream.error());
+            return;
+        }
+        m.actual_hash = m.sha.hexDigest();
+        m.tarball_done = true;
+        verifyModule(m);
+        return;
+    }
+    case TransferKind::HeadTarball:
+    case TransferKind::HeadSum:
+        if (result != CURLE_OK) {
+            m.state = ModuleState::Failed;
+            m.message = "[DRY-RUN] missing " + t.url;
+            logLine(std::cout, m.message);
+        } else if (++m.dry_run_checks == 2) {
+            m.message = "would download, verify and install " + m.version;
+            logLine(std::cout, "[DRY-RUN] " + m.name + ": " + m.message);
+        }
+        return;
+    }
+}
+
+// Function to fix permissions the way the update script does and hand the tree to the pi user
+void fixPermissions(const std::string& root) {
+    struct passwd* owner = (geteuid() == 0) ? getpwnam(MODULE_OWNER) : nullptr;
+    bool owned = true;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(root, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        const std::string path = it->path().string();
+        const std::string name = it->path().filename().string();
+        if (owner && lchown(path.c_str(), owner->pw_uid, owner->pw_gid) != 0) owned = false;
+        if (!it->is_regular_file(ec) || it->is_symlink(ec)) continue;
+        if (name.rfind("de_", 0) == 0) {
+            chmod(path.c_str(), 0755);
+        } else if (it->path().extension() == ".json" || it->path().extension() == ".crt") {
+            chmod(path.c_str(), 0644);
+        }
+    }
+    if (owner && lchown(root.c_str(), owner->pw_uid, owner->pw_gid) != 0) owned = false;
+    if (!owned) logLine(std::cerr, "WARNING: cannot hand all of " + root + " to " + MODULE_OWNER);
+}
+
+// Function to record the installed module as a hardlinked backup generation (see module_backup.hpp)
+void backupModule(const ModuleUpdate& m, const UpdaterOptions& options) {
+    de_config::ModuleBackup store(options.backup_dir);
+    de_config::BackupGeneration gen;
+    de_config::GenerationStats stats;
+    std::string error;
+    logLine(std::cout, "Backing up " + m.name + "...");
+    if (!store.create(m.name, options.base + "/" + m.name, m.local_version, BACKUPS_TO_KEEP, gen, stats, error)) {
+        logLine(std::cerr, "WARNING: backup of " + m.name + " failed: " + error);
+        return;
+    }
+    logLine(std::cout, "Backup " + m.name + "/" + gen.name + ": " + std::to_string(stats.linked) + " files linked, " +
+                           std::to_string(stats.copied) + " copied (" + std::to_string(stats.copied_bytes / 1024) + " KiB written)");
+}
+
+// Function to swap the verified staging tree into place. With an existing module this is a
+// single renameat2(RENAME_EXCHANGE), so the module directory is never missing or half written.
+bool installModule(ModuleUpdate& m, const UpdaterOptions& options) {
+    const std::string live = options.base + "/" + m.name;
+    const std::string fresh = m.staging_root + "/" + m.name;
+    fixPermissions(fresh);
+
+    std::error_code ec;
+    const bool exists = std::filesystem::exists(live, ec);
+    if (exists && options.backup) backupModule(m, options);
+
+    if (exists) {
+        if (syscall(SYS_renameat2, AT_FDCWD, fresh.c_str(), AT_FDCWD, live.c_str(), RENAME_EXCHANGE) != 0) {
+            // Kernels or filesystems without RENAME_EXCHANGE: two renames, still never a partial tree
+            const std::string old_path = m.staging_root + "/" + m.name + ".old";
+            if (rename(live.c_str(), old_path.c_str()) != 0) {
+                failModule(m, std::string("cannot swap in new version: ") + std::strerror(errno));
+                return false;
+            }
+            if (rename(fresh.c_str(), live.c_str()) != 0) {
+                const int rename_errno = errno; // the rollback below may overwrite it
+                rename(old_path.c_str(), live.c_str());
+                failModule(m, std::string("cannot swap in new version: ") + std::strerror(rename_errno));
+                return false;
+            }
+        }
+    } else if (rename(fresh.c_str(), live.c_str()) != 0) {
+        failModule(m, std::string("cannot install new version: ") + std::strerror(errno));
+        return false;
+    }
+
+    // The previous version now sits in the staging directory
+    std::filesystem::remove_all(m.staging_root, ec);
+
+    const std::string version_dir = options.base + "/" + VERSION_DIR_NAME;
+    std::filesystem::create_directories(version_dir, ec);
+    std::ofstream(version_dir + "/" + m.name + ".version") << m.version << "\n";
+    m.state = ModuleState::Installed;
+    logLine(std::cout, m.name + " updated to " + m.version);
+    return true;
+}
+
+// Function to build the module list: installed directories plus the defaults, without duplicates
+std::vector<std::string> discoverModules(const std::string& base) {
+    std::vector<std::string> installed;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(base, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.empty() || name[0] == '.' || !entry.is_directory(ec)) continue;
+        installed.push_back(name);
+    }
+    std::sort(installed.begin(), installed.end());
+    std::vector<std::string> modules;
+    std::set<std::string> seen;
+    for (const auto& name : installed) {
+        if (seen.insert(name).second) modules.push_back(name);
+    }
+    for (const char* name : DEFAULT_MODULES) {
+        if (seen.insert(name).second) modules.push_back(name);
+    }
+    return modules;
+}
+
+void printUsage(const char* app) {
+    std::cerr << "Usage: " << app << " <url_base> [module_name|all]... [--dry-run] [--force] [--jobs N] [--base DIR] [--backup-dir DIR] [--no-backup] [--no-delta]" << std::endl;
+    std::cerr << "       " << app << " --make-delta <module> <from_version> <to_version> <old_dir> <new_dir> <out_dir>" << std::endl;
+    std::cerr << "  Checks and downloads all modules concurrently; each tarball is verified and extracted while it streams." << std::endl;
+    std::cerr << "  Uses <module>_<installed>_to_<latest>.delta when the server has one, falling back to the full tarball." << std::endl;
+    std::cerr << "Example: " << app << " https://cloud.ardupilot.org/downloads/RPI/Latest" << std::endl;
+    std::cerr << "Example: " << app << " https://cloud.ardupilot.org/downloads/RPI/Latest de_camera --force" << std::endl;
+    std::cerr << "Example: " << app << " http://127.0.0.1:8000 --base /tmp/de_test --no-backup" << std::endl;
+}
+
+// Function to publish a delta: writes <out_dir>/<mod>_<from>_to_<to>.delta and its .sha256
+// old_dir and new_dir are the extracted <mod>/ folders of both release tarballs.
+int makeDelta(int argc, char** argv) {
+    if (argc != 6) {
+        std::cerr << "Error: --make-delta needs <module> <from_version> <to_version> <old_dir> <new_dir> <out_dir>" << std::endl;
+        return 1;
+    }
+    const de_config::DeltaHeader header{argv[0], argv[1], argv[2]};
+    const std::string old_dir = argv[3], new_dir = argv[4], out_dir = argv[5];
+    const auto start = std::chrono::steady_clock::now();
+    std::string delta, error;
+    de_config::DeltaStats stats;
+    if (!de_config::ModuleDelta::create(header, old_dir, new_dir, delta, stats, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    const std::string file = header.module + "_" + header.from + "_to_" + header.to + ".delta";
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    std::ofstream(out_dir + "/" + file, std::ios::binary) << delta;
+    std::ofstream(out_dir + "/" + file + ".sha256") << de_config::Sha256::hex(delta) << "  " << file << "\n";
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << file << ": " << stats.files << " files (" << stats.copied_files << " diffed), "
+              << stats.copy_bytes / 1024 << " KiB reused, " << stats.literal_bytes / 1024 << " KiB literal, "
+              << delta.size() / 1024 << " KiB compressed in " << static_cast<long>(ms) << " ms" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    UpdaterOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--dry-run") {
+            options.dry_run = true;
+        } else if (arg == "--force") {
+            options.force = true;
+        } else if (arg == "--no-backup") {
+            options.backup = false;
+        } else if (arg == "--no-delta") {
+            options.delta = false;
+        } else if (arg == "--make-delta") {
+            return makeDelta(argc - i - 1, argv + i + 1);
+        } else if (arg == "--jobs" || arg == "-j") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                std::cerr << "Error: " << arg << " requires a positive number" << std::endl;
+                return 1;
+            }
+            options.jobs = std::atoi(argv[++i]);
+        } else if (arg == "--base" || arg == "--backup-dir") {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                std::cerr << "Error: " << arg << " requires a directory" << std::endl;
+                return 1;
+            }
+            std::string dir = argv[++i];
+            while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+            (arg == "--base" ? options.base : options.backup_dir) = dir;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else if (options.url_base.empty()) {
+            options.url_base = arg;
+            while (!options.url_base.empty() && options.url_base.back() == '/') options.url_base.pop_back();
+        } else if (arg != "all") {
+            options.modules.push_back(arg);
+        }
+    }
+    if (options.url_base.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> names = options.modules.empty() ? discoverModules(options.base) : options.modules;
+    if (names.empty()) {
+        logLine(std::cout, "No modules found to update.");
+        return 0;
+    }
+
+    logLine(std::cout, "Starting update from URL: " + options.url_base);
+    logLine(std::cout, "Modules: " + std::to_string(names.size()) + (options.dry_run ? " (DRY-RUN, no changes will be made)" : ""));
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CURLM* multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, options.jobs);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    std::vector<std::unique_ptr<ModuleUpdate>> modules;
+    std::vector<std::unique_ptr<Transfer>> transfers;
+    const std::string version_dir = options.base + "/" + VERSION_DIR_NAME;
+    for (const auto& name : names) {
+        std::unique_ptr<ModuleUpdate> m(new ModuleUpdate());
+        m->name = name;
+        m->local_version = trim(readFile(version_dir + "/" + name + ".version"));
+        addTransfer(multi, transfers, m.get(), TransferKind::Latest, options.url_base + "/" + name + "_LATEST");
+        modules.push_back(std::move(m));
+    }
+
+    // One event loop drives every check, checksum and tarball transfer
+    const auto start = std::chrono::steady_clock::now();
+    int running = 1;
+    while (running) {
+        curl_multi_perform(multi, &running);
+        bool finished_any = false;
+        int queued;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Transfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&t));
+            const CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi, t->easy);
+            curl_easy_cleanup(t->easy);
+            t->easy = nullptr;
+            onTransferDone(multi, transfers, *t, result, options);
+            finished_any = true;
+        }
+        if (finished_any) {
+            running = 1; // follow-up transfers may have been queued; start them before waiting
+            continue;
+        }
+        if (running) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+    const double download_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Swap in every verified module
+    for (auto& m : modules) {
+        if (m->state == ModuleState::Verified) installModule(*m, options);
+    }
+    if (!options.dry_run) {
+        std::error_code ec;
+        std::filesystem::remove(options.base + "/" + STAGING_DIR_NAME, ec); // only if empty
+    }
+
+    uint64_t total_bytes = 0;
+    size_t updated = 0, failed = 0;
+    std::cout << std::endl << "Summary:" << std::endl;
+    for (const auto& m : modules) {
+        const char* status = "skipped";
+        switch (m->state) {
+        case ModuleState::Installed: status = "updated"; ++updated; break;
+        case ModuleState::DryRun: status = "dry-run"; ++updated; break;
+        case ModuleState::Failed: status = "FAILED"; ++failed; break;
+        default: break;
+        }
+        total_bytes += m->bytes;
+        std::cout << "  " << std::left << std::setw(9) << status << std::setw(16) << m->name
+                  << std::setw(14) << (m->version.empty() ? "-" : m->version) << m->message << std::endl;
+    }
+    std::cout << "  " << updated << (options.dry_run ? " would be updated, " : " updated, ") << failed << " failed, "
+              << total_bytes / 1024 << " KiB downloaded in " << std::fixed << std::setprecision(0) << download_ms << " ms";
+    if (download_ms > 0 && total_bytes > 0) {
+        std::cout << " (" << std::setprecision(1) << (total_bytes / 1024.0 / 1024.0) / (download_ms / 1000.0) << " MiB/s)";
+    }
+    std::cout << std::endl;
+    return failed ? 1 : 0;
+}
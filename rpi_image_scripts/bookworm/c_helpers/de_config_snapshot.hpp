@@ -0,0 +1,259 @@
+//***************************************************************************** */
+//  Precompiled binary snapshots of DroneEngage module configs
+//
+//  updateConfig --snapshot writes <config>.snap next to each config file. A
+//  snapshot holds every value of the config, already decoded, in a sorted
+//  table that can be used straight from an mmap: opening one costs a header
+//  check and each lookup is a binary search, with no JSON parsing at all.
+//
+//  Modules include this header only (no extra library to link) and use:
+//
+//      de_config::ConfigSnapshot snap;
+//      if (snap.open(snapshot_path, config_path)) {
+//          std::string user = snap.getString("userName", "");
+//          int port = (int) snap.getNumber("s2s_udp_listening_port", 60000);
+//      } else {
+//          // fall back to parsing config_path
+//      }
+//
+//  Layout (little endian, 8-byte aligned):
+//      SnapshotHeader
+//      SnapshotEntry[entry_count]   sorted by path (byte order)
+//      string pool                  paths and text values, not NUL terminated
+//
+//***************************************************************************** */
+
+#ifndef DE_CONFIG_SNAPSHOT_HPP
+#define DE_CONFIG_SNAPSHOT_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace de_config
+{
+
+#define DE_SNAPSHOT_MAGIC "DECSNAP"
+#define DE_SNAPSHOT_VERSION 1
+
+enum SnapshotKind : uint8_t
+{
+    SNAP_OBJECT = 0,
+    SNAP_ARRAY = 1,
+    SNAP_STRING = 2,
+    SNAP_NUMBER = 3,
+    SNAP_BOOL = 4,
+    SNAP_NULL = 5
+};
+
+struct SnapshotHeader
+{
+    char magic[8];             // "DECSNAP\0"
+    uint32_t version;          // DE_SNAPSHOT_VERSION
+    uint32_t header_size;      // sizeof(SnapshotHeader)
+    uint8_t source_sha256[32]; // SHA-256 of the config text the snapshot was built from
+    int64_t source_mtime_ns;   // st_mtim of the config when the snapshot was built
+    uint64_t source_size;      // size of the config text
+    uint64_t entry_count;
+    uint64_t entries_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t file_size;
+    uint64_t body_checksum;    // FNV-1a 64 of everything after the header
+};
+
+struct SnapshotEntry
+{
+    uint32_t path_offset;  // into the string pool; "" is the root, "a.b.0" style otherwise
+    uint32_t path_length;
+    uint32_t text_offset;  // decoded value for strings, compact JSON text otherwise
+    uint32_t text_length;
+    uint8_t kind;          // SnapshotKind
+    uint8_t reserved[3];
+    uint32_t child_count;  // members of an object / elements of an array
+    double number;         // numbers; 1.0 / 0.0 for bools
+};
+
+static_assert(sizeof(SnapshotHeader) == 112, "SnapshotHeader layout changed");
+static_assert(sizeof(SnapshotEntry) == 32, "SnapshotEntry layout changed");
+
+inline uint64_t snapshotChecksum(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline int64_t fileMtimeNs(const struct stat &st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Read-only, mmap-backed view of a snapshot file.
+ */
+class ConfigSnapshot
+{
+public:
+    ConfigSnapshot() : m_base(nullptr), m_size(0) {}
+    ~ConfigSnapshot() { close(); }
+    ConfigSnapshot(const ConfigSnapshot &) = delete;
+    ConfigSnapshot &operator=(const ConfigSnapshot &) = delete;
+
+    /**
+     * @brief Maps a snapshot and checks it is usable.
+     * @param source_path If not empty, the snapshot is rejected unless the
+     *        config file still has the size and mtime it was built from.
+     * @param verify_body Also checksum the whole body (slower, catches torn writes).
+     * @return False if the file is missing, malformed, stale or from another version.
+     */
+    bool open(const std::string &path, const std::string &source_path = "", bool verify_body = false)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return false;
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))
+        {
+            ::close(fd);
+            return false;
+        }
+        void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) return false;
+        m_base = static_cast<const uint8_t *>(base);
+        m_size = static_cast<size_t>(st.st_size);
+
+        if (!validate(verify_body) || (!source_path.empty() && !matchesSource(source_path)))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (m_base) munmap(const_cast<uint8_t *>(m_base), m_size);
+        m_base = nullptr;
+        m_size = 0;
+    }
+
+    bool isOpen() const { return m_base != nullptr; }
+    const SnapshotHeader &header() const { return *reinterpret_cast<const SnapshotHeader *>(m_base); }
+
+    /**
+     * @brief True if the config file has the size and mtime recorded in the snapshot.
+     */
+    bool matchesSource(const std::string &source_path) const
+    {
+        struct stat st;
+        if (!m_base || stat(source_path.c_str(), &st) == -1) return false;
+        return static_cast<uint64_t>(st.st_size) == header().source_size && fileMtimeNs(st) == header().source_mtime_ns;
+    }
+
+    size_t size() const { return m_base ? header().entry_count : 0; }
+    const SnapshotEntry &entry(size_t i) const { return entries()[i]; }
+
+    std::string path(const SnapshotEntry &e) const { return std::string(strings() + e.path_offset, e.path_length); }
+    std::string text(const SnapshotEntry &e) const { return std::string(strings() + e.text_offset, e.text_length); }
+
+    /**
+     * @brief Finds a value by dotted path ("" for the root). Returns nullptr if absent.
+     */
+    const SnapshotEntry *find(const std::string &key) const
+    {
+        if (!m_base) return nullptr;
+        size_t lo = 0, hi = header().entry_count;
+        const char *pool = strings();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            const SnapshotEntry &e = entries()[mid];
+            const size_t n = e.path_length < key.size() ? e.path_length : key.size();
+            int cmp = std::memcmp(pool + e.path_offset, key.data(), n);
+            if (cmp == 0) cmp = (e.path_length < key.size()) ? -1 : (e.path_length > key.size() ? 1 : 0);
+            if (cmp == 0) return &e;
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return nullptr;
+    }
+
+    std::string getString(const std::string &key, const std::string &fallback) const
+    {
+        const SnapshotEntry *e = find(key);
+        return (e && e->kind == SNAP_STRING) ? text(*e) : fallback;
+    }
+
+    double getNumber(const std::string &key, double fallback) const
+    {
+        const SnapshotEntry *e = find(key);
+        return (e && e->kind == SNAP_NUMBER) ? e->number : fallback;
+    }
+
+    bool getBool(const std::string &key, bool fallback) const
+    {
+        const SnapshotEntry *e = find(key);
+        return (e && e->kind == SNAP_BOOL) ? e->number != 0.0 : fallback;
+    }
+
+    /**
+     * @brief Compact JSON text of any value (objects and arrays included).
+     */
+    std::string getJson(const std::string &key, const std::string &fallback) const
+    {
+        const SnapshotEntry *e = find(key);
+        if (!e) return fallback;
+        if (e->kind != SNAP_STRING) return text(*e);
+        std::string quoted = "\"";
+        for (char c : text(*e))
+        {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+private:
+    const SnapshotEntry *entries() const { return reinterpret_cast<const SnapshotEntry *>(m_base + header().entries_offset); }
+    const char *strings() const { return reinterpret_cast<const char *>(m_base + header().strings_offset); }
+
+    bool validate(bool verify_body) const
+    {
+        const SnapshotHeader &h = header();
+        if (std::memcmp(h.magic, DE_SNAPSHOT_MAGIC, 8) != 0) return false;
+        if (h.version != DE_SNAPSHOT_VERSION || h.header_size != sizeof(SnapshotHeader)) return false;
+        if (h.file_size != m_size) return false;
+        if (h.entries_offset % 8 != 0 || h.entries_offset < sizeof(SnapshotHeader)) return false;
+        if (h.entry_count > (m_size - h.entries_offset) / sizeof(SnapshotEntry)) return false;
+        if (h.strings_offset < h.entries_offset + h.entry_count * sizeof(SnapshotEntry)) return false;
+        if (h.strings_offset > m_size || h.strings_size > m_size - h.strings_offset) return false;
+        if (verify_body && snapshotChecksum(m_base + sizeof(SnapshotHeader), m_size - sizeof(SnapshotHeader)) != h.body_checksum)
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < h.entry_count; ++i)
+        {
+            const SnapshotEntry &e = entries()[i];
+            if (static_cast<uint64_t>(e.path_offset) + e.path_length > h.strings_size) return false;
+            if (static_cast<uint64_t>(e.text_offset) + e.text_length > h.strings_size) return false;
+        }
+        return true;
+    }
+
+    const uint8_t *m_base;
+    size_t m_size;
+};
+
+} // namespace de_config
+
+#endif // DE_CONFIG_SNAPSHOT_HPP
@@ -0,0 +1,664 @@
+//***************************************************************************** */
+//  Module delta format for DroneEngage OTA updates
+//
+//  A delta rebuilds the complete <mod>/ tree of version <to> from an installed
+//  <from> tree. It is one gzip stream holding text records:
+//
+//      DEDELTA1 <mod> <from> <to>
+//      D <mode> <path>                               directory
+//      S <path>\t<target>                            symlink
+//      F <mode> <size> <sha256>\t<source>\t<path>    file, followed by ops:
+//          C <offset> <length>                       copy bytes of the installed <source>
+//          I <length>\n<bytes>                       literal bytes
+//          E                                         end of file
+//      T <sha256>                                    tree hash (see treeLine)
+//
+//  Changed files are diffed block by block (rsync style rolling checksum) against
+//  the old file of the same path, or a similarly named file in the same folder
+//  (e.g. libfoo.so.1.2 -> libfoo.so.1.3). Small files are always sent literally,
+//  so a locally edited config file does not invalidate the delta.
+//  Every rebuilt file is checked against its SHA-256, and the record list against
+//  the tree hash; any mismatch fails the apply and the caller falls back to the
+//  full tarball.
+//  Symlink targets must be relative and free of "..", so a link can never point
+//  out of the module folder, and nothing is ever written through a symlink: a
+//  module with other links is only published as a tarball.
+//
+//***************************************************************************** */
+
+#ifndef DE_DELTA_HPP
+#define DE_DELTA_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "sha256.hpp"
+
+#define DE_DELTA_MAGIC "DEDELTA1"
+#define DE_DELTA_BLOCK 2048             // block size for matching against the old file
+#define DE_DELTA_INLINE_LIMIT 16384     // files up to this size are always sent literally
+#define DE_DELTA_MAX_CANDIDATES 8       // old blocks compared per weak checksum hit
+
+namespace de_config
+{
+
+struct DeltaHeader
+{
+    std::string module;
+    std::string from;
+    std::string to;
+};
+
+struct DeltaStats
+{
+    size_t files = 0;
+    size_t copied_files = 0;  // files rebuilt partly or fully from the installed version
+    uint64_t copy_bytes = 0;
+    uint64_t literal_bytes = 0;
+};
+
+class ModuleDelta
+{
+public:
+    /**
+     * @brief Builds the gzip-compressed delta that turns old_dir into new_dir.
+     * @param old_dir Contents of the <from> module folder (the <mod>/ directory itself).
+     * @param new_dir Contents of the <to> module folder.
+     */
+    static bool create(const DeltaHeader &header, const std::string &old_dir, const std::string &new_dir,
+                       std::string &out, DeltaStats &stats, std::string &error)
+    {
+        std::vector<std::string> paths;
+        if (!listTree(new_dir, paths, error)) return false;
+
+        std::string payload = std::string(DE_DELTA_MAGIC) + " " + header.module + " " + header.from + " " + header.to + "\n";
+        Sha256 tree;
+        for (const auto &rel : paths)
+        {
+            if (rel.find_first_of("\t\n") != std::string::npos)
+            {
+                error = "unsupported character in file name: " + rel;
+                return false;
+            }
+            const std::filesystem::path path = std::filesystem::path(new_dir) / rel;
+            std::error_code ec;
+            const auto status = std::filesystem::symlink_status(path, ec);
+            const unsigned mode = static_cast<unsigned>(status.permissions()) & 0777;
+            std::string line;
+            if (std::filesystem::is_symlink(status))
+            {
+                const std::string target = std::filesystem::read_symlink(path, ec).string();
+                if (!safeLinkTarget(rel, target, error)) return false;
+                payload += "S " + rel + "\t" + target + "\n";
+                line = treeLine('S', 0, 0, target, rel);
+            }
+            else if (std::filesystem::is_directory(status))
+            {
+                payload += "D " + octal(mode) + " " + rel + "\n";
+                line = treeLine('D', mode, 0, "", rel);
+            }
+            else if (std::filesystem::is_regular_file(status))
+            {
+                std::string content;
+                if (!readAll(path.string(), content, error)) return false;
+                const std::string hash = Sha256::hex(content);
+                const std::string source = content.size() > DE_DELTA_INLINE_LIMIT ? findSource(old_dir, rel) : "";
+                payload += "F " + octal(mode) + " " + std::to_string(content.size()) + " " + hash + "\t" + source + "\t" + rel + "\n";
+                std::string old_content;
+                if (!source.empty() && readAll(old_dir + "/" + source, old_content, error))
+                {
+                    const uint64_t copied = diff(old_content, content, payload, stats);
+                    if (copied) ++stats.copied_files;
+                }
+                else
+                {
+                    appendLiteral(payload, content.data(), content.size(), stats);
+                }
+                payload += "E\n";
+                line = treeLine('F', mode, content.size(), hash, rel);
+                ++stats.files;
+            }
+            else
+            {
+                error = "unsupported file type: " + rel;
+                return false;
+            }
+            tree.update(line);
+        }
+        payload += "T " + tree.hexDigest() + "\n";
+        return gzip(payload, out, error);
+    }
+
+    /**
+     * @brief Rebuilds the <to> tree in target_dir (which must not exist yet) from installed_dir.
+     * @param expected Header the delta must carry (module, from and to versions).
+     * @return False and sets error on any format, bounds or hash mismatch.
+     */
+    static bool apply(const std::string &compressed, const DeltaHeader &expected, const std::string &installed_dir,
+                      const std::string &target_dir, DeltaStats &stats, std::string &error)
+    {
+        std::string data;
+        if (!gunzip(compressed, data, error)) return false;
+
+        Reader in(data);
+        std::string line;
+        const std::string magic = std::string(DE_DELTA_MAGIC) + " " + expected.module + " " + expected.from + " " + expected.to;
+        if (!in.line(line) || line != magic)
+        {
+            error = "delta header does not match (" + line.substr(0, 80) + ")";
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(target_dir, ec);
+        if (ec)
+        {
+            error = "cannot create " + target_dir + ": " + ec.message();
+            return false;
+        }
+
+        Sha256 tree;
+        while (in.line(line))
+        {
+            if (line.size() < 2 || line[1] != ' ')
+            {
+                error = "malformed delta record";
+                return false;
+            }
+            const char type = line[0];
+            const std::string rest = line.substr(2);
+            if (type == 'T')
+            {
+                if (rest != tree.hexDigest())
+                {
+                    error = "tree hash mismatch";
+                    return false;
+                }
+                return true;
+            }
+            if (type == 'D')
+            {
+                const size_t space = rest.find(' ');
+                const unsigned mode = std::strtoul(rest.substr(0, space).c_str(), nullptr, 8) & 0777;
+                const std::string rel = space == std::string::npos ? "" : rest.substr(space + 1);
+                if (!safePath(rel, error) || !noSymlinkOnPath(target_dir, rel, true, error)) return false;
+                std::filesystem::create_directories(target_dir + "/" + rel, ec);
+                chmod((target_dir + "/" + rel).c_str(), mode | 0700);
+                tree.update(treeLine('D', mode, 0, "", rel));
+            }
+            else if (type == 'S')
+            {
+                const size_t tab = rest.find('\t');
+                const std::string rel = rest.substr(0, tab);
+                const std::string target = tab == std::string::npos ? "" : rest.substr(tab + 1);
+                if (!safePath(rel, error) || !safeLinkTarget(rel, target, error) || !noSymlinkOnPath(target_dir, rel, false, error)) return false;
+                if (symlink(target.c_str(), (target_dir + "/" + rel).c_str()) != 0)
+                {
+                    error = "cannot create symlink " + rel;
+                    return false;
+                }
+                tree.update(treeLine('S', 0, 0, target, rel));
+            }
+            else if (type == 'F')
+            {
+                if (!applyFile(in, rest, installed_dir, target_dir, tree, stats, error)) return false;
+            }
+            else
+            {
+                error = std::string("unknown delta record '") + type + "'";
+                return false;
+            }
+        }
+        error = "delta is truncated";
+        return false;
+    }
+
+private:
+    // Sequential reader over the decompressed delta
+    class Reader
+    {
+    public:
+        explicit Reader(const std::string &data) : m_data(data) {}
+
+        bool line(std::string &out)
+        {
+            const size_t end = m_data.find('\n', m_pos);
+            if (end == std::string::npos) return false;
+            out.assign(m_data, m_pos, end - m_pos);
+            m_pos = end + 1;
+            return true;
+        }
+
+        const char *take(uint64_t size)
+        {
+            if (size > m_data.size() - m_pos) return nullptr;
+            const char *p = m_data.data() + m_pos;
+            m_pos += static_cast<size_t>(size);
+            return p;
+        }
+
+    private:
+        const std::string &m_data;
+        size_t m_pos = 0;
+    };
+
+    // Canonical description of one rebuilt entry; the tree hash covers all of them in order
+    static std::string treeLine(char type, unsigned mode, uint64_t size, const std::string &hash_or_target, const std::string &rel)
+    {
+        return std::string(1, type) + " " + octal(mode) + " " + std::to_string(size) + " " + hash_or_target + " " + rel + "\n";
+    }
+
+    static std::string octal(unsigned mode)
+    {
+        std::ostringstream ss;
+        ss << std::oct << mode;
+        return ss.str();
+    }
+
+    static bool safePath(const std::string &rel, std::string &error)
+    {
+        bool ok = !rel.empty() && rel[0] != '/';
+        std::istringstream parts(rel);
+        std::string part;
+        while (ok && std::getline(parts, part, '/'))
+        {
+            if (part == "..") ok = false;
+        }
+        if (!ok) error = "unsafe path in delta: " + rel;
+        return ok;
+    }
+
+    // Relative and without "..": the link cannot leave the folder it is in, let alone the tree
+    static bool safeLinkTarget(const std::string &rel, const std::string &target, std::string &error)
+    {
+        bool ok = !target.empty() && target[0] != '/';
+        std::istringstream parts(target);
+        std::string part;
+        while (ok && std::getline(parts, part, '/'))
+        {
+            if (part == "..") ok = false;
+        }
+        if (!ok) error = "unsafe symlink in delta: " + rel + " -> " + target;
+        return ok;
+    }
+
+    // False if a folder on the way to rel (or rel itself, with last) is a symlink below root
+    static bool noSymlinkOnPath(const std::string &root, const std::string &rel, bool last, std::string &error)
+    {
+        for (size_t end = rel.find('/'); ; end = rel.find('/', end + 1))
+        {
+            if (end == std::string::npos && !last) return true;
+            const std::string prefix = rel.substr(0, end);
+            struct stat st;
+            if (lstat((root + "/" + prefix).c_str(), &st) == 0 && S_ISLNK(st.st_mode))
+            {
+                error = "delta writes through symlink " + prefix;
+                return false;
+            }
+            if (end == std::string::npos) return true;
+        }
+    }
+
+    static bool readAll(const std::string &path, std::string &out, std::string &error)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            error = "cannot read " + path;
+            return false;
+        }
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        out = ss.str();
+        return true;
+    }
+
+    // Relative paths below root, sorted so that every folder precedes its contents
+    static bool listTree(const std::string &root, std::vector<std::string> &paths, std::string &error)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            paths.push_back(it->path().lexically_relative(root).generic_string()); // does not follow symlinks
+        }
+        if (ec)
+        {
+            error = "cannot list " + root + ": " + ec.message();
+            return false;
+        }
+        std::sort(paths.begin(), paths.end());
+        return true;
+    }
+
+    // The old file a new file is diffed against: the same path, or the regular file in the
+    // same folder sharing the longest name prefix (versioned library names)
+    static std::string findSource(const std::string &old_dir, const std::string &rel)
+    {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(old_dir + "/" + rel, ec)) return rel;
+
+        const std::filesystem::path new_path(rel);
+        const std::string name = new_path.filename().string();
+        const std::filesystem::path folder = std::filesystem::path(old_dir) / new_path.parent_path();
+        std::string best;
+        size_t best_len = 3; // require at least 4 shared characters
+        for (const auto &entry : std::filesystem::directory_iterator(folder, ec))
+        {
+            if (!entry.is_regular_file(ec) || entry.is_symlink(ec)) continue;
+            const std::string candidate = entry.path().filename().string();
+            size_t len = 0;
+            while (len < name.size() && len < candidate.size() && name[len] == candidate[len]) ++len;
+            if (len > best_len)
+            {
+                best_len = len;
+                best = candidate;
+            }
+        }
+        if (best.empty()) return "";
+        return (new_path.parent_path() / best).generic_string();
+    }
+
+    static void appendLiteral(std::string &payload, const char *data, size_t size, DeltaStats &stats)
+    {
+        if (size == 0) return;
+        payload += "I " + std::to_string(size) + "\n";
+        payload.append(data, size);
+        stats.literal_bytes += size;
+    }
+
+    static uint32_t weakSum(const unsigned char *p, size_t size, uint32_t &a, uint32_t &b)
+    {
+        a = 0;
+        b = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            a += p[i];
+            b += static_cast<uint32_t>(size - i) * p[i];
+        }
+        return (a & 0xffff) | (b << 16);
+    }
+
+    // Emits copy/literal ops for content using blocks of the old file; returns the bytes copied
+    static uint64_t diff(const std::string &old_content, const std::string &content, std::string &payload, DeltaStats &stats)
+    {
+        const size_t block = DE_DELTA_BLOCK;
+        if (old_content.size() < block || content.size() < block)
+        {
+            appendLiteral(payload, content.data(), content.size(), stats);
+            return 0;
+        }
+
+        const unsigned char *o = reinterpret_cast<const unsigned char *>(old_content.data());
+        const unsigned char *n = reinterpret_cast<const unsigned char *>(content.data());
+        std::unordered_map<uint32_t, std::vector<size_t>> blocks;
+        blocks.reserve(old_content.size() / block + 1);
+        for (size_t off = 0; off + block <= old_content.size(); off += block)
+        {
+            uint32_t a, b;
+            auto &list = blocks[weakSum(o + off, block, a, b)];
+            if (list.size() < DE_DELTA_MAX_CANDIDATES) list.push_back(off);
+        }
+
+        uint64_t copied = 0;
+        size_t literal_start = 0;
+        uint64_t copy_off = 0, copy_len = 0; // pending copy op, merged while contiguous
+        auto flushCopy = [&]() {
+            if (copy_len == 0) return;
+            payload += "C " + std::to_string(copy_off) + " " + std::to_string(copy_len) + "\n";
+            stats.copy_bytes += copy_len;
+            copied += copy_len;
+            copy_len = 0;
+        };
+
+        size_t i = 0;
+        uint32_t a = 0, b = 0;
+        bool rolling = false;
+        while (i + block <= content.size())
+        {
+            if (!rolling)
+            {
+                weakSum(n + i, block, a, b);
+                rolling = true;
+            }
+            const uint32_t weak = (a & 0xffff) | (b << 16);
+            size_t match_off = 0, match_len = 0;
+            const auto hit = blocks.find(weak);
+            if (hit != blocks.end())
+            {
+                for (size_t off : hit->second)
+                {
+                    if (std::memcmp(o + off, n + i, block) != 0) continue;
+                    size_t len = block;
+                    while (i + len < content.size() && off + len < old_content.size() && n[i + len] == o[off + len]) ++len;
+                    if (len > match_len)
+                    {
+                        match_len = len;
+                        match_off = off;
+                    }
+                }
+            }
+            if (match_len)
+            {
+                if (literal_start < i)
+                {
+                    flushCopy();
+                    appendLiteral(payload, content.data() + literal_start, i - literal_start, stats);
+                }
+                if (copy_len && copy_off + copy_len == match_off)
+                {
+                    copy_len += match_len;
+                }
+                else
+                {
+                    flushCopy();
+                    copy_off = match_off;
+                    copy_len = match_len;
+                }
+                i += match_len;
+                literal_start = i;
+                rolling = false;
+                continue;
+            }
+            // Slide the window by one byte
+            if (i + block < content.size())
+            {
+                a = a - n[i] + n[i + block];
+                b = b - static_cast<uint32_t>(block) * n[i] + a;
+            }
+            ++i;
+        }
+        if (literal_start < content.size())
+        {
+            flushCopy();
+            appendLiteral(payload, content.data() + literal_start, content.size() - literal_start, stats);
+        }
+        flushCopy();
+        return copied;
+    }
+
+    static bool applyFile(Reader &in, const std::string &spec, const std::string &installed_dir,
+                          const std::string &target_dir, Sha256 &tree, DeltaStats &stats, std::string &error)
+    {
+        // "<mode> <size> <sha256>\t<source>\t<path>"
+        const size_t tab1 = spec.find('\t');
+        const size_t tab2 = tab1 == std::string::npos ? tab1 : spec.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos)
+        {
+            error = "malformed file record";
+            return false;
+        }
+        std::istringstream head(spec.substr(0, tab1));
+        std::string mode_text, hash;
+        uint64_t size = 0;
+        head >> mode_text >> size >> hash;
+        const unsigned mode = std::strtoul(mode_text.c_str(), nullptr, 8) & 0777;
+        const std::string source = spec.substr(tab1 + 1, tab2 - tab1 - 1);
+        const std::string rel = spec.substr(tab2 + 1);
+        if (!safePath(rel, error) || (!source.empty() && !safePath(source, error)) || !noSymlinkOnPath(target_dir, rel, false, error)) return false;
+
+        int src = -1;
+        uint64_t src_size = 0;
+        if (!source.empty())
+        {
+            src = open((installed_dir + "/" + source).c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC); // sources are never symlinks (findSource)
+            struct stat st;
+            if (src != -1 && fstat(src, &st) == 0) src_size = static_cast<uint64_t>(st.st_size);
+        }
+        const std::string target = target_dir + "/" + rel;
+        // The tree is new, so the file must be too; O_EXCL also refuses a symlink left by an 'S' record
+        const int dst = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode | 0600);
+        if (dst == -1)
+        {
+            if (src != -1) close(src);
+            error = "cannot create " + target;
+            return false;
+        }
+
+        Sha256 sha;
+        uint64_t written = 0;
+        std::vector<char> buffer(64 * 1024);
+        bool ok = true;
+        std::string op;
+        while (ok && in.line(op))
+        {
+            if (op == "E") break;
+            std::istringstream args(op.substr(std::min<size_t>(2, op.size())));
+            if (op[0] == 'I')
+            {
+                uint64_t length = 0;
+                args >> length;
+                const char *bytes = in.take(length);
+                ok = bytes && writeAll(dst, bytes, length);
+                if (ok) sha.update(bytes, length);
+                stats.literal_bytes += length;
+                written += length;
+            }
+            else if (op[0] == 'C')
+            {
+                uint64_t offset = 0, length = 0;
+                args >> offset >> length;
+                if (src == -1 || offset > src_size || length > src_size - offset)
+                {
+                    error = "installed " + (source.empty() ? rel : source) + " does not match the delta base";
+                    ok = false;
+                    break;
+                }
+                while (ok && length > 0)
+                {
+                    const size_t chunk = static_cast<size_t>(std::min<uint64_t>(length, buffer.size()));
+                    ok = pread(src, buffer.data(), chunk, static_cast<off_t>(offset)) == static_cast<ssize_t>(chunk) &&
+                         writeAll(dst, buffer.data(), chunk);
+                    sha.update(buffer.data(), chunk);
+                    stats.copy_bytes += chunk;
+                    offset += chunk;
+                    length -= chunk;
+                    written += chunk;
+                }
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        if (src != -1) close(src);
+        close(dst);
+        if (!ok)
+        {
+            if (error.empty()) error = "cannot rebuild " + rel;
+            return false;
+        }
+        if (written != size || sha.hexDigest() != hash)
+        {
+            error = "hash mismatch after rebuilding " + rel;
+            return false;
+        }
+        if (written > 0 && !source.empty()) ++stats.copied_files;
+        ++stats.files;
+        tree.update(treeLine('F', mode, size, hash, rel));
+        return true;
+    }
+
+    static bool writeAll(int fd, const char *data, uint64_t size)
+    {
+        while (size > 0)
+        {
+            const ssize_t n = write(fd, data, static_cast<size_t>(std::min<uint64_t>(size, 1 << 20)));
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    static bool gzip(const std::string &in, std::string &out, std::string &error)
+    {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, 9, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            error = "deflateInit2 failed";
+            return false;
+        }
+        out.resize(deflateBound(&zs, in.size()));
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        zs.avail_in = static_cast<uInt>(in.size());
+        zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        zs.avail_out = static_cast<uInt>(out.size());
+        const int rc = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END)
+        {
+            error = "deflate failed";
+            return false;
+        }
+        return true;
+    }
+
+    static bool gunzip(const std::string &in, std::string &out, std::string &error)
+    {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK)
+        {
+            error = "inflateInit2 failed";
+            return false;
+        }
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        zs.avail_in = static_cast<uInt>(in.size());
+        char buffer[64 * 1024];
+        int rc = Z_OK;
+        while (rc == Z_OK)
+        {
+            zs.next_out = reinterpret_cast<Bytef *>(buffer);
+            zs.avail_out = sizeof(buffer);
+            rc = inflate(&zs, Z_NO_FLUSH);
+            out.append(buffer, sizeof(buffer) - zs.avail_out);
+            if (rc == Z_BUF_ERROR && zs.avail_in == 0) break;
+        }
+        inflateEnd(&zs);
+        if (rc != Z_STREAM_END)
+        {
+            error = "delta is not a complete gzip stream";
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace de_config
+
+#endif // DE_DELTA_HPP
@@ -0,0 +1,686 @@
+//***************************************************************************** */
+//  Streaming JSON scanner and in-place patcher for DroneEngage config files
+//
+//  The scanner walks the text exactly once and reports every value with its
+//  key path and byte span. Comments (// and /* */) and trailing commas, which
+//  DroneEngage module configs use freely, are accepted and left untouched.
+//  The patcher uses the spans to splice new values into the original text, so
+//  formatting, comments and key order are preserved byte for byte.
+//  Files that do not parse can still get single-key edits through
+//  applyTextPatches, the regex replacement updateConfig used before.
+//
+//***************************************************************************** */
+
+#ifndef DE_JSON_PATCH_HPP
+#define DE_JSON_PATCH_HPP
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <cstddef>
+#include <cstdlib>
+
+namespace de_config
+{
+
+enum class JsonKind
+{
+    Object,
+    Array,
+    String,
+    Number,
+    Bool,
+    Null
+};
+
+inline const char *jsonKindName(JsonKind kind)
+{
+    switch (kind)
+    {
+    case JsonKind::Object: return "object";
+    case JsonKind::Array: return "array";
+    case JsonKind::String: return "string";
+    case JsonKind::Number: return "number";
+    case JsonKind::Bool: return "bool";
+    case JsonKind::Null: return "null";
+    }
+    return "unknown";
+}
+
+typedef std::vector<std::string> JsonPath;
+
+/**
+ * @brief Receives values from JsonScanner in document order.
+ *
+ * enter() is called when a value starts; returning false skips its children
+ * (the value is still scanned for syntax). leave() is called once the value
+ * has been fully scanned, with [begin, end) covering its text.
+ */
+class JsonVisitor
+{
+public:
+    virtual ~JsonVisitor() {}
+    virtual bool enter(const JsonPath &path, JsonKind kind, size_t begin) { (void)path; (void)kind; (void)begin; return true; }
+    virtual void leave(const JsonPath &path, JsonKind kind, size_t begin, size_t end) { (void)path; (void)kind; (void)begin; (void)end; }
+};
+
+/**
+ * @brief Single pass, allocation-light JSON scanner.
+ */
+class JsonScanner
+{
+public:
+    JsonScanner(const std::string &text) : m_text(text), m_pos(0) {}
+
+    /**
+     * @brief Scans the whole document, reporting values to the visitor.
+     * @return True if the text is a single well-formed JSON value.
+     */
+    bool scan(JsonVisitor &visitor)
+    {
+        m_error.clear();
+        m_pos = 0;
+        m_path.clear();
+        skipSpace();
+        if (!m_error.empty()) return false;
+        if (!parseValue(visitor, true)) return false;
+        skipSpace();
+        if (!m_error.empty()) return false;
+        if (m_pos != m_text.size())
+        {
+            return fail("unexpected trailing content");
+        }
+        return true;
+    }
+
+    const std::string &error() const { return m_error; }
+    size_t errorOffset() const { return m_pos; }
+
+    /**
+     * @brief Formats "line L, column C" for a byte offset in the text.
+     */
+    std::string location(size_t offset) const
+    {
+        size_t line = 1, column = 1;
+        for (size_t i = 0; i < offset && i < m_text.size(); ++i)
+        {
+            if (m_text[i] == '\n') { ++line; column = 1; }
+            else ++column;
+        }
+        return "line " + std::to_string(line) + ", column " + std::to_string(column);
+    }
+
+    /**
+     * @brief Decodes a JSON string literal (including the quotes) to its value.
+     */
+    static std::string decodeString(const std::string &text, size_t begin, size_t end)
+    {
+        std::string out;
+        if (end - begin < 2) return out;
+        out.reserve(end - begin - 2);
+        for (size_t i = begin + 1; i + 1 < end; ++i)
+        {
+            char c = text[i];
+            if (c != '\\' || i + 2 >= end)
+            {
+                out += c;
+                continue;
+            }
+            char e = text[++i];
+            switch (e)
+            {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u':
+                if (i + 4 < end)
+                {
+                    unsigned long cp = std::strtoul(text.substr(i + 1, 4).c_str(), nullptr, 16);
+                    i += 4;
+                    // Characters outside the BMP come as a UTF-16 surrogate pair: \uD83D\uDE00
+                    if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < end && text[i + 1] == '\\' && text[i + 2] == 'u')
+                    {
+                        const unsigned long low = std::strtoul(text.substr(i + 3, 4).c_str(), nullptr, 16);
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD; // unpaired surrogate
+                    if (cp < 0x80) out += static_cast<char>(cp);
+                    else if (cp < 0x800)
+                    {
+                        out += static_cast<char>(0xC0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    else if (cp < 0x10000)
+                    {
+                        out += static_cast<char>(0xE0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    else
+                    {
+                        out += static_cast<char>(0xF0 | (cp >> 18));
+                        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                }
+                break;
+            default: out += e; break;
+            }
+        }
+        return out;
+    }
+
+private:
+    bool fail(const std::string &message)
+    {
+        if (m_error.empty()) m_error = message + " at " + location(m_pos);
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos];
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                ++m_pos;
+            }
+            else if (c == '/' && m_pos + 1 < m_text.size() && m_text[m_pos + 1] == '/')
+            {
+                while (m_pos < m_text.size() && m_text[m_pos] != '\n') ++m_pos;
+            }
+            else if (c == '/' && m_pos + 1 < m_text.size() && m_text[m_pos + 1] == '*')
+            {
+                size_t close = m_text.find("*/", m_pos + 2);
+                if (close == std::string::npos)
+                {
+                    fail("unterminated comment");
+                    m_pos = m_text.size();
+                    return;
+                }
+                m_pos = close + 2;
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    bool scanString()
+    {
+        ++m_pos; // opening quote
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos];
+            if (c == '\\') { m_pos += 2; continue; }
+            if (c == '"') { ++m_pos; return true; }
+            if (c == '\n') return fail("newline in string");
+            ++m_pos;
+        }
+        return fail("unterminated string");
+    }
+
+    bool scanNumber()
+    {
+        size_t start = m_pos;
+        if (m_text[m_pos] == '-' || m_text[m_pos] == '+') ++m_pos;
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos];
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+') ++m_pos;
+            else break;
+        }
+        if (m_pos == start || (m_pos == start + 1 && !(m_text[start] >= '0' && m_text[start] <= '9')))
+        {
+            return fail("invalid number");
+        }
+        return true;
+    }
+
+    bool scanLiteral(const char *word)
+    {
+        size_t len = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, len, word) != 0) return fail("invalid literal");
+        m_pos += len;
+        return true;
+    }
+
+    bool parseValue(JsonVisitor &visitor, bool report)
+    {
+        if (m_pos >= m_text.size()) return fail("unexpected end of input");
+
+        const size_t begin = m_pos;
+        const char c = m_text[m_pos];
+        JsonKind kind;
+        if (c == '{') kind = JsonKind::Object;
+        else if (c == '[') kind = JsonKind::Array;
+        else if (c == '"') kind = JsonKind::String;
+        else if (c == 't' || c == 'f') kind = JsonKind::Bool;
+        else if (c == 'n') kind = JsonKind::Null;
+        else if (c == '-' || c == '+' || (c >= '0' && c <= '9')) kind = JsonKind::Number;
+        else return fail(std::string("unexpected character '") + c + "'");
+
+        const bool descend = report ? visitor.enter(m_path, kind, begin) : false;
+        const bool report_children = report && descend;
+
+        bool ok = true;
+        switch (kind)
+        {
+        case JsonKind::Object: ok = parseObject(visitor, report_children); break;
+        case JsonKind::Array: ok = parseArray(visitor, report_children); break;
+        case JsonKind::String: ok = scanString(); break;
+        case JsonKind::Number: ok = scanNumber(); break;
+        case JsonKind::Bool: ok = scanLiteral(c == 't' ? "true" : "false"); break;
+        case JsonKind::Null: ok = scanLiteral("null"); break;
+        }
+        if (!ok) return false;
+
+        if (report) visitor.leave(m_path, kind, begin, m_pos);
+        return true;
+    }
+
+    bool parseObject(JsonVisitor &visitor, bool report)
+    {
+        ++m_pos; // '{'
+        while (true)
+        {
+            skipSpace();
+            if (m_pos >= m_text.size()) return fail("unterminated object");
+            if (m_text[m_pos] == '}') { ++m_pos; return true; }
+            if (m_text[m_pos] != '"') return fail("expected key");
+
+            const size_t key_begin = m_pos;
+            if (!scanString()) return false;
+            if (report) m_path.push_back(decodeString(m_text, key_begin, m_pos));
+
+            skipSpace();
+            if (m_pos >= m_text.size() || m_text[m_pos] != ':') return fail("expected ':'");
+            ++m_pos;
+            skipSpace();
+            if (!m_error.empty() || !parseValue(visitor, report)) return false;
+            if (report) m_path.pop_back();
+
+            skipSpace();
+            if (m_pos >= m_text.size()) return fail("unterminated object");
+            if (m_text[m_pos] == ',') { ++m_pos; continue; }
+            if (m_text[m_pos] == '}') { ++m_pos; return true; }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parseArray(JsonVisitor &visitor, bool report)
+    {
+        ++m_pos; // '['
+        size_t index = 0;
+        while (true)
+        {
+            skipSpace();
+            if (m_pos >= m_text.size()) return fail("unterminated array");
+            if (m_text[m_pos] == ']') { ++m_pos; return true; }
+
+            if (report) m_path.push_back(std::to_string(index));
+            if (!parseValue(visitor, report)) return false;
+            if (report) m_path.pop_back();
+            ++index;
+
+            skipSpace();
+            if (m_pos >= m_text.size()) return fail("unterminated array");
+            if (m_text[m_pos] == ',') { ++m_pos; continue; }
+            if (m_text[m_pos] == ']') { ++m_pos; return true; }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    const std::string &m_text;
+    size_t m_pos;
+    JsonPath m_path;
+    std::string m_error;
+};
+
+/**
+ * @brief Splits "a.b.c" into path segments. "*" matches one level, "**" any depth.
+ */
+inline JsonPath splitPath(const std::string &path)
+{
+    JsonPath segments;
+    std::string current;
+    for (char c : path)
+    {
+        if (c == '.')
+        {
+            segments.push_back(current);
+            current.clear();
+        }
+        else
+        {
+            current += c;
+        }
+    }
+    segments.push_back(current);
+    return segments;
+}
+
+inline std::string joinPath(const JsonPath &path)
+{
+    std::string out;
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        if (i) out += '.';
+        out += path[i];
+    }
+    return out;
+}
+
+inline bool matchPath(const JsonPath &pattern, size_t pi, const JsonPath &path, size_t vi)
+{
+    while (pi < pattern.size())
+    {
+        if (pattern[pi] == "**")
+        {
+            for (size_t skip = vi; skip <= path.size(); ++skip)
+            {
+                if (matchPath(pattern, pi + 1, path, skip)) return true;
+            }
+            return false;
+        }
+        if (vi >= path.size()) return false;
+        if (pattern[pi] != "*" && pattern[pi] != path[vi]) return false;
+        ++pi;
+        ++vi;
+    }
+    return vi == path.size();
+}
+
+inline std::string jsonEscape(const std::string &value)
+{
+    std::string out = "\"";
+    for (unsigned char c : value)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if (c < 0x20)
+            {
+                static const char hex[] = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            }
+            else
+            {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+/**
+ * @brief Copies text[begin, end) without whitespace and comments outside strings,
+ *        giving a single-line JSON value.
+ */
+inline std::string compactJson(const std::string &text, size_t begin, size_t end)
+{
+    std::string out;
+    out.reserve(end - begin);
+    bool in_string = false;
+    for (size_t i = begin; i < end; ++i)
+    {
+        char c = text[i];
+        if (in_string)
+        {
+            out += c;
+            if (c == '\\' && i + 1 < end) out += text[++i];
+            else if (c == '"') in_string = false;
+            continue;
+        }
+        if (c == '"') { in_string = true; out += c; continue; }
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+        if (c == '/' && i + 1 < end && text[i + 1] == '/')
+        {
+            while (i < end && text[i] != '\n') ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < end && text[i + 1] == '*')
+        {
+            size_t close = text.find("*/", i + 2);
+            i = (close == std::string::npos || close >= end) ? end : close + 1;
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+/**
+ * @brief How the command-line value of an edit becomes JSON.
+ */
+enum class PatchValueType
+{
+    Keep,   // --set: valid JSON is written as-is and anything else as a string, but a string stays a string
+    String, // --set-string: always a JSON string
+    Json    // --set-json: must be valid JSON, written as-is whatever the old value was
+};
+
+/**
+ * @brief One "--set path=value" edit and its outcome.
+ */
+struct PatchEdit
+{
+    std::string path;         // as given by the user, for messages
+    JsonPath pattern;         // split path
+    std::string value;        // JSON text written in place of the old value
+    std::string string_value; // JSON text written in place of an old string (Keep)
+    std::string raw;          // value as given on the command line
+    std::string written;      // JSON text at the last match, for messages
+    PatchValueType type = PatchValueType::Keep;
+    bool quiet = false;       // do not echo the value (secrets)
+    size_t changed = 0;       // matches whose text changed
+    size_t unchanged = 0;     // matches that already had this value
+
+    /**
+     * @brief JSON text to write over an old value that is a string or not.
+     */
+    const std::string &valueFor(bool old_is_string) const
+    {
+        return (old_is_string && type == PatchValueType::Keep) ? string_value : value;
+    }
+};
+
+/**
+ * @brief Sets the raw value of an edit and the JSON text written for it.
+ * @return False and sets error if a Json edit's value is not valid JSON.
+ */
+inline bool setEditValue(PatchEdit &edit, const std::string &raw, std::string &error)
+{
+    edit.raw = raw;
+    edit.string_value = jsonEscape(raw);
+    edit.value = edit.string_value;
+    if (edit.type == PatchValueType::String) return true;
+
+    JsonScanner scanner(raw);
+    JsonVisitor none;
+    if (raw.empty() || !scanner.scan(none))
+    {
+        if (edit.type != PatchValueType::Json) return true;
+        error = "value of '" + edit.path + "' is not valid JSON" + (raw.empty() ? "" : ": " + scanner.error());
+        return false;
+    }
+    edit.value = raw;
+    const size_t first = raw.find_first_not_of(" \t\r\n");
+    if (raw[first] == '"') edit.string_value = raw; // already a quoted string
+    return true;
+}
+
+/**
+ * @brief Parses "path=value" into an edit of the given type.
+ * @return False and sets error if the argument is malformed.
+ */
+inline bool parseSetArgument(const std::string &arg, PatchValueType type, PatchEdit &edit, std::string &error)
+{
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos || eq == 0)
+    {
+        error = "expected path=value, got '" + arg + "'";
+        return false;
+    }
+    edit.path = arg.substr(0, eq);
+    edit.pattern = splitPath(edit.path);
+    for (const auto &segment : edit.pattern)
+    {
+        if (segment.empty())
+        {
+            error = "empty segment in path '" + edit.path + "'";
+            return false;
+        }
+    }
+    edit.type = type;
+    return setEditValue(edit, arg.substr(eq + 1), error);
+}
+
+/**
+ * @brief Applies edits to JSON text in a single scan.
+ *
+ * Every value whose path matches an edit is replaced by the edit's value (see
+ * PatchEdit::valueFor for old strings); the first matching edit wins and the
+ * children of a replaced container are not visited. Everything between
+ * replaced values is copied through unchanged.
+ *
+ * @param input Original file content.
+ * @param edits Edits to apply; their changed/unchanged counters are updated.
+ * @param output Receives the patched content (equal to input if nothing changed).
+ * @param error Receives a parse error description on failure.
+ * @return True on success, false if the input is not valid JSON.
+ */
+inline bool applyPatches(const std::string &input, std::vector<PatchEdit> &edits, std::string &output, std::string &error)
+{
+    class Patcher : public JsonVisitor
+    {
+    public:
+        Patcher(const std::string &in, std::vector<PatchEdit> &e, std::string &out)
+            : m_in(in), m_edits(e), m_out(out), m_copied(0), m_active(-1), m_active_begin(0) {}
+
+        bool enter(const JsonPath &path, JsonKind kind, size_t begin) override
+        {
+            (void)kind;
+            if (path.empty()) return true;
+            for (size_t i = 0; i < m_edits.size(); ++i)
+            {
+                if (matchPath(m_edits[i].pattern, 0, path, 0))
+                {
+                    m_active = static_cast<int>(i);
+                    m_active_begin = begin;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void leave(const JsonPath &path, JsonKind kind, size_t begin, size_t end) override
+        {
+            (void)path;
+            if (m_active < 0 || begin != m_active_begin) return;
+
+            PatchEdit &edit = m_edits[m_active];
+            m_active = -1;
+            const std::string &value = edit.valueFor(kind == JsonKind::String);
+            edit.written = value;
+            if (m_in.compare(begin, end - begin, value) == 0)
+            {
+                ++edit.unchanged;
+                return;
+            }
+            m_out.append(m_in, m_copied, begin - m_copied);
+            m_out += value;
+            m_copied = end;
+            ++edit.changed;
+        }
+
+        void finish() { m_out.append(m_in, m_copied, std::string::npos); }
+
+    private:
+        const std::string &m_in;
+        std::vector<PatchEdit> &m_edits;
+        std::string &m_out;
+        size_t m_copied;
+        int m_active;
+        size_t m_active_begin;
+    };
+
+    output.clear();
+    output.reserve(input.size() + 64);
+    Patcher patcher(input, edits, output);
+    JsonScanner scanner(input);
+    if (!scanner.scan(patcher))
+    {
+        error = scanner.error();
+        return false;
+    }
+    patcher.finish();
+    return true;
+}
+
+/**
+ * @brief Fallback for text that is not JSON: replaces "key": <string or scalar> wherever
+ *        it appears, like the regex updater this patcher replaced.
+ *
+ * Only edits naming one key ("key" or "**.key") are applied, at any depth; the others
+ * keep zero counters and are reported as not found.
+ *
+ * @return True if at least one edit found its key this way.
+ */
+inline bool applyTextPatches(const std::string &input, std::vector<PatchEdit> &edits, std::string &output)
+{
+    static const std::regex special(R"([.^$|()\[\]{}*+?\\])");
+    output = input;
+    bool found = false;
+    for (auto &edit : edits)
+    {
+        const JsonPath &pattern = edit.pattern;
+        if (pattern.empty() || pattern.size() > 2 || (pattern.size() == 2 && pattern[0] != "**")) continue;
+        const std::string &key = pattern.back();
+        if (key == "*" || key == "**") continue;
+        const std::regex field("(\"" + std::regex_replace(key, special, "\\$&") + "\"\\s*:\\s*)"
+                               "(\"(?:[^\"\\\\]|\\\\.)*\"|-?[0-9][0-9.eE+-]*|true|false|null)");
+        std::string patched;
+        size_t copied = 0;
+        for (auto it = std::sregex_iterator(output.begin(), output.end(), field); it != std::sregex_iterator(); ++it)
+        {
+            const size_t begin = static_cast<size_t>(it->position(2));
+            const std::string &value = edit.valueFor(output[begin] == '"');
+            edit.written = value;
+            if (it->str(2) == value)
+            {
+                ++edit.unchanged;
+                continue;
+            }
+            patched.append(output, copied, begin - copied);
+            patched += value;
+            copied = begin + static_cast<size_t>(it->length(2));
+            ++edit.changed;
+        }
+        patched.append(output, copied, std::string::npos);
+        output.swap(patched);
+        if (edit.changed + edit.unchanged > 0) found = true;
+    }
+    return found;
+}
+
+} // namespace de_config
+
+#endif // DE_JSON_PATCH_HPP
@@ -0,0 +1,541 @@
+//***************************************************************************** */
+//  Hardlinked backup generations for DroneEngage module folders
+//
+//  Layout (default: /home/pi/drone_engage_backups):
+//      <mod>/<YYYYmmdd_HHMMSS>/tree/...     copy of the module folder
+//      <mod>/<YYYYmmdd_HHMMSS>/MANIFEST     one line per entry, see below
+//
+//  A file whose size, mtime and mode match the previous generation's manifest
+//  (or whose size and SHA-256 match, after a reinstall changed the mtime) is
+//  hardlinked to that generation's copy instead of being copied, so a backup
+//  only writes what changed since the last one. Pruning a generation only drops
+//  link counts. Restore copies a generation's files into a fresh folder and
+//  swaps it in with renameat2(RENAME_EXCHANGE). Links only exist inside the
+//  store, so a restored module never shares an inode with a backup. Owners
+//  are kept on backup and on restore.
+//
+//  MANIFEST:
+//      # version <module version or ->
+//      D <mode>\t<path>
+//      S\t<path>\t<target>
+//      F <mode> <size> <mtime_ns> <sha256>\t<path>
+//
+//***************************************************************************** */
+
+#ifndef DE_MODULE_BACKUP_HPP
+#define DE_MODULE_BACKUP_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "sha256.hpp"
+
+#define DE_BACKUP_MANIFEST "MANIFEST"
+#define DE_BACKUP_TREE "tree"
+
+namespace de_config
+{
+
+struct ManifestEntry
+{
+    char type = 'F';            // 'D', 'S' or 'F'
+    unsigned mode = 0;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    std::string hash;           // files
+    std::string target;         // symlinks
+};
+
+struct BackupGeneration
+{
+    std::string name;           // YYYYmmdd_HHMMSS
+    std::string path;
+    std::string version;
+    size_t files = 0;
+    uint64_t bytes = 0;
+};
+
+struct GenerationStats
+{
+    size_t files = 0;
+    size_t linked = 0;          // hardlinked to the previous generation
+    size_t copied = 0;
+    uint64_t linked_bytes = 0;
+    uint64_t copied_bytes = 0;
+};
+
+class ModuleBackup
+{
+public:
+    explicit ModuleBackup(const std::string &backup_dir) : m_dir(backup_dir) {}
+
+    const std::string &dir() const { return m_dir; }
+
+    /**
+     * @brief Lists the complete generations of a module, oldest first.
+     */
+    std::vector<BackupGeneration> list(const std::string &module) const
+    {
+        std::vector<BackupGeneration> out;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(m_dir + "/" + module, ec))
+        {
+            const std::string name = entry.path().filename().string();
+            if (name.find('.') != std::string::npos) continue; // unfinished "<name>.tmp"
+            BackupGeneration gen;
+            gen.name = name;
+            gen.path = entry.path().string();
+            std::map<std::string, ManifestEntry> manifest;
+            if (!readManifest(gen.path, manifest, gen.version)) continue;
+            for (const auto &item : manifest)
+            {
+                if (item.second.type != 'F') continue;
+                ++gen.files;
+                gen.bytes += item.second.size;
+            }
+            out.push_back(gen);
+        }
+        std::sort(out.begin(), out.end(), [](const BackupGeneration &a, const BackupGeneration &b) { return a.name < b.name; });
+        return out;
+    }
+
+    /**
+     * @brief Records module_dir as a new generation of module and prunes to keep generations.
+     * @param version Installed version recorded in the manifest (may be empty).
+     * @param keep Generations kept after this one is added, 0 = unlimited.
+     * @return False and sets error on failure; the previous generations are untouched.
+     */
+    bool create(const std::string &module, const std::string &module_dir, const std::string &version, size_t keep,
+                BackupGeneration &created, GenerationStats &stats, std::string &error)
+    {
+        const std::vector<BackupGeneration> generations = list(module);
+        std::map<std::string, ManifestEntry> previous;
+        std::string previous_tree, previous_version;
+        if (!generations.empty())
+        {
+            readManifest(generations.back().path, previous, previous_version);
+            previous_tree = generations.back().path + "/" + DE_BACKUP_TREE;
+        }
+
+        std::string name = timestamp();
+        while (!generations.empty() && name <= generations.back().name) name = bump(name); // several backups within one second
+        const std::string final_path = m_dir + "/" + module + "/" + name;
+        const std::string tmp_path = final_path + ".tmp";
+        const std::string tree = tmp_path + "/" + DE_BACKUP_TREE;
+        std::error_code ec;
+        std::filesystem::remove_all(tmp_path, ec);
+        std::filesystem::create_directories(tree, ec);
+        if (ec)
+        {
+            error = "cannot create " + tree + ": " + ec.message();
+            return false;
+        }
+        struct stat owner;
+        if (stat(module_dir.c_str(), &owner) == 0) keepOwner(tree, owner); // restore() gives the module folder this owner
+
+        std::ostringstream manifest;
+        manifest << "# version " << (version.empty() ? "-" : version) << "\n";
+        std::vector<std::string> paths;
+        for (auto it = std::filesystem::recursive_directory_iterator(module_dir, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            paths.push_back(it->path().lexically_relative(module_dir).generic_string());
+        }
+        if (ec)
+        {
+            error = "cannot list " + module_dir + ": " + ec.message();
+            std::filesystem::remove_all(tmp_path, ec);
+            return false;
+        }
+        std::sort(paths.begin(), paths.end());
+
+        for (const auto &rel : paths)
+        {
+            const std::string src = module_dir + "/" + rel;
+            const std::string dst = tree + "/" + rel;
+            struct stat st;
+            if (lstat(src.c_str(), &st) != 0) continue; // removed while walking
+            const unsigned mode = st.st_mode & 07777;
+            bool ok = true;
+            if (S_ISDIR(st.st_mode))
+            {
+                ok = mkdir(dst.c_str(), 0755) == 0;
+                ok = ok && keepOwner(dst, st); // the owner is restored from the tree
+                manifest << "D " << std::oct << mode << std::dec << "\t" << rel << "\n";
+            }
+            else if (S_ISLNK(st.st_mode))
+            {
+                const std::string target = std::filesystem::read_symlink(src, ec).string();
+                ok = symlink(target.c_str(), dst.c_str()) == 0;
+                ok = ok && keepOwner(dst, st);
+                manifest << "S\t" << rel << "\t" << target << "\n";
+            }
+            else if (S_ISREG(st.st_mode))
+            {
+                const int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+                const uint64_t size = static_cast<uint64_t>(st.st_size);
+                std::string hash;
+                const auto prev = previous.find(rel);
+                const bool same_size = prev != previous.end() && prev->second.type == 'F' && prev->second.size == size &&
+                                       prev->second.mode == mode;
+                // Quick check on size and mtime; a file reinstalled with a new mtime is hashed
+                // (reading is far cheaper than writing on SD cards) and linked if it is unchanged
+                if (same_size && (prev->second.mtime_ns == mtime_ns || (hashFile(src, hash) && hash == prev->second.hash)) &&
+                    link((previous_tree + "/" + rel).c_str(), dst.c_str()) == 0)
+                {
+                    hash = prev->second.hash;
+                    ++stats.linked;
+                    stats.linked_bytes += size;
+                }
+                else
+                {
+                    ok = copyFile(src, dst, st, hash, error);
+                    ++stats.copied;
+                    stats.copied_bytes += size;
+                }
+                ++stats.files;
+                manifest << "F " << std::oct << mode << std::dec << " " << size << " " << mtime_ns << " " << hash << "\t" << rel << "\n";
+            }
+            if (!ok)
+            {
+                if (error.empty()) error = "cannot back up " + src + ": " + std::strerror(errno);
+                std::filesystem::remove_all(tmp_path, ec);
+                return false;
+            }
+        }
+
+        if (!writeFile(tmp_path + "/" + DE_BACKUP_MANIFEST, manifest.str(), error) ||
+            rename(tmp_path.c_str(), final_path.c_str()) != 0)
+        {
+            if (error.empty()) error = "cannot finish " + final_path + ": " + std::strerror(errno);
+            std::filesystem::remove_all(tmp_path, ec);
+            return false;
+        }
+
+        created.name = name;
+        created.path = final_path;
+        created.version = version;
+        created.files = stats.files;
+        created.bytes = stats.linked_bytes + stats.copied_bytes;
+        prune(module, keep);
+        return true;
+    }
+
+    /**
+     * @brief Checks every file of a generation against the manifest hashes.
+     * @param bad Receives the paths that are missing or differ.
+     */
+    bool verify(const BackupGeneration &gen, std::vector<std::string> &bad, std::string &error) const
+    {
+        std::map<std::string, ManifestEntry> manifest;
+        std::string version;
+        if (!readManifest(gen.path, manifest, version))
+        {
+            error = "cannot read " + gen.path + "/" + DE_BACKUP_MANIFEST;
+            return false;
+        }
+        for (const auto &item : manifest)
+        {
+            if (item.second.type != 'F') continue;
+            std::string hash;
+            if (!hashFile(gen.path + "/" + DE_BACKUP_TREE + "/" + item.first, hash) || hash != item.second.hash)
+            {
+                bad.push_back(item.first);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Replaces module_dir with a generation by copying it into a new folder next to
+     *        module_dir and exchanging the two. Files are copied, not linked: a module that
+     *        rewrites a file in place would otherwise change the backup with it.
+     */
+    bool restore(const BackupGeneration &gen, const std::string &module_dir, std::string &error) const
+    {
+        std::map<std::string, ManifestEntry> manifest;
+        std::string version;
+        if (!readManifest(gen.path, manifest, version))
+        {
+            error = "cannot read " + gen.path + "/" + DE_BACKUP_MANIFEST;
+            return false;
+        }
+
+        const std::string fresh = module_dir + ".restore." + std::to_string(getpid());
+        const std::string tree = gen.path + "/" + DE_BACKUP_TREE;
+        std::error_code ec;
+        std::filesystem::remove_all(fresh, ec);
+        if (mkdir(fresh.c_str(), 0755) != 0)
+        {
+            error = "cannot create " + fresh + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat owner;
+        if (stat(tree.c_str(), &owner) == 0) keepOwner(fresh, owner);
+
+        // std::map orders "a" before "a/b", so folders exist before their contents
+        for (const auto &item : manifest)
+        {
+            const std::string src = tree + "/" + item.first;
+            const std::string dst = fresh + "/" + item.first;
+            const ManifestEntry &e = item.second;
+            struct stat st;
+            bool ok = lstat(src.c_str(), &st) == 0;
+            if (!ok)
+            {
+                error = "backup tree is missing " + item.first;
+            }
+            else if (e.type == 'D')
+            {
+                ok = mkdir(dst.c_str(), 0755) == 0 || errno == EEXIST; // final modes are set below
+                ok = ok && keepOwner(dst, st);
+            }
+            else if (e.type == 'S')
+            {
+                ok = symlink(e.target.c_str(), dst.c_str()) == 0;
+                ok = ok && keepOwner(dst, st);
+            }
+            else
+            {
+                std::string hash;
+                ok = copyFile(src, dst, st, hash, error);
+            }
+            if (!ok)
+            {
+                if (error.empty()) error = "cannot restore " + item.first + ": " + std::strerror(errno);
+                std::filesystem::remove_all(fresh, ec);
+                return false;
+            }
+        }
+        for (const auto &item : manifest)
+        {
+            if (item.second.type == 'D') chmod((fresh + "/" + item.first).c_str(), item.second.mode);
+        }
+
+        struct stat st;
+        if (lstat(module_dir.c_str(), &st) == 0)
+        {
+            if (syscall(SYS_renameat2, AT_FDCWD, fresh.c_str(), AT_FDCWD, module_dir.c_str(), RENAME_EXCHANGE) != 0)
+            {
+                const std::string old_dir = fresh + ".old";
+                if (rename(module_dir.c_str(), old_dir.c_str()) != 0 || rename(fresh.c_str(), module_dir.c_str()) != 0)
+                {
+                    error = std::string("cannot swap in restored folder: ") + std::strerror(errno);
+                    rename(old_dir.c_str(), module_dir.c_str());
+                    std::filesystem::remove_all(fresh, ec);
+                    return false;
+                }
+                std::filesystem::remove_all(old_dir, ec);
+            }
+            std::filesystem::remove_all(fresh, ec); // the replaced folder after an exchange
+        }
+        else if (rename(fresh.c_str(), module_dir.c_str()) != 0)
+        {
+            error = std::string("cannot install restored folder: ") + std::strerror(errno);
+            std::filesystem::remove_all(fresh, ec);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finds a generation by name, by "latest", or by index from the newest ("-1" = previous).
+     */
+    bool find(const std::string &module, const std::string &selector, BackupGeneration &out) const
+    {
+        const std::vector<BackupGeneration> generations = list(module);
+        if (generations.empty()) return false;
+        if (selector.empty() || selector == "latest")
+        {
+            out = generations.back();
+            return true;
+        }
+        if (selector[0] == '-')
+        {
+            const long back = std::strtol(selector.c_str() + 1, nullptr, 10);
+            if (back < 0 || static_cast<size_t>(back) >= generations.size()) return false;
+            out = generations[generations.size() - 1 - back];
+            return true;
+        }
+        for (const auto &gen : generations)
+        {
+            if (gen.name == selector || gen.name.compare(0, selector.size(), selector) == 0)
+            {
+                out = gen;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void prune(const std::string &module, size_t keep) const
+    {
+        if (keep == 0) return;
+        const std::vector<BackupGeneration> generations = list(module);
+        std::error_code ec;
+        for (size_t i = 0; i + keep < generations.size(); ++i)
+        {
+            std::filesystem::remove_all(generations[i].path, ec);
+        }
+    }
+
+    static bool readManifest(const std::string &gen_path, std::map<std::string, ManifestEntry> &out, std::string &version)
+    {
+        std::ifstream in(gen_path + "/" + DE_BACKUP_MANIFEST);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.compare(0, 10, "# version ") == 0)
+            {
+                version = line.substr(10);
+                if (version == "-") version.clear();
+                continue;
+            }
+            const size_t tab = line.find('\t');
+            if (line.empty() || tab == std::string::npos) continue;
+            ManifestEntry e;
+            e.type = line[0];
+            std::string rel = line.substr(tab + 1);
+            std::istringstream head(line.substr(1, tab - 1));
+            if (e.type == 'D')
+            {
+                head >> std::oct >> e.mode;
+            }
+            else if (e.type == 'S')
+            {
+                const size_t tab2 = rel.find('\t');
+                if (tab2 == std::string::npos) continue;
+                e.target = rel.substr(tab2 + 1);
+                rel.resize(tab2);
+            }
+            else if (e.type == 'F')
+            {
+                head >> std::oct >> e.mode >> std::dec >> e.size >> e.mtime_ns >> e.hash;
+            }
+            else
+            {
+                continue;
+            }
+            out[rel] = e;
+        }
+        return true;
+    }
+
+private:
+    static std::string timestamp()
+    {
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+        return stamp;
+    }
+
+    // Next name after an existing one in the same second: 20250101_120000 -> 20250101_120000_1 -> ..._2
+    static std::string bump(const std::string &name)
+    {
+        const size_t underscore = name.rfind('_');
+        if (underscore == 8) return name + "_1";
+        return name.substr(0, underscore + 1) + std::to_string(std::atoi(name.c_str() + underscore + 1) + 1);
+    }
+
+    // Gives path (not a symlink's target) the owner in st; fails harmlessly when not root
+    static bool keepOwner(const std::string &path, const struct stat &st)
+    {
+        return lchown(path.c_str(), st.st_uid, st.st_gid) == 0 || errno == EPERM;
+    }
+
+    // Copies a file while hashing it, keeping its owner, mode and mtime so the next backup can link to it
+    static bool copyFile(const std::string &src, const std::string &dst, const struct stat &st, std::string &hash, std::string &error)
+    {
+        const int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in == -1)
+        {
+            error = "cannot read " + src + ": " + std::strerror(errno);
+            return false;
+        }
+        const int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+        if (out == -1)
+        {
+            error = "cannot create " + dst + ": " + std::strerror(errno);
+            close(in);
+            return false;
+        }
+        Sha256 sha;
+        std::vector<char> buffer(256 * 1024);
+        bool ok = true;
+        ssize_t n;
+        while (ok && (n = read(in, buffer.data(), buffer.size())) > 0)
+        {
+            sha.update(buffer.data(), static_cast<size_t>(n));
+            for (ssize_t done = 0; ok && done < n;)
+            {
+                const ssize_t w = write(out, buffer.data() + done, static_cast<size_t>(n - done));
+                ok = w > 0;
+                done += w;
+            }
+        }
+        if (n < 0) ok = false;
+        // Owner first: chown clears the set-user-ID bits that fchmod sets again. Fails harmlessly when not root
+        if (fchown(out, st.st_uid, st.st_gid) != 0 && errno != EPERM) ok = false;
+        fchmod(out, st.st_mode & 07777);
+        const struct timespec times[2] = {st.st_atim, st.st_mtim};
+        futimens(out, times);
+        close(in);
+        if (close(out) != 0) ok = false;
+        if (!ok)
+        {
+            error = "cannot copy " + src + ": " + std::strerror(errno);
+            return false;
+        }
+        hash = sha.hexDigest();
+        return true;
+    }
+
+    static bool hashFile(const std::string &path, std::string &hash)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return false;
+        Sha256 sha;
+        std::vector<char> buffer(256 * 1024);
+        ssize_t n;
+        while ((n = read(fd, buffer.data(), buffer.size())) > 0) sha.update(buffer.data(), static_cast<size_t>(n));
+        close(fd);
+        if (n < 0) return false;
+        hash = sha.hexDigest();
+        return true;
+    }
+
+    static bool writeFile(const std::string &path, const std::string &content, std::string &error)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+        out.flush();
+        if (!out)
+        {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    std::string m_dir;
+};
+
+} // namespace de_config
+
+#endif // DE_MODULE_BACKUP_HPP
@@ -1,71 +1,285 @@
-//g++ -o updateConfig updateConfig.cpp -std=c++17 -lstdc++fs
+//g++ -o updateConfig updateConfig.cpp -std=c++17 -pthread -lstdc++fs
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <string>
-#include <regex>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include <sys/file.h> // For file locking (flock)
+#include <fcntl.h>    // For open
 #include <unistd.h>   // For close
+#include <glob.h>     // For expanding wildcard arguments
+#include <fnmatch.h>  // For matching files inside directory arguments
 #include <filesystem> // For backup and disk space checks
 #include <ctime>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <set>
+#include <cctype>
+#include <sys/stat.h>
 
-// Function to create a backup of the file
-bool createBackup(const std::string& file_path) {
-    std::string backup_path = file_path + ".bak." + std::to_string(std::time(nullptr));
-    try {
-        std::filesystem::copy_file(file_path, backup_path, std::filesystem::copy_options::overwrite_existing);
-        std::cout << "Backup created: " << backup_path << std::endl;
+#include "json_patch.hpp"
+#include "backup_store.hpp"
+#include "de_config_snapshot.hpp"
+
+// Files picked from a directory argument unless --pattern is given
+#define DEFAULT_DIRECTORY_PATTERN "*.config.module.json"
+
+enum class FileStatus {
+    Updated,
+    Unchanged,
+    Failed
+};
+
+// Result and buffered log of one file, printed in one piece so workers do not interleave
+struct FileReport {
+    std::string path;
+    FileStatus status = FileStatus::Failed;
+    double elapsed_ms = 0.0;
+    std::ostringstream out;
+    std::ostringstream err;
+};
+
+// Where and how long the previous versions of updated files are kept
+struct BackupOptions {
+    bool enabled = true;
+    std::string dir;                 // empty = <config dir>/.config_backups
+    de_config::BackupPolicy policy;
+};
+
+// Options shared by every file of a run
+struct UpdateOptions {
+    BackupOptions backup;
+    bool snapshot = false;           // keep <file>.snap binary snapshots up to date
+};
+
+de_config::BackupStore backupStoreFor(const std::string& file_path, const BackupOptions& options) {
+    return de_config::BackupStore(options.dir.empty() ? de_config::BackupStore::defaultDirFor(file_path) : options.dir);
+}
+
+// Function to record the current content of the file in the backup store
+bool createBackup(const std::string& file_path, const std::string& content, const BackupOptions& options, std::ostream& out, std::ostream& err) {
+    de_config::BackupStore store = backupStoreFor(file_path, options);
+    std::string hash, error;
+    bool stored = false;
+    if (!store.save(file_path, content, options.policy, hash, stored, error)) {
+        err << "Warning: Failed to create backup for " << file_path << ": " << error << std::endl;
+        return false;
+    }
+    out << "Backup " << (stored ? "stored" : "already present") << ": " << hash.substr(0, 12) << " in " << store.dir() << std::endl;
+    return true;
+}
+
+std::string snapshotPathFor(const std::string& file_path) {
+    return file_path + ".snap";
+}
+
+// Function to build the binary snapshot image of a config (see de_config_snapshot.hpp)
+bool buildSnapshot(const std::string& content, const struct stat& st, std::string& image, std::string& error) {
+    struct Value {
+        std::string path;
+        std::string text;
+        uint8_t kind;
+        uint32_t children = 0;
+        double number = 0.0;
+    };
+
+    class Collector : public de_config::JsonVisitor {
+    public:
+        Collector(const std::string& text, std::map<std::string, Value>& values) : m_text(text), m_values(values) {}
+        void leave(const de_config::JsonPath& path, de_config::JsonKind kind, size_t begin, size_t end) override {
+            Value v;
+            v.path = de_config::joinPath(path);
+            switch (kind) {
+            case de_config::JsonKind::Object: v.kind = de_config::SNAP_OBJECT; break;
+            case de_config::JsonKind::Array: v.kind = de_config::SNAP_ARRAY; break;
+            case de_config::JsonKind::String: v.kind = de_config::SNAP_STRING; break;
+            case de_config::JsonKind::Number: v.kind = de_config::SNAP_NUMBER; break;
+            case de_config::JsonKind::Bool: v.kind = de_config::SNAP_BOOL; break;
+            default: v.kind = de_config::SNAP_NULL; break;
+            }
+            if (kind == de_config::JsonKind::String) {
+                v.text = de_config::JsonScanner::decodeString(m_text, begin, end);
+            } else {
+                v.text = de_config::compactJson(m_text, begin, end);
+            }
+            if (kind == de_config::JsonKind::Number) v.number = std::strtod(v.text.c_str(), nullptr);
+            if (kind == de_config::JsonKind::Bool) v.number = (v.text == "true") ? 1.0 : 0.0;
+            auto counted = m_child_counts.find(v.path);
+            if (counted != m_child_counts.end()) v.children = counted->second;
+            if (!path.empty()) ++m_child_counts[de_config::joinPath(de_config::JsonPath(path.begin(), path.end() - 1))];
+            m_values[v.path] = v;
+        }
+    private:
+        const std::string& m_text;
+        std::map<std::string, Value>& m_values;
+        std::map<std::string, uint32_t> m_child_counts;
+    };
+
+    // Only valid JSON gets a snapshot
+    std::map<std::string, Value> values; // sorted by path, as the reader's binary search expects
+    Collector collector(content, values);
+    de_config::JsonScanner scanner(content);
+    if (!scanner.scan(collector)) {
+        error = scanner.error();
+        return false;
+    }
+
+    std::string pool;
+    std::vector<de_config::SnapshotEntry> entries;
+    entries.reserve(values.size());
+    for (const auto& item : values) {
+        de_config::SnapshotEntry e;
+        std::memset(&e, 0, sizeof(e));
+        e.path_offset = static_cast<uint32_t>(pool.size());
+        e.path_length = static_cast<uint32_t>(item.second.path.size());
+        pool += item.second.path;
+        e.text_offset = static_cast<uint32_t>(pool.size());
+        e.text_length = static_cast<uint32_t>(item.second.text.size());
+        pool += item.second.text;
+        e.kind = item.second.kind;
+        e.child_count = item.second.children;
+        e.number = item.second.number;
+        entries.push_back(e);
+    }
+
+    de_config::SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DE_SNAPSHOT_MAGIC, 8);
+    header.version = DE_SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    de_config::Sha256 sha;
+    sha.update(content);
+    sha.digest(header.source_sha256);
+    header.source_mtime_ns = de_config::fileMtimeNs(st);
+    header.source_size = content.size();
+    header.entry_count = entries.size();
+    header.entries_offset = sizeof(header);
+    header.strings_offset = header.entries_offset + entries.size() * sizeof(de_config::SnapshotEntry);
+    header.strings_size = pool.size();
+    header.file_size = (header.strings_offset + pool.size() + 7) & ~uint64_t(7);
+
+    image.assign(header.file_size, '\0');
+    if (!entries.empty()) {
+        std::memcpy(&image[header.entries_offset], entries.data(), entries.size() * sizeof(de_config::SnapshotEntry));
+    }
+    std::memcpy(&image[header.strings_offset], pool.data(), pool.size());
+    header.body_checksum = de_config::snapshotChecksum(reinterpret_cast<const uint8_t*>(image.data()) + sizeof(header), image.size() - sizeof(header));
+    std::memcpy(&image[0], &header, sizeof(header));
+    return true;
+}
+
+// Function to write content to a unique temporary file and rename it over file_path.
+// The temp file keeps the mode of the file it replaces; written receives its stat
+// taken before the rename, which the rename does not change.
+bool writeFileAtomically(const std::string& file_path, const std::string& content, std::ostream& err, struct stat* written = nullptr) {
+    std::string temp_path = file_path + ".tmp.XXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if (fd == -1) {
+        err << "Error: Failed to create temporary file for " << file_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat old_st;
+    const mode_t mode = (stat(file_path.c_str(), &old_st) == 0) ? (old_st.st_mode & 07777) : 0644;
+    bool ok = fchmod(fd, mode) == 0;
+    for (size_t done = 0; ok && done < content.size();) {
+        const ssize_t n = write(fd, content.data() + done, content.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) done += static_cast<size_t>(n);
+    }
+    if (ok && written) ok = fstat(fd, written) == 0;
+    if (close(fd) != 0) ok = false;
+    if (!ok) {
+        err << "Error: Failed to write temporary file " << temp_path << ": " << std::strerror(errno) << std::endl;
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    if (rename(temp_path.c_str(), file_path.c_str()) != 0) {
+        err << "Error: Failed to rename temporary file to " << file_path << ": " << std::strerror(errno) << std::endl;
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Function to write <file>.snap unless an up-to-date snapshot already exists.
+// st is the config as written or read under its lock, so the recorded size and
+// mtime always describe the content the snapshot is built from.
+bool updateSnapshot(const std::string& file_path, const std::string& content, const struct stat& st, std::ostream& out, std::ostream& err) {
+    const std::string snap_path = snapshotPathFor(file_path);
+    uint8_t digest[32];
+    de_config::Sha256 sha;
+    sha.update(content);
+    sha.digest(digest);
+
+    de_config::ConfigSnapshot existing;
+    if (existing.open(snap_path, file_path) && std::memcmp(existing.header().source_sha256, digest, 32) == 0) {
         return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Warning: Failed to create backup for " << file_path << ": " << e.what() << std::endl;
+    }
+    existing.close();
+
+    std::string image, error;
+    if (!buildSnapshot(content, st, image, error)) {
+        err << "Error: Not writing snapshot, " << file_path << " is invalid: " << error << std::endl;
+        return false;
+    }
+
+    if (!writeFileAtomically(snap_path, image, err)) {
         return false;
     }
+    out << "Snapshot written: " << snap_path << " (" << image.size() << " bytes)" << std::endl;
+    return true;
 }
 
 // Function to check available disk space
-bool checkDiskSpace(const std::string& file_path) {
+bool checkDiskSpace(const std::string& file_path, std::ostream& err) {
     try {
-        auto space = std::filesystem::space(std::filesystem::path(file_path).parent_path());
+        auto space = std::filesystem::space(std::filesystem::absolute(file_path).parent_path());
         if (space.available < 1024 * 1024) { // Require at least 1MB free
-            std::cerr << "Error: Insufficient disk space for " << file_path << std::endl;
+            err << "Error: Insufficient disk space for " << file_path << std::endl;
             return false;
         }
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Warning: Failed to check disk space for " << file_path << ": " << e.what() << std::endl;
+        err << "Warning: Failed to check disk space for " << file_path << ": " << e.what() << std::endl;
         return true; // Proceed cautiously
     }
 }
 
-// Function to update a single config file using text replacement
-bool updateConfigFile(const std::string& file_path, const std::string& username, const std::string& access_code, const std::string& server) {
-    // Check disk space
-    if (!checkDiskSpace(file_path)) {
-        return false;
-    }
-
+// Function to update a single config file by patching values in place.
+// Files whose content would not change are left alone: no backup, temp file or rename.
+FileStatus updateConfigFile(const std::string& file_path, std::vector<de_config::PatchEdit> edits, const UpdateOptions& options, std::ostream& out, std::ostream& err) {
     // Open file with locking
     int fd = open(file_path.c_str(), O_RDWR);
     if (fd == -1) {
-        std::cerr << "Error: Failed to open config file: " << file_path << std::endl;
-        return false;
+        err << "Error: Failed to open config file: " << file_path << std::endl;
+        return FileStatus::Failed;
     }
 
     // Acquire file lock
     if (flock(fd, LOCK_EX) == -1) {
-        std::cerr << "Error: Failed to lock file: " << file_path << std::endl;
+        err << "Error: Failed to lock file: " << file_path << std::endl;
         close(fd);
-        return false;
+        return FileStatus::Failed;
     }
 
     // Read the config file
     std::ifstream ifs(file_path);
     if (!ifs.is_open()) {
-        std::cerr << "Error: Failed to open config file for reading: " << file_path << std::endl;
+        err << "Error: Failed to open config file for reading: " << file_path << std::endl;
         flock(fd, LOCK_UN);
         close(fd);
-        return false;
+        return FileStatus::Failed;
     }
 
     std::stringstream ss;
@@ -73,135 +287,688 @@ bool updateConfigFile(const std::string& file_path, const std::string& username,
     std::string content = ss.str();
     ifs.close();
 
-    // Create a backup
-    if (!createBackup(file_path)) {
-        std::cerr << "Warning: Proceeding without backup for " << file_path << std::endl;
+    // Apply all edits in a single pass over the text
+    std::string final_content;
+    std::string parse_error;
+    if (!de_config::applyPatches(content, edits, final_content, parse_error)) {
+        // Not JSON: single-key edits still go through the old text replacement
+        for (auto& edit : edits) edit.changed = edit.unchanged = 0;
+        if (!de_config::applyTextPatches(content, edits, final_content)) {
+            err << "Error: Failed to parse " << file_path << ": " << parse_error << std::endl;
+            flock(fd, LOCK_UN);
+            close(fd);
+            return FileStatus::Failed;
+        }
+        err << "Warning: " << file_path << " is not valid JSON (" << parse_error << "); single keys replaced as text" << std::endl;
     }
 
-    // Declare updated flag
+    // Report the outcome of each edit
     bool updated = false;
-
-    // Prepare regex patterns for userName, accessCode, and auth_ip
-    // Matches: "userName": "value" or "userName" : "value" (with optional whitespace)
-    std::regex username_pattern("\"userName\"\\s*:\\s*\"([^\"]*)\"");
-    std::regex accesscode_pattern("\"accessCode\"\\s*:\\s*\"([^\"]*)\"");
-    std::regex authip_pattern("\"auth_ip\"\\s*:\\s*\"([^\"]*)\"");
-
-    std::string current_content = content;
-
-    // Replace userName only if username is not empty
-    if (!username.empty()) {
-        if (std::regex_search(current_content, username_pattern)) {
-            std::string new_content = std::regex_replace(
-                current_content,
-                username_pattern,
-                "\"userName\": \"" + username + "\""
-            );
-            if (new_content != current_content) {
-                std::cout << "Updated 'userName' to '" << username << "' in " << file_path << std::endl;
-            } else {
-                std::cout << "'userName' already set to '" << username << "' in " << file_path << std::endl;
-            }
-            updated = true;
-            current_content = new_content;
+    for (const auto& edit : edits) {
+        if (edit.changed + edit.unchanged == 0) {
+            err << "Warning: '" << edit.path << "' field not found in " << file_path << std::endl;
+            continue;
+        }
+        updated = true;
+        if (edit.changed > 0) {
+            out << "Updated '" << edit.path << "'";
+            if (!edit.quiet) out << " to " << edit.written;
+            out << " in " << file_path << std::endl;
         } else {
-            std::cerr << "Warning: 'userName' field not found in " << file_path << std::endl;
+            out << "'" << edit.path << "' already set";
+            if (!edit.quiet) out << " to " << edit.written;
+            out << " in " << file_path << std::endl;
         }
     }
 
-    // Replace accessCode only if access_code is not empty
-    if (!access_code.empty()) {
-        if (std::regex_search(current_content, accesscode_pattern)) {
-            std::string new_content = std::regex_replace(
-                current_content,
-                accesscode_pattern,
-                "\"accessCode\": \"" + access_code + "\""
-            );
-            if (new_content != current_content) {
-                std::cout << "Updated 'accessCode' in " << file_path << std::endl;
-            } else {
-                std::cout << "'accessCode' already set in " << file_path << std::endl;
+    if (!updated && !(edits.empty() && options.snapshot)) {
+        err << "Warning: No fields were updated in " << file_path << " (no parameters provided)" << std::endl;
+    }
+
+    if (final_content == content) {
+        struct stat st;
+        const bool have_stat = fstat(fd, &st) == 0;
+        flock(fd, LOCK_UN);
+        close(fd);
+        out << "No changes needed: " << file_path << std::endl;
+        if (options.snapshot && (!have_stat || !updateSnapshot(file_path, content, st, out, err))) {
+            return FileStatus::Failed;
+        }
+        return FileStatus::Unchanged;
+    }
+
+    // Check disk space
+    if (!checkDiskSpace(file_path, err)) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return FileStatus::Failed;
+    }
+
+    // Create a backup
+    if (options.backup.enabled && !createBackup(file_path, content, options.backup, out, err)) {
+        err << "Warning: Proceeding without backup for " << file_path << std::endl;
+    }
+
+    // Write to a temporary file and atomically rename it over the original
+    struct stat written;
+    if (!writeFileAtomically(file_path, final_content, err, &written)) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return FileStatus::Failed;
+    }
+
+    // Release file lock
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    out << "Config file updated successfully: " << file_path << std::endl;
+    if (options.snapshot && !updateSnapshot(file_path, final_content, written, out, err)) {
+        return FileStatus::Failed;
+    }
+    return FileStatus::Updated;
+}
+
+// Function to expand a file, directory or wildcard argument into file paths
+bool expandInput(const std::string& input, const std::string& pattern, std::vector<std::string>& files) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec)) {
+        std::vector<std::string> found;
+        for (const auto& entry : std::filesystem::directory_iterator(input, ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            if (fnmatch(pattern.c_str(), entry.path().filename().c_str(), 0) == 0) {
+                found.push_back(entry.path().string());
             }
-            updated = true;
-            current_content = new_content;
-        } else {
-            std::cerr << "Warning: 'accessCode' field not found in " << file_path << std::endl;
         }
+        if (found.empty()) {
+            std::cerr << "Warning: No files matching '" << pattern << "' in directory " << input << std::endl;
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+        return true;
+    }
+
+    if (input.find_first_of("*?[") != std::string::npos) {
+        glob_t matches;
+        int rc = glob(input.c_str(), 0, nullptr, &matches);
+        if (rc == GLOB_NOMATCH) {
+            std::cerr << "Warning: No files match " << input << std::endl;
+            return true;
+        }
+        if (rc != 0) {
+            std::cerr << "Error: Failed to expand " << input << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < matches.gl_pathc; ++i) {
+            files.push_back(matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+        return true;
+    }
+
+    files.push_back(input);
+    return true;
+}
+
+// Function to drop files named more than once (e.g. "dir" and "dir/*.json", or via a
+// symlink), keeping the first spelling; two workers must never patch the same file.
+// A symlink is replaced by its target so the rename updates the file, not the link.
+void removeDuplicateFiles(std::vector<std::string>& files) {
+    std::set<std::string> seen;
+    std::vector<std::string> unique;
+    for (const auto& file : files) {
+        std::error_code ec;
+        std::filesystem::path key = std::filesystem::weakly_canonical(file, ec);
+        if (ec) key = std::filesystem::absolute(file, ec).lexically_normal();
+        if (!seen.insert(key.string()).second) continue;
+        unique.push_back(std::filesystem::is_symlink(file, ec) ? key.string() : file);
+    }
+    files.swap(unique);
+}
+
+// Function to run task(i, report) for every report on a pool of worker threads
+template <typename Task>
+void runWorkers(std::vector<FileReport>& reports, unsigned int jobs, Task task) {
+    std::atomic<size_t> next(0);
+    std::mutex print_mutex;
+
+    auto worker = [&]() {
+        while (true) {
+            const size_t i = next.fetch_add(1);
+            if (i >= reports.size()) return;
+
+            FileReport& report = reports[i];
+            const auto start = std::chrono::steady_clock::now();
+            report.status = task(i, report);
+            report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(print_mutex);
+            std::cout << report.out.str() << std::flush;
+            std::cerr << report.err.str() << std::flush;
+        }
+    };
+
+    if (jobs > reports.size()) jobs = static_cast<unsigned int>(reports.size());
+    std::vector<std::thread> pool;
+    for (unsigned int j = 1; j < jobs; ++j) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
     }
+}
+
+// Function to process files on a pool of worker threads
+void processFiles(const std::vector<std::string>& files, const std::vector<de_config::PatchEdit>& edits, const UpdateOptions& options, unsigned int jobs, std::vector<FileReport>& reports) {
+    reports = std::vector<FileReport>(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        reports[i].path = files[i];
+    }
+    runWorkers(reports, jobs, [&](size_t i, FileReport& report) {
+        return updateConfigFile(files[i], edits, options, report.out, report.err);
+    });
+}
 
-    // Replace auth_ip only if server is not empty
-    if (!server.empty()) {
-        if (std::regex_search(current_content, authip_pattern)) {
-            std::string new_content = std::regex_replace(
-                current_content,
-                authip_pattern,
-                "\"auth_ip\": \"" + server + "\""
-            );
-            if (new_content != current_content) {
-                std::cout << "Updated 'auth_ip' to '" << server << "' in " << file_path << std::endl;
+// Function to evaluate a placeholder expression such as "i", "i0", "7500+100*i" or "2*i0+1".
+// Returns false for anything that is not a sum of integer products referring to i or i0.
+bool evalInstanceExpression(const std::string& expr, long long i, long long i0, long long& result) {
+    size_t pos = 0;
+    bool uses_instance = false;
+    result = 0;
+    auto skipSpaces = [&]() { while (pos < expr.size() && expr[pos] == ' ') ++pos; };
+
+    skipSpaces();
+    if (pos == expr.size()) return false;
+    long long sign = 1;
+    while (true) {
+        if (expr[pos] == '-') { sign = -sign; ++pos; skipSpaces(); }
+        long long term = sign;
+        while (true) {
+            if (pos < expr.size() && std::isdigit(static_cast<unsigned char>(expr[pos]))) {
+                long long n = 0;
+                while (pos < expr.size() && std::isdigit(static_cast<unsigned char>(expr[pos]))) {
+                    n = n * 10 + (expr[pos++] - '0');
+                    if (n > 1000000000000LL) return false;
+                }
+                term *= n;
+            } else if (expr.compare(pos, 2, "i0") == 0) {
+                term *= i0;
+                pos += 2;
+                uses_instance = true;
+            } else if (pos < expr.size() && expr[pos] == 'i') {
+                term *= i;
+                ++pos;
+                uses_instance = true;
             } else {
-                std::cout << "'auth_ip' already set to '" << server << "' in " << file_path << std::endl;
+                return false;
             }
-            updated = true;
-            current_content = new_content;
-        } else {
-            std::cerr << "Warning: 'auth_ip' field not found in " << file_path << std::endl;
+            skipSpaces();
+            if (pos < expr.size() && expr[pos] == '*') { ++pos; skipSpaces(); continue; }
+            break;
         }
+        result += term;
+        if (pos == expr.size()) return uses_instance;
+        if (expr[pos] == '+') sign = 1;
+        else if (expr[pos] == '-') sign = -1;
+        else return false;
+        ++pos;
+        skipSpaces();
+        if (pos == expr.size()) return false;
     }
+}
 
-    std::string final_content = current_content;
+// Function to replace {i}, {i0} and {BASE+STEP*i} placeholders for one generated instance.
+// Braces holding anything else (JSON objects, literal text) are copied unchanged.
+std::string expandInstance(const std::string& text, long long i, long long i0) {
+    std::string out;
+    out.reserve(text.size() + 16);
+    size_t copied = 0;
+    size_t open_pos = text.find('{');
+    while (open_pos != std::string::npos) {
+        const size_t close_pos = text.find('}', open_pos + 1);
+        if (close_pos == std::string::npos) break;
+        long long value = 0;
+        if (close_pos - open_pos <= 32 && evalInstanceExpression(text.substr(open_pos + 1, close_pos - open_pos - 1), i, i0, value)) {
+            out.append(text, copied, open_pos - copied);
+            out += std::to_string(value);
+            copied = close_pos + 1;
+            open_pos = text.find('{', copied);
+        } else {
+            open_pos = text.find('{', open_pos + 1);
+        }
+    }
+    out.append(text, copied, std::string::npos);
+    return out;
+}
 
-    if (!updated) {
-        std::cerr << "Warning: No fields were updated in " << file_path << " (no parameters provided)" << std::endl;
+// Function to write one generated config. Existing files with identical content
+// are not touched; changed ones are backed up first like any other update.
+FileStatus writeGeneratedFile(const std::string& file_path, const std::string& content, const UpdateOptions& options, std::ostream& out, std::ostream& err) {
+    std::error_code ec;
+    const std::filesystem::path parent = std::filesystem::absolute(file_path).parent_path();
+    std::filesystem::create_directories(parent, ec);
+    if (ec) {
+        err << "Error: Failed to create directory " << parent.string() << ": " << ec.message() << std::endl;
+        return FileStatus::Failed;
     }
 
-    // Write to a temporary file
-    std::string temp_path = file_path + ".tmp";
-    std::ofstream ofs(temp_path);
-    if (!ofs.is_open()) {
-        std::cerr << "Error: Failed to open temporary file for writing: " << temp_path << std::endl;
+    int fd = open(file_path.c_str(), O_RDWR);
+    if (fd != -1 && flock(fd, LOCK_EX) == -1) {
+        err << "Error: Failed to lock file: " << file_path << std::endl;
+        close(fd);
+        return FileStatus::Failed;
+    }
+    auto unlock = [&]() {
+        if (fd == -1) return;
         flock(fd, LOCK_UN);
         close(fd);
+        fd = -1;
+    };
+
+    if (fd != -1) {
+        std::ifstream ifs(file_path);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        const std::string existing = ss.str();
+        if (existing == content) {
+            struct stat st;
+            const bool have_stat = fstat(fd, &st) == 0;
+            unlock();
+            out << "No changes needed: " << file_path << std::endl;
+            if (options.snapshot && (!have_stat || !updateSnapshot(file_path, content, st, out, err))) {
+                return FileStatus::Failed;
+            }
+            return FileStatus::Unchanged;
+        }
+        if (options.backup.enabled && !createBackup(file_path, existing, options.backup, out, err)) {
+            err << "Warning: Proceeding without backup for " << file_path << std::endl;
+        }
+    }
+
+    struct stat written;
+    if (!checkDiskSpace(file_path, err) || !writeFileAtomically(file_path, content, err, &written)) {
+        unlock();
+        return FileStatus::Failed;
+    }
+    unlock();
+
+    out << "Config file generated: " << file_path << std::endl;
+    if (options.snapshot && !updateSnapshot(file_path, content, written, out, err)) {
+        return FileStatus::Failed;
+    }
+    return FileStatus::Updated;
+}
+
+// Function to render instance number i (index i0) of a template: placeholders in the
+// template text are expanded first, then the templated --set edits are applied.
+bool renderInstance(const std::string& template_text, const std::vector<de_config::PatchEdit>& edits, long long i, long long i0,
+                    std::string& content, std::vector<de_config::PatchEdit>& applied, std::string& error) {
+    applied = edits;
+    for (auto& edit : applied) {
+        if (!de_config::setEditValue(edit, expandInstance(edit.raw, i, i0), error)) return false;
+    }
+    return de_config::applyPatches(expandInstance(template_text, i, i0), applied, content, error);
+}
+
+// Function to generate count configs from one template in a single batched pass
+bool generateConfigs(const std::string& template_path, const std::string& out_pattern, unsigned int count, long long first,
+                     const std::vector<de_config::PatchEdit>& edits, const UpdateOptions& options, unsigned int jobs,
+                     std::vector<FileReport>& reports) {
+    std::ifstream ifs(template_path);
+    if (!ifs.is_open()) {
+        std::cerr << "Error: Failed to open template: " << template_path << std::endl;
         return false;
     }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    const std::string template_text = ss.str();
 
-    ofs << final_content;
-    ofs.close();
+    // Validate once up front instead of failing (or warning) count times
+    std::string content, error;
+    std::vector<de_config::PatchEdit> applied;
+    if (!renderInstance(template_text, edits, first, 0, content, applied, error)) {
+        std::cerr << "Error: Template " << template_path << " does not render to valid JSON: " << error << std::endl;
+        return false;
+    }
+    for (const auto& edit : applied) {
+        if (edit.changed + edit.unchanged == 0) {
+            std::cerr << "Error: '" << edit.path << "' field not found in template " << template_path << std::endl;
+            return false;
+        }
+    }
 
-    // Atomically rename temporary file to original
-    try {
-        std::filesystem::rename(temp_path, file_path);
-    } catch (const std::exception& e) {
-        std::cerr << "Error: Failed to rename temporary file to " << file_path << ": " << e.what() << std::endl;
+    reports = std::vector<FileReport>(count);
+    std::set<std::string> seen;
+    for (unsigned int n = 0; n < count; ++n) {
+        reports[n].path = expandInstance(out_pattern, first + n, n);
+        if (!seen.insert(reports[n].path).second) {
+            std::cerr << "Error: Output name " << out_pattern << " gives " << reports[n].path
+                      << " more than once; use {i} in it" << std::endl;
+            return false;
+        }
+    }
+
+    runWorkers(reports, jobs, [&](size_t n, FileReport& report) {
+        std::string instance, instance_error;
+        std::vector<de_config::PatchEdit> instance_edits;
+        if (!renderInstance(template_text, edits, first + static_cast<long long>(n), static_cast<long long>(n),
+                            instance, instance_edits, instance_error)) {
+            report.err << "Error: Instance " << (first + static_cast<long long>(n)) << " is not valid JSON: " << instance_error << std::endl;
+            return FileStatus::Failed;
+        }
+        return writeGeneratedFile(report.path, instance, options, report.out, report.err);
+    });
+    return true;
+}
+
+// Function to list the versions of a file recorded in the backup store
+bool listBackups(const std::string& file_path, const BackupOptions& options) {
+    de_config::BackupStore store = backupStoreFor(file_path, options);
+    std::vector<de_config::BackupEntry> entries;
+    std::string error;
+    if (!store.list(file_path, entries, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    std::cout << entries.size() << " version(s) of " << file_path << " in " << store.dir() << " (newest first):" << std::endl;
+    for (size_t i = entries.size(); i-- > 0;) {
+        const auto& e = entries[i];
+        char when[32];
+        std::time_t t = static_cast<std::time_t>(e.epoch);
+        std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+        std::cout << "  ~" << std::left << std::setw(3) << (entries.size() - 1 - i) << " " << when << "  "
+                  << e.hash.substr(0, 12) << "  " << e.size << " bytes" << std::endl;
+    }
+    return true;
+}
+
+// Function to restore a version of a file from the backup store.
+// The content being replaced is recorded first so a restore can itself be undone.
+bool restoreBackup(const std::string& file_path, const std::string& selector, const BackupOptions& options) {
+    int fd = open(file_path.c_str(), O_RDWR);
+    if (fd == -1) {
+        std::cerr << "Error: Failed to open config file: " << file_path << std::endl;
+        return false;
+    }
+    if (flock(fd, LOCK_EX) == -1) {
+        std::cerr << "Error: Failed to lock file: " << file_path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    auto fail = [&](const std::string& message) {
+        std::cerr << "Error: " << message << std::endl;
         flock(fd, LOCK_UN);
         close(fd);
         return false;
+    };
+
+    std::ifstream ifs(file_path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    const std::string current = ss.str();
+    ifs.close();
+
+    de_config::BackupStore store = backupStoreFor(file_path, options);
+    de_config::BackupEntry entry;
+    std::string content, error;
+    if (!store.resolve(file_path, selector, de_config::Sha256::hex(current), entry, error)) return fail(error);
+    if (!store.load(entry.hash, content, error)) return fail(error);
+
+    if (content == current) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        std::cout << file_path << " already matches " << entry.hash.substr(0, 12) << std::endl;
+        return true;
     }
 
-    // Release file lock
+    std::string saved_hash;
+    bool stored = false;
+    if (!store.save(file_path, current, options.policy, saved_hash, stored, error)) return fail(error);
+
+    const std::string temp_path = file_path + ".tmp";
+    std::ofstream ofs(temp_path);
+    if (!ofs.is_open()) return fail("Failed to open temporary file for writing: " + temp_path);
+    ofs << content;
+    ofs.close();
+    std::error_code ec;
+    std::filesystem::rename(temp_path, file_path, ec);
+    if (ec) return fail("Failed to rename temporary file to " + file_path + ": " + ec.message());
+
     flock(fd, LOCK_UN);
     close(fd);
-
-    std::cout << "Config file updated successfully: " << file_path << std::endl;
+    std::cout << "Restored " << file_path << " to " << entry.hash.substr(0, 12)
+              << " (previous content kept as " << saved_hash.substr(0, 12) << ")" << std::endl;
     return true;
 }
 
+// Function to print the per-file timing summary
+void printSummary(const std::vector<FileReport>& reports, double total_ms, unsigned int jobs) {
+    size_t updated = 0, unchanged = 0, failed = 0;
+    std::cout << std::endl << "Summary:" << std::endl;
+    for (const auto& report : reports) {
+        const char* status = "FAILED";
+        if (report.status == FileStatus::Updated) { status = "updated"; ++updated; }
+        else if (report.status == FileStatus::Unchanged) { status = "unchanged"; ++unchanged; }
+        else ++failed;
+        std::cout << "  " << std::left << std::setw(10) << status
+                  << std::right << std::fixed << std::setprecision(2) << std::setw(9) << report.elapsed_ms << " ms  "
+                  << report.path << std::endl;
+    }
+    std::cout << "  " << reports.size() << " file(s): " << updated << " updated, " << unchanged << " unchanged, "
+              << failed << " failed in " << std::fixed << std::setprecision(2) << total_ms << " ms using "
+              << jobs << " worker(s)" << std::endl;
+}
+
+void printUsage(const char* app) {
+    std::cerr << "Usage: " << app << " [--set <path>=<value>]... [--set-string <path>=<value>]... [--set-json <path>=<json>]... [--jobs N] [--pattern GLOB] [--] <file|dir|glob> [...]" << std::endl;
+    std::cerr << "       " << app << " <username> <access_code> <server> <file|dir|glob> [...]" << std::endl;
+    std::cerr << "       " << app << " --list-backups <file> | --restore <file> [<hash-prefix>|~N]" << std::endl;
+    std::cerr << "       " << app << " --generate <template> --count N --out <name with {i}> [--first N] [--set <path>=<value with {i}>]..." << std::endl;
+    std::cerr << "Snapshots: --snapshot writes/refreshes <file>.snap binary snapshots next to each config" << std::endl;
+    std::cerr << "Backup options: [--no-backup] [--backup-dir DIR] [--backup-keep N] [--backup-max-age DAYS]" << std::endl;
+    std::cerr << "--set keeps the type of a string already in the file; --set-string always writes a string, --set-json writes JSON as given." << std::endl;
+    std::cerr << "Paths are dot separated (e.g. module.ports.0); '*' matches one level and '**' any depth." << std::endl;
+    std::cerr << "Generator placeholders: {i} instance number (from --first, default 1), {i0} zero-based index, {BASE+STEP*i} e.g. {7500+100*i}." << std::endl;
+    std::cerr << "Directories are expanded to files matching --pattern (default " << DEFAULT_DIRECTORY_PATTERN << ")." << std::endl;
+    std::cerr << "Example: " << app << " --set userName=myUser --set s2s_udp_listening_port=7700 de_comm.config.module.json" << std::endl;
+    std::cerr << "Example: " << app << " --generate de_comm.template.json --count 50 --out 'sim/de_comm.{i}.config.module.json' --set 's2s_udp_listening_port={60000+10*i}'" << std::endl;
+    std::cerr << "Example: " << app << " --jobs 4 --set userName=myUser '/home/pi/simulator/sim_de_mavlink_instances/de_comm.*.config.module.json'" << std::endl;
+}
+
 int main(int argc, char** argv) {
-    // Check for at least username, access_code, server, and one file path
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " <username> <access_code> <server> <config_file_path> [<config_file_path> ...]" << std::endl;
-        return 1;
+    std::vector<de_config::PatchEdit> edits;
+    std::vector<std::string> inputs;
+    std::string pattern = DEFAULT_DIRECTORY_PATTERN;
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    UpdateOptions options;
+    BackupOptions& backup = options.backup;
+    std::string restore_file, restore_selector, list_file;
+    std::string generate_template, generate_out;
+    unsigned int generate_count = 0;
+    long long generate_first = 1;
+
+    if (argc >= 2 && std::string(argv[1]).rfind("--", 0) == 0) {
+        // Option form: any number of --set edits followed by files
+        bool only_files = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (only_files) {
+                inputs.push_back(arg);
+            } else if (arg == "--") {
+                only_files = true;
+            } else if (arg == "--set" || arg == "--set-string" || arg == "--set-json") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: " << arg << " requires <path>=<value>" << std::endl;
+                    return 1;
+                }
+                de_config::PatchEdit edit;
+                std::string error;
+                const de_config::PatchValueType type = (arg == "--set-string") ? de_config::PatchValueType::String
+                                                     : (arg == "--set-json") ? de_config::PatchValueType::Json
+                                                     : de_config::PatchValueType::Keep;
+                if (!de_config::parseSetArgument(argv[++i], type, edit, error)) {
+                    std::cerr << "Error: " << error << std::endl;
+                    return 1;
+                }
+                edits.push_back(edit);
+            } else if (arg == "--jobs" || arg == "-j") {
+                if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                    std::cerr << "Error: " << arg << " requires a positive number" << std::endl;
+                    return 1;
+                }
+                jobs = static_cast<unsigned int>(std::atoi(argv[++i]));
+            } else if (arg == "--pattern") {
+                if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                    std::cerr << "Error: --pattern requires a file name pattern" << std::endl;
+                    return 1;
+                }
+                pattern = argv[++i];
+            } else if (arg == "--generate") {
+                if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                    std::cerr << "Error: --generate requires a template config" << std::endl;
+                    return 1;
+                }
+                generate_template = argv[++i];
+            } else if (arg == "--count") {
+                if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                    std::cerr << "Error: --count requires a positive number" << std::endl;
+                    return 1;
+                }
+                generate_count = static_cast<unsigned int>(std::atoi(argv[++i]));
+            } else if (arg == "--first") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --first requires the number of the first instance" << std::endl;
+                    return 1;
+                }
+                generate_first = std::atoll(argv[++i]);
+            } else if (arg == "--out") {
+                if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                    std::cerr << "Error: --out requires an output file name such as de_comm.{i}.config.module.json" << std::endl;
+                    return 1;
+                }
+                generate_out = argv[++i];
+            } else if (arg == "--snapshot") {
+                options.snapshot = true;
+            } else if (arg == "--no-backup") {
+                backup.enabled = false;
+            } else if (arg == "--backup-dir") {
+                if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                    std::cerr << "Error: --backup-dir requires a directory" << std::endl;
+                    return 1;
+                }
+                backup.dir = argv[++i];
+            } else if (arg == "--backup-keep") {
+                if (i + 1 >= argc || std::atoi(argv[i + 1]) < 0) {
+                    std::cerr << "Error: --backup-keep requires a count (0 = unlimited)" << std::endl;
+                    return 1;
+                }
+                backup.policy.keep = static_cast<size_t>(std::atoi(argv[++i]));
+            } else if (arg == "--backup-max-age") {
+                if (i + 1 >= argc || std::atof(argv[i + 1]) < 0) {
+                    std::cerr << "Error: --backup-max-age requires a number of days (0 = never expire)" << std::endl;
+                    return 1;
+                }
+                backup.policy.max_age_sec = static_cast<long long>(std::atof(argv[++i]) * 86400);
+            } else if (arg == "--list-backups") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --list-backups requires a config file" << std::endl;
+                    return 1;
+                }
+                list_file = argv[++i];
+            } else if (arg == "--restore") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --restore requires a config file" << std::endl;
+                    return 1;
+                }
+                restore_file = argv[++i];
+                // Optional version selector: hash prefix or ~N
+                if (i + 1 < argc && argv[i + 1][0] != '-' && !std::filesystem::exists(argv[i + 1])) {
+                    restore_selector = argv[++i];
+                }
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (arg.rfind("--", 0) == 0) {
+                std::cerr << "Error: Unknown option " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            } else {
+                inputs.push_back(arg);
+            }
+        }
+    } else {
+        // Legacy form: <username> <access_code> <server> <files...>
+        if (argc < 5) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        // Empty values leave the field unchanged; '**' matches the key at any depth
+        const char* legacy_keys[] = {"userName", "accessCode", "auth_ip"};
+        for (int k = 0; k < 3; ++k) {
+            std::string value = argv[1 + k];
+            if (value.empty()) continue;
+            de_config::PatchEdit edit;
+            edit.path = legacy_keys[k];
+            edit.pattern = {"**", legacy_keys[k]};
+            edit.type = de_config::PatchValueType::String;
+            edit.value = de_config::jsonEscape(value);
+            edit.quiet = (k == 1);
+            edits.push_back(edit);
+        }
+        for (int i = 4; i < argc; ++i) {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (!list_file.empty()) {
+        return listBackups(list_file, backup) ? 0 : 1;
+    }
+    if (!restore_file.empty()) {
+        return restoreBackup(restore_file, restore_selector, backup) ? 0 : 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<FileReport> reports;
+    if (!generate_template.empty()) {
+        // Generator mode: one template, count instance configs
+        if (generate_count == 0 || generate_out.empty() || !inputs.empty()) {
+            std::cerr << "Error: --generate requires --count N and --out NAME and takes no input files" << std::endl;
+            return 1;
+        }
+        if (!generateConfigs(generate_template, generate_out, generate_count, generate_first, edits, options, jobs, reports)) {
+            return 1;
+        }
+    } else {
+        if (inputs.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        // Expand directories and wildcards
+        std::vector<std::string> files;
+        for (const auto& input : inputs) {
+            if (!expandInput(input, pattern, files)) {
+                return 1;
+            }
+        }
+        removeDuplicateFiles(files);
+        if (files.empty()) {
+            std::cerr << "Error: No config files to process." << std::endl;
+            return 1;
+        }
+
+        // Process the files in parallel
+        processFiles(files, edits, options, jobs, reports);
     }
+    const double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    std::string username = argv[1];
-    std::string access_code = argv[2];
-    std::string server = argv[3];
+    printSummary(reports, total_ms, std::min<unsigned int>(jobs, reports.size()));
 
-    // Process each file path starting from argv[4]
     bool all_success = true;
-    for (int i = 4; i < argc; ++i) {
-        std::string file_path = argv[i];
-        if (!updateConfigFile(file_path, username, access_code, server)) {
+    for (const auto& report : reports) {
+        if (report.status == FileStatus::Failed) {
             all_success = false;
         }
     }
@@ -214,4 +981,3 @@ int main(int argc, char** argv) {
         return 1;
     }
 }
-
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 
-/home/pi/scripts/c_helpers/updateConfig ENTER_ACCOUNT ENTER_PASSWORD cloud.ardupilot.org /home/pi/drone_engage/de_comm/de_comm.config.module.json /home/pi/simulator/sim_de_mavlink_instances/de_comm.1.config.module.json /home/pi/simulator/sim_de_mavlink_instances/de_comm.2.config.module.json
+/home/pi/scripts/c_helpers/updateConfig ENTER_ACCOUNT ENTER_PASSWORD cloud.ardupilot.org /home/pi/drone_engage/de_comm/de_comm.config.module.json '/home/pi/simulator/sim_de_mavlink_instances/de_comm.*.config.module.json'
 
 /home/pi/scripts/wifi_start_ap.sh
 
@@ -15,3 +15,6 @@ sudo find ~/drone_engage/de_camera -type f \( -iname "*.png" -o -iname "*.bmp" -
 # Delete all .bak files in drone_engage folder and subfolders
 sudo find ~/drone_engage -type f -name "*.bak" -delete 2>/dev/null
 
+# Delete the updateConfig backup stores; they still hold the previous account and password
+sudo find ~/drone_engage /home/pi/simulator -type d -name ".config_backups" -prune -exec rm -rf {} + 2>/dev/null
+
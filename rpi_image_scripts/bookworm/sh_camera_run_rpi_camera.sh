@@ -22,6 +22,10 @@
 #     (default: "DE-RPI").
 #   - Runs rpicam-vid with configured width/height/framerate and yuv420 output,
 #     piping rawvideo into FFmpeg which publishes to the target /dev/videoX.
+#   - With DE_RPI_ENCODED=1 (set by camera_manager_wrapper --rpi-encoded) the
+#     hardware H.264 encoder is used instead and the Annex-B stream is written
+#     to stdout; the wrapper publishes it to a shared-memory ring and decodes
+#     it to the virtual camera itself. All messages then go to stderr.
 #
 # Requirements:
 #   - rpicam-vid and rpicam-hello installed and accessible at the paths below.
@@ -32,6 +36,13 @@
 #   - CAM_LABEL_PREFIX: card label to match for the virtual camera.
 #   - RPICAM_VID, RPICAM_HELLO: paths to rpicam binaries.
 #   - VIDEO_WIDTH, VIDEO_HEIGHT, VIDEO_FRAMERATE: stream settings.
+#   - DE_RPI_ENCODED (environment): 1 = H.264 on stdout, see Behavior.
+#   - DE_VIDEO_WIDTH, DE_VIDEO_HEIGHT, DE_VIDEO_FRAMERATE (environment):
+#     override the stream settings above.
+#   - DE_VIDEO_MODE (environment): sensor mode passed to rpicam-vid --mode
+#     (W:H:bit-depth:packing), set by the wrapper's --capture-plan.
+#   - DE_RPI_METADATA (environment): path (a FIFO created by the wrapper's
+#     --frame-meta) that receives rpicam-vid's per-frame JSON metadata.
 #
 # Exit Codes:
 #   1  Usage error or virtual camera not found.
@@ -72,13 +83,21 @@ RPICAM_HELLO="/home/pi/rpicam-apps/build/apps/rpicam-hello"
 #VIDEO_WIDTH=640
 #VIDEO_HEIGHT=480
 #VIDEO_FRAMERATE=20
-VIDEO_WIDTH=1920
-VIDEO_HEIGHT=1080
-VIDEO_FRAMERATE=15
+# DE_VIDEO_* from the environment win (set by the wrapper's governor when it reduces capture load)
+VIDEO_WIDTH=${DE_VIDEO_WIDTH:-1920}
+VIDEO_HEIGHT=${DE_VIDEO_HEIGHT:-1080}
+VIDEO_FRAMERATE=${DE_VIDEO_FRAMERATE:-15}
+# Sensor mode chosen by the wrapper's --capture-plan; without it libcamera picks one
+SENSOR_MODE_OPTION=${DE_VIDEO_MODE:+--mode ${DE_VIDEO_MODE}}
 
 
 # --- Script Logic ---
 
+# Encoded mode: stdout carries the video, keep it clean of messages
+if [ "${DE_RPI_ENCODED}" = "1" ]; then
+    exec 3>&1 1>&2
+fi
+
 # Check for correct number of arguments (now 0 or 1)
 if [ "$#" -gt 1 ]; then
     echo -e "${YELLOW}Usage: $0 [postprocess_file_path]${NC}"
@@ -96,6 +115,21 @@ if ! ${RPICAM_HELLO} --list-cameras | grep -qi "available cameras"; then
 fi
 echo -e "${GREEN}Raspberry Pi camera detected. Proceeding with pipeline setup...${NC}"
 
+if [ "${DE_RPI_ENCODED}" = "1" ]; then
+    # One access unit per write (--flush), SPS/PPS before every keyframe (--inline),
+    # one keyframe per second so consumers can join the stream quickly
+    RPICAM_VID_COMMAND="${RPICAM_VID} -t 0 --vflip=1 --width ${VIDEO_WIDTH} --height ${VIDEO_HEIGHT} --framerate ${VIDEO_FRAMERATE} ${SENSOR_MODE_OPTION} --codec h264 --inline --flush --intra ${VIDEO_FRAMERATE} --info-text \"\""
+    if [ -n "${1:-}" ]; then
+        RPICAM_VID_COMMAND="${RPICAM_VID_COMMAND} --post-process-file ${1}"
+        echo -e "${GREEN}Using post-processing file: ${1}${NC}"
+    fi
+    if [ -n "${DE_RPI_METADATA}" ]; then
+        RPICAM_VID_COMMAND="${RPICAM_VID_COMMAND} --metadata ${DE_RPI_METADATA} --metadata-format json"
+    fi
+    echo -e "${BLUE}Executing command: ${YELLOW}${RPICAM_VID_COMMAND} -o -${NC}"
+    eval exec ${RPICAM_VID_COMMAND} -o - 1>&3 3>&-
+fi
+
 
 # *** UPDATED: Use the hardcoded index to form the target name ***
 TARGET_CAM_NAME="${CAM_LABEL_PREFIX}"
@@ -142,7 +176,7 @@ fi
 echo -e "${GREEN}Found ${TARGET_CAM_NAME} at ${TARGET_DEVICE}. Starting FFmpeg pipeline...${NC}"
 
 # Build the rpicam-vid command with or without the post-processing file
-RPICAM_VID_COMMAND="${RPICAM_VID} -t 0 --vflip=1 --width ${VIDEO_WIDTH} --height ${VIDEO_HEIGHT} --framerate ${VIDEO_FRAMERATE} --codec yuv420 --info-text \"\""
+RPICAM_VID_COMMAND="${RPICAM_VID} -t 0 --vflip=1 --width ${VIDEO_WIDTH} --height ${VIDEO_HEIGHT} --framerate ${VIDEO_FRAMERATE} ${SENSOR_MODE_OPTION} --codec yuv420 --info-text \"\""
 
 if [ -n "$POSTPROCESS_FILE" ]; then
     RPICAM_VID_COMMAND="${RPICAM_VID_COMMAND} --post-process-file ${POSTPROCESS_FILE}"
@@ -150,6 +184,9 @@ if [ -n "$POSTPROCESS_FILE" ]; then
 else
     echo -e "${YELLOW}No post-processing file specified.${NC}"
 fi
+if [ -n "${DE_RPI_METADATA}" ]; then
+    RPICAM_VID_COMMAND="${RPICAM_VID_COMMAND} --metadata ${DE_RPI_METADATA} --metadata-format json"
+fi
 
 # Construct the full FFmpeg command
 FFMPG_COMMAND="${RPICAM_VID_COMMAND} -o -  | ffmpeg -f rawvideo -pixel_format yuv420p -video_size ${VIDEO_WIDTH}x${VIDEO_HEIGHT} -i - -f v4l2 -pixel_format yuv420p ${TARGET_DEVICE} -loglevel quiet"
@@ -22,6 +22,7 @@
 #      - Extract and install the new version.
 #      - Fix file permissions.
 #      - Prune old backups (keep 3 most recent).
+#   Restore a backup with: deBackup restore <module> [generation]
 #   3. Log all actions with color-coded output.
 #   4. Clean up temporary files.
 #
@@ -29,6 +30,9 @@
 #   - BASE: Path to modules (default: /home/pi/drone_engage)
 #   - URL_BASE: Base URL for release files
 #   - BACKUP_DIR: Where backups are stored
+#   - DE_BACKUP: deBackup binary for hardlinked backup generations
+#                (default: /home/pi/scripts/c_helpers/deBackup). Without it,
+#                the module is backed up as a full tar.gz as before.
 #   - LOG: Log file (not actively used in this script)
 #
 # AUTHOR: Mohammad Hefny
@@ -90,6 +94,7 @@ BASE="/home/pi/drone_engage"
 TMP="/tmp/de_mod_$$"
 BACKUP_DIR="/home/pi/drone_engage_backups"
 VERSION_DIR="$BASE/.versions"
+DE_BACKUP="${DE_BACKUP:-/home/pi/scripts/c_helpers/deBackup}"
 
 # --- Logging and Setup ---
 RED='\033[31m'; GREEN='\033[32m'; YELLOW='\033[33m'; BLUE='\033[34m'; NC='\033[0m'
@@ -196,11 +201,18 @@ for mod in "${MODULE_LIST[@]}"; do
     }
     logc "Checksum OK" "$GREEN"
 
-    # 3. Backup
-    [[ -d "$BASE/$mod" ]] && {
+    # 3. Backup: a hardlinked generation only writes files changed since the last backup
+    if [[ -d "$BASE/$mod" ]]; then
         logc "Backing up $mod..." "$YELLOW"
-        sudo tar -czf "$BACKUP_DIR/${mod}_$(date +%Y%m%d_%H%M%S).tar.gz" -C "/" "${BASE#/}/$mod"
-    }
+        if [[ -x "$DE_BACKUP" ]]; then
+            # Never delete the installed module without a backup of it
+            sudo "$DE_BACKUP" --base "$BASE" --backup-dir "$BACKUP_DIR" --keep 3 backup "$mod" || {
+                logc "BACKUP FAIL: $mod, not updated" "$RED"; sudo rm -f "${mod}_${VERSION}".*; continue;
+            }
+        else
+            sudo tar -czf "$BACKUP_DIR/${mod}_$(date +%Y%m%d_%H%M%S).tar.gz" -C "/" "${BASE#/}/$mod"
+        fi
+    fi
 
     # 4. Extract new module
     sudo rm -rf "$BASE/$mod"
@@ -215,8 +227,8 @@ for mod in "${MODULE_LIST[@]}"; do
     find "$BASE/$mod" -type f -name 'de_*' -exec chmod +x {} \;
     find "$BASE/$mod" -type f \( -name '*.json' -o -name '*.crt' \) -exec chmod 644 {} \;
 
-    # Keep only 3 latest backups
-    find "$BACKUP_DIR" -name "${mod}_*.tar.gz" -printf '%T@ %p\n' | \
+    # Keep only 3 latest tar.gz backups (deBackup prunes its own generations)
+    find "$BACKUP_DIR" -maxdepth 1 -name "${mod}_*.tar.gz" -printf '%T@ %p\n' | \
         sort -nr | tail -n +4 | cut -d' ' -f2- | xargs -r sudo rm -f
 
     logc "$mod updated" "$GREEN"
@@ -6,10 +6,12 @@
 //
 //***************************************************************************** */
 
-// g++ camera_manager_wrapper.cpp -o camera_manager_wrapper -pthread
+// g++ camera_manager_wrapper.cpp -o camera_manager_wrapper -pthread -O2
 #include <iostream>    // For standard input/output operations
 #include <string>      // For std::string
 #include <vector>      // For std::vector to handle multiple scripts
+#include <sstream>     // For splitting comma-separated option lists
+#include <cstdio>      // For std::sscanf
 #include <cstdlib>     // For system(), exit()
 #include <thread>      // For std::this_thread::sleep_for
 #include <chrono>      // For std::chrono::seconds
@@ -19,7 +21,24 @@
 #include <csignal>     // For SIGTERM, SIGINT
 #include <getopt.h>    // For parsing command-line options
 
-#define VERSION_APP "4.2.0"
+#include "de_supervisor.hpp" // Supervised children table and WNOHANG monitoring loop
+#include "de_sim_fleet.hpp"  // --sim-fleet simulator instance groups
+#include "de_thermal.hpp"    // --enable-thermal-capture native thermal bridge
+#include "de_gimbal.hpp"     // --gimbal-native RTSP ingest
+#include "de_rpi_encoded.hpp" // --rpi-encoded H.264 camera pipeline
+#include "de_rtp_out.hpp"     // --stream-to RTP/UDP network output
+#include "de_governor.hpp"    // --governor thermal/power load shedding
+#include "de_cgroup.hpp"      // --cgroup per-module cgroup v2 leaves and PSI shedding
+#include "de_on_demand.hpp"   // --on-demand producers that run only while read
+#include "de_frame_meta.hpp"  // --frame-meta per-frame metadata rings
+#include "de_detections.hpp"  // IMX500 on-sensor detections ring
+#include "de_standby.hpp"     // --standby warm spares of slow-to-start modules
+#include "de_flight_recorder.hpp" // --flight-recorder persistent supervisor event log
+#include "de_chaos.hpp"       // --chaos fault injection and recovery timing
+#include "de_adaptive.hpp"    // --adapt-capture closed-loop capture mode
+#include "de_capture_plan.hpp" // --capture-plan capture mode from the modules' declared needs
+
+#define VERSION_APP "4.17.0"
 
 // Module startup delays in seconds since start - not incremental
 #define GIMBAL_MODULE_DELAY_SEC 2
@@ -29,15 +48,193 @@
 #define DE_CAMERA_MODULE_DELAY_SEC 25
 
 
+// Config snapshots (see c_helpers/de_config_snapshot.hpp) are passed to modules via the environment
+#define CONFIG_SNAPSHOT_SUFFIX ".snap"
+#define CONFIG_SNAPSHOT_ENV "DE_CONFIG_SNAPSHOT"
+
 // Global PID variables to track child processes
 pid_t camera_pid = -1;
 pid_t gimbal_camera_pid = -1;
+pid_t thermal_pid = -1;
+pid_t stream_pid = -1;
 pid_t tracking_camera_pid = -1;
 pid_t ai_tracking_camera_pid = -1;
 pid_t generic_ai_tracking_camera_pid = -1;
 pid_t de_camera_pid = -1;
 std::vector<pid_t> script_pids; // To track PIDs of executed scripts
 
+// Every started child is registered here; see de_supervisor.hpp
+ChildSupervisor supervisor;
+FlightRecorder flight_recorder; // records nothing until --flight-recorder opens it
+bool sim_fleet_mode = false;
+Governor *governor = nullptr; // set when --governor is given
+CgroupManager *cgroups = nullptr; // set when --cgroup is given
+OnDemand *on_demand = nullptr;    // set when --on-demand is given
+StandbyPool *standby = nullptr;   // set when --standby is given
+ChaosMonkey *chaos = nullptr;     // set when --chaos is given
+CapturePlan *capture_plan = nullptr; // set when --capture-plan is given
+
+// Long-only options of the simulator fleet mode
+enum SimFleetOption
+{
+    OPT_SIM_FLEET = 256,
+    OPT_SIM_FIRST,
+    OPT_SIM_PATH,
+    OPT_SIM_INSTANCES_DIR,
+    OPT_SIM_BASE_PORT,
+    OPT_SIM_PORT_STRIDE,
+    OPT_SIM_SPEEDUP,
+    OPT_SIM_READY_TIMEOUT,
+    OPT_SIM_REPORT_INTERVAL,
+    OPT_SIM_MAX_STARTING,
+    OPT_SIM_LOG_DIR,
+    OPT_SIM_START_STAGGER
+};
+
+// Long-only options of the thermal bridge
+enum ThermalOption
+{
+    OPT_THERMAL_CAPTURE = 300,
+    OPT_THERMAL_SOURCE,
+    OPT_THERMAL_SIZE,
+    OPT_THERMAL_FPS,
+    OPT_THERMAL_OUTPUT,
+    OPT_THERMAL_PALETTE,
+    OPT_THERMAL_RING,
+    OPT_THERMAL_UNITS,
+    OPT_THERMAL_FRAMES
+};
+
+// Long-only options of the native gimbal ingest
+enum GimbalOption
+{
+    OPT_GIMBAL_NATIVE = 320,
+    OPT_GIMBAL_URL,
+    OPT_GIMBAL_TRANSPORT,
+    OPT_GIMBAL_JITTER,
+    OPT_GIMBAL_OUTPUT,
+    OPT_GIMBAL_DECODER,
+    OPT_GIMBAL_NO_DECODE,
+    OPT_GIMBAL_PASSTHROUGH
+};
+
+// Long-only options of the encoded camera pipeline
+enum RpiEncodedOption
+{
+    OPT_RPI_ENCODED = 340,
+    OPT_RPI_NO_DECODE,
+    OPT_RPI_DETECTIONS,
+    OPT_RPI_NO_DETECTIONS,
+    OPT_RPI_DECODER
+};
+
+// Long-only options of the RTP network output
+enum StreamOption
+{
+    OPT_STREAM_TO = 360,
+    OPT_STREAM_RING,
+    OPT_STREAM_MTU,
+    OPT_STREAM_BATCH,
+    OPT_STREAM_RATE,
+    OPT_STREAM_SDP
+};
+
+// Long-only options of the load governor
+enum GovernorOption
+{
+    OPT_GOVERNOR = 380,
+    OPT_GOVERNOR_SYSFS_ROOT,
+    OPT_GOVERNOR_TEMPS,
+    OPT_GOVERNOR_HOLD,
+    OPT_GOVERNOR_BATTERY_FILE,
+    OPT_GOVERNOR_BATTERY_LOW,
+    OPT_GOVERNOR_MAX_LEVEL,
+    OPT_GOVERNOR_REDUCED,
+    OPT_GOVERNOR_STATUS
+};
+
+// Long-only options of the cgroup isolation and PSI shedding
+enum CgroupOption
+{
+    OPT_CGROUP = 400,
+    OPT_CGROUP_ROOT,
+    OPT_CGROUP_LIMIT,
+    OPT_CGROUP_PSI,
+    OPT_CGROUP_PSI_HOLD,
+    OPT_CGROUP_PSI_ROOT,
+    OPT_CGROUP_REPORT,
+    OPT_CGROUP_STATUS
+};
+
+// Long-only options of the demand-driven producers
+enum OnDemandOption
+{
+    OPT_ON_DEMAND = 420,
+    OPT_ON_DEMAND_GRACE,
+    OPT_ON_DEMAND_POLL,
+    OPT_ON_DEMAND_STATUS
+};
+
+// Long-only options of the per-frame metadata rings
+enum FrameMetaOption
+{
+    OPT_FRAME_META = 440,
+    OPT_FRAME_META_PREFIX
+};
+
+// Long-only options of the warm-standby spares
+enum StandbyOption
+{
+    OPT_STANDBY = 460,
+    OPT_STANDBY_WARMUP,
+    OPT_STANDBY_RESPAWN,
+    OPT_STANDBY_STATUS
+};
+
+// Long-only options of the flight recorder
+enum FlightRecorderOption
+{
+    OPT_FLIGHT_RECORDER = 480,
+    OPT_FLIGHT_RECORDER_RECORDS,
+    OPT_FLIGHT_RECORDER_SYNC
+};
+
+// Long-only options of the chaos mode
+enum ChaosOption
+{
+    OPT_CHAOS = 500,
+    OPT_CHAOS_FAULTS,
+    OPT_CHAOS_TARGETS,
+    OPT_CHAOS_STOP_MS,
+    OPT_CHAOS_DELAY_MS,
+    OPT_CHAOS_DURATION,
+    OPT_CHAOS_SEED,
+    OPT_CHAOS_REPORT
+};
+
+// Long-only options of the adaptive capture mode
+enum AdaptiveOption
+{
+    OPT_ADAPT_CAPTURE = 520,
+    OPT_ADAPT_LADDER,
+    OPT_ADAPT_UPTAKE,
+    OPT_ADAPT_LATENCY,
+    OPT_ADAPT_CPU,
+    OPT_ADAPT_HOLD,
+    OPT_ADAPT_SOURCE,
+    OPT_ADAPT_STATUS
+};
+
+// Long-only options of the capture-mode negotiation
+enum CapturePlanOption
+{
+    OPT_CAPTURE_PLAN = 540,
+    OPT_CAPTURE_NEED,
+    OPT_CAPTURE_SENSOR_MODES,
+    OPT_CAPTURE_PLAN_STATUS,
+    OPT_CAPTURE_PLAN_ONLY
+};
+
 // Default base directories for drone_engage modules
 const std::string DEFAULT_BASE_DRONE_ENGAGE_PATH = "/home/pi/drone_engage/";
 const std::string DEFAULT_SCRIPTS_PATH = "/home/pi/scripts";
@@ -130,9 +327,11 @@ pid_t startScript(const std::string &scriptPath)
 /**
  * @brief Forks a new process to start the rpicam-vid | ffmpeg pipeline.
  * @param postProcessFile Optional path to a post-processing file.
+ * @param encoded If set, runs the script in H.264 mode under RpiEncodedStage (see de_rpi_encoded.hpp).
+ * @param metadata Rings fed from rpicam-vid's metadata in the raw pipeline. The encoded pipeline uses encoded->metadata.
  * @return The process ID (PID) of the child process, -1 on failure, or 0 if no RPI camera is detected.
  */
-pid_t startCameraPipeline(const std::string &postProcessFile)
+pid_t startCameraPipeline(const std::string &postProcessFile, const RpiEncodedOptions *encoded, const RpiMetadataOptions &metadata)
 {
     std::string cameraCmd = SCRIPTS_PATH + "/sh_camera_run_rpi_camera.sh ";
     if (!postProcessFile.empty())
@@ -140,7 +339,18 @@ pid_t startCameraPipeline(const std::string &postProcessFile)
         cameraCmd += " \"" + postProcessFile + "\"";
     }
 
-    pid_t pid = fork();
+    pid_t pid;
+    if (encoded)
+    {
+        RpiEncodedOptions options = *encoded;
+        options.script = SCRIPTS_PATH + "/sh_camera_run_rpi_camera.sh";
+        options.post_process_file = postProcessFile;
+        pid = spawnFunction("encoded camera pipeline", [options]() { return RpiEncodedStage(options).run(); });
+    }
+    else
+    {
+        pid = fork();
+    }
     if (pid == -1)
     {
         std::cerr << "Failed to fork for camera pipeline." << std::endl;
@@ -148,6 +358,19 @@ pid_t startCameraPipeline(const std::string &postProcessFile)
     }
     else if (pid == 0)
     {
+        setpgid(0, 0); // rpicam-vid | ffmpeg are stopped with the script (see ChildSupervisor::replace)
+        if (metadata.enabled())
+        {
+            // The tap shares the script's process group and exits with it
+            std::string fifo;
+            const int fd = openRpicamMetadataFifo(fifo);
+            if (fd != -1)
+            {
+                if (fork() == 0) _exit(runRpicamMetadataTap(fd, fifo, metadata));
+                close(fd);
+                setenv("DE_RPI_METADATA", fifo.c_str(), 1);
+            }
+        }
         std::cout << "Calling sh_camera_run_rpi_camera.sh with command: " << cameraCmd << std::endl;
         execlp("sh", "sh", "-c", cameraCmd.c_str(), (char *)NULL);
         perror("execlp for camera pipeline failed");
@@ -194,6 +417,30 @@ pid_t startCameraPipeline(const std::string &postProcessFile)
     return pid;
 }
 
+/**
+ * @brief Forks the native RTSP ingest for DE-GIMBAL (see de_gimbal.hpp).
+ * @return The process ID (PID) of the child process, or -1 on failure.
+ */
+pid_t startNativeGimbalPipeline(const GimbalIngestOptions &options)
+{
+    pid_t pid = spawnFunction("gimbal ingest", [options]() { return GimbalIngest(options).run(); });
+    if (pid == -1)
+    {
+        return -1;
+    }
+
+    // Only configuration errors end the ingest early; link problems are retried inside it
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid)
+    {
+        std::cerr << "Gimbal ingest " << describeExitStatus(status) << " during startup." << std::endl;
+        return -1;
+    }
+    std::cout << "Gimbal ingest started with PID: " << pid << std::endl;
+    return pid;
+}
+
 /**
  * @brief Forks a new process to start the RTSP | ffmpeg pipeline for DE-GIMBAL.
  * @return The process ID (PID) of the child process, or -1 on failure.
@@ -251,17 +498,68 @@ pid_t startGimbalCameraPipeline()
     return pid;
 }
 
+/**
+ * @brief Forks the native thermal bridge (see de_thermal.hpp): raw frames to a shared
+ *        memory ring and a colour-mapped preview to DE-THERMAL.
+ * @return The process ID (PID) of the child process, or -1 on failure.
+ */
+pid_t startThermalPipeline(const ThermalOptions &options)
+{
+    pid_t pid = spawnFunction("thermal bridge", [options]() { return ThermalBridge(options).run(); });
+    if (pid == -1)
+    {
+        return -1;
+    }
+
+    // Give the bridge a short time to open its source and output
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid)
+    {
+        std::cerr << "Thermal bridge " << describeExitStatus(status) << " during startup." << std::endl;
+        return -1;
+    }
+    std::cout << "Thermal bridge started with PID: " << pid << std::endl;
+    return pid;
+}
+
+/**
+ * @brief Forks the RTP network output (see de_rtp_out.hpp). It waits for its ring,
+ *        so it can start before the capture stage has created it.
+ * @return The process ID (PID) of the child process, or -1 on failure.
+ */
+pid_t startStreamOutput(const RtpOutOptions &options)
+{
+    pid_t pid = spawnFunction("rtp output", [options]() { return RtpOutput(options).run(); });
+    if (pid == -1)
+    {
+        return -1;
+    }
+
+    // Give the output a short time to resolve its receivers
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid)
+    {
+        std::cerr << "RTP output " << describeExitStatus(status) << " during startup." << std::endl;
+        return -1;
+    }
+    std::cout << "RTP output started with PID: " << pid << std::endl;
+    return pid;
+}
+
 /**
  * @brief Forks a new process to start a module executable.
  * @param modulePath Path to the module executable.
  * @param moduleConfig Path to the module's configuration file.
  * @param moduleName Name of the module for logging.
  * @param workingDir Directory to change to before executing.
+ * @param standby Start a warm spare (DE_STANDBY=1, see de_standby.hpp).
  * @return The process ID (PID) of the child process, or -1 on failure.
  */
-pid_t startModule(const std::string &modulePath, const std::string &moduleConfig, const std::string &moduleName, const std::string &workingDir)
+pid_t startModule(const std::string &modulePath, const std::string &moduleConfig, const std::string &moduleName, const std::string &workingDir, bool standby = false)
 {
-    std::cout << "Starting module: " << moduleName << std::endl;
+    std::cout << "Starting module: " << moduleName << (standby ? " (standby)" : "") << std::endl;
     std::cout << "  Module path: " << modulePath << std::endl;
     std::cout << "  Config path: " << moduleConfig << std::endl;
     std::cout << "  Working dir: " << workingDir << std::endl;
@@ -282,44 +580,79 @@ pid_t startModule(const std::string &modulePath, const std::string &moduleConfig
         std::cerr << "ERROR: Working directory not found: " << workingDir << std::endl;
         return -1;
     }
+
+    // Binary snapshot written by updateConfig --snapshot; the module validates it against the config
+    const std::string snapshotPath = moduleConfig + CONFIG_SNAPSHOT_SUFFIX;
+    const bool hasSnapshot = (access(snapshotPath.c_str(), R_OK) == 0);
+    if (hasSnapshot) {
+        std::cout << "  Snapshot: " << snapshotPath << std::endl;
+    }
     
-    pid_t pid = fork();
+    std::vector<std::pair<std::string, std::string>> env;
+    if (hasSnapshot)
+    {
+        env.push_back({CONFIG_SNAPSHOT_ENV, snapshotPath});
+    }
+    if (standby)
+    {
+        env.push_back({STANDBY_ENV, "1"});
+    }
+    if (capture_plan)
+    {
+        capture_plan->addEnvironment(moduleName, env);
+    }
+
+    std::cout << "Executing: " << modulePath << " -c " << moduleConfig << " in dir " << workingDir << std::endl;
+    pid_t pid = spawnProcess({modulePath, "-c", moduleConfig}, workingDir, env, "");
     if (pid == -1)
     {
         std::cerr << "Failed to fork for " << moduleName << "." << std::endl;
         return -1;
     }
-    else if (pid == 0)
-    {
-        if (chdir(workingDir.c_str()) == -1)
-        {
-            perror(("chdir for " + moduleName + " failed").c_str());
-            _exit(1);
-        }
-        std::cout << "Executing: " << modulePath << " -c " << moduleConfig << " in dir " << workingDir << std::endl;
-        execlp(modulePath.c_str(), moduleName.c_str(), "-c", moduleConfig.c_str(), (char *)NULL);
-        perror(("execlp for " + moduleName + " failed").c_str());
-        _exit(127);
-    }
     std::cout << moduleName << " started with PID: " << pid << std::endl;
     return pid;
 }
 
+/**
+ * @brief Hands back what the supervisor features hold: standby spares are stopped and
+ *        every paused process is continued, since a stopped process would not act on SIGTERM.
+ */
+void releaseFeatures()
+{
+    if (governor) governor->release();
+    if (cgroups) cgroups->release();
+    if (on_demand) on_demand->release();
+    if (standby) standby->release();
+    if (chaos) chaos->release();
+    supervisor.wakeAll(); // whatever is still paused, e.g. by a feature that has no release()
+}
+
 /**
  * @brief Gracefully stops all child processes, including scripts.
  */
 void stopAllChildren()
 {
+    releaseFeatures();
     if (camera_pid > 0)
     {
         std::cout << "Stopping camera pipeline (PID " << camera_pid << ")..." << std::endl;
-        kill(camera_pid, SIGTERM);
+        if (kill(-camera_pid, SIGTERM) == -1) kill(camera_pid, SIGTERM); // the script's group, if it leads one
     }
     if (gimbal_camera_pid > 0)
     {
         std::cout << "Stopping gimbal camera pipeline (PID " << gimbal_camera_pid << ")..." << std::endl;
         kill(gimbal_camera_pid, SIGTERM);
     }
+    if (thermal_pid > 0)
+    {
+        std::cout << "Stopping thermal bridge (PID " << thermal_pid << ")..." << std::endl;
+        kill(thermal_pid, SIGTERM);
+    }
+    if (stream_pid > 0)
+    {
+        std::cout << "Stopping RTP output (PID " << stream_pid << ")..." << std::endl;
+        kill(stream_pid, SIGTERM);
+    }
     if (tracking_camera_pid > 0)
     {
         std::cout << "Stopping tracking module (PID " << tracking_camera_pid << ")..." << std::endl;
@@ -362,13 +695,34 @@ void preemptiveKill()
     std::this_thread::sleep_for(std::chrono::seconds(2));
 }
 
+/**
+ * @brief Stops the supervised stack, on a signal or when the supervisor loop returns.
+ */
+void shutdownChildren()
+{
+    releaseFeatures();
+    // In-wrapper pipelines (thermal bridge, gimbal ingest, RTP output) are not known to sh_kill_all_camera_apps.sh
+    for (auto &child : supervisor.children())
+    {
+        if (child.pid > 0 && child.policy == RestartPolicy::Restart) kill(child.pid, SIGTERM);
+    }
+    preemptiveKill();
+    if (cgroups) cgroups->cleanup();
+}
+
 /**
  * @brief Signal handler for termination signals (SIGINT, SIGTERM).
  */
 void signal_handler(int signal_num)
 {
     std::cout << "Received signal " << signal_num << ". Shutting down." << std::endl;
-    preemptiveKill();
+    flight_recorder.record(SupervisorEvent::Shutdown, "wrapper", getpid(), signal_num);
+    if (sim_fleet_mode)
+    {
+        supervisor.stopAll();
+        exit(0);
+    }
+    shutdownChildren();
     exit(0);
 }
 
@@ -377,6 +731,8 @@ int main(int argc, char *argv[])
     // Command-line options
     bool enable_rpi_cam_capture = false;
     bool enable_gimbal_capture = false;
+    bool enable_thermal_capture = false;
+    bool gimbal_native = false;
     bool enable_tracker = false;
     bool enable_ai_tracker = false;
     bool enable_generic_ai_tracker = false;
@@ -391,6 +747,64 @@ int main(int argc, char *argv[])
     int de_camera_delay_sec = DE_CAMERA_MODULE_DELAY_SEC;
     int gimbal_delay_sec = 0; // Default: no delay for gimbal
 
+    // Simulator fleet mode (--sim-fleet N) replaces the camera stack
+    SimFleetOptions fleet_options;
+
+    // Native thermal bridge (--enable-thermal-capture)
+    ThermalOptions thermal_options;
+
+    // Native gimbal RTSP ingest (--gimbal-native)
+    GimbalIngestOptions gimbal_options;
+
+    // H.264 camera pipeline (--rpi-encoded)
+    bool rpi_encoded = false;
+    RpiEncodedOptions rpi_encoded_options;
+
+    // RTP network output of a capture ring (--stream-to)
+    RtpOutOptions stream_options;
+
+    // Thermal/power load governor (--governor)
+    bool enable_governor = false;
+    GovernorOptions governor_options;
+
+    // cgroup v2 isolation and PSI shedding (--cgroup)
+    bool enable_cgroups = false;
+    CgroupOptions cgroup_options;
+
+    // Demand-driven producers (--on-demand)
+    bool enable_on_demand = false;
+    OnDemandOptions on_demand_options;
+
+    // Warm spares of slow-to-start modules (--standby)
+    StandbyOptions standby_options;
+
+    // Persistent supervisor event log (--flight-recorder)
+    std::string flight_recorder_path;
+    int flight_recorder_records = FLIGHT_RECORDER_DEFAULT_RECORDS;
+    int flight_recorder_sync_sec = 5;
+
+    // Fault injection (--chaos)
+    ChaosOptions chaos_options;
+
+    // Closed-loop capture resolution and frame rate (--adapt-capture)
+    bool enable_adaptive = false;
+    std::string adaptive_ladder = "1920x1080@15,1280x720@15,1280x720@10,640x480@10";
+    AdaptiveOptions adaptive_options;
+
+    // Capture mode from the modules' declared needs (--capture-plan)
+    bool enable_capture_plan = false;
+    bool capture_plan_only = false;
+    CapturePlanOptions capture_plan_options;
+
+    // Per-frame metadata rings (--frame-meta)
+    bool enable_frame_meta = false;
+    std::string frame_meta_prefix = "de_meta_";
+    RpiMetadataOptions rpi_metadata;
+
+    // IMX500 on-sensor detections (on with an imx500_object_detection post-process file)
+    bool rpi_detections = true;
+    std::string rpi_detection_ring = DETECTION_DEFAULT_RING;
+
     std::cout << "Camera Wrapper ver: " << VERSION_APP << std::endl;
 
     // Parse command-line options
@@ -410,6 +824,97 @@ int main(int argc, char *argv[])
         {"de-camera-delay", required_argument, 0, 'C'},
         {"gimbal-delay", required_argument, 0, 'M'},
         {"version", no_argument, 0, 'v'},
+        {"sim-fleet", required_argument, 0, OPT_SIM_FLEET},
+        {"sim-first", required_argument, 0, OPT_SIM_FIRST},
+        {"sim-path", required_argument, 0, OPT_SIM_PATH},
+        {"sim-instances-dir", required_argument, 0, OPT_SIM_INSTANCES_DIR},
+        {"sim-base-port", required_argument, 0, OPT_SIM_BASE_PORT},
+        {"sim-port-stride", required_argument, 0, OPT_SIM_PORT_STRIDE},
+        {"sim-speedup", required_argument, 0, OPT_SIM_SPEEDUP},
+        {"sim-ready-timeout", required_argument, 0, OPT_SIM_READY_TIMEOUT},
+        {"sim-report-interval", required_argument, 0, OPT_SIM_REPORT_INTERVAL},
+        {"sim-max-starting", required_argument, 0, OPT_SIM_MAX_STARTING},
+        {"sim-log-dir", required_argument, 0, OPT_SIM_LOG_DIR},
+        {"sim-start-stagger", required_argument, 0, OPT_SIM_START_STAGGER},
+        {"enable-thermal-capture", no_argument, 0, OPT_THERMAL_CAPTURE},
+        {"thermal-source", required_argument, 0, OPT_THERMAL_SOURCE},
+        {"thermal-size", required_argument, 0, OPT_THERMAL_SIZE},
+        {"thermal-fps", required_argument, 0, OPT_THERMAL_FPS},
+        {"thermal-output", required_argument, 0, OPT_THERMAL_OUTPUT},
+        {"thermal-palette", required_argument, 0, OPT_THERMAL_PALETTE},
+        {"thermal-ring", required_argument, 0, OPT_THERMAL_RING},
+        {"thermal-units", required_argument, 0, OPT_THERMAL_UNITS},
+        {"thermal-frames", required_argument, 0, OPT_THERMAL_FRAMES},
+        {"gimbal-native", no_argument, 0, OPT_GIMBAL_NATIVE},
+        {"gimbal-url", required_argument, 0, OPT_GIMBAL_URL},
+        {"gimbal-transport", required_argument, 0, OPT_GIMBAL_TRANSPORT},
+        {"gimbal-jitter-ms", required_argument, 0, OPT_GIMBAL_JITTER},
+        {"gimbal-output", required_argument, 0, OPT_GIMBAL_OUTPUT},
+        {"gimbal-decoder", required_argument, 0, OPT_GIMBAL_DECODER},
+        {"gimbal-no-decode", no_argument, 0, OPT_GIMBAL_NO_DECODE},
+        {"gimbal-passthrough", required_argument, 0, OPT_GIMBAL_PASSTHROUGH},
+        {"rpi-encoded", required_argument, 0, OPT_RPI_ENCODED},
+        {"rpi-no-decode", no_argument, 0, OPT_RPI_NO_DECODE},
+        {"rpi-detections", required_argument, 0, OPT_RPI_DETECTIONS},
+        {"rpi-no-detections", no_argument, 0, OPT_RPI_NO_DETECTIONS},
+        {"rpi-decoder", required_argument, 0, OPT_RPI_DECODER},
+        {"stream-to", required_argument, 0, OPT_STREAM_TO},
+        {"stream-ring", required_argument, 0, OPT_STREAM_RING},
+        {"stream-mtu", required_argument, 0, OPT_STREAM_MTU},
+        {"stream-batch", required_argument, 0, OPT_STREAM_BATCH},
+        {"stream-rate-kbps", required_argument, 0, OPT_STREAM_RATE},
+        {"stream-sdp", required_argument, 0, OPT_STREAM_SDP},
+        {"governor", no_argument, 0, OPT_GOVERNOR},
+        {"governor-sysfs-root", required_argument, 0, OPT_GOVERNOR_SYSFS_ROOT},
+        {"governor-temps", required_argument, 0, OPT_GOVERNOR_TEMPS},
+        {"governor-hold", required_argument, 0, OPT_GOVERNOR_HOLD},
+        {"governor-battery-file", required_argument, 0, OPT_GOVERNOR_BATTERY_FILE},
+        {"governor-battery-low", required_argument, 0, OPT_GOVERNOR_BATTERY_LOW},
+        {"governor-max-level", required_argument, 0, OPT_GOVERNOR_MAX_LEVEL},
+        {"governor-reduced", required_argument, 0, OPT_GOVERNOR_REDUCED},
+        {"governor-status", required_argument, 0, OPT_GOVERNOR_STATUS},
+        {"cgroup", no_argument, 0, OPT_CGROUP},
+        {"cgroup-root", required_argument, 0, OPT_CGROUP_ROOT},
+        {"cgroup-limit", required_argument, 0, OPT_CGROUP_LIMIT},
+        {"cgroup-psi", required_argument, 0, OPT_CGROUP_PSI},
+        {"cgroup-psi-hold", required_argument, 0, OPT_CGROUP_PSI_HOLD},
+        {"cgroup-psi-root", required_argument, 0, OPT_CGROUP_PSI_ROOT},
+        {"cgroup-report", required_argument, 0, OPT_CGROUP_REPORT},
+        {"cgroup-status", required_argument, 0, OPT_CGROUP_STATUS},
+        {"on-demand", no_argument, 0, OPT_ON_DEMAND},
+        {"on-demand-grace", required_argument, 0, OPT_ON_DEMAND_GRACE},
+        {"on-demand-poll-ms", required_argument, 0, OPT_ON_DEMAND_POLL},
+        {"on-demand-status", required_argument, 0, OPT_ON_DEMAND_STATUS},
+        {"standby", required_argument, 0, OPT_STANDBY},
+        {"standby-warmup", required_argument, 0, OPT_STANDBY_WARMUP},
+        {"standby-respawn", required_argument, 0, OPT_STANDBY_RESPAWN},
+        {"standby-status", required_argument, 0, OPT_STANDBY_STATUS},
+        {"flight-recorder", required_argument, 0, OPT_FLIGHT_RECORDER},
+        {"flight-recorder-records", required_argument, 0, OPT_FLIGHT_RECORDER_RECORDS},
+        {"flight-recorder-sync", required_argument, 0, OPT_FLIGHT_RECORDER_SYNC},
+        {"chaos", required_argument, 0, OPT_CHAOS},
+        {"chaos-faults", required_argument, 0, OPT_CHAOS_FAULTS},
+        {"chaos-targets", required_argument, 0, OPT_CHAOS_TARGETS},
+        {"chaos-stop-ms", required_argument, 0, OPT_CHAOS_STOP_MS},
+        {"chaos-delay-ms", required_argument, 0, OPT_CHAOS_DELAY_MS},
+        {"chaos-duration", required_argument, 0, OPT_CHAOS_DURATION},
+        {"chaos-seed", required_argument, 0, OPT_CHAOS_SEED},
+        {"chaos-report", required_argument, 0, OPT_CHAOS_REPORT},
+        {"adapt-capture", no_argument, 0, OPT_ADAPT_CAPTURE},
+        {"adapt-ladder", required_argument, 0, OPT_ADAPT_LADDER},
+        {"adapt-uptake", required_argument, 0, OPT_ADAPT_UPTAKE},
+        {"adapt-latency", required_argument, 0, OPT_ADAPT_LATENCY},
+        {"adapt-cpu", required_argument, 0, OPT_ADAPT_CPU},
+        {"adapt-hold", required_argument, 0, OPT_ADAPT_HOLD},
+        {"adapt-source", required_argument, 0, OPT_ADAPT_SOURCE},
+        {"adapt-status", required_argument, 0, OPT_ADAPT_STATUS},
+        {"capture-plan", no_argument, 0, OPT_CAPTURE_PLAN},
+        {"capture-need", required_argument, 0, OPT_CAPTURE_NEED},
+        {"capture-sensor-modes", required_argument, 0, OPT_CAPTURE_SENSOR_MODES},
+        {"capture-plan-status", required_argument, 0, OPT_CAPTURE_PLAN_STATUS},
+        {"capture-plan-only", no_argument, 0, OPT_CAPTURE_PLAN_ONLY},
+        {"frame-meta", no_argument, 0, OPT_FRAME_META},
+        {"frame-meta-prefix", required_argument, 0, OPT_FRAME_META_PREFIX},
         {0, 0, 0, 0}};
 
     int opt;
@@ -510,6 +1015,403 @@ int main(int argc, char *argv[])
                 if (gimbal_delay_sec < 0) gimbal_delay_sec = 0;
             }
             break;
+        case OPT_SIM_FLEET:
+            fleet_options.count = std::atoi(optarg);
+            if (fleet_options.count <= 0)
+            {
+                std::cerr << "Error: --sim-fleet requires a positive number of instances." << std::endl;
+                return 1;
+            }
+            sim_fleet_mode = true;
+            break;
+        case OPT_SIM_FIRST:
+            fleet_options.first = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_SIM_PATH:
+            fleet_options.simulator_path = optarg;
+            if (fleet_options.simulator_path.back() != '/')
+                fleet_options.simulator_path += "/";
+            break;
+        case OPT_SIM_INSTANCES_DIR:
+            fleet_options.instances_dir = optarg;
+            if (fleet_options.instances_dir.back() != '/')
+                fleet_options.instances_dir += "/";
+            break;
+        case OPT_SIM_BASE_PORT:
+            fleet_options.base_port = std::atoi(optarg);
+            break;
+        case OPT_SIM_PORT_STRIDE:
+            fleet_options.port_stride = std::max(SIM_FLEET_PORTS_PER_INSTANCE, std::atoi(optarg));
+            break;
+        case OPT_SIM_SPEEDUP:
+            fleet_options.speedup = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_SIM_READY_TIMEOUT:
+            fleet_options.ready_timeout_sec = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_SIM_REPORT_INTERVAL:
+            fleet_options.report_sec = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_SIM_MAX_STARTING:
+            fleet_options.max_starting = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_SIM_LOG_DIR:
+            fleet_options.log_dir = optarg;
+            break;
+        case OPT_SIM_START_STAGGER:
+            fleet_options.start_stagger_ms = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_THERMAL_CAPTURE:
+            enable_thermal_capture = true;
+            break;
+        case OPT_THERMAL_SOURCE:
+            thermal_options.source = optarg;
+            break;
+        case OPT_THERMAL_SIZE:
+            if (std::sscanf(optarg, "%ux%u", &thermal_options.width, &thermal_options.height) != 2 || thermal_options.width == 0 || thermal_options.height == 0)
+            {
+                std::cerr << "Error: --thermal-size expects WIDTHxHEIGHT, e.g. 80x62." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_THERMAL_FPS:
+            thermal_options.fps = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_THERMAL_OUTPUT:
+            thermal_options.output = optarg;
+            break;
+        case OPT_THERMAL_PALETTE:
+            thermal_options.palette = optarg;
+            break;
+        case OPT_THERMAL_RING:
+            thermal_options.ring_name = optarg;
+            break;
+        case OPT_THERMAL_UNITS:
+            if (std::sscanf(optarg, "%f,%f", &thermal_options.unit_scale, &thermal_options.unit_offset) != 2)
+            {
+                std::cerr << "Error: --thermal-units expects SCALE,OFFSET (degrees C = raw * SCALE + OFFSET)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_THERMAL_FRAMES:
+            thermal_options.max_frames = std::max(0L, std::atol(optarg));
+            break;
+        case OPT_GIMBAL_NATIVE:
+            enable_gimbal_capture = true;
+            gimbal_native = true;
+            break;
+        case OPT_GIMBAL_URL:
+            gimbal_options.url = optarg;
+            break;
+        case OPT_GIMBAL_TRANSPORT:
+            if (std::string(optarg) != "tcp" && std::string(optarg) != "udp")
+            {
+                std::cerr << "Error: --gimbal-transport must be tcp or udp." << std::endl;
+                return 1;
+            }
+            gimbal_options.tcp = std::string(optarg) == "tcp";
+            break;
+        case OPT_GIMBAL_JITTER:
+            gimbal_options.jitter_ms = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_GIMBAL_OUTPUT:
+            gimbal_options.output = optarg;
+            break;
+        case OPT_GIMBAL_DECODER:
+            gimbal_options.decoder = optarg;
+            break;
+        case OPT_GIMBAL_NO_DECODE:
+            gimbal_options.decoder.clear();
+            break;
+        case OPT_GIMBAL_PASSTHROUGH:
+            gimbal_options.passthrough = optarg;
+            break;
+        case OPT_RPI_ENCODED:
+            enable_rpi_cam_capture = true;
+            rpi_encoded = true;
+            rpi_encoded_options.ring = optarg;
+            break;
+        case OPT_RPI_NO_DECODE:
+            rpi_encoded_options.decoder.clear();
+            break;
+        case OPT_RPI_DECODER:
+            rpi_encoded_options.decoder = optarg;
+            break;
+        case OPT_RPI_DETECTIONS:
+            rpi_detections = true;
+            rpi_detection_ring = optarg;
+            break;
+        case OPT_RPI_NO_DETECTIONS:
+            rpi_detections = false;
+            break;
+        case OPT_STREAM_TO:
+        {
+            // Comma-separated receivers, the option may also be repeated
+            std::string list = optarg;
+            size_t start = 0;
+            while (start <= list.size())
+            {
+                const size_t comma = list.find(',', start);
+                const std::string destination = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                if (!destination.empty()) stream_options.destinations.push_back(destination);
+                if (comma == std::string::npos) break;
+                start = comma + 1;
+            }
+            break;
+        }
+        case OPT_STREAM_RING:
+            stream_options.ring = optarg;
+            break;
+        case OPT_STREAM_MTU:
+            stream_options.mtu = std::atoi(optarg);
+            break;
+        case OPT_STREAM_BATCH:
+            stream_options.batch = std::atoi(optarg);
+            break;
+        case OPT_STREAM_RATE:
+            stream_options.rate_kbps = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_STREAM_SDP:
+            stream_options.sdp_path = optarg;
+            break;
+        case OPT_GOVERNOR:
+            enable_governor = true;
+            break;
+        case OPT_GOVERNOR_SYSFS_ROOT:
+            enable_governor = true;
+            governor_options.sysfs_root = optarg;
+            break;
+        case OPT_GOVERNOR_TEMPS:
+            if (std::sscanf(optarg, "%lf,%lf", &governor_options.hot_c, &governor_options.cool_c) != 2 || governor_options.cool_c >= governor_options.hot_c)
+            {
+                std::cerr << "Error: --governor-temps must be hot,cool in degrees C with cool < hot (e.g. 75,68)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_GOVERNOR_HOLD:
+            if (std::sscanf(optarg, "%d,%d", &governor_options.up_sec, &governor_options.down_sec) != 2 || governor_options.up_sec < 1 || governor_options.down_sec < 1)
+            {
+                std::cerr << "Error: --governor-hold must be up,down in seconds (e.g. 5,30)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_GOVERNOR_BATTERY_FILE:
+            governor_options.battery_file = optarg;
+            break;
+        case OPT_GOVERNOR_BATTERY_LOW:
+            governor_options.battery_low_pct = std::atoi(optarg);
+            break;
+        case OPT_GOVERNOR_MAX_LEVEL:
+            governor_options.max_level = std::atoi(optarg);
+            break;
+        case OPT_GOVERNOR_REDUCED:
+        {
+            unsigned width = 0, height = 0;
+            int fps = 0;
+            if (std::sscanf(optarg, "%ux%u@%d", &width, &height, &fps) != 3 || width == 0 || height == 0 || fps <= 0)
+            {
+                std::cerr << "Error: --governor-reduced must be WxH@fps (e.g. 1280x720@10)." << std::endl;
+                return 1;
+            }
+            governor_options.reduced_size = std::to_string(width) + "x" + std::to_string(height);
+            governor_options.reduced_fps = fps;
+            break;
+        }
+        case OPT_GOVERNOR_STATUS:
+            governor_options.status_path = optarg;
+            break;
+        case OPT_CGROUP:
+            enable_cgroups = true;
+            break;
+        case OPT_CGROUP_ROOT:
+            enable_cgroups = true;
+            cgroup_options.root = optarg;
+            while (cgroup_options.root.size() > 1 && cgroup_options.root.back() == '/') cgroup_options.root.pop_back();
+            break;
+        case OPT_CGROUP_LIMIT:
+            enable_cgroups = true;
+            if (!cgroupParseLimit(optarg, cgroup_options.limits))
+            {
+                std::cerr << "Error: --cgroup-limit must be <module>:key=value,... with keys cpu, weight, mem_high, mem_max, oom, prio (e.g. de_yolo_generic:cpu=150,mem_high=400M)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_CGROUP_PSI:
+            if (std::sscanf(optarg, "%lf,%lf", &cgroup_options.psi_memory, &cgroup_options.psi_cpu) != 2 || cgroup_options.psi_memory <= 0 || cgroup_options.psi_cpu <= 0)
+            {
+                std::cerr << "Error: --cgroup-psi must be memory,cpu stall percentages (e.g. 10,40)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_CGROUP_PSI_HOLD:
+            if (std::sscanf(optarg, "%d,%d", &cgroup_options.up_sec, &cgroup_options.down_sec) != 2 || cgroup_options.up_sec < 1 || cgroup_options.down_sec < 1)
+            {
+                std::cerr << "Error: --cgroup-psi-hold must be up,down in seconds (e.g. 2,15)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_CGROUP_PSI_ROOT:
+            cgroup_options.psi_root = optarg;
+            break;
+        case OPT_CGROUP_REPORT:
+            cgroup_options.report_sec = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_CGROUP_STATUS:
+            cgroup_options.status_path = optarg;
+            break;
+        case OPT_ON_DEMAND:
+            enable_on_demand = true;
+            break;
+        case OPT_ON_DEMAND_GRACE:
+            on_demand_options.grace_sec = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_ON_DEMAND_POLL:
+            on_demand_options.poll_ms = std::max(50, std::atoi(optarg));
+            break;
+        case OPT_ON_DEMAND_STATUS:
+            on_demand_options.status_path = optarg;
+            break;
+        case OPT_STANDBY:
+        {
+            std::stringstream names(optarg);
+            std::string name;
+            while (std::getline(names, name, ','))
+            {
+                if (name != "de_yolo_generic" && name != "de_ai_tracker.so" && name != "de_tracker" && name != "de_camera")
+                {
+                    std::cerr << "Error: --standby takes de_yolo_generic, de_ai_tracker.so, de_tracker and/or de_camera." << std::endl;
+                    return 1;
+                }
+                standby_options.modules.insert(name);
+            }
+            break;
+        }
+        case OPT_STANDBY_WARMUP:
+            standby_options.warmup_sec = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_STANDBY_RESPAWN:
+            standby_options.respawn_sec = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_STANDBY_STATUS:
+            standby_options.status_path = optarg;
+            break;
+        case OPT_FLIGHT_RECORDER:
+            flight_recorder_path = optarg;
+            break;
+        case OPT_FLIGHT_RECORDER_RECORDS:
+            flight_recorder_records = std::max(64, std::atoi(optarg));
+            break;
+        case OPT_FLIGHT_RECORDER_SYNC:
+            flight_recorder_sync_sec = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_CHAOS:
+            chaos_options.rate_per_min = std::atof(optarg);
+            if (chaos_options.rate_per_min <= 0)
+            {
+                std::cerr << "Error: --chaos takes the mean number of faults per minute (e.g. 2)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_CHAOS_FAULTS:
+        {
+            chaos_options.faults.clear();
+            std::stringstream names(optarg);
+            std::string name;
+            while (std::getline(names, name, ','))
+            {
+                ChaosFault fault;
+                if (!chaosFaultFromName(name, fault))
+                {
+                    std::cerr << "Error: --chaos-faults takes kill, stop, close and/or delay." << std::endl;
+                    return 1;
+                }
+                chaos_options.faults.insert(fault);
+            }
+            break;
+        }
+        case OPT_CHAOS_TARGETS:
+        {
+            std::stringstream names(optarg);
+            std::string name;
+            while (std::getline(names, name, ',')) chaos_options.targets.insert(name);
+            break;
+        }
+        case OPT_CHAOS_STOP_MS:
+            chaos_options.stop_ms = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_CHAOS_DELAY_MS:
+            chaos_options.delay_ms = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_CHAOS_DURATION:
+            chaos_options.duration_sec = std::max(0, std::atoi(optarg));
+            break;
+        case OPT_CHAOS_SEED:
+            chaos_options.seed = static_cast<unsigned>(std::strtoul(optarg, nullptr, 10));
+            break;
+        case OPT_CHAOS_REPORT:
+            chaos_options.report_path = optarg;
+            break;
+        case OPT_ADAPT_CAPTURE:
+            enable_adaptive = true;
+            break;
+        case OPT_ADAPT_LADDER:
+            enable_adaptive = true;
+            adaptive_ladder = optarg;
+            break;
+        case OPT_ADAPT_UPTAKE:
+            adaptive_options.uptake_pct = std::max(1, std::min(100, std::atoi(optarg)));
+            break;
+        case OPT_ADAPT_LATENCY:
+            adaptive_options.latency_ms = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_ADAPT_CPU:
+            adaptive_options.cpu_pct = std::max(1, std::atoi(optarg));
+            break;
+        case OPT_ADAPT_HOLD:
+            if (std::sscanf(optarg, "%d,%d", &adaptive_options.down_sec, &adaptive_options.up_sec) != 2 || adaptive_options.down_sec < 1 || adaptive_options.up_sec < 1)
+            {
+                std::cerr << "Error: --adapt-hold must be down,up in seconds (e.g. 3,20)." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_ADAPT_SOURCE:
+            adaptive_options.source_ring = optarg;
+            break;
+        case OPT_ADAPT_STATUS:
+            adaptive_options.status_path = optarg;
+            break;
+        case OPT_CAPTURE_PLAN:
+            enable_capture_plan = true;
+            break;
+        case OPT_CAPTURE_NEED:
+        {
+            CaptureNeed need;
+            if (!parseCaptureNeed(optarg, need))
+            {
+                std::cerr << "Error: --capture-need must be name=WxH@fps[:format] (e.g. de_tracker=640x480@30:gray)." << std::endl;
+                return 1;
+            }
+            enable_capture_plan = true;
+            capture_plan_options.needs.push_back(need);
+            break;
+        }
+        case OPT_CAPTURE_SENSOR_MODES:
+            capture_plan_options.sensor_modes = optarg;
+            break;
+        case OPT_CAPTURE_PLAN_STATUS:
+            capture_plan_options.status_path = optarg;
+            break;
+        case OPT_CAPTURE_PLAN_ONLY:
+            enable_capture_plan = true;
+            capture_plan_only = true;
+            break;
+        case OPT_FRAME_META:
+            enable_frame_meta = true;
+            break;
+        case OPT_FRAME_META_PREFIX:
+            enable_frame_meta = true;
+            frame_meta_prefix = optarg;
+            break;
         default:
             std::cerr << "Usage: " << argv[0] << " [--enable-rpi-cam-capture] [--enable-gimbal-capture] [--enable-tracker] [--enable-ai-tracker] [--enable-generic-ai-tracker] [--disable-de-camera] [--execute script_path] [--drone-engage-path path] [--scripts-path path] [--ai-tracker-delay seconds] [--generic-ai-delay seconds] [--tracker-delay seconds] [--de-camera-delay seconds] [--gimbal-delay seconds] [postprocess_file_path]" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-tracker" << std::endl;
@@ -522,6 +1424,75 @@ int main(int argc, char *argv[])
             std::cerr << "Example: " << argv[0] << " --enable-generic-ai-tracker --generic-ai-delay 10" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-tracker --tracker-delay 20 --de-camera-delay 30" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-gimbal-capture --gimbal-delay 5" << std::endl;
+            std::cerr << "Simulator fleet: " << argv[0] << " --sim-fleet N [--sim-first N] [--sim-path path] [--sim-instances-dir path] [--sim-base-port port] [--sim-port-stride ports] [--sim-speedup N] [--sim-ready-timeout seconds] [--sim-report-interval seconds] [--sim-max-starting N] [--sim-log-dir path] [--sim-start-stagger ms]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --sim-fleet 50 --sim-max-starting 8 --sim-log-dir /home/pi/simulator/fleet_logs" << std::endl;
+            std::cerr << "Thermal bridge: " << argv[0] << " --enable-thermal-capture --thermal-source file:path|pipe:command [--thermal-size WxH] [--thermal-fps N] [--thermal-output label|/dev/videoN|file:path] [--thermal-palette iron|rainbow|white-hot|black-hot] [--thermal-ring name] [--thermal-units scale,offset] [--thermal-frames N]" << std::endl;
+            std::cerr << "Native gimbal ingest: " << argv[0] << " --gimbal-native [--gimbal-url rtsp://...] [--gimbal-transport tcp|udp] [--gimbal-jitter-ms ms] [--gimbal-output label|/dev/videoN|file:path] [--gimbal-decoder command] [--gimbal-no-decode] [--gimbal-passthrough ring_name]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --gimbal-native --gimbal-url rtsp://192.168.2.119:554/live/viewpro --gimbal-passthrough de_gimbal_h264" << std::endl;
+            std::cerr << "Encoded camera: " << argv[0] << " --rpi-encoded ring_name [--rpi-decoder command | --rpi-no-decode]" << std::endl;
+            std::cerr << "IMX500 detections: " << argv[0] << " -c [--rpi-detections ring_name | --rpi-no-detections] imx500_post_process.json" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --rpi-encoded de_rpi_h264 --enable-tracker" << std::endl;
+            std::cerr << "RTP output: " << argv[0] << " --stream-to host:port[,host:port...] [--stream-ring name] [--stream-mtu bytes] [--stream-batch N] [--stream-rate-kbps N] [--stream-sdp path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --rpi-encoded de_rpi_h264 --stream-to 127.0.0.1:5600,192.168.1.10:5600 --stream-sdp /tmp/de_rpi.sdp" << std::endl;
+            std::cerr << "Governor: " << argv[0] << " --governor [--governor-sysfs-root path] [--governor-temps hot,cool] [--governor-hold up,down] [--governor-battery-file path] [--governor-battery-low pct] [--governor-max-level 0-3] [--governor-reduced WxH@fps] [--governor-status path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-generic-ai-tracker --governor --governor-temps 75,68" << std::endl;
+            std::cerr << "cgroups: " << argv[0] << " --cgroup [--cgroup-root path] [--cgroup-limit module:key=value,...] [--cgroup-psi memory,cpu] [--cgroup-psi-hold up,down] [--cgroup-psi-root path] [--cgroup-report seconds] [--cgroup-status path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-generic-ai-tracker --cgroup --cgroup-limit de_yolo_generic:cpu=150,mem_high=400M,mem_max=600M" << std::endl;
+            std::cerr << "On demand: " << argv[0] << " --on-demand [--on-demand-grace seconds] [--on-demand-poll-ms ms] [--on-demand-status path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-gimbal-capture --enable-thermal-capture --on-demand" << std::endl;
+            std::cerr << "Standby: " << argv[0] << " --standby module[,module...] [--standby-warmup seconds] [--standby-respawn seconds] [--standby-status path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-generic-ai-tracker --standby de_yolo_generic" << std::endl;
+            std::cerr << "Flight recorder: " << argv[0] << " --flight-recorder path [--flight-recorder-records n] [--flight-recorder-sync seconds]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --flight-recorder /home/pi/drone_engage/de_flight.rec" << std::endl;
+            std::cerr << "Chaos: " << argv[0] << " --chaos faults_per_min [--chaos-faults kill,stop,close,delay] [--chaos-targets name,...] [--chaos-stop-ms ms] [--chaos-delay-ms ms] [--chaos-duration seconds] [--chaos-seed n] [--chaos-report path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-thermal-capture --thermal-source file:/tmp/raw.bin --chaos 4 --chaos-duration 600" << std::endl;
+            std::cerr << "Adaptive capture: " << argv[0] << " --adapt-capture [--adapt-ladder WxH@fps,...] [--adapt-uptake pct] [--adapt-latency ms] [--adapt-cpu pct] [--adapt-hold down,up] [--adapt-source ring] [--adapt-status path]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --frame-meta --adapt-ladder 1920x1080@15,1280x720@15,640x480@10 --adapt-latency 200" << std::endl;
+            std::cerr << "Capture plan: " << argv[0] << " --capture-plan [--capture-need name=WxH@fps[:format]] [--capture-sensor-modes WxH@fps[:bits][/CWxCH],...] [--capture-plan-status path] [--capture-plan-only]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-tracker --enable-generic-ai-tracker --capture-plan --capture-need de_tracker=800x600@60:gray" << std::endl;
+            std::cerr << "Frame metadata: " << argv[0] << " --frame-meta [--frame-meta-prefix prefix]" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-thermal-capture --thermal-source file:/tmp/raw.bin --frame-meta" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-thermal-capture --thermal-source \"pipe:/home/pi/senxor_venv/bin/python /opt/thermal_app/thermal_toolbox.py --raw\"" << std::endl;
+            return 1;
+        }
+    }
+
+    if (enable_thermal_capture && thermal_options.source.empty())
+    {
+        std::cerr << "Error: --enable-thermal-capture requires --thermal-source file:path or pipe:command." << std::endl;
+        return 1;
+    }
+
+    if (enable_frame_meta)
+    {
+        rpi_metadata.meta_ring = frame_meta_prefix + "rpi";
+        thermal_options.meta_ring = frame_meta_prefix + "thermal";
+        if (gimbal_native) gimbal_options.meta_ring = frame_meta_prefix + "gimbal";
+        else if (enable_gimbal_capture) std::cout << "Frame metadata: the ffmpeg gimbal pipeline has none; use --gimbal-native for " << frame_meta_prefix << "gimbal." << std::endl;
+    }
+
+    if (enable_adaptive)
+    {
+        if (!parseCaptureLadder(adaptive_ladder, adaptive_options.ladder))
+        {
+            std::cerr << "Error: --adapt-ladder must be a list of WxH@fps (e.g. 1920x1080@15,1280x720@15,640x480@10)." << std::endl;
+            return 1;
+        }
+        // Delivered frames are counted in the pipeline's own ring; without one, the mode's nominal rate is assumed
+        if (adaptive_options.source_ring.empty()) adaptive_options.source_ring = rpi_encoded ? rpi_encoded_options.ring : rpi_metadata.meta_ring;
+    }
+    // A resize by either restarts the modules reading the pipeline's virtual camera with it
+    governor_options.capture_output = adaptive_options.output = rpi_encoded ? rpi_encoded_options.output : "DE-RPI";
+
+    if (!stream_options.destinations.empty() && stream_options.ring.empty())
+    {
+        // Default to the encoded channel of whichever capture stage produces one
+        if (rpi_encoded) stream_options.ring = rpi_encoded_options.ring;
+        else if (gimbal_native && !gimbal_options.passthrough.empty()) stream_options.ring = gimbal_options.passthrough;
+        else if (enable_thermal_capture) stream_options.ring = thermal_options.ring_name;
+        else
+        {
+            std::cerr << "Error: --stream-to needs --stream-ring, or --rpi-encoded, --gimbal-passthrough or --enable-thermal-capture to take the ring from." << std::endl;
             return 1;
         }
     }
@@ -532,6 +1503,15 @@ int main(int argc, char *argv[])
         postProcessFilePath = argv[optind];
     }
 
+    // An IMX500 network already detects on the sensor: publish its results instead of dropping them
+    if (enable_rpi_cam_capture && rpi_detections && !postProcessFilePath.empty() && imx500ReadPostProcess(postProcessFilePath, rpi_metadata.imx500))
+    {
+        rpi_metadata.detection_ring = rpi_detection_ring;
+        std::cout << "IMX500 detections: /dev/shm/" << rpi_detection_ring << " (threshold " << rpi_metadata.imx500.threshold << ", at most "
+                  << rpi_metadata.imx500.max_detections << " per frame)" << std::endl;
+    }
+    rpi_encoded_options.metadata = rpi_metadata;
+
     // Update derived module paths based on final base path (after parsing arguments)
     BASE_CAMERA_MODULE_PATH = BASE_DRONE_ENGAGE_PATH + "de_camera/";
     BASE_TRACKER_MODULE_PATH = BASE_DRONE_ENGAGE_PATH + "de_tracking/";
@@ -548,6 +1528,19 @@ int main(int argc, char *argv[])
     const std::string GENERIC_AI_MODULE = BASE_GENERIC_AI_MODULE_PATH + "de_yolo_generic";
     const std::string GENERIC_AI_CONFIG = BASE_GENERIC_AI_MODULE_PATH + "de_yolo_ai_generic.config.module.json";
 
+    // A spare of a module that does not stop itself under DE_STANDBY=1 would run it twice
+    for (const auto &name : standby_options.modules)
+    {
+        const std::string config = name == "de_yolo_generic" ? GENERIC_AI_CONFIG : name == "de_ai_tracker.so" ? AI_TRACKER_CONFIG
+                                 : name == "de_tracker" ? TRACKING_CONFIG : DE_CAMERA_CONFIG;
+        if (!standbyDeclared(config))
+        {
+            std::cerr << "Error: --standby " << name << ": " << config << " does not declare \"" STANDBY_CONFIG_KEY "\": true." << std::endl;
+            std::cerr << "Only modules that stop themselves under " STANDBY_ENV "=1 once loaded can have a warm spare." << std::endl;
+            return 1;
+        }
+    }
+
     // Display current paths and delays for debugging
     std::cout << "Using paths:" << std::endl;
     std::cout << "  DroneEngage: " << BASE_DRONE_ENGAGE_PATH << std::endl;
@@ -563,9 +1556,90 @@ int main(int argc, char *argv[])
     std::cout << "  DE Camera: " << de_camera_delay_sec << "s" << std::endl;
     std::cout << "  Gimbal: " << gimbal_delay_sec << "s" << std::endl;
 
+    capture_plan_options.source = rpi_encoded ? rpi_encoded_options.ring : "DE-RPI";
+    CapturePlan capture_plan_instance(capture_plan_options);
+    if (enable_capture_plan && (enable_rpi_cam_capture || capture_plan_only))
+    {
+        // The enabled modules that read the RPI camera, in the wrapper's start order
+        if (enable_tracker) capture_plan_instance.addModule("de_tracker", TRACKING_CONFIG);
+        if (enable_ai_tracker) capture_plan_instance.addModule("de_ai_tracker.so", AI_TRACKER_CONFIG);
+        if (enable_generic_ai_tracker) capture_plan_instance.addModule("de_yolo_generic", GENERIC_AI_CONFIG);
+        if (enable_de_camera) capture_plan_instance.addModule("de_camera", DE_CAMERA_CONFIG);
+        capture_plan_instance.addUndeclaredNeeds();
+        const bool planned = capture_plan_instance.compute();
+        if (planned)
+        {
+            capture_plan_instance.print(std::cout);
+            for (const auto &need : capture_plan_options.needs)
+                if (need.format == "h264" && !rpi_encoded) std::cerr << "Capture plan: " << need.name << " wants h264; only --rpi-encoded publishes it." << std::endl;
+        }
+        if (capture_plan_only) return planned ? 0 : 1;
+        if (planned)
+        {
+            capture_plan_instance.writeStatus();
+            capture_plan = &capture_plan_instance;
+            if (enable_adaptive)
+            {
+                // The plan is the top of the ladder; under pressure the controller steps down to the cheaper rungs
+                const CaptureMode top = capture_plan_instance.mode();
+                auto &ladder = adaptive_options.ladder;
+                ladder.erase(std::remove_if(ladder.begin(), ladder.end(), [&top](const CaptureMode &mode) { return mode.pixelRate() >= top.pixelRate(); }), ladder.end());
+                ladder.insert(ladder.begin(), top);
+            }
+            else
+            {
+                setCaptureEnvironment(capture_plan_instance.mode());
+            }
+        }
+    }
+    else if (enable_capture_plan)
+    {
+        std::cout << "Capture plan: only applies to --enable-rpi-cam-capture; skipped." << std::endl;
+    }
+
+    if (!flight_recorder_path.empty())
+    {
+        if (flight_recorder.open(flight_recorder_path, static_cast<uint32_t>(flight_recorder_records), flight_recorder_sync_sec))
+        {
+            // Boot records carry the version as major * 10000 + minor * 100 + patch
+            int major = 0, minor = 0, patch = 0;
+            std::sscanf(VERSION_APP, "%d.%d.%d", &major, &minor, &patch);
+            flight_recorder.record(SupervisorEvent::Boot, "wrapper", getpid(), major * 10000 + minor * 100 + patch);
+            supervisor.addEventHook([](SupervisorEvent event, const std::string &name, pid_t pid, int32_t value, int64_t arg)
+                                    { flight_recorder.record(event, name, pid, value, arg); });
+            supervisor.addTickHook([]() { flight_recorder.tick(); });
+            std::cout << "Flight recorder: " << flight_recorder_path << " (" << flight_recorder.capacity() << " records, boot #"
+                      << flight_recorder.boot() << ", flushed every " << flight_recorder_sync_sec << " s)" << std::endl;
+        }
+        else
+        {
+            std::cerr << "Flight recorder: cannot open " << flight_recorder_path << "; running without it." << std::endl;
+        }
+    }
+
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    if (sim_fleet_mode)
+    {
+        // Simulator fleet: stop leftovers like sh_start_simulators.sh did, then supervise the groups
+        std::string stop_script = SCRIPTS_PATH;
+        if (stop_script.back() == '/') stop_script.pop_back();
+        executeCommand(stop_script + "/sh_stop_simulators.sh");
+
+        fleet_options.drone_engage_path = BASE_DRONE_ENGAGE_PATH;
+        std::cout << "Starting simulator fleet of " << fleet_options.count << " instance(s), base port "
+                  << fleet_options.base_port << " stride " << fleet_options.port_stride << std::endl;
+        SimFleet fleet(fleet_options, supervisor);
+        if (!fleet.prepare())
+        {
+            return 1;
+        }
+        const int result = supervisor.run();
+        supervisor.stopAll();
+        return result;
+    }
+
     // Step 1: Pre-emptive kill of old processes
     preemptiveKill();
 
@@ -582,8 +1656,10 @@ int main(int argc, char *argv[])
     // Step 3: Start rpicam-vid | ffmpeg if enabled
     if (enable_rpi_cam_capture)
     {
+        // The adaptive controller starts from the top of its ladder
+        if (enable_adaptive) setCaptureEnvironment(adaptive_options.ladder.front());
         std::cout << "Starting camera pipeline..." << std::endl;
-        camera_pid = startCameraPipeline(postProcessFilePath);
+        camera_pid = startCameraPipeline(postProcessFilePath, rpi_encoded ? &rpi_encoded_options : nullptr, rpi_metadata);
         if (camera_pid == -1)
         {
             std::cerr << "CRITICAL: Failed to start camera pipeline. Exiting." << std::endl;
@@ -610,7 +1686,7 @@ int main(int argc, char *argv[])
             std::this_thread::sleep_for(std::chrono::seconds(gimbal_delay_sec));
         }
         std::cout << "Starting gimbal camera pipeline..." << std::endl;
-        gimbal_camera_pid = startGimbalCameraPipeline();
+        gimbal_camera_pid = gimbal_native ? startNativeGimbalPipeline(gimbal_options) : startGimbalCameraPipeline();
         if (gimbal_camera_pid == -1)
         {
             std::cerr << "CRITICAL: Failed to start gimbal camera pipeline. Exiting." << std::endl;
@@ -623,6 +1699,36 @@ int main(int argc, char *argv[])
         std::cout << "Skipping gimbal camera pipeline (not enabled)." << std::endl;
     }
 
+    // Step 3c: Start the native thermal bridge if enabled
+    if (enable_thermal_capture)
+    {
+        std::cout << "Starting thermal bridge..." << std::endl;
+        thermal_pid = startThermalPipeline(thermal_options);
+        if (thermal_pid == -1)
+        {
+            std::cerr << "CRITICAL: Failed to start thermal bridge. Exiting." << std::endl;
+            stopAllChildren();
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << "Skipping thermal bridge (not enabled)." << std::endl;
+    }
+
+    // Step 3d: Start the RTP network output if enabled
+    if (!stream_options.destinations.empty())
+    {
+        std::cout << "Starting RTP output of /dev/shm/" << stream_options.ring << "..." << std::endl;
+        stream_pid = startStreamOutput(stream_options);
+        if (stream_pid == -1)
+        {
+            std::cerr << "CRITICAL: Failed to start RTP output. Exiting." << std::endl;
+            stopAllChildren();
+            return 1;
+        }
+    }
+
     // Step 4: Start any specified scripts
     for (const auto &script : scripts_to_execute)
     {
@@ -716,31 +1822,209 @@ int main(int argc, char *argv[])
         std::cout << "SKIPPING de_camera..." << std::endl;
     }
 
-    // Main monitoring loop: Wait for any child process to crash
-    while (true)
+    // Main monitoring loop: any camera stack child exiting crashes the wrapper to force a full systemctl restart
+    if (camera_pid > 0)
+    {
+        // A crash still takes the wrapper down; the start function is for the governor's deliberate restarts
+        supervisor.add("camera pipeline", camera_pid, RestartPolicy::CrashWrapper,
+                       [postProcessFilePath, rpi_encoded, rpi_encoded_options, rpi_metadata]()
+                       {
+                           camera_pid = startCameraPipeline(postProcessFilePath, rpi_encoded ? &rpi_encoded_options : nullptr, rpi_metadata);
+                           return camera_pid > 0 ? camera_pid : -1;
+                       });
+    }
+    if (!gimbal_native && gimbal_camera_pid > 0)
+    {
+        supervisor.add("gimbal camera pipeline", gimbal_camera_pid, RestartPolicy::CrashWrapper);
+    }
+    // The modules; each is started again exactly like at boot (DE_STANDBY=1 for a spare)
+    const struct
+    {
+        const char *name;
+        std::string path, config, dir;
+        pid_t *pid;
+    } modules[] = {
+        {"de_tracker", TRACKING_MODULE, TRACKING_CONFIG, BASE_TRACKER_MODULE_PATH, &tracking_camera_pid},
+        {"de_ai_tracker.so", AI_TRACKER_MODULE, AI_TRACKER_CONFIG, BASE_AI_TRACKER_MODULE_PATH, &ai_tracking_camera_pid},
+        {"de_yolo_generic", GENERIC_AI_MODULE, GENERIC_AI_CONFIG, BASE_GENERIC_AI_MODULE_PATH, &generic_ai_tracking_camera_pid},
+        {"de_camera", DE_CAMERA_MODULE, DE_CAMERA_CONFIG, BASE_CAMERA_MODULE_PATH, &de_camera_pid}};
+    for (const auto &module : modules)
+    {
+        if (*module.pid <= 0) continue;
+        const std::string name = module.name, path = module.path, config = module.config, dir = module.dir;
+        pid_t *const pid = module.pid;
+        // Still a crash, but the governor and --adapt-capture restart them on purpose after a frame size change
+        supervisor.add(name, *pid, RestartPolicy::CrashWrapper, [name, path, config, dir, pid]()
+                       {
+                           *pid = startModule(path, config, name, dir);
+                           return *pid > 0 ? *pid : -1;
+                       });
+    }
+    for (pid_t script_pid : script_pids)
+    {
+        supervisor.add("script", script_pid, RestartPolicy::CrashWrapper);
+    }
+    if (gimbal_native && gimbal_camera_pid > 0)
+    {
+        // Link drops are retried inside the ingest; restart it only if it dies anyway
+        supervisor.add("gimbal ingest", gimbal_camera_pid, RestartPolicy::Restart,
+                       [gimbal_options]() { return spawnFunction("gimbal ingest", [gimbal_options]() { return GimbalIngest(gimbal_options).run(); }); });
+    }
+    if (thermal_pid > 0)
+    {
+        // A sensor hiccup only restarts the bridge; readers reopen the raw ring by name
+        supervisor.add("thermal bridge", thermal_pid, RestartPolicy::Restart,
+                       [thermal_options]() { return spawnFunction("thermal bridge", [thermal_options]() { return ThermalBridge(thermal_options).run(); }); });
+    }
+    if (stream_pid > 0)
+    {
+        // The output follows its ring across producer restarts; restart it only if it dies
+        supervisor.add("rtp output", stream_pid, RestartPolicy::Restart,
+                       [stream_options]() { return spawnFunction("rtp output", [stream_options]() { return RtpOutput(stream_options).run(); }); });
+    }
+
+    StandbyPool standby_instance(supervisor, standby_options);
+    if (!standby_options.modules.empty())
     {
-        int status;
-        pid_t exited_pid = waitpid(-1, &status, 0);
-        if (exited_pid > 0)
+        // Spares of the modules that are running
+        for (const auto &module : modules)
         {
-            std::string exit_reason;
-            if (WIFEXITED(status))
-            {
-                exit_reason = "exited with status " + std::to_string(WEXITSTATUS(status));
-            }
-            else if (WIFSIGNALED(status))
-            {
-                exit_reason = "terminated by signal " + std::to_string(WTERMSIG(status));
-            }
-            else
-            {
-                exit_reason = "exited for unknown reason";
-            }
-            std::cerr << "Child process (PID " << exited_pid << ") " << exit_reason << ". Crashing wrapper to force a full systemctl restart." << std::endl;
-            preemptiveKill();
-            return 1;
+            if (!standby_options.modules.count(module.name) || *module.pid <= 0) continue;
+            const std::string name = module.name, path = module.path, config = module.config, dir = module.dir;
+            pid_t *const pid = module.pid;
+            standby_instance.addModule(name, [name, path, config, dir]() { return startModule(path, config, name, dir, true); },
+                                       [pid](pid_t promoted) { *pid = promoted; });
+        }
+        standby = &standby_instance;
+        supervisor.addTickHook([]() { standby->tick(); });
+        std::cout << "Standby: " << standby_instance.size() << " spare(s), paused after " << standby_options.warmup_sec
+                  << " s at the latest, status in " << standby_options.status_path << std::endl;
+    }
+
+    ChaosMonkey chaos_instance(supervisor, chaos_options);
+    if (chaos_options.rate_per_min > 0)
+    {
+        // What each producer writes: the rings time the frame gap, the outputs are what close faults close
+        if (camera_pid > 0)
+        {
+            ChaosTarget target;
+            target.child = "camera pipeline";
+            if (rpi_encoded) target.rings.push_back(rpi_encoded_options.ring);
+            if (!rpi_metadata.meta_ring.empty()) target.rings.push_back(rpi_metadata.meta_ring);
+            if (!rpi_metadata.detection_ring.empty()) target.rings.push_back(rpi_metadata.detection_ring);
+            target.outputs.push_back(rpi_encoded ? rpi_encoded_options.output : "DE-RPI");
+            chaos_instance.addTarget(target);
         }
+        if (gimbal_camera_pid > 0)
+        {
+            ChaosTarget target;
+            target.child = gimbal_native ? "gimbal ingest" : "gimbal camera pipeline";
+            if (gimbal_native && !gimbal_options.passthrough.empty()) target.rings.push_back(gimbal_options.passthrough);
+            if (!gimbal_options.meta_ring.empty()) target.rings.push_back(gimbal_options.meta_ring);
+            target.outputs.push_back(gimbal_native ? gimbal_options.output : "DE-GIMBAL");
+            chaos_instance.addTarget(target);
+        }
+        if (thermal_pid > 0)
+        {
+            ChaosTarget target;
+            target.child = "thermal bridge";
+            target.rings.push_back(thermal_options.ring_name);
+            if (!thermal_options.meta_ring.empty()) target.rings.push_back(thermal_options.meta_ring);
+            target.outputs.push_back(thermal_options.output);
+            chaos_instance.addTarget(target);
+        }
+        chaos = &chaos_instance;
+        supervisor.addEventHook([](SupervisorEvent event, const std::string &name, pid_t pid, int32_t value, int64_t arg)
+                                { chaos->onEvent(event, name, pid, value, arg); });
+        supervisor.addTickHook([]() { chaos->tick(); });
+        std::cout << "Chaos: " << chaos_options.rate_per_min << " fault(s) per minute from " << CHAOS_START_SEC << " s on"
+                  << (chaos_options.duration_sec > 0 ? " for " + std::to_string(chaos_options.duration_sec) + " s" : "")
+                  << ", report in " << chaos_options.report_path << std::endl;
+    }
+
+    // The AI rate is only followed by modules that declare it
+    for (const auto &module : modules)
+    {
+        if (*module.pid > 0 && moduleConfigDeclares(module.config, GOVERNOR_AI_RATE_CONFIG_KEY)) governor_options.ai_modules.push_back(module.name);
+    }
+    Governor governor_instance(supervisor, governor_options);
+    if (enable_governor)
+    {
+        governor = &governor_instance;
+        supervisor.addTickHook([]() { governor->tick(); });
+        std::cout << "Governor: watching " << governor_options.sysfs_root << " (hot " << governor_options.hot_c << " C, cool "
+                  << governor_options.cool_c << " C), status in " << governor_options.status_path << std::endl;
+    }
+
+    CgroupManager cgroup_instance(supervisor, cgroup_options);
+    if (enable_cgroups)
+    {
+        cgroups = &cgroup_instance;
+        cgroups->setup();
+        cgroups->tick(); // place the children before the first supervisor tick
+        supervisor.addTickHook([]() { cgroups->tick(); });
+        std::cout << "cgroup: modules in " << cgroups->root() << ", shedding at memory " << cgroup_options.psi_memory << "% / cpu "
+                  << cgroup_options.psi_cpu << "% stall, status in " << cgroup_options.status_path << std::endl;
+    }
+
+    OnDemand on_demand_instance(supervisor, on_demand_options);
+    if (enable_on_demand)
+    {
+        // file: outputs have no readers to watch; such producers only follow their rings
+        auto device = [](const std::string &output) { return output.rfind("file:", 0) == 0 ? std::vector<std::string>() : std::vector<std::string>{output}; };
+        if (camera_pid > 0)
+        {
+            OnDemandChannel channel;
+            channel.name = "rpi";
+            channel.child = "camera pipeline";
+            channel.devices = device(rpi_encoded ? rpi_encoded_options.output : "DE-RPI");
+            if (rpi_encoded) channel.rings.push_back(rpi_encoded_options.ring);
+            if (!rpi_metadata.meta_ring.empty()) channel.rings.push_back(rpi_metadata.meta_ring);
+            if (!rpi_metadata.detection_ring.empty()) channel.rings.push_back(rpi_metadata.detection_ring);
+            on_demand_instance.addChannel(channel);
+        }
+        if (gimbal_camera_pid > 0)
+        {
+            OnDemandChannel channel;
+            channel.name = "gimbal";
+            channel.child = gimbal_native ? "gimbal ingest" : "gimbal camera pipeline";
+            channel.devices = device(gimbal_native ? gimbal_options.output : "DE-GIMBAL");
+            if (gimbal_native && !gimbal_options.passthrough.empty()) channel.rings.push_back(gimbal_options.passthrough);
+            if (!gimbal_options.meta_ring.empty()) channel.rings.push_back(gimbal_options.meta_ring);
+            on_demand_instance.addChannel(channel);
+        }
+        if (thermal_pid > 0)
+        {
+            OnDemandChannel channel;
+            channel.name = "thermal";
+            channel.child = "thermal bridge";
+            channel.devices = device(thermal_options.output);
+            channel.rings.push_back(thermal_options.ring_name);
+            if (!thermal_options.meta_ring.empty()) channel.rings.push_back(thermal_options.meta_ring);
+            on_demand_instance.addChannel(channel);
+        }
+        on_demand = &on_demand_instance;
+        supervisor.addTickHook([]() { on_demand->tick(); });
+        std::cout << "On-demand: watching readers of " << on_demand_instance.channelCount() << " producer(s), idle after "
+                  << on_demand_options.grace_sec << " s without readers" << std::endl;
+    }
+
+    AdaptiveCapture adaptive_instance(supervisor, adaptive_options);
+    if (enable_adaptive && camera_pid > 0)
+    {
+        // The governor's AI rate and capture-reduced level would read as consumer pressure
+        adaptive_instance.setHold([]() { return governor && governor->level() > 0; });
+        supervisor.addTickHook([&adaptive_instance]() { adaptive_instance.tick(); });
+        std::cout << "Adaptive capture: " << adaptive_options.ladder.size() << " mode(s) from " << adaptive_instance.mode().text() << ", delivered frames from "
+                  << (adaptive_options.source_ring.empty() ? std::string("the nominal rate") : "/dev/shm/" + adaptive_options.source_ring)
+                  << ", status in " << adaptive_options.status_path << std::endl;
+    }
+    else if (enable_adaptive)
+    {
+        std::cout << "Adaptive capture: no camera pipeline running; disabled." << std::endl;
     }
 
-    return 0;
+    const int result = supervisor.run();
+    shutdownChildren();
+    return result;
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
 //
 //***************************************************************************** */
 
-// g++ camera_manager_wrapper.cpp -o camera_manager_wrapper -pthread
+// g++ camera_manager_wrapper_ubuntu.cpp -o camera_manager_wrapper_ubuntu -pthread -O2 -ljpeg
 #include <iostream>    // For standard input/output operations
 #include <string>      // For std::string
 #include <vector>      // For std::vector to handle multiple scripts
@@ -18,8 +18,15 @@
 #include <unistd.h>    // For fork(), execlp(), kill(), chdir(), access()
 #include <csignal>     // For SIGTERM, SIGINT
 #include <getopt.h>    // For parsing command-line options
+#include <sstream>     // For splitting comma-separated option values
 
-#define VERSION_APP "4.0.0"
+#include "de_uvc.hpp"  // Native USB (UVC) MJPEG capture
+
+#define VERSION_APP "4.1.0"
+
+// Config snapshots (see c_helpers/de_config_snapshot.hpp) are passed to modules via the environment
+#define CONFIG_SNAPSHOT_SUFFIX ".snap"
+#define CONFIG_SNAPSHOT_ENV "DE_CONFIG_SNAPSHOT"
 
 // Global PID variables to track child processes
 pid_t camera_pid = -1;
@@ -28,6 +35,7 @@ pid_t tracking_camera_pid = -1;
 pid_t ai_tracking_camera_pid = -1;
 pid_t generic_ai_tracking_camera_pid = -1;
 pid_t de_camera_pid = -1;
+pid_t uvc_camera_pid = -1;
 std::vector<pid_t> script_pids; // To track PIDs of executed scripts
 
 // Default base directories for drone_engage modules
@@ -243,6 +251,40 @@ pid_t startGimbalCameraPipeline()
     return pid;
 }
 
+/**
+ * @brief Forks a process that captures the USB camera and decodes it into the loopback devices (de_uvc.hpp).
+ * @param options Device, mode, outputs and decode threads.
+ * @return The process ID (PID) of the child process, or -1 on failure.
+ */
+pid_t startUvcPipeline(const UvcOptions &options)
+{
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "Failed to fork for UVC capture." << std::endl;
+        return -1;
+    }
+    else if (pid == 0)
+    {
+        // Plain stop on SIGINT/SIGTERM; the wrapper's handler would run preemptiveKill in the child
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        _exit(UvcCapture(options).run());
+    }
+
+    // Give the capture a short time to open its outputs
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid)
+    {
+        std::cerr << "UVC capture failed to start (" << (WIFEXITED(status) ? "exit code " + std::to_string(WEXITSTATUS(status)) : std::string("terminated abnormally")) << ")." << std::endl;
+        return -1;
+    }
+    std::cout << "UVC capture started with PID: " << pid << std::endl;
+    return pid;
+}
+
 /**
  * @brief Forks a new process to start a module executable.
  * @param modulePath Path to the module executable.
@@ -274,6 +316,13 @@ pid_t startModule(const std::string &modulePath, const std::string &moduleConfig
         std::cerr << "ERROR: Working directory not found: " << workingDir << std::endl;
         return -1;
     }
+
+    // Binary snapshot written by updateConfig --snapshot; the module validates it against the config
+    const std::string snapshotPath = moduleConfig + CONFIG_SNAPSHOT_SUFFIX;
+    const bool hasSnapshot = (access(snapshotPath.c_str(), R_OK) == 0);
+    if (hasSnapshot) {
+        std::cout << "  Snapshot: " << snapshotPath << std::endl;
+    }
     
     pid_t pid = fork();
     if (pid == -1)
@@ -288,6 +337,10 @@ pid_t startModule(const std::string &modulePath, const std::string &moduleConfig
             perror(("chdir for " + moduleName + " failed").c_str());
             _exit(1);
         }
+        if (hasSnapshot)
+        {
+            setenv(CONFIG_SNAPSHOT_ENV, snapshotPath.c_str(), 1);
+        }
         std::cout << "Executing: " << modulePath << " -c " << moduleConfig << " in dir " << workingDir << std::endl;
         execlp(modulePath.c_str(), moduleName.c_str(), "-c", moduleConfig.c_str(), (char *)NULL);
         perror(("execlp for " + moduleName + " failed").c_str());
@@ -312,6 +365,11 @@ void stopAllChildren()
         std::cout << "Stopping gimbal camera pipeline (PID " << gimbal_camera_pid << ")..." << std::endl;
         kill(gimbal_camera_pid, SIGTERM);
     }
+    if (uvc_camera_pid > 0)
+    {
+        std::cout << "Stopping UVC capture (PID " << uvc_camera_pid << ")..." << std::endl;
+        kill(uvc_camera_pid, SIGTERM);
+    }
     if (tracking_camera_pid > 0)
     {
         std::cout << "Stopping tracking module (PID " << tracking_camera_pid << ")..." << std::endl;
@@ -373,11 +431,26 @@ int main(int argc, char *argv[])
     bool enable_ai_tracker = false;
     bool enable_generic_ai_tracker = false;
     bool enable_de_camera = true; // Enabled by default
+    bool enable_uvc_capture = false;
+    UvcOptions uvc_options;
     std::string postProcessFilePath;
     std::vector<std::string> scripts_to_execute; // To store script paths
 
     std::cout << "Camera Wrapper ver: " << VERSION_APP << std::endl;
 
+    // Long-only options
+    enum UvcOption
+    {
+        OPT_UVC_CAPTURE = 256,
+        OPT_UVC_DEVICE,
+        OPT_UVC_SIZE,
+        OPT_UVC_FPS,
+        OPT_UVC_OUTPUT,
+        OPT_UVC_THREADS,
+        OPT_UVC_BENCHMARK,
+        OPT_UVC_BENCHMARK_SECONDS
+    };
+
     // Parse command-line options
     static struct option long_options[] = {
         {"enable-rpi-cam-capture", no_argument, 0, 'c'},
@@ -390,6 +463,14 @@ int main(int argc, char *argv[])
         {"drone-engage-path", required_argument, 0, 'D'},
         {"scripts-path", required_argument, 0, 'S'},
         {"version", no_argument, 0, 'v'},
+        {"enable-uvc-capture", no_argument, 0, OPT_UVC_CAPTURE},
+        {"uvc-device", required_argument, 0, OPT_UVC_DEVICE},
+        {"uvc-size", required_argument, 0, OPT_UVC_SIZE},
+        {"uvc-fps", required_argument, 0, OPT_UVC_FPS},
+        {"uvc-output", required_argument, 0, OPT_UVC_OUTPUT},
+        {"uvc-threads", required_argument, 0, OPT_UVC_THREADS},
+        {"uvc-benchmark", required_argument, 0, OPT_UVC_BENCHMARK},
+        {"uvc-benchmark-seconds", required_argument, 0, OPT_UVC_BENCHMARK_SECONDS},
         {0, 0, 0, 0}};
 
     int opt;
@@ -455,8 +536,42 @@ int main(int argc, char *argv[])
                 return 1;
             }
             break;
+        case OPT_UVC_CAPTURE:
+            enable_uvc_capture = true;
+            break;
+        case OPT_UVC_DEVICE:
+            uvc_options.device = optarg;
+            break;
+        case OPT_UVC_SIZE:
+            if (sscanf(optarg, "%ux%u", &uvc_options.width, &uvc_options.height) != 2 || uvc_options.width < 16 || uvc_options.height < 16)
+            {
+                std::cerr << "Error: --uvc-size expects WIDTHxHEIGHT, e.g. 1920x1080." << std::endl;
+                return 1;
+            }
+            break;
+        case OPT_UVC_FPS:
+            uvc_options.fps = static_cast<unsigned>(std::max(0, atoi(optarg)));
+            break;
+        case OPT_UVC_OUTPUT:
+        {
+            uvc_options.outputs.clear();
+            std::stringstream list(optarg);
+            std::string output;
+            while (std::getline(list, output, ','))
+                if (!output.empty()) uvc_options.outputs.push_back(output);
+            break;
+        }
+        case OPT_UVC_THREADS:
+            uvc_options.threads = atoi(optarg);
+            break;
+        case OPT_UVC_BENCHMARK:
+            uvc_options.benchmark_file = optarg;
+            break;
+        case OPT_UVC_BENCHMARK_SECONDS:
+            uvc_options.benchmark_sec = std::max(1, atoi(optarg));
+            break;
         default:
-            std::cerr << "Usage: " << argv[0] << " [--enable-rpi-cam-capture] [--enable-gimbal-capture] [--enable-tracker] [--enable-ai-tracker] [--enable-generic-ai-tracker] [--disable-de-camera] [--execute script_path] [--drone-engage-path path] [--scripts-path path] [postprocess_file_path]" << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--enable-rpi-cam-capture] [--enable-gimbal-capture] [--enable-tracker] [--enable-ai-tracker] [--enable-generic-ai-tracker] [--disable-de-camera] [--execute script_path] [--drone-engage-path path] [--scripts-path path] [--enable-uvc-capture] [--uvc-device dev] [--uvc-size WxH] [--uvc-fps n] [--uvc-output list] [--uvc-threads n] [--uvc-benchmark file.mjpeg] [--uvc-benchmark-seconds n] [postprocess_file_path]" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --enable-tracker" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-gimbal-capture" << std::endl;
             std::cerr << "Example: " << argv[0] << " --enable-ai-tracker \"/usr/share/rpi-camera-assets/imx500_mobilenet_ssd.json\"" << std::endl;
@@ -464,6 +579,8 @@ int main(int argc, char *argv[])
             std::cerr << "Example: " << argv[0] << " --enable-rpi-cam-capture --execute /path/to/script.sh" << std::endl;
             std::cerr << "Example: " << argv[0] << " --drone-engage-path /custom/path/drone_engage --enable-rpi-cam-capture" << std::endl;
             std::cerr << "Example: " << argv[0] << " --scripts-path /custom/scripts --enable-rpi-cam-capture" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --enable-uvc-capture --uvc-device /dev/video0 --uvc-size 1920x1080 --uvc-fps 30 --uvc-output DE-CAM1,DE-TRK" << std::endl;
+            std::cerr << "Example: " << argv[0] << " --uvc-benchmark recording.mjpeg --uvc-size 1920x1080 --uvc-fps 30" << std::endl;
             return 1;
         }
     }
@@ -474,6 +591,17 @@ int main(int argc, char *argv[])
         postProcessFilePath = argv[optind];
     }
 
+    // Benchmark mode: decode a recorded MJPEG file through the UVC pipeline and report; nothing else is started
+    if (!uvc_options.benchmark_file.empty())
+    {
+        return UvcCapture(uvc_options).run();
+    }
+    if (enable_uvc_capture && uvc_options.outputs.empty())
+    {
+        std::cerr << "Error: --uvc-output needs at least one output." << std::endl;
+        return 1;
+    }
+
     // Update derived module paths based on final base path (after parsing arguments)
     BASE_CAMERA_MODULE_PATH = BASE_DRONE_ENGAGE_PATH + "de_camera/";
     BASE_TRACKER_MODULE_PATH = BASE_DRONE_ENGAGE_PATH + "de_tracking/";
@@ -554,6 +682,23 @@ int main(int argc, char *argv[])
         std::cout << "Skipping gimbal camera pipeline (not enabled)." << std::endl;
     }
 
+    // Step 3c: Start native USB (UVC) capture if enabled
+    if (enable_uvc_capture)
+    {
+        std::cout << "Starting UVC capture from " << uvc_options.device << "..." << std::endl;
+        uvc_camera_pid = startUvcPipeline(uvc_options);
+        if (uvc_camera_pid == -1)
+        {
+            std::cerr << "CRITICAL: Failed to start UVC capture. Exiting." << std::endl;
+            stopAllChildren();
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << "Skipping UVC capture (not enabled)." << std::endl;
+    }
+
     // Step 4: Start any specified scripts
     for (const auto &script : scripts_to_execute)
     {
@@ -0,0 +1,593 @@
+//***************************************************************************** */
+//  Closed-loop capture resolution and frame rate
+//
+//  sh_camera_run_rpi_camera.sh captures at one fixed mode, whether or not
+//  the modules behind DE-RPI keep up with it. With --adapt-capture the
+//  wrapper moves the camera pipeline along a ladder of modes (--adapt-ladder,
+//  highest pixel rate first) from what it measures once per second:
+//
+//      uptake    frames each consumer finished / frames the pipeline delivered,
+//                from the consumer's /dev/shm/de_uptake_<name> (UptakeReporter)
+//      latency   capture to end of processing, as reported by the consumers
+//      cpu       system CPU busy %, /proc/stat
+//      delivery  frames in the pipeline's ring / frames its mode promises
+//
+//  Pressure (low uptake or delivery, high latency or CPU) that lasts the
+//  "down" hold steps one rung down. Headroom that lasts the "up" hold steps
+//  one rung up, but only if the consumers' latency and busy time, scaled
+//  by the pixel rate of the next rung, still fit. A step up that is undone
+//  soon after doubles the up hold, so a load that sits between two rungs
+//  does not make the pipeline restart every few seconds.
+//
+//  A mode is applied like the governor's capture-reduced level: the
+//  DE_VIDEO_* variables are set and the pipeline is restarted, together with
+//  the modules reading DE-RPI when the frame size changes. While the
+//  governor sheds load, or the pipeline is down, the controller holds.
+//
+//***************************************************************************** */
+
+#ifndef DE_ADAPTIVE_HPP
+#define DE_ADAPTIVE_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "de_supervisor.hpp"
+#include "de_shm_ring.hpp"
+#include "de_frame_sink.hpp"
+
+#define ADAPTIVE_UPTAKE_DIR "/dev/shm/"
+#define ADAPTIVE_UPTAKE_PREFIX "de_uptake_"
+#define ADAPTIVE_REPORT_MS 500         // UptakeReporter rewrites its file at most this often
+#define ADAPTIVE_WINDOW_SEC 3          // measurements are averaged over this many seconds
+#define ADAPTIVE_SETTLE_SEC 5          // ignored after a mode change or a pipeline restart
+#define ADAPTIVE_STALE_SEC 3           // a consumer that has not reported for this long is left out
+#define ADAPTIVE_HEADROOM_UPTAKE 98    // % uptake a consumer needs for a step up
+#define ADAPTIVE_HEADROOM_BUSY 80      // % busy a consumer may reach on the next rung up
+#define ADAPTIVE_CPU_MARGIN 15         // % below --adapt-cpu needed for a step up
+#define ADAPTIVE_DELIVERY_LOW 85       // % of the mode's frame rate below which the pipeline itself is short
+#define ADAPTIVE_MAX_BACKOFF 8         // the up hold grows to at most this multiple
+#define ADAPTIVE_BACKOFF_RESET_SEC 600 // a mode kept this long resets the up hold
+#define CAPTURE_CONSUMER_GAP_MS 3000   // after a resize, consumers are started this long after the pipeline and each other
+
+/**
+ * @brief One rung of the ladder.
+ */
+struct CaptureMode
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned fps = 0;
+    std::string sensor; // rpicam-vid --mode (W:H:bits:packing) chosen by --capture-plan; empty = libcamera chooses
+
+    double pixelRate() const { return static_cast<double>(width) * height * fps; }
+    std::string text() const { return std::to_string(width) + "x" + std::to_string(height) + "@" + std::to_string(fps); }
+};
+
+/**
+ * @brief Parses "WxH@fps,WxH@fps,..." and sorts it by pixel rate, highest first.
+ */
+inline bool parseCaptureLadder(const std::string &list, std::vector<CaptureMode> &ladder)
+{
+    ladder.clear();
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        CaptureMode mode;
+        if (std::sscanf(item.c_str(), "%ux%u@%u", &mode.width, &mode.height, &mode.fps) != 3 || !mode.width || !mode.height || !mode.fps) return false;
+        ladder.push_back(mode);
+    }
+    std::stable_sort(ladder.begin(), ladder.end(), [](const CaptureMode &a, const CaptureMode &b) { return a.pixelRate() > b.pixelRate(); });
+    return !ladder.empty();
+}
+
+/**
+ * @brief Read by sh_camera_run_rpi_camera.sh; inherited by the next pipeline the wrapper starts.
+ */
+inline void setCaptureEnvironment(const CaptureMode &mode)
+{
+    setenv("DE_VIDEO_WIDTH", std::to_string(mode.width).c_str(), 1);
+    setenv("DE_VIDEO_HEIGHT", std::to_string(mode.height).c_str(), 1);
+    setenv("DE_VIDEO_FRAMERATE", std::to_string(mode.fps).c_str(), 1);
+    if (mode.sensor.empty()) unsetenv("DE_VIDEO_MODE");
+    else setenv("DE_VIDEO_MODE", mode.sensor.c_str(), 1);
+}
+
+/**
+ * @brief Restarts the capture pipeline (the supervised child named child) for the mode in
+ *        DE_VIDEO_*. v4l2loopback keeps a device's format for as long as anyone has it open,
+ *        so after a size change the children holding output open are stopped with the
+ *        pipeline and started again after it. A frame rate change keeps the format.
+ * @param output The pipeline's virtual camera: label, /dev/videoN or file:<path>.
+ * @return False if the pipeline is not running.
+ */
+inline bool restartCapture(ChildSupervisor &supervisor, const std::string &child, const std::string &output, bool resized)
+{
+    auto &children = supervisor.children();
+    size_t pipeline = children.size();
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (children[i].name == child) pipeline = i;
+    }
+    if (pipeline == children.size() || children[pipeline].pid <= 0 || !children[pipeline].start) return false;
+
+    std::vector<size_t> chain = {pipeline};
+    std::string consumers;
+    const std::string device = output.rfind("/dev/", 0) == 0 ? output : (output.rfind("file:", 0) == 0 ? "" : findVideoDeviceByLabel(output));
+    for (size_t i = 0; resized && !device.empty() && i < children.size(); ++i)
+    {
+        if (i == pipeline || children[i].pid <= 0 || !processTreeHolds(children[i].pid, device)) continue;
+        chain.push_back(i);
+        consumers += (consumers.empty() ? "" : ", ") + children[i].name;
+    }
+    if (chain.size() == 1)
+    {
+        supervisor.replace(pipeline);
+    }
+    else if (supervisor.replaceChain(chain, CAPTURE_CONSUMER_GAP_MS))
+    {
+        std::cout << "Restarting " << child << " with the consumers of " << device << ": " << consumers << std::endl;
+    }
+    else
+    {
+        std::cerr << "Consumers of " << device << " (" << consumers << ") cannot be restarted; they keep the old frame size." << std::endl;
+        supervisor.replace(pipeline);
+    }
+    return true;
+}
+
+/**
+ * @brief Consumer side: reports frames finished to the wrapper's controller.
+ *
+ *          UptakeReporter uptake("de_yolo_generic");
+ *          ...
+ *          const uint64_t started = shmRingNowNs();
+ *          process(frame);
+ *          uptake.frameDone(meta.capture_ns, started); // capture_ns from de_meta_rpi, or the time the frame was read
+ *
+ *        Writes /dev/shm/de_uptake_<name> (frames, latency_ms, busy_pct, pid) at most
+ *        every ADAPTIVE_REPORT_MS; removes it when destroyed.
+ */
+class UptakeReporter
+{
+public:
+    explicit UptakeReporter(const std::string &name) : m_path(ADAPTIVE_UPTAKE_DIR ADAPTIVE_UPTAKE_PREFIX + name)
+    {
+        m_period_start = shmRingNowNs();
+    }
+
+    ~UptakeReporter() { unlink(m_path.c_str()); }
+
+    /**
+     * @param capture_ns CLOCK_MONOTONIC capture time of the frame.
+     * @param started_ns When processing of the frame started; 0 if the consumer does not measure its busy time.
+     */
+    void frameDone(uint64_t capture_ns, uint64_t started_ns = 0)
+    {
+        const uint64_t now = shmRingNowNs();
+        ++m_frames;
+        if (capture_ns && capture_ns <= now)
+        {
+            m_latency_ns += now - capture_ns;
+            ++m_latency_count;
+        }
+        if (started_ns && started_ns <= now) m_busy_ns += now - started_ns;
+        else m_busy_known = false;
+        if (now - m_period_start >= ADAPTIVE_REPORT_MS * 1000000ull) write(now);
+    }
+
+private:
+    void write(uint64_t now)
+    {
+        writeStatusFile(m_path, [&](std::ostream &out) {
+            out << "frames=" << m_frames << "\nlatency_ms=" << (m_latency_count ? static_cast<double>(m_latency_ns) / m_latency_count / 1e6 : -1.0)
+                << "\nbusy_pct=" << (m_busy_known ? 100.0 * m_busy_ns / (now - m_period_start) : -1.0) << "\npid=" << getpid() << "\n";
+        });
+        m_period_start = now;
+        m_latency_ns = m_busy_ns = 0;
+        m_latency_count = 0;
+        m_busy_known = true;
+    }
+
+    std::string m_path;
+    uint64_t m_frames = 0;
+    uint64_t m_period_start = 0;
+    uint64_t m_latency_ns = 0;
+    uint64_t m_latency_count = 0;
+    uint64_t m_busy_ns = 0;
+    bool m_busy_known = true;
+};
+
+struct AdaptiveOptions
+{
+    std::vector<CaptureMode> ladder;          // highest pixel rate first, see parseCaptureLadder
+    std::string child = "camera pipeline";    // supervised name of the capture stage
+    std::string output = "DE-RPI";            // its virtual camera, see restartCapture
+    std::string source_ring;                  // ring with one slot per delivered frame; empty = the mode's nominal rate
+    int uptake_pct = 90;                      // pressure below
+    int latency_ms = 150;                     // pressure above
+    int cpu_pct = 85;                         // pressure above
+    int down_sec = 3;                         // pressure must last this long to step down
+    int up_sec = 20;                          // headroom must last this long to step up (before backoff)
+    std::string proc_stat = "/proc/stat";
+    std::string status_path = "/dev/shm/de_adaptive";
+};
+
+/**
+ * @brief Picks the capture mode from a supervisor tick hook.
+ */
+class AdaptiveCapture
+{
+public:
+    AdaptiveCapture(ChildSupervisor &supervisor, const AdaptiveOptions &options) : m_supervisor(supervisor), m_options(options)
+    {
+        m_settle_until = m_pressure_since = m_headroom_since = m_last_change = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief hold returns true while someone else owns the capture mode (the governor).
+     */
+    void setHold(std::function<bool()> hold) { m_hold = hold; }
+
+    const CaptureMode &mode() const { return m_options.ladder[m_rung]; }
+
+    /**
+     * @brief Supervisor tick: samples and decides once per second.
+     */
+    void tick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_sample < std::chrono::seconds(1)) return;
+        const double dt = m_last_sample.time_since_epoch().count() ? std::chrono::duration<double>(now - m_last_sample).count() : 0.0;
+        m_last_sample = now;
+        sample(now, dt);
+        evaluate(now);
+        writeStatus();
+    }
+
+private:
+    struct Consumer
+    {
+        std::deque<std::pair<uint64_t, uint64_t>> reports; // (file mtime ns, frames) over the window
+        bool live = false;
+        double latency_ms = -1.0;
+        double busy_pct = -1.0;
+        uint64_t updated_ns = 0; // mtime of the file, CLOCK_REALTIME
+        pid_t pid = -1;
+    };
+
+    /**
+     * @brief One second of measurements.
+     */
+    struct Sample
+    {
+        double seconds = 0.0;
+        double delivered = 0.0; // frames
+        double latency_ms = -1.0; // worst consumer
+        double busy_pct = -1.0;   // busiest consumer
+        double cpu_pct = -1.0;
+    };
+
+    /**
+     * @brief The window's averages.
+     */
+    struct Metrics
+    {
+        double delivery_pct = -1.0; // -1 = no source ring
+        double uptake_pct = -1.0;   // -1 = no consumer reported
+        std::string uptake_name;    // the consumer with the lowest uptake
+        double latency_ms = -1.0;
+        double busy_pct = -1.0;
+        double cpu_pct = -1.0;
+    };
+
+    /**
+     * @brief Frames delivered since the last call; -1 if the source ring restarted.
+     */
+    double pollSource()
+    {
+        if (m_options.source_ring.empty()) return 0.0;
+        struct stat st;
+        const ino_t inode = stat(("/dev/shm/" + m_options.source_ring).c_str(), &st) == 0 ? st.st_ino : 0;
+        if (inode != m_source_inode)
+        {
+            m_source_inode = inode;
+            m_source.close();
+            if (inode) m_source.open(m_options.source_ring);
+            m_source_seen = m_source.isOpen() ? m_source.latest() : 0;
+            return -1.0;
+        }
+        if (!m_source.isOpen()) return 0.0;
+        const uint64_t latest = m_source.latest();
+        const double frames = latest >= m_source_seen ? static_cast<double>(latest - m_source_seen) : 0.0;
+        m_source_seen = latest;
+        return frames;
+    }
+
+    /**
+     * @brief Busy % of all CPUs since the previous call, -1 on the first.
+     */
+    double pollCpu()
+    {
+        std::ifstream in(m_options.proc_stat);
+        std::string label;
+        unsigned long long value, total = 0, idle = 0;
+        in >> label;
+        for (int field = 0; field < 8 && in >> value; ++field)
+        {
+            total += value;
+            if (field == 3 || field == 4) idle += value; // idle, iowait
+        }
+        if (label != "cpu" || total == 0) return -1.0;
+        const bool first = m_cpu_total == 0;
+        const double busy = total > m_cpu_total ? 100.0 * ((total - m_cpu_total) - (idle - m_cpu_idle)) / (total - m_cpu_total) : -1.0;
+        m_cpu_total = total;
+        m_cpu_idle = idle;
+        return first ? -1.0 : busy;
+    }
+
+    static uint64_t realtimeNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    /**
+     * @brief Reads the consumers' reports. Their counts are compared at the times
+     *        they were written (the file mtime), not at our tick.
+     */
+    void pollConsumers(Sample &sample)
+    {
+        DIR *dir = opendir(ADAPTIVE_UPTAKE_DIR);
+        if (!dir) return;
+        const size_t prefix = sizeof(ADAPTIVE_UPTAKE_PREFIX) - 1;
+        const uint64_t now = realtimeNs();
+        while (struct dirent *entry = readdir(dir))
+        {
+            const std::string file = entry->d_name;
+            if (file.compare(0, prefix, ADAPTIVE_UPTAKE_PREFIX) != 0 || file.size() <= prefix || file.find(".tmp") != std::string::npos) continue;
+            const std::string path = ADAPTIVE_UPTAKE_DIR + file;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            Consumer &consumer = m_consumers[file.substr(prefix)];
+            const uint64_t mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull + st.st_mtim.tv_nsec;
+            if (mtime_ns != consumer.updated_ns)
+            {
+                consumer.updated_ns = mtime_ns;
+                std::ifstream in(path);
+                std::string line;
+                uint64_t frames = 0;
+                while (std::getline(in, line))
+                {
+                    const size_t eq = line.find('=');
+                    if (eq == std::string::npos) continue;
+                    const std::string key = line.substr(0, eq);
+                    const char *text = line.c_str() + eq + 1;
+                    if (key == "frames") frames = std::strtoull(text, nullptr, 10);
+                    else if (key == "latency_ms") consumer.latency_ms = std::atof(text);
+                    else if (key == "busy_pct") consumer.busy_pct = std::atof(text);
+                    else if (key == "pid") consumer.pid = std::atoi(text);
+                }
+                // A restarted consumer counts from 0 again
+                if (!consumer.reports.empty() && frames < consumer.reports.back().second) consumer.reports.clear();
+                consumer.reports.emplace_back(mtime_ns, frames);
+            }
+            while (consumer.reports.size() > 1 && consumer.reports.front().first + (ADAPTIVE_WINDOW_SEC + 1) * 1000000000ull < now)
+            {
+                consumer.reports.pop_front();
+            }
+            const bool alive = consumer.pid <= 0 || kill(consumer.pid, 0) == 0;
+            consumer.live = alive && consumer.updated_ns + ADAPTIVE_STALE_SEC * 1000000000ull > now;
+            if (!consumer.live) continue;
+            sample.latency_ms = std::max(sample.latency_ms, consumer.latency_ms);
+            sample.busy_pct = std::max(sample.busy_pct, consumer.busy_pct);
+        }
+        closedir(dir);
+    }
+
+    void sample(std::chrono::steady_clock::time_point now, double dt)
+    {
+        Sample sample;
+        sample.seconds = dt;
+        sample.cpu_pct = pollCpu();
+        const double delivered = pollSource();
+        pollConsumers(sample);
+        if (delivered < 0)
+        {
+            // The pipeline restarted: a new mode, a crash or the governor
+            settle(now);
+            return;
+        }
+        if (dt <= 0.0) return;
+        sample.delivered = m_options.source_ring.empty() ? mode().fps * dt : delivered;
+        m_window.push_back(sample);
+        while (m_window.size() > ADAPTIVE_WINDOW_SEC) m_window.pop_front();
+    }
+
+    Metrics metrics() const
+    {
+        Metrics m;
+        double seconds = 0.0, delivered = 0.0, latency = 0.0, busy = 0.0, cpu = 0.0;
+        int latency_n = 0, busy_n = 0, cpu_n = 0;
+        for (const auto &sample : m_window)
+        {
+            seconds += sample.seconds;
+            delivered += sample.delivered;
+            if (sample.latency_ms >= 0) latency += sample.latency_ms, ++latency_n;
+            if (sample.busy_pct >= 0) busy += sample.busy_pct, ++busy_n;
+            if (sample.cpu_pct >= 0) cpu += sample.cpu_pct, ++cpu_n;
+        }
+        if (!m_options.source_ring.empty() && seconds > 0) m.delivery_pct = 100.0 * delivered / (mode().fps * seconds);
+        const uint64_t now = realtimeNs();
+        for (const auto &item : m_consumers)
+        {
+            const Consumer &consumer = item.second;
+            if (!consumer.live || consumer.reports.empty() || delivered <= 0) continue;
+            // A consumer that stopped reporting has stopped finishing frames: its rate decays until it is stale
+            const auto &first = consumer.reports.front();
+            const auto &last = consumer.reports.back();
+            const uint64_t end = now - last.first > 2 * ADAPTIVE_REPORT_MS * 1000000ull ? now : last.first;
+            if (end - first.first < (ADAPTIVE_WINDOW_SEC - 1) * 1000000000ull) continue; // not enough reports since the last settle
+            const double rate = (last.second - first.second) / ((end - first.first) / 1e9);
+            const double uptake = std::min(100.0, 100.0 * rate / (delivered / seconds));
+            if (m.uptake_pct < 0 || uptake < m.uptake_pct)
+            {
+                m.uptake_pct = uptake;
+                m.uptake_name = item.first;
+            }
+        }
+        if (latency_n) m.latency_ms = latency / latency_n;
+        if (busy_n) m.busy_pct = busy / busy_n;
+        if (cpu_n) m.cpu_pct = cpu / cpu_n;
+        return m;
+    }
+
+    void settle(std::chrono::steady_clock::time_point now)
+    {
+        m_window.clear();
+        for (auto &consumer : m_consumers) consumer.second.reports.clear();
+        m_settle_until = now + std::chrono::seconds(ADAPTIVE_SETTLE_SEC);
+    }
+
+    /**
+     * @brief Pressure and headroom are not complements: in between, the mode stays.
+     */
+    void evaluate(std::chrono::steady_clock::time_point now)
+    {
+        const bool held = (m_hold && m_hold()) || !pipelineUp();
+        if (held || now < m_settle_until || m_window.size() < ADAPTIVE_WINDOW_SEC)
+        {
+            if (held && !m_held) std::cout << "Adaptive capture: holding " << mode().text() << (pipelineUp() ? " while the governor sheds load" : " while the pipeline is down") << std::endl;
+            if (held) settle(now);
+            m_held = held;
+            m_state = held ? "held" : "settling";
+            m_pressure_since = m_headroom_since = now;
+            return;
+        }
+        m_held = false;
+        m_metrics = metrics();
+        const Metrics &m = m_metrics;
+
+        std::ostringstream reason;
+        reason << std::fixed << std::setprecision(0);
+        if (m.uptake_pct >= 0 && m.uptake_pct < m_options.uptake_pct) reason << "uptake " << m.uptake_pct << "% (" << m.uptake_name << ")";
+        else if (m.latency_ms > m_options.latency_ms) reason << "latency " << m.latency_ms << " ms";
+        else if (m.cpu_pct > m_options.cpu_pct) reason << "CPU " << m.cpu_pct << "%";
+        else if (m.delivery_pct >= 0 && m.delivery_pct < ADAPTIVE_DELIVERY_LOW) reason << "delivery " << m.delivery_pct << "% of " << mode().fps << " fps";
+        const bool pressure = !reason.str().empty();
+
+        // A step up multiplies the consumers' per-second work by the pixel rate ratio
+        bool headroom = !pressure && m_rung > 0;
+        if (headroom)
+        {
+            const double ratio = m_options.ladder[m_rung - 1].pixelRate() / mode().pixelRate();
+            headroom = (m.uptake_pct < 0 || m.uptake_pct >= ADAPTIVE_HEADROOM_UPTAKE) &&
+                       (m.delivery_pct < 0 || m.delivery_pct >= ADAPTIVE_DELIVERY_LOW) &&
+                       (m.latency_ms < 0 || m.latency_ms * ratio <= m_options.latency_ms) &&
+                       (m.busy_pct < 0 || m.busy_pct * ratio <= ADAPTIVE_HEADROOM_BUSY) &&
+                       (m.cpu_pct < 0 || m.cpu_pct <= m_options.cpu_pct - ADAPTIVE_CPU_MARGIN);
+        }
+        m_state = pressure ? "pressure" : (headroom ? "headroom" : "steady");
+
+        if (!pressure) m_pressure_since = now;
+        if (!headroom) m_headroom_since = now;
+        if (now - m_last_change >= std::chrono::seconds(ADAPTIVE_BACKOFF_RESET_SEC) && m_backoff > 1)
+        {
+            m_backoff = 1;
+            std::cout << "Adaptive capture: " << mode().text() << " held for " << ADAPTIVE_BACKOFF_RESET_SEC << " s, up hold back to " << m_options.up_sec << " s" << std::endl;
+        }
+
+        if (pressure && m_rung + 1 < m_options.ladder.size() && now - m_pressure_since >= std::chrono::seconds(m_options.down_sec))
+        {
+            // The last step up did not hold: wait longer before trying it again
+            if (m_last_step_up && now - m_last_change < std::chrono::seconds(m_options.up_sec * m_backoff * 2))
+            {
+                m_backoff = std::min(m_backoff * 2, ADAPTIVE_MAX_BACKOFF);
+            }
+            step(m_rung + 1, reason.str(), now);
+        }
+        else if (headroom && now - m_headroom_since >= std::chrono::seconds(m_options.up_sec * m_backoff))
+        {
+            step(m_rung - 1, "headroom", now);
+        }
+    }
+
+    bool pipelineUp() const
+    {
+        for (const auto &child : m_supervisor.children())
+        {
+            if (child.name == m_options.child) return child.pid > 0;
+        }
+        return false;
+    }
+
+    void step(size_t rung, const std::string &reason, std::chrono::steady_clock::time_point now)
+    {
+        const size_t previous = m_rung;
+        m_rung = rung;
+        m_last_step_up = rung < previous;
+        m_last_change = m_pressure_since = m_headroom_since = now;
+        ++m_changes;
+        std::cout << "Adaptive capture: " << m_options.ladder[previous].text() << " -> " << mode().text() << " on " << reason;
+        if (m_last_step_up && m_backoff > 1) std::cout << " (up hold " << m_options.up_sec * m_backoff << " s after oscillating)";
+        std::cout << std::endl;
+        m_supervisor.notify(SupervisorEvent::Level, "adaptive capture", getpid(), static_cast<int32_t>(rung), static_cast<int64_t>(previous));
+
+        setCaptureEnvironment(mode());
+        const CaptureMode &from = m_options.ladder[previous];
+        restartCapture(m_supervisor, m_options.child, m_options.output, from.width != mode().width || from.height != mode().height);
+        settle(now);
+    }
+
+    /**
+     * @brief key=value lines; replaced atomically.
+     */
+    void writeStatus() const
+    {
+        writeStatusFile(m_options.status_path, [&](std::ostream &out) {
+            const Metrics &m = m_metrics;
+            out << "mode=" << mode().text() << "\nrung=" << m_rung << "\nstate=" << m_state << std::fixed << std::setprecision(1)
+                << "\nuptake_pct=" << m.uptake_pct << "\nuptake_consumer=" << m.uptake_name << "\nlatency_ms=" << m.latency_ms
+                << "\nbusy_pct=" << m.busy_pct << "\ncpu_pct=" << m.cpu_pct << "\ndelivery_pct=" << m.delivery_pct
+                << "\nup_hold_sec=" << m_options.up_sec * m_backoff << "\nchanges=" << m_changes << "\n";
+        });
+    }
+
+    ChildSupervisor &m_supervisor;
+    AdaptiveOptions m_options;
+    std::function<bool()> m_hold;
+    size_t m_rung = 0;
+    int m_backoff = 1;
+    int m_changes = 0;
+    bool m_last_step_up = false;
+    bool m_held = false;
+    std::string m_state = "settling";
+    Metrics m_metrics;
+    std::deque<Sample> m_window;
+    std::map<std::string, Consumer> m_consumers;
+    ShmRingReader m_source;
+    ino_t m_source_inode = 0;
+    uint64_t m_source_seen = 0;
+    unsigned long long m_cpu_total = 0, m_cpu_idle = 0;
+    std::chrono::steady_clock::time_point m_last_sample;
+    std::chrono::steady_clock::time_point m_settle_until, m_pressure_since, m_headroom_since, m_last_change;
+};
+
+#endif // DE_ADAPTIVE_HPP
@@ -0,0 +1,599 @@
+//***************************************************************************** */
+//  Capture-mode negotiation from declared consumer requirements
+//
+//  sh_camera_run_rpi_camera.sh captures one fixed mode, and libcamera picks
+//  the sensor mode for it. The consumers want different things: de_camera
+//  1080p for streaming, de_tracker a small image at a high rate, the AI
+//  modules a square input at a few frames per second. With --capture-plan
+//  each enabled module declares what it needs:
+//
+//      --capture-need name=WxH@fps[:format]       on the command line, or
+//      <module config>.capture                    width=, height=, fps=, format=
+//                                                 next to its config, or
+//      the built-in default of the module         (captureNeedDefault)
+//
+//  and the wrapper chooses, from the sensor modes rpicam-hello --list-cameras
+//  reports, the mode that serves all of them for the least pixel throughput:
+//
+//      capture rate   the highest rate anyone needs
+//      output size    the smallest frame, at the widest aspect anyone needs,
+//                     from which every consumer can crop its own aspect
+//                     without upscaling
+//      sensor mode    covers the output at that rate without cropping the
+//                     field of view; cheapest readout + ISP output wins
+//
+//  The plan is logged with its estimated Mpx/s, written to the status file
+//  and applied with DE_VIDEO_WIDTH/HEIGHT/FRAMERATE/MODE. Each module gets
+//  its derived output (crop, size, frames kept, format) in DE_CAPTURE_*.
+//
+//***************************************************************************** */
+
+#ifndef DE_CAPTURE_PLAN_HPP
+#define DE_CAPTURE_PLAN_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "de_adaptive.hpp"
+
+#define CAPTURE_NEEDS_SUFFIX ".capture" // <module config>.capture
+#define CAPTURE_PLAN_FOV_TOLERANCE 0.98 // a sensor mode reading this much of the sensor counts as the full field of view
+#define CAPTURE_PLAN_WIDTH_ALIGN 64     // output width alignment; rpicam-vid pads other widths
+
+/**
+ * @brief What one consumer declared.
+ */
+struct CaptureNeed
+{
+    std::string name;
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned fps = 0;
+    std::string format = "yuv420"; // yuv420, gray, rgb24, bgr24 or h264
+    std::string origin;            // where the declaration came from, for the log
+
+    double aspect() const { return static_cast<double>(width) / height; }
+};
+
+/**
+ * @brief One sensor mode as rpicam-hello --list-cameras reports it.
+ */
+struct SensorMode
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    double max_fps = 0.0;
+    unsigned bits = 0;     // 0 = unknown, --mode then gives only the size
+    bool packed = true;
+    unsigned crop_w = 0;   // area of the sensor it reads; 0 = all of it
+    unsigned crop_h = 0;
+
+    std::string rpicamMode() const
+    {
+        std::string text = std::to_string(width) + ":" + std::to_string(height);
+        if (bits) text += ":" + std::to_string(bits) + (packed ? ":P" : ":U");
+        return text;
+    }
+};
+
+struct CapturePlanOptions
+{
+    std::vector<CaptureNeed> needs;   // --capture-need; win over files and defaults
+    std::string sensor_modes;         // --capture-sensor-modes WxH@fps[:bits][/CWxCH],... instead of asking the camera
+    std::string list_command = "/home/pi/rpicam-apps/build/apps/rpicam-hello --list-cameras";
+    std::string source = "DE-RPI";    // what the modules read the camera from
+    std::string status_path = "/dev/shm/de_capture_plan";
+};
+
+/**
+ * @brief Parses "name=WxH@fps[:format]".
+ */
+inline bool parseCaptureNeed(const std::string &text, CaptureNeed &need)
+{
+    const size_t equals = text.find('=');
+    if (equals == std::string::npos || equals == 0) return false;
+    need.name = text.substr(0, equals);
+    char format[16] = "";
+    const int fields = std::sscanf(text.c_str() + equals + 1, "%ux%u@%u:%15s", &need.width, &need.height, &need.fps, format);
+    if (fields < 3 || !need.width || !need.height || !need.fps) return false;
+    if (fields == 4) need.format = format;
+    need.origin = "--capture-need";
+    return true;
+}
+
+/**
+ * @brief Reads a module's own declaration: key=value lines width, height, fps and format.
+ */
+inline bool readCaptureNeedFile(const std::string &path, CaptureNeed &need)
+{
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos) continue;
+        const std::string key = line.substr(0, equals), value = line.substr(equals + 1);
+        if (key == "width") need.width = static_cast<unsigned>(std::atoi(value.c_str()));
+        else if (key == "height") need.height = static_cast<unsigned>(std::atoi(value.c_str()));
+        else if (key == "fps") need.fps = static_cast<unsigned>(std::atoi(value.c_str()));
+        else if (key == "format") need.format = value;
+    }
+    need.origin = path;
+    return need.width && need.height && need.fps;
+}
+
+/**
+ * @brief What the modules of this stack want when they declare nothing.
+ */
+inline bool captureNeedDefault(const std::string &name, CaptureNeed &need)
+{
+    static const struct
+    {
+        const char *name;
+        unsigned width, height, fps;
+        const char *format;
+    } defaults[] = {
+        {"de_camera", 1920, 1080, 15, "yuv420"},        // streaming; what the script captured so far
+        {"de_tracker", 640, 480, 30, "gray"},           // small and fast
+        {"de_ai_tracker.so", 640, 640, 15, "rgb24"},
+        {"de_yolo_generic", 640, 640, 5, "rgb24"},      // square network input
+    };
+    for (const auto &entry : defaults)
+    {
+        if (name != entry.name) continue;
+        need.name = name;
+        need.width = entry.width;
+        need.height = entry.height;
+        need.fps = entry.fps;
+        need.format = entry.format;
+        need.origin = "default";
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Parses the first camera of rpicam-hello --list-cameras:
+ *
+ *   0 : imx708 [4608x2592 10-bit RGGB] (/base/...)
+ *       Modes: 'SRGGB10_CSI2P' : 1536x864 [120.13 fps - (768, 432)/3072x1728 crop]
+ *                                2304x1296 [56.03 fps - (0, 0)/4608x2592 crop]
+ */
+inline bool parseSensorModes(const std::string &text, std::vector<SensorMode> &modes, std::string &sensor)
+{
+    modes.clear();
+    std::stringstream lines(text);
+    std::string line;
+    unsigned bits = 0;
+    bool packed = true, in_camera = false;
+    while (std::getline(lines, line))
+    {
+        unsigned index = 0;
+        char model[64] = "";
+        if (std::sscanf(line.c_str(), " %u : %63s", &index, model) == 2)
+        {
+            if (in_camera) break; // the first camera only
+            in_camera = true;
+            sensor = model;
+            continue;
+        }
+        if (!in_camera) continue;
+        // A new pixel format starts a group: 'SRGGB10_CSI2P' :
+        const size_t quote = line.find('\'');
+        if (quote != std::string::npos)
+        {
+            const size_t end = line.find('\'', quote + 1);
+            const std::string format = line.substr(quote + 1, end == std::string::npos ? std::string::npos : end - quote - 1);
+            const size_t digits = format.find_first_of("0123456789");
+            bits = digits == std::string::npos ? 0 : static_cast<unsigned>(std::atoi(format.c_str() + digits));
+            packed = format.empty() || format.back() == 'P';
+            line = end == std::string::npos ? "" : line.substr(line.find(':', end) + 1);
+        }
+        SensorMode mode;
+        int crop_x = 0, crop_y = 0;
+        if (std::sscanf(line.c_str(), " %ux%u [%lf fps - (%d, %d)/%ux%u", &mode.width, &mode.height, &mode.max_fps, &crop_x, &crop_y,
+                        &mode.crop_w, &mode.crop_h) < 3)
+            continue;
+        mode.bits = bits;
+        mode.packed = packed;
+        modes.push_back(mode);
+    }
+    return !modes.empty();
+}
+
+/**
+ * @brief Parses --capture-sensor-modes "WxH@fps[:bits][/CWxCH],...". CWxCH is
+ *        the sensor area the mode reads; without it, the whole sensor.
+ */
+inline bool parseSensorModeList(const std::string &list, std::vector<SensorMode> &modes)
+{
+    modes.clear();
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        SensorMode mode;
+        const size_t slash = item.find('/');
+        if (slash != std::string::npos && std::sscanf(item.c_str() + slash + 1, "%ux%u", &mode.crop_w, &mode.crop_h) != 2) return false;
+        const size_t colon = item.find(':');
+        if (colon != std::string::npos && colon < slash) mode.bits = static_cast<unsigned>(std::atoi(item.c_str() + colon + 1));
+        if (std::sscanf(item.c_str(), "%ux%u@%lf", &mode.width, &mode.height, &mode.max_fps) != 3 || !mode.width || !mode.height || mode.max_fps <= 0) return false;
+        modes.push_back(mode);
+    }
+    return !modes.empty();
+}
+
+/**
+ * @brief Chooses the capture mode for the declared needs and hands each module its share.
+ */
+class CapturePlan
+{
+public:
+    explicit CapturePlan(const CapturePlanOptions &options) : m_options(options) {}
+
+    /**
+     * @brief Adds an enabled module: its --capture-need, else <config>.capture, else its default.
+     */
+    void addModule(const std::string &name, const std::string &config)
+    {
+        CaptureNeed need;
+        need.name = name;
+        bool found = false;
+        for (const auto &declared : m_options.needs)
+        {
+            if (declared.name == name)
+            {
+                need = declared;
+                found = true;
+            }
+        }
+        if (!found) found = readCaptureNeedFile(config + CAPTURE_NEEDS_SUFFIX, need);
+        if (!found) found = captureNeedDefault(name, need);
+        if (!found)
+        {
+            std::cerr << "Capture plan: " << name << " declares no capture needs; it gets the camera's mode." << std::endl;
+            return;
+        }
+        m_needs.push_back(need);
+    }
+
+    /**
+     * @brief Adds the --capture-need entries of consumers that are not wrapper modules (e.g. --execute scripts).
+     */
+    void addUndeclaredNeeds()
+    {
+        for (const auto &declared : m_options.needs)
+        {
+            const bool known = std::any_of(m_needs.begin(), m_needs.end(), [&declared](const CaptureNeed &need) { return need.name == declared.name; });
+            if (!known) m_needs.push_back(declared);
+        }
+    }
+
+    /**
+     * @brief Reads the sensor modes and chooses the plan. False if there is nothing to plan for.
+     */
+    bool compute()
+    {
+        if (m_needs.empty())
+        {
+            std::cerr << "Capture plan: no consumer declared anything; the script's mode is kept." << std::endl;
+            return false;
+        }
+        loadSensorModes();
+
+        // The fastest consumer sets the rate, the widest its aspect; narrower ones crop the centre
+        unsigned fps = 0;
+        double aspect = 0.0;
+        for (const auto &need : m_needs)
+        {
+            fps = std::max(fps, need.fps);
+            aspect = std::max(aspect, need.aspect());
+        }
+        double height = 0.0;
+        for (const auto &need : m_needs) height = std::max(height, need.aspect() < aspect ? static_cast<double>(need.height) : need.width / aspect);
+        const double width = height * aspect;
+
+        if (m_sensor_modes.empty())
+        {
+            m_choice = evaluate(nullptr, width, height, aspect, fps);
+        }
+        else
+        {
+            unsigned sensor_w = 0, sensor_h = 0;
+            for (const auto &mode : m_sensor_modes)
+            {
+                sensor_w = std::max(sensor_w, mode.crop_w ? mode.crop_w : mode.width);
+                sensor_h = std::max(sensor_h, mode.crop_h ? mode.crop_h : mode.height);
+            }
+            m_sensor_w = sensor_w;
+            m_sensor_h = sensor_h;
+            bool have = false;
+            for (const auto &mode : m_sensor_modes)
+            {
+                Candidate candidate = evaluate(&mode, width, height, aspect, fps);
+                if (!have || better(candidate, m_choice)) m_choice = candidate;
+                have = true;
+                m_candidates.push_back(candidate);
+            }
+        }
+        m_mode.width = m_choice.width;
+        m_mode.height = m_choice.height;
+        m_mode.fps = m_choice.fps;
+        m_mode.sensor = m_choice.has_sensor ? m_choice.sensor.rpicamMode() : "";
+        derive();
+        return true;
+    }
+
+    const CaptureMode &mode() const { return m_mode; }
+
+    /**
+     * @brief Environment for a module: its derived output from the planned mode.
+     */
+    void addEnvironment(const std::string &name, std::vector<std::pair<std::string, std::string>> &env) const
+    {
+        for (const auto &output : m_outputs)
+        {
+            if (output.need.name != name) continue;
+            env.push_back({"DE_CAPTURE_PLAN", m_options.status_path});
+            env.push_back({"DE_CAPTURE_SOURCE", m_options.source});
+            env.push_back({"DE_CAPTURE_CROP", std::to_string(output.crop_x) + "," + std::to_string(output.crop_y) + "," + std::to_string(output.crop_w) + "," +
+                                                  std::to_string(output.crop_h)});
+            env.push_back({"DE_CAPTURE_SIZE", std::to_string(output.need.width) + "x" + std::to_string(output.need.height)});
+            env.push_back({"DE_CAPTURE_FPS", std::to_string(output.need.fps)});
+            env.push_back({"DE_CAPTURE_KEEP", std::to_string(output.keep) + "/" + std::to_string(output.of)});
+            env.push_back({"DE_CAPTURE_FORMAT", output.need.format});
+        }
+    }
+
+    /**
+     * @brief Logs the plan: mode, sensor mode, the consumers' outputs and the Mpx/s of each stage.
+     */
+    void print(std::ostream &out) const
+    {
+        out << std::fixed << std::setprecision(1) << "Capture plan: " << m_mode.text();
+        if (m_choice.has_sensor)
+        {
+            out << " from sensor mode " << m_choice.sensor.width << "x" << m_choice.sensor.height;
+            if (m_choice.sensor.bits) out << " " << m_choice.sensor.bits << "-bit";
+            out << " (" << m_choice.sensor.max_fps << " fps max" << (m_choice.full_fov ? "" : ", crops the field of view") << ")";
+        }
+        else
+        {
+            out << " (sensor modes unknown; libcamera chooses)";
+        }
+        out << std::endl;
+        if (m_choice.has_sensor) out << "  sensor readout  " << std::setw(8) << m_choice.readout_mpx << " Mpx/s" << std::endl;
+        out << "  camera output   " << std::setw(8) << m_choice.output_mpx << " Mpx/s  " << m_options.source << std::endl;
+        double derived = 0.0;
+        for (const auto &output : m_outputs)
+        {
+            derived += output.mpx;
+            std::ostringstream size, crop, keep;
+            size << output.need.width << "x" << output.need.height << "@" << output.need.fps << " " << output.need.format;
+            crop << "crop " << output.crop_x << "," << output.crop_y << " " << output.crop_w << "x" << output.crop_h;
+            keep << (output.keep == output.of ? std::string("every frame") : std::to_string(output.keep) + " of " + std::to_string(output.of) + " frames");
+            out << "  " << std::left << std::setw(16) << output.need.name << std::right << std::setw(8) << output.mpx << " Mpx/s  " << std::left
+                << std::setw(22) << size.str() << std::setw(24) << crop.str() << std::setw(16) << keep.str() << std::right << "(" << output.need.origin << ")";
+            if (!output.met) out << "  NOT MET: " << output.shortfall;
+            out << std::endl;
+        }
+        out << "  total           " << std::setw(8) << m_choice.readout_mpx + m_choice.output_mpx + derived << " Mpx/s" << std::endl;
+        for (const auto &candidate : m_candidates)
+        {
+            if (candidate.sensor.width == m_choice.sensor.width && candidate.sensor.height == m_choice.sensor.height && candidate.sensor.bits == m_choice.sensor.bits)
+                continue;
+            out << "  not chosen: " << candidate.sensor.width << "x" << candidate.sensor.height;
+            if (candidate.sensor.bits) out << " " << candidate.sensor.bits << "-bit";
+            out << " - " << rejection(candidate) << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+    /**
+     * @brief Writes the plan for modules and tools: mode= sensor= and one consumer= line per module.
+     */
+    void writeStatus() const
+    {
+        writeStatusFile(m_options.status_path, [&](std::ostream &out) {
+            out << std::fixed << std::setprecision(1) << "mode=" << m_mode.text() << "\nsensor=" << m_mode.sensor << "\nsensor_model=" << m_sensor_model
+                << "\nfull_fov=" << (m_choice.full_fov ? 1 : 0) << "\nsource=" << m_options.source << "\nreadout_mpx=" << m_choice.readout_mpx
+                << "\noutput_mpx=" << m_choice.output_mpx << "\n";
+            for (const auto &output : m_outputs)
+            {
+                out << "consumer=" << output.need.name << " size=" << output.need.width << "x" << output.need.height << " fps=" << output.need.fps
+                    << " format=" << output.need.format << " crop=" << output.crop_x << "," << output.crop_y << "," << output.crop_w << "," << output.crop_h
+                    << " keep=" << output.keep << "/" << output.of << " mpx=" << output.mpx << " met=" << (output.met ? 1 : 0) << "\n";
+            }
+        });
+    }
+
+private:
+    struct Candidate
+    {
+        bool has_sensor = false;
+        SensorMode sensor;
+        unsigned width = 0, height = 0, fps = 0; // camera output
+        int unmet = 0;                           // consumers that would get less than they asked for
+        bool full_fov = true;
+        bool too_slow = false;
+        bool too_small = false;
+        double readout_mpx = 0.0, output_mpx = 0.0;
+    };
+
+    struct DerivedOutput
+    {
+        CaptureNeed need;
+        unsigned crop_x = 0, crop_y = 0, crop_w = 0, crop_h = 0; // in the camera output
+        unsigned keep = 1, of = 1;                               // frames kept of the camera's
+        double mpx = 0.0;
+        bool met = true;
+        std::string shortfall;
+    };
+
+    void loadSensorModes()
+    {
+        if (!m_options.sensor_modes.empty())
+        {
+            if (!parseSensorModeList(m_options.sensor_modes, m_sensor_modes))
+                std::cerr << "Capture plan: --capture-sensor-modes must be WxH@fps[:bits][/CWxCH],...; planning without sensor modes." << std::endl;
+            m_sensor_model = "--capture-sensor-modes";
+            return;
+        }
+        FILE *pipe = popen((m_options.list_command + " 2>/dev/null").c_str(), "r");
+        std::string text;
+        if (pipe)
+        {
+            char buffer[512];
+            while (fgets(buffer, sizeof(buffer), pipe)) text += buffer;
+            pclose(pipe);
+        }
+        if (!parseSensorModes(text, m_sensor_modes, m_sensor_model))
+            std::cerr << "Capture plan: no sensor modes from '" << m_options.list_command << "'; libcamera will choose the sensor mode." << std::endl;
+    }
+
+    /**
+     * @brief Output size and cost of capturing the needs with one sensor mode (nullptr: unknown modes).
+     */
+    Candidate evaluate(const SensorMode *mode, double width, double height, double aspect, unsigned fps) const
+    {
+        Candidate candidate;
+        candidate.fps = fps;
+        double scale = 1.0;
+        if (mode)
+        {
+            candidate.has_sensor = true;
+            candidate.sensor = *mode;
+            // The largest frame of the output aspect the mode's image holds; the ISP only scales down
+            const double mode_aspect = static_cast<double>(mode->width) / mode->height;
+            const double region_w = aspect >= mode_aspect ? mode->width : mode->height * aspect;
+            if (region_w < width)
+            {
+                scale = region_w / width;
+                candidate.too_small = true;
+            }
+            if (mode->max_fps + 0.01 < fps)
+            {
+                candidate.fps = std::max(1u, static_cast<unsigned>(mode->max_fps));
+                candidate.too_slow = true;
+            }
+            // Field of view: the mode must read the whole sensor area that the output aspect can use
+            const double sensor_aspect = static_cast<double>(m_sensor_w) / m_sensor_h;
+            const double fov_w = aspect >= sensor_aspect ? m_sensor_w : m_sensor_h * aspect;
+            const double fov_h = aspect >= sensor_aspect ? m_sensor_w / aspect : m_sensor_h;
+            const double read_w = mode->crop_w ? mode->crop_w : m_sensor_w, read_h = mode->crop_h ? mode->crop_h : m_sensor_h;
+            candidate.full_fov = read_w >= CAPTURE_PLAN_FOV_TOLERANCE * fov_w && read_h >= CAPTURE_PLAN_FOV_TOLERANCE * fov_h;
+        }
+        // rpicam-vid wants the width aligned; round up unless that goes past the mode
+        unsigned out_w = static_cast<unsigned>(std::ceil(width * scale - 0.001));
+        unsigned out_h = static_cast<unsigned>(std::ceil(height * scale - 0.001));
+        const unsigned aligned = (out_w + CAPTURE_PLAN_WIDTH_ALIGN - 1) / CAPTURE_PLAN_WIDTH_ALIGN * CAPTURE_PLAN_WIDTH_ALIGN;
+        if (!mode || aligned <= mode->width)
+        {
+            out_w = aligned;
+        }
+        else
+        {
+            out_w = out_w / CAPTURE_PLAN_WIDTH_ALIGN * CAPTURE_PLAN_WIDTH_ALIGN;
+            out_h = static_cast<unsigned>(out_w / aspect); // narrower: keep the aspect
+        }
+        out_h = (out_h + 1) / 2 * 2;
+        if (mode && out_h > mode->height) out_h = mode->height / 2 * 2;
+        candidate.width = out_w;
+        candidate.height = out_h;
+
+        for (const auto &need : m_needs)
+        {
+            const double crop_w = need.aspect() < static_cast<double>(out_w) / out_h ? out_h * need.aspect() : out_w;
+            if (crop_w + 0.5 < need.width || need.fps > candidate.fps) ++candidate.unmet;
+        }
+        if (mode) candidate.readout_mpx = static_cast<double>(mode->width) * mode->height * candidate.fps / 1e6;
+        candidate.output_mpx = static_cast<double>(out_w) * out_h * candidate.fps / 1e6;
+        return candidate;
+    }
+
+    /**
+     * @brief Fewest unmet consumers, then the full field of view, then the fewest pixels per second.
+     */
+    static bool better(const Candidate &a, const Candidate &b)
+    {
+        if (a.unmet != b.unmet) return a.unmet < b.unmet;
+        if (a.full_fov != b.full_fov) return a.full_fov;
+        return a.readout_mpx + a.output_mpx < b.readout_mpx + b.output_mpx;
+    }
+
+    std::string rejection(const Candidate &candidate) const
+    {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1);
+        if (candidate.too_slow) text << candidate.sensor.max_fps << " fps max, " << m_choice.fps << " needed";
+        else if (candidate.too_small) text << "too small for " << m_choice.width << "x" << m_choice.height;
+        else if (!candidate.full_fov && m_choice.full_fov) text << "crops the field of view";
+        else text << "+" << (candidate.readout_mpx + candidate.output_mpx) - (m_choice.readout_mpx + m_choice.output_mpx) << " Mpx/s";
+        return text.str();
+    }
+
+    /**
+     * @brief Each consumer's centre crop of the output, frames kept and cost.
+     */
+    void derive()
+    {
+        m_outputs.clear();
+        const double out_aspect = static_cast<double>(m_mode.width) / m_mode.height;
+        for (const auto &need : m_needs)
+        {
+            DerivedOutput output;
+            output.need = need;
+            if (need.aspect() < out_aspect)
+            {
+                output.crop_h = m_mode.height;
+                output.crop_w = std::min(m_mode.width, static_cast<unsigned>(std::lround(m_mode.height * need.aspect() / 2.0)) * 2);
+            }
+            else
+            {
+                output.crop_w = m_mode.width;
+                output.crop_h = std::min(m_mode.height, static_cast<unsigned>(std::lround(m_mode.width / need.aspect() / 2.0)) * 2);
+            }
+            output.crop_x = (m_mode.width - output.crop_w) / 4 * 2; // even, for the 4:2:0 chroma
+            output.crop_y = (m_mode.height - output.crop_h) / 4 * 2;
+            const unsigned fps = std::min(need.fps, m_mode.fps);
+            const unsigned divisor = std::gcd(fps, m_mode.fps);
+            output.keep = fps / divisor;
+            output.of = m_mode.fps / divisor;
+            output.mpx = static_cast<double>(need.width) * need.height * fps / 1e6;
+            if (output.crop_w < need.width)
+            {
+                output.met = false;
+                output.shortfall = "upscaled from " + std::to_string(output.crop_w) + "x" + std::to_string(output.crop_h);
+            }
+            if (need.fps > m_mode.fps)
+            {
+                output.met = false;
+                output.shortfall += std::string(output.shortfall.empty() ? "" : ", ") + std::to_string(m_mode.fps) + " fps";
+            }
+            m_outputs.push_back(output);
+        }
+    }
+
+    CapturePlanOptions m_options;
+    std::vector<CaptureNeed> m_needs;
+    std::vector<SensorMode> m_sensor_modes;
+    std::string m_sensor_model;
+    unsigned m_sensor_w = 0, m_sensor_h = 0;
+    std::vector<Candidate> m_candidates;
+    Candidate m_choice;
+    CaptureMode m_mode;
+    std::vector<DerivedOutput> m_outputs;
+};
+
+#endif // DE_CAPTURE_PLAN_HPP
@@ -0,0 +1,208 @@
+//***************************************************************************** */
+//  Synthetic camera and stub modules for testing --adapt-capture, the
+//  governor and --standby without a camera or AI modules
+//
+//      de_capture_stub source [--output DE-RPI]
+//      de_capture_stub consumer <name> [--input DE-RPI] [--ms-per-mpx N] [--meta de_meta_rpi]
+//      de_capture_stub module <name> [--load-sec N]
+//
+//  The source stands in for sh_camera_run_rpi_camera.sh: it writes YUV420
+//  test frames at DE_VIDEO_WIDTH x DE_VIDEO_HEIGHT @ DE_VIDEO_FRAMERATE (the
+//  script's defaults otherwise) to the virtual camera, and one rpicam-style
+//  JSON object per frame to $DE_RPI_METADATA (--frame-meta).
+//
+//  A consumer stands in for a module: it keeps the virtual camera open like
+//  a real reader, takes the newest frame of the metadata ring, spends
+//  --ms-per-mpx of CPU per megapixel of the frame size and reports through
+//  UptakeReporter. Frames that arrive while it is busy are missed, so its
+//  uptake falls as the pixel rate rises.
+//
+//  A module stands in for a slow-starting module with "standby_support": it
+//  "loads its model" for --load-sec seconds, and under DE_STANDBY=1 then
+//  stops itself with raise(SIGSTOP) like a real spare. Once running (or
+//  continued after a promotion) it idles until SIGTERM.
+//
+//***************************************************************************** */
+
+// g++ de_capture_stub.cpp -o de_capture_stub -O2
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#include "de_frame_sink.hpp"
+#include "de_frame_meta.hpp"
+#include "de_adaptive.hpp"
+
+static volatile sig_atomic_t g_stop = 0;
+
+static unsigned envNumber(const char *name, unsigned def)
+{
+    const char *value = getenv(name);
+    return value && std::atoi(value) > 0 ? static_cast<unsigned>(std::atoi(value)) : def;
+}
+
+static int runSource(const std::string &output)
+{
+    const unsigned width = envNumber("DE_VIDEO_WIDTH", 1920);
+    const unsigned height = envNumber("DE_VIDEO_HEIGHT", 1080);
+    const unsigned fps = envNumber("DE_VIDEO_FRAMERATE", 15);
+    const size_t frame_bytes = static_cast<size_t>(width) * height * 3 / 2;
+
+    FrameSink sink;
+    if (!sink.open(output, width, height, V4L2_PIX_FMT_YUV420, frame_bytes)) return 1;
+    FILE *metadata = nullptr;
+    if (const char *path = getenv("DE_RPI_METADATA"))
+    {
+        metadata = fopen(path, "w"); // the wrapper's FIFO: waits for its reader
+        if (!metadata) perror(path);
+    }
+    std::cerr << "de_capture_stub: " << width << "x" << height << "@" << fps << " to " << sink.path() << std::endl;
+
+    std::vector<uint8_t> frame(frame_bytes, 128);
+    const auto period = std::chrono::microseconds(1000000 / fps);
+    auto next = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; !g_stop; ++n)
+    {
+        // A bar moving across the luma plane, so the frames can be told apart by eye
+        const unsigned bar = static_cast<unsigned>(n * 8 % width);
+        for (unsigned y = 0; y < height; ++y)
+        {
+            uint8_t *row = frame.data() + static_cast<size_t>(y) * width;
+            std::memset(row, 16, width);
+            std::memset(row + bar, 235, std::min(16u, width - bar));
+        }
+        if (!sink.write(frame.data())) break;
+        if (metadata)
+        {
+            std::fprintf(metadata, "{\"FrameDuration\": %u, \"ExposureTime\": %u}\n", 1000000 / fps, 1000000 / fps / 2);
+            std::fflush(metadata);
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    if (metadata) fclose(metadata);
+    return 0;
+}
+
+/**
+ * @brief Frame size of the open capture device; the DE_VIDEO_* size if it is not one.
+ */
+static void inputSize(int fd, unsigned &width, unsigned &height)
+{
+    struct v4l2_format fmt;
+    std::memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (fd != -1 && ioctl(fd, VIDIOC_G_FMT, &fmt) == 0 && fmt.fmt.pix.width && fmt.fmt.pix.height)
+    {
+        width = fmt.fmt.pix.width;
+        height = fmt.fmt.pix.height;
+        return;
+    }
+    width = envNumber("DE_VIDEO_WIDTH", 1920);
+    height = envNumber("DE_VIDEO_HEIGHT", 1080);
+}
+
+static int runConsumer(const std::string &name, const std::string &input, double ms_per_mpx, const std::string &meta_ring)
+{
+    const std::string path = input.rfind("file:", 0) == 0 ? input.substr(5) : (input.rfind("/dev/", 0) == 0 ? input : findVideoDeviceByLabel(input));
+    const int fd = path.empty() ? -1 : open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd == -1)
+    {
+        std::cerr << "de_capture_stub: cannot open " << input << (path.empty() ? "" : " (" + path + ")") << std::endl;
+        return 1;
+    }
+    unsigned width = 0, height = 0;
+    inputSize(fd, width, height);
+    const auto cost = std::chrono::microseconds(static_cast<long>(ms_per_mpx * width * height / 1000.0));
+    std::cerr << "de_capture_stub: " << name << " reads " << width << "x" << height << " from " << path << ", "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(cost).count() << " ms per frame" << std::endl;
+
+    UptakeReporter uptake(name);
+    FrameMetaReader meta;
+    meta.open(meta_ring);
+    uint64_t seen = 0;
+    while (!g_stop)
+    {
+        meta.refresh();
+        const uint64_t latest = meta.latest();
+        FrameMeta frame;
+        if (latest == 0 || latest == seen || !meta.read(latest, frame))
+        {
+            if (latest < seen) seen = 0; // the pipeline restarted
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+        seen = latest;
+        // The newest frame only, like a module that grabs whatever is current
+        const uint64_t started = shmRingNowNs();
+        const auto until = std::chrono::steady_clock::now() + cost;
+        while (std::chrono::steady_clock::now() < until && !g_stop)
+        {
+        }
+        uptake.frameDone(frame.capture_ns, started);
+    }
+    close(fd);
+    return 0;
+}
+
+static int runModule(const std::string &name, int load_sec)
+{
+    const bool standby = getenv("DE_STANDBY") && std::string(getenv("DE_STANDBY")) == "1";
+    std::cerr << "de_capture_stub: " << name << " (PID " << getpid() << ") loading for " << load_sec << " s"
+              << (standby ? " as a standby spare" : "") << std::endl;
+    for (int i = 0; i < load_sec * 10 && !g_stop; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (standby && !g_stop)
+    {
+        std::cerr << "de_capture_stub: " << name << " (PID " << getpid() << ") loaded, stopping until promoted" << std::endl;
+        raise(SIGSTOP); // everything is loaded; nothing opened that the active module holds
+        std::cerr << "de_capture_stub: " << name << " (PID " << getpid() << ") continued" << std::endl;
+    }
+    if (!g_stop) std::cerr << "de_capture_stub: " << name << " (PID " << getpid() << ") running" << std::endl;
+    while (!g_stop) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string mode = argc >= 2 ? argv[1] : "";
+    std::string name, output = "DE-RPI", meta_ring = "de_meta_rpi";
+    double ms_per_mpx = 20.0;
+    int load_sec = 10;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if ((arg == "--output" || arg == "--input") && i + 1 < argc) output = argv[++i];
+        else if (arg == "--ms-per-mpx" && i + 1 < argc) ms_per_mpx = std::atof(argv[++i]);
+        else if (arg == "--load-sec" && i + 1 < argc) load_sec = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--meta" && i + 1 < argc) meta_ring = argv[++i];
+        else if (arg == "-c" && i + 1 < argc) ++i; // the module config the wrapper passes
+        else if (name.empty()) name = arg;
+    }
+    if ((mode != "source" && mode != "consumer" && mode != "module") || (mode != "source" && name.empty()))
+    {
+        std::cerr << "Usage: " << argv[0] << " source [--output label|/dev/videoN|file:path]" << std::endl;
+        std::cerr << "       " << argv[0] << " consumer <name> [--input label|/dev/videoN|file:path] [--ms-per-mpx N] [--meta ring_name]" << std::endl;
+        std::cerr << "       " << argv[0] << " module <name> [--load-sec N]" << std::endl;
+        std::cerr << "  source: test frames at DE_VIDEO_WIDTH x DE_VIDEO_HEIGHT @ DE_VIDEO_FRAMERATE, metadata to $DE_RPI_METADATA." << std::endl;
+        std::cerr << "  consumer: CPU work per frame of the metadata ring, reported to --adapt-capture as <name>." << std::endl;
+        std::cerr << "  module: loads for --load-sec seconds (default 10), then SIGSTOPs itself under DE_STANDBY=1." << std::endl;
+        return 1;
+    }
+
+    signal(SIGINT, [](int) { g_stop = 1; });
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGPIPE, SIG_IGN);
+    if (mode == "module") return runModule(name, load_sec);
+    return mode == "source" ? runSource(output) : runConsumer(name, output, ms_per_mpx, meta_ring);
+}
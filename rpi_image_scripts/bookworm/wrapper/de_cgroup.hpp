@@ -0,0 +1,573 @@
+//***************************************************************************** */
+//  cgroup v2 isolation and PSI-driven load shedding of the camera stack
+//
+//  Without this every child runs in the wrapper's cgroup, and a memory spike
+//  in an AI module pushes the whole board into swap or the OOM killer, often
+//  taking capture with it. With --cgroup each supervised child gets its own
+//  leaf below the wrapper's own cgroup (its systemd unit, which must have
+//  Delegate=yes) or below --cgroup-root:
+//
+//      <unit>/supervisor          the wrapper itself (no processes in <unit>)
+//      <unit>/camera-pipeline     cpu.weight 400, oom -500
+//      <unit>/de_yolo_generic     cpu.max / memory.high / memory.max
+//      ...                        from --cgroup-limit, oom +500
+//
+//  The modules stay inside the unit, so systemctl stop/restart still reaches
+//  them, and systemd only writes the unit's parent.
+//
+//  Pressure stall information (PSI) of the system and of the capture leaves
+//  is read once per second. When memory or CPU stall stays above the limit,
+//  the modules are frozen (cgroup.freeze) lowest priority first, one at a
+//  time, and memory of a frozen module is reclaimed. They are thawed again,
+//  in reverse order, once the pressure is gone. Capture and streaming
+//  children are never shed.
+//
+//***************************************************************************** */
+
+#ifndef DE_CGROUP_HPP
+#define DE_CGROUP_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "de_supervisor.hpp"
+
+#define CGROUP_CRITICAL_PRIORITY 100 // at or above: never shed
+#define CGROUP_CPU_PERIOD_US 100000
+#define CGROUP_SUPERVISOR_LEAF "supervisor" // the wrapper's own leaf below the root
+
+/**
+ * @brief Limits and priority of one module's leaf. -1 = leave the kernel default.
+ */
+struct CgroupLimits
+{
+    int cpu_pct = -1;         // cpu.max as percent of one core
+    int cpu_weight = -1;      // cpu.weight, 1..10000 (kernel default 100)
+    long long mem_high = -1;  // memory.high in bytes: reclaim and throttle above
+    long long mem_max = -1;   // memory.max in bytes: OOM kill inside the leaf above
+    int oom_score_adj = 0;    // -1000..1000, written for every process of the module
+    int priority = 50;        // shed order, lowest first; CGROUP_CRITICAL_PRIORITY and above never shed
+};
+
+struct CgroupOptions
+{
+    std::string root;                          // empty = the wrapper's own cgroup
+    std::string mount = "/sys/fs/cgroup";
+    std::string psi_root = "/proc/pressure";
+    std::map<std::string, CgroupLimits> limits; // by supervised child name, merged over the defaults
+    double psi_memory = 10.0;                  // "some avg10" percent that counts as pressure
+    double psi_cpu = 40.0;
+    int up_sec = 2;                            // pressure must last this long to shed one more module
+    int down_sec = 15;                         // relief must last this long to thaw one module
+    int report_sec = 30;                       // 0 = no periodic report
+    std::string status_path = "/dev/shm/de_cgroups";
+};
+
+/**
+ * @brief Default limits: capture and streaming are critical, AI goes first.
+ */
+inline CgroupLimits cgroupDefaultLimits(const std::string &name)
+{
+    CgroupLimits limits;
+    if (name == "camera pipeline" || name == "gimbal camera pipeline" || name == "gimbal ingest" ||
+        name == "thermal bridge" || name == "rtp output" || name == "de_camera")
+    {
+        limits.priority = CGROUP_CRITICAL_PRIORITY;
+        limits.cpu_weight = 400;
+        limits.oom_score_adj = -500;
+    }
+    else if (name == "de_yolo_generic" || name == "de_ai_tracker.so")
+    {
+        limits.priority = name == "de_yolo_generic" ? 10 : 20;
+        limits.oom_score_adj = 500;
+    }
+    else if (name.size() > 8 && name.compare(name.size() - 8, 8, " standby") == 0)
+    {
+        // Warm spares (de_standby.hpp) are shed before any running module
+        limits.priority = 5;
+        limits.oom_score_adj = 800;
+    }
+    else if (name == "de_tracker")
+    {
+        limits.priority = 30;
+        limits.oom_score_adj = 300;
+    }
+    else if (name == "script")
+    {
+        limits.priority = 40;
+        limits.oom_score_adj = 200;
+    }
+    return limits;
+}
+
+/**
+ * @brief Parses "100M", "1G", "512K" or plain bytes. Returns -1 on error.
+ */
+inline long long cgroupParseBytes(const std::string &text)
+{
+    char *end = nullptr;
+    const double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) return -1;
+    switch (*end)
+    {
+    case '\0': return static_cast<long long>(value);
+    case 'k': case 'K': return static_cast<long long>(value * 1024);
+    case 'm': case 'M': return static_cast<long long>(value * 1024 * 1024);
+    case 'g': case 'G': return static_cast<long long>(value * 1024 * 1024 * 1024);
+    default: return -1;
+    }
+}
+
+/**
+ * @brief Parses "<name>:cpu=50,weight=100,mem_high=300M,mem_max=400M,oom=500,prio=10"
+ *        on top of the defaults for <name>. Returns false on a syntax error.
+ */
+inline bool cgroupParseLimit(const std::string &spec, std::map<std::string, CgroupLimits> &limits)
+{
+    const size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    const std::string name = spec.substr(0, colon);
+    CgroupLimits entry = limits.count(name) ? limits[name] : cgroupDefaultLimits(name);
+    std::stringstream list(spec.substr(colon + 1));
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        const std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+        if (key == "cpu") entry.cpu_pct = std::atoi(value.c_str());
+        else if (key == "weight") entry.cpu_weight = std::atoi(value.c_str());
+        else if (key == "mem_high") entry.mem_high = cgroupParseBytes(value);
+        else if (key == "mem_max") entry.mem_max = cgroupParseBytes(value);
+        else if (key == "oom") entry.oom_score_adj = std::max(-1000, std::min(1000, std::atoi(value.c_str())));
+        else if (key == "prio") entry.priority = std::atoi(value.c_str());
+        else return false;
+        if ((key == "mem_high" && entry.mem_high < 0) || (key == "mem_max" && entry.mem_max < 0)) return false;
+    }
+    limits[name] = entry;
+    return true;
+}
+
+/**
+ * @brief Places the supervised children in cgroup leaves and sheds them under pressure.
+ */
+class CgroupManager
+{
+public:
+    CgroupManager(ChildSupervisor &supervisor, const CgroupOptions &options) : m_supervisor(supervisor), m_options(options)
+    {
+        m_pressure_since = m_relief_since = m_last_change = m_last_report = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Resolves the root, moves the wrapper into a leaf of its own and enables
+     *        the cpu and memory controllers for the leaves. The root's parent is not
+     *        touched: under systemd it belongs to systemd, which enables the
+     *        controllers for a unit with Delegate=yes.
+     * @return False if there is no usable root (no cgroup v2, the wrapper runs in the
+     *         root cgroup, or no permission); the modules then run unconfined, but PSI
+     *         shedding still works through SIGSTOP.
+     */
+    bool setup()
+    {
+        const std::string own = ownCgroup();
+        if (m_options.root.empty())
+        {
+            if (own.empty() || own == m_options.mount)
+            {
+                std::cerr << "cgroup: the wrapper is not in a cgroup v2 of its own; run it from a systemd unit with Delegate=yes or give --cgroup-root."
+                          << " Modules are not isolated; shedding falls back to SIGSTOP." << std::endl;
+                return false;
+            }
+            m_options.root = own;
+        }
+        else if (own.empty() || m_options.root.compare(0, own.size() + 1, own + "/") != 0)
+        {
+            std::cerr << "cgroup: " << m_options.root << " is outside the wrapper's cgroup " << (own.empty() ? "?" : own)
+                      << "; systemctl stop and restart will not reach the modules." << std::endl;
+        }
+        if (mkdir(m_options.root.c_str(), 0755) == -1 && errno != EEXIST)
+        {
+            std::cerr << "cgroup: cannot create " << m_options.root << ": " << std::strerror(errno)
+                      << ". Modules are not isolated; shedding falls back to SIGSTOP." << std::endl;
+            return false;
+        }
+        // Controllers can only be enabled for the leaves of a cgroup without processes of its own
+        const std::string self_leaf = m_options.root + "/" CGROUP_SUPERVISOR_LEAF;
+        if (mkdir(self_leaf.c_str(), 0755) == 0 || errno == EEXIST)
+        {
+            std::set<std::string> ours;
+            for (pid_t pid : processTree(getpid())) ours.insert(std::to_string(pid));
+            std::string procs;
+            readFile(m_options.root + "/cgroup.procs", procs);
+            std::istringstream lines(procs);
+            std::string pid;
+            while (std::getline(lines, pid))
+            {
+                if (ours.count(pid)) writeFile(self_leaf + "/cgroup.procs", pid);
+            }
+        }
+        if (!writeFile(m_options.root + "/cgroup.subtree_control", "+cpu +memory"))
+        {
+            std::cerr << "cgroup: cpu/memory controllers not available below " << m_options.root
+                      << " (the unit needs Delegate=yes, and only the wrapper may run in it); only placement and freezing work." << std::endl;
+        }
+        m_enabled = true;
+        return true;
+    }
+
+    const std::string &root() const { return m_options.root; }
+
+    /**
+     * @brief Supervisor tick: places new and relaunched children, reads PSI once per second.
+     */
+    void tick()
+    {
+        auto &children = m_supervisor.children();
+        if (m_modules.size() < children.size()) m_modules.resize(children.size());
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (children[i].pid > 0 && children[i].pid != m_modules[i].placed_pid) place(i);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_sample < std::chrono::seconds(1)) return;
+        m_last_sample = now;
+        readPressure();
+        evaluate(now);
+        writeStatus();
+        if (m_options.report_sec > 0 && now - m_last_report >= std::chrono::seconds(m_options.report_sec))
+        {
+            m_last_report = now;
+            report(std::cout);
+        }
+    }
+
+    /**
+     * @brief Thaws every shed module. Called before the wrapper stops its children.
+     */
+    void release()
+    {
+        for (size_t i = 0; i < m_modules.size(); ++i)
+        {
+            if (m_modules[i].shed) setShed(i, false);
+        }
+        m_shed_order.clear();
+    }
+
+    /**
+     * @brief Removes the (by then empty) module leaves. The wrapper's own leaf goes with the unit.
+     */
+    void cleanup()
+    {
+        for (const auto &module : m_modules)
+        {
+            if (!module.leaf.empty()) rmdir(module.leaf.c_str());
+        }
+    }
+
+    /**
+     * @brief Prints PSI and the state, limits and usage of every module.
+     */
+    void report(std::ostream &out)
+    {
+        out << "cgroup: memory pressure " << std::fixed << std::setprecision(1) << m_psi_memory << "% (capture " << m_psi_capture_memory
+            << "%), cpu " << m_psi_cpu << "% (capture " << m_psi_capture_cpu << "%), " << m_shed_order.size() << " module(s) shed" << std::endl;
+        out << "  module                   pid     prio  state    cpu%    mem MB   high MB  oom kills" << std::endl;
+        auto &children = m_supervisor.children();
+        for (size_t i = 0; i < children.size() && i < m_modules.size(); ++i)
+        {
+            SupervisedChild &child = children[i];
+            const Module &module = m_modules[i];
+            ChildSupervisor::sample(child);
+            out << "  " << std::left << std::setw(24) << child.name << " " << std::setw(7) << child.pid << " " << std::setw(5)
+                << module.limits.priority << " " << std::setw(7) << (child.pid <= 0 ? "down" : (module.shed ? "shed" : "running"))
+                << std::right << std::setw(6) << child.cpu_percent << std::setw(10) << memoryCurrent(module, child) / (1024.0 * 1024.0)
+                << std::setw(10);
+            if (module.limits.mem_high > 0) out << module.limits.mem_high / (1024.0 * 1024.0);
+            else out << "-";
+            out << std::setw(11) << eventCount(module, "oom_kill") << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+private:
+    struct Module
+    {
+        std::string leaf;     // empty = not in a cgroup of ours
+        pid_t placed_pid = -1;
+        CgroupLimits limits;
+        bool shed = false;
+        bool frozen_by_cgroup = false;
+        std::vector<pid_t> stopped; // paused through the supervisor when the leaf cannot be frozen
+    };
+
+    static bool writeFile(const std::string &path, const std::string &value)
+    {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << value;
+        out.flush();
+        return static_cast<bool>(out);
+    }
+
+    static bool readFile(const std::string &path, std::string &text)
+    {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        text = buffer.str();
+        return true;
+    }
+
+    /**
+     * @brief The wrapper's cgroup v2 directory from /proc/self/cgroup ("0::<path>"), empty if none.
+     */
+    std::string ownCgroup() const
+    {
+        std::ifstream in("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.compare(0, 3, "0::") != 0) continue;
+            std::string path = line.substr(3);
+            while (!path.empty() && path.back() == '/') path.pop_back();
+            return m_options.mount + path;
+        }
+        return "";
+    }
+
+    /**
+     * @brief "some avg10=" of a PSI file, 0 if it cannot be read.
+     */
+    static double someAvg10(const std::string &path)
+    {
+        std::string text;
+        if (!readFile(path, text)) return 0.0;
+        const size_t at = text.find("some avg10=");
+        return at == std::string::npos ? 0.0 : std::atof(text.c_str() + at + 11);
+    }
+
+    static std::string leafName(const std::string &name)
+    {
+        std::string leaf = name;
+        std::replace(leaf.begin(), leaf.end(), ' ', '-');
+        std::replace(leaf.begin(), leaf.end(), '/', '-');
+        return leaf;
+    }
+
+    void place(size_t i)
+    {
+        SupervisedChild &child = m_supervisor.children()[i];
+        Module &module = m_modules[i];
+        const bool first = module.placed_pid == -1;
+        module.placed_pid = child.pid;
+        if (first)
+        {
+            module.limits = m_options.limits.count(child.name) ? m_options.limits.at(child.name) : cgroupDefaultLimits(child.name);
+        }
+        const std::vector<pid_t> tree = processTree(child.pid);
+        for (pid_t pid : tree)
+        {
+            if (!writeFile("/proc/" + std::to_string(pid) + "/oom_score_adj", std::to_string(module.limits.oom_score_adj)) && first && pid == child.pid)
+            {
+                std::cerr << "cgroup: cannot set oom_score_adj " << module.limits.oom_score_adj << " for " << child.name << " (needs CAP_SYS_RESOURCE below 0)." << std::endl;
+            }
+        }
+        if (!m_enabled) return;
+
+        if (module.leaf.empty())
+        {
+            // Two children of the same name (several --execute scripts) get numbered leaves
+            std::string leaf = m_options.root + "/" + leafName(child.name);
+            for (int n = 2; std::find_if(m_modules.begin(), m_modules.end(), [&](const Module &m) { return m.leaf == leaf; }) != m_modules.end(); ++n)
+            {
+                leaf = m_options.root + "/" + leafName(child.name) + "-" + std::to_string(n);
+            }
+            if (mkdir(leaf.c_str(), 0755) == -1 && errno != EEXIST)
+            {
+                std::cerr << "cgroup: cannot create " << leaf << ": " << std::strerror(errno) << std::endl;
+                return;
+            }
+            module.leaf = leaf;
+            const CgroupLimits &l = module.limits;
+            if (l.cpu_pct > 0) writeFile(leaf + "/cpu.max", std::to_string(l.cpu_pct * CGROUP_CPU_PERIOD_US / 100) + " " + std::to_string(CGROUP_CPU_PERIOD_US));
+            if (l.cpu_weight > 0) writeFile(leaf + "/cpu.weight", std::to_string(l.cpu_weight));
+            if (l.mem_high > 0) writeFile(leaf + "/memory.high", std::to_string(l.mem_high));
+            if (l.mem_max > 0) writeFile(leaf + "/memory.max", std::to_string(l.mem_max));
+            writeFile(leaf + "/memory.oom.group", "1"); // an OOM kill takes the whole module, not just one of its processes
+        }
+        int moved = 0;
+        for (pid_t pid : tree)
+        {
+            if (writeFile(module.leaf + "/cgroup.procs", std::to_string(pid))) ++moved;
+        }
+        if (moved == 0)
+        {
+            std::cerr << "cgroup: cannot move " << child.name << " (PID " << child.pid << ") to " << module.leaf << std::endl;
+            return;
+        }
+        std::cout << "cgroup: " << child.name << " (PID " << child.pid << (tree.size() > 1 ? " and " + std::to_string(tree.size() - 1) + " descendant(s)" : "")
+                  << ") in " << module.leaf << std::endl;
+    }
+
+    void readPressure()
+    {
+        m_psi_memory = someAvg10(m_options.psi_root + "/memory");
+        m_psi_cpu = someAvg10(m_options.psi_root + "/cpu");
+        // The capture leaves' own stall shows pressure on the path that matters before the system average does
+        m_psi_capture_memory = m_psi_capture_cpu = 0.0;
+        for (const auto &module : m_modules)
+        {
+            if (module.leaf.empty() || module.limits.priority < CGROUP_CRITICAL_PRIORITY) continue;
+            m_psi_capture_memory = std::max(m_psi_capture_memory, someAvg10(module.leaf + "/memory.pressure"));
+            m_psi_capture_cpu = std::max(m_psi_capture_cpu, someAvg10(module.leaf + "/cpu.pressure"));
+        }
+    }
+
+    void evaluate(std::chrono::steady_clock::time_point now)
+    {
+        const double memory = std::max(m_psi_memory, m_psi_capture_memory);
+        const double cpu = std::max(m_psi_cpu, m_psi_capture_cpu);
+        const bool pressure = memory >= m_options.psi_memory || cpu >= m_options.psi_cpu;
+        const bool relief = memory < m_options.psi_memory / 2 && cpu < m_options.psi_cpu / 2;
+        if (!pressure) m_pressure_since = now;
+        if (!relief) m_relief_since = now;
+
+        if (pressure && now - m_pressure_since >= std::chrono::seconds(m_options.up_sec) && now - m_last_change >= std::chrono::seconds(m_options.up_sec))
+        {
+            // Lowest priority running module that is not shed yet
+            auto &children = m_supervisor.children();
+            int pick = -1;
+            for (size_t i = 0; i < m_modules.size() && i < children.size(); ++i)
+            {
+                const Module &module = m_modules[i];
+                if (children[i].pid <= 0 || module.shed || module.limits.priority >= CGROUP_CRITICAL_PRIORITY) continue;
+                if (pick < 0 || module.limits.priority < m_modules[pick].limits.priority) pick = static_cast<int>(i);
+            }
+            if (pick >= 0)
+            {
+                std::cout << "cgroup: shedding " << children[pick].name << " (memory pressure " << std::fixed << std::setprecision(1) << memory
+                          << "%, cpu " << cpu << "%)" << std::defaultfloat << std::endl;
+                setShed(pick, true);
+                m_supervisor.notify(SupervisorEvent::Shed, children[pick].name, children[pick].pid, static_cast<int32_t>(std::max(memory, cpu) * 10));
+                if (memory >= m_options.psi_memory) reclaim(pick);
+                m_shed_order.push_back(pick);
+                m_last_change = m_pressure_since = now;
+            }
+        }
+        else if (relief && !m_shed_order.empty() && now - m_relief_since >= std::chrono::seconds(m_options.down_sec) &&
+                 now - m_last_change >= std::chrono::seconds(m_options.down_sec))
+        {
+            const size_t i = m_shed_order.back();
+            m_shed_order.pop_back();
+            std::cout << "cgroup: restoring " << m_supervisor.children()[i].name << std::endl;
+            setShed(i, false);
+            m_supervisor.notify(SupervisorEvent::Restore, m_supervisor.children()[i].name, m_supervisor.children()[i].pid, 0);
+            m_last_change = m_relief_since = now;
+        }
+    }
+
+    /**
+     * @brief Freezes or thaws a module: the whole leaf if it has one, else its process.
+     */
+    void setShed(size_t i, bool shed)
+    {
+        Module &module = m_modules[i];
+        SupervisedChild &child = m_supervisor.children()[i];
+        if (shed)
+        {
+            module.frozen_by_cgroup = !module.leaf.empty() && writeFile(module.leaf + "/cgroup.freeze", "1");
+            if (!module.frozen_by_cgroup && child.pid > 0) module.stopped = m_supervisor.pauseTree(child.pid, "cgroup");
+        }
+        else
+        {
+            if (module.frozen_by_cgroup) writeFile(module.leaf + "/cgroup.freeze", "0");
+            m_supervisor.resume(module.stopped, "cgroup");
+            module.stopped.clear();
+            module.frozen_by_cgroup = false;
+        }
+        module.shed = shed;
+    }
+
+    /**
+     * @brief Asks the kernel to reclaim half of a frozen module's memory (memory.reclaim, Linux 5.19+).
+     */
+    void reclaim(size_t i)
+    {
+        const Module &module = m_modules[i];
+        const long long current = memoryCurrent(module, m_supervisor.children()[i]);
+        if (module.leaf.empty() || current <= 0) return;
+        writeFile(module.leaf + "/memory.reclaim", std::to_string(current / 2));
+    }
+
+    static long long memoryCurrent(const Module &module, const SupervisedChild &child)
+    {
+        std::string text;
+        if (!module.leaf.empty() && readFile(module.leaf + "/memory.current", text) && !text.empty()) return std::atoll(text.c_str());
+        return child.rss_kb * 1024LL;
+    }
+
+    static long long eventCount(const Module &module, const std::string &event)
+    {
+        std::string text;
+        if (module.leaf.empty() || !readFile(module.leaf + "/memory.events", text)) return 0;
+        std::istringstream lines(text);
+        std::string key;
+        long long value = 0;
+        while (lines >> key >> value)
+        {
+            if (key == event) return value;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief key=value lines: PSI first, then one "module=" line per child; replaced atomically.
+     */
+    void writeStatus()
+    {
+        writeStatusFile(m_options.status_path, [this](std::ostream &out) {
+            out << std::fixed << std::setprecision(1) << "psi_memory=" << m_psi_memory << "\npsi_cpu=" << m_psi_cpu
+                << "\npsi_capture_memory=" << m_psi_capture_memory << "\npsi_capture_cpu=" << m_psi_capture_cpu
+                << "\nshed=" << m_shed_order.size() << "\n";
+            auto &children = m_supervisor.children();
+            for (size_t i = 0; i < children.size() && i < m_modules.size(); ++i)
+            {
+                const Module &module = m_modules[i];
+                out << "module=" << leafName(children[i].name) << " pid=" << children[i].pid << " prio=" << module.limits.priority
+                    << " state=" << (children[i].pid <= 0 ? "down" : (module.shed ? "shed" : "running"))
+                    << " mem_bytes=" << memoryCurrent(module, children[i]) << " oom_kills=" << eventCount(module, "oom_kill")
+                    << " leaf=" << (module.leaf.empty() ? "-" : module.leaf) << "\n";
+            }
+        });
+    }
+
+    ChildSupervisor &m_supervisor;
+    CgroupOptions m_options;
+    bool m_enabled = false;
+    std::vector<Module> m_modules; // parallel to m_supervisor.children()
+    std::vector<size_t> m_shed_order;
+    double m_psi_memory = 0.0, m_psi_cpu = 0.0, m_psi_capture_memory = 0.0, m_psi_capture_cpu = 0.0;
+    std::chrono::steady_clock::time_point m_last_sample, m_last_report;
+    std::chrono::steady_clock::time_point m_pressure_since, m_relief_since, m_last_change;
+};
+
+#endif // DE_CGROUP_HPP
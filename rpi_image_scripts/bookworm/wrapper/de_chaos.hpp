@@ -0,0 +1,572 @@
+//***************************************************************************** */
+//  Chaos mode: induced faults and the stack's recovery time
+//
+//  With --chaos <faults per minute>, the wrapper injects one fault at a time
+//  into a random supervised child, at random intervals:
+//
+//      kill   SIGKILL, like a segfault or the OOM killer
+//      stop   SIGSTOP of the process tree for --chaos-stop-ms, like a hang
+//      close  SIGUSR2 to the processes writing the child's outputs: a
+//             FrameSink closes its device, ffmpeg dies (de_frame_sink.hpp)
+//      delay  SIGKILL, and the restart is held back --chaos-delay-ms,
+//             like a module that is slow to start
+//
+//  For each fault it measures, from the moment of injection:
+//
+//      detection  until the supervisor reaped the child (a stop is never
+//                 detected: nothing watches for hung children)
+//      recovery   until the child is back (restarted, promoted standby or
+//                 resumed) and, if it writes a ring or a file:, a new frame
+//                 came out of it
+//      frame gap  between the last frame before the fault and the first one
+//                 after it, from the ring timestamps
+//
+//  By default only children that recover in place are targets (Restart
+//  policy, or a warm standby). Naming a camera stack child in
+//  --chaos-targets lets a fault crash the wrapper, which is also reported.
+//
+//***************************************************************************** */
+
+#ifndef DE_CHAOS_HPP
+#define DE_CHAOS_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "de_supervisor.hpp"
+#include "de_shm_ring.hpp"
+#include "de_frame_sink.hpp"
+
+#define CHAOS_START_SEC 10            // no fault before the stack had this long to come up
+#define CHAOS_SETTLE_MS 2000          // quiet time after a fault ended
+#define CHAOS_RECOVERY_TIMEOUT_SEC 60 // a fault not recovered by then is reported as such
+
+enum class ChaosFault
+{
+    Kill = 1,
+    Stop = 2,
+    Close = 3,
+    Delay = 4
+};
+
+inline const char *chaosFaultName(ChaosFault fault)
+{
+    switch (fault)
+    {
+    case ChaosFault::Kill: return "kill";
+    case ChaosFault::Stop: return "stop";
+    case ChaosFault::Close: return "close";
+    case ChaosFault::Delay: return "delay";
+    }
+    return "unknown";
+}
+
+inline bool chaosFaultFromName(const std::string &name, ChaosFault &fault)
+{
+    for (ChaosFault candidate : {ChaosFault::Kill, ChaosFault::Stop, ChaosFault::Close, ChaosFault::Delay})
+    {
+        if (name == chaosFaultName(candidate))
+        {
+            fault = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief What a child writes: rings give the frame timestamps, outputs are closed by close faults.
+ */
+struct ChaosTarget
+{
+    std::string child;                // supervised child name
+    std::vector<std::string> rings;   // shm ring names
+    std::vector<std::string> outputs; // v4l2loopback labels, /dev/videoN or file:<path>
+};
+
+struct ChaosOptions
+{
+    double rate_per_min = 0.0; // mean faults per minute, 0 = off
+    std::set<ChaosFault> faults = {ChaosFault::Kill, ChaosFault::Stop, ChaosFault::Close, ChaosFault::Delay};
+    std::set<std::string> targets; // supervised names; empty = every child that recovers in place
+    int stop_ms = 3000;
+    int delay_ms = 5000;
+    int duration_sec = 0; // stop injecting after this, 0 = until the wrapper stops
+    unsigned seed = 0;    // 0 = from the clock
+    std::string report_path = "/dev/shm/de_chaos_report";
+};
+
+/**
+ * @brief Injects faults from a supervisor tick hook and times the recovery through the event hook.
+ */
+class ChaosMonkey
+{
+public:
+    ChaosMonkey(ChildSupervisor &supervisor, const ChaosOptions &options)
+        : m_supervisor(supervisor), m_options(options), m_random(options.seed ? options.seed : static_cast<unsigned>(shmRingNowNs()))
+    {
+        m_started_ns = shmRingNowNs();
+        m_next_ns = m_started_ns + CHAOS_START_SEC * 1000000000ULL + nextInterval();
+    }
+
+    /**
+     * @brief Declares what a child writes. Children without an entry are still targets,
+     *        but their recovery is only the process coming back.
+     */
+    void addTarget(const ChaosTarget &target)
+    {
+        m_targets[target.child] = target;
+        for (const auto &ring : target.rings)
+        {
+            m_sources.emplace_back();
+            m_sources.back().child = target.child;
+            m_sources.back().ring = ring;
+        }
+        for (const auto &output : target.outputs)
+        {
+            if (output.rfind("file:", 0) != 0) continue;
+            m_sources.emplace_back();
+            m_sources.back().child = target.child;
+            m_sources.back().file = output.substr(5);
+        }
+    }
+
+    /**
+     * @brief Supervisor tick: follows the frames, ends the current fault or injects the next one.
+     */
+    void tick()
+    {
+        const uint64_t now = shmRingNowNs();
+        for (auto &source : m_sources)
+        {
+            if (poll(source, now) && m_active && source.child == m_fault.target && m_fault.back_ns && !m_fault.first_frame_ns)
+            {
+                m_fault.first_frame_ns = source.last_frame_ns;
+                finish("recovered", now);
+            }
+        }
+
+        if (m_active)
+        {
+            if (m_fault.kind == ChaosFault::Stop && !m_fault.stopped.empty() && now >= m_fault.resume_ns)
+            {
+                m_supervisor.resume(m_fault.stopped, "chaos");
+                m_fault.stopped.clear();
+                back(now);
+            }
+            if (m_active && now - m_fault.injected_ns >= CHAOS_RECOVERY_TIMEOUT_SEC * 1000000000ULL)
+            {
+                m_supervisor.resume(m_fault.stopped, "chaos");
+                m_fault.stopped.clear();
+                finish("not-recovered", now);
+            }
+            return;
+        }
+
+        if (m_done || now < m_next_ns) return;
+        if (m_options.duration_sec > 0 && now - m_started_ns >= static_cast<uint64_t>(m_options.duration_sec) * 1000000000ULL)
+        {
+            m_done = true;
+            std::cout << "Chaos: " << m_options.duration_sec << " s done, no more faults." << std::endl;
+            printSummary();
+            return;
+        }
+        inject(now);
+    }
+
+    /**
+     * @brief Supervisor event hook: detection and recovery of the fault in progress.
+     */
+    void onEvent(SupervisorEvent event, const std::string &name, pid_t, int32_t, int64_t)
+    {
+        if (!m_active || name != m_fault.target) return;
+        const uint64_t now = shmRingNowNs();
+        switch (event)
+        {
+        case SupervisorEvent::Exit:
+            if (!m_fault.detected_ns) m_fault.detected_ns = now;
+            break;
+        case SupervisorEvent::Restart:
+            if (m_fault.kind == ChaosFault::Delay)
+            {
+                for (auto &child : m_supervisor.children())
+                {
+                    if (child.name == name && child.restart_pending) child.restart_at += std::chrono::milliseconds(m_options.delay_ms);
+                }
+            }
+            break;
+        case SupervisorEvent::Spawn:
+        case SupervisorEvent::Promote:
+            if (m_fault.detected_ns) back(now);
+            break;
+        case SupervisorEvent::Crash:
+            finish("wrapper-crash", now);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @brief Resumes stopped processes and prints the results. Called before the wrapper stops its children.
+     */
+    void release()
+    {
+        if (m_active)
+        {
+            m_supervisor.resume(m_fault.stopped, "chaos");
+            m_fault.stopped.clear();
+            finish("interrupted", shmRingNowNs());
+        }
+        if (!m_done)
+        {
+            m_done = true;
+            printSummary();
+        }
+    }
+
+private:
+    struct Source
+    {
+        std::string child;
+        std::string ring;
+        std::string file;
+        ShmRingReader reader;
+        ino_t inode = 0;
+        uint64_t seen = 0;
+        off_t size = 0;
+        uint64_t last_frame_ns = 0;
+    };
+
+    struct Fault
+    {
+        int number = 0;
+        ChaosFault kind = ChaosFault::Kill;
+        std::string target;
+        pid_t pid = -1;
+        uint64_t injected_ns = 0;
+        uint64_t detected_ns = 0;
+        uint64_t back_ns = 0;        // the process is back
+        uint64_t recovered_ns = 0;
+        uint64_t last_frame_ns = 0;  // before the fault
+        uint64_t first_frame_ns = 0; // after it
+        uint64_t resume_ns = 0;
+        bool has_frames = false;
+        std::vector<pid_t> stopped;
+        std::string outcome;
+    };
+
+    uint64_t nextInterval()
+    {
+        if (m_options.rate_per_min <= 0) return UINT64_MAX / 2;
+        std::exponential_distribution<double> interval(m_options.rate_per_min / 60.0);
+        return static_cast<uint64_t>(interval(m_random) * 1e9);
+    }
+
+    /**
+     * @return True if source has a frame it did not have at the previous poll.
+     */
+    static bool poll(Source &source, uint64_t now)
+    {
+        struct stat st;
+        if (!source.file.empty())
+        {
+            if (stat(source.file.c_str(), &st) != 0) return false;
+            const bool grew = st.st_size > source.size;
+            source.size = st.st_size;
+            if (grew) source.last_frame_ns = now; // at tick resolution
+            return grew;
+        }
+        // A restarted producer creates a new ring under the same name
+        const ino_t inode = stat(("/dev/shm/" + source.ring).c_str(), &st) == 0 ? st.st_ino : 0;
+        if (inode != source.inode)
+        {
+            source.inode = inode;
+            source.seen = 0;
+            if (!inode || !source.reader.open(source.ring)) source.reader.close();
+        }
+        if (!source.reader.isOpen()) return false;
+        const uint64_t latest = source.reader.latest();
+        if (latest <= source.seen) return false;
+        source.seen = latest;
+        ShmFrameInfo info;
+        const bool stamped = source.reader.peek(latest, info) && info.timestamp_ns && info.timestamp_ns <= now &&
+                             now - info.timestamp_ns < 10000000000ULL;
+        source.last_frame_ns = stamped ? info.timestamp_ns : now;
+        return true;
+    }
+
+    bool eligible(const SupervisedChild &child) const
+    {
+        if (child.pid <= 0 || child.restart_pending || child.replacing || child.chained) return false;
+        if (!m_options.targets.empty()) return m_options.targets.count(child.name) > 0;
+        const bool spare = child.name.size() > 8 && child.name.compare(child.name.size() - 8, 8, " standby") == 0;
+        return !spare && (child.policy == RestartPolicy::Restart || child.takeover);
+    }
+
+    bool applicable(const SupervisedChild &child, ChaosFault kind) const
+    {
+        if (!m_options.faults.count(kind)) return false;
+        if (kind == ChaosFault::Close)
+        {
+            auto target = m_targets.find(child.name);
+            return target != m_targets.end() && !target->second.outputs.empty();
+        }
+        // A held-back restart needs a restart: a standby takes over at once, a camera stack child crashes the wrapper
+        if (kind == ChaosFault::Delay) return child.policy == RestartPolicy::Restart && child.start && !child.takeover;
+        return true;
+    }
+
+    void inject(uint64_t now)
+    {
+        std::vector<std::pair<size_t, ChaosFault>> choices;
+        auto &children = m_supervisor.children();
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (!eligible(children[i])) continue;
+            for (ChaosFault kind : {ChaosFault::Kill, ChaosFault::Stop, ChaosFault::Close, ChaosFault::Delay})
+            {
+                if (applicable(children[i], kind)) choices.push_back({i, kind});
+            }
+        }
+        if (choices.empty())
+        {
+            m_next_ns = now + CHAOS_SETTLE_MS * 1000000ULL; // nothing running yet
+            return;
+        }
+        const auto choice = choices[std::uniform_int_distribution<size_t>(0, choices.size() - 1)(m_random)];
+        const SupervisedChild &child = children[choice.first];
+
+        m_fault = Fault();
+        m_fault.number = static_cast<int>(m_results.size()) + 1;
+        m_fault.kind = choice.second;
+        m_fault.target = child.name;
+        m_fault.pid = child.pid;
+        m_fault.injected_ns = now;
+        for (const auto &source : m_sources)
+        {
+            if (source.child != child.name) continue;
+            m_fault.has_frames = true;
+            m_fault.last_frame_ns = std::max(m_fault.last_frame_ns, source.last_frame_ns);
+        }
+        m_active = true;
+        std::cout << "Chaos: fault #" << m_fault.number << " " << chaosFaultName(m_fault.kind) << " " << child.name << " (PID " << child.pid << ")" << std::endl;
+        m_supervisor.notify(SupervisorEvent::Fault, child.name, child.pid, static_cast<int32_t>(m_fault.kind));
+
+        switch (m_fault.kind)
+        {
+        case ChaosFault::Kill:
+        case ChaosFault::Delay:
+            kill(getpgid(child.pid) == child.pid ? -child.pid : child.pid, SIGKILL);
+            break;
+        case ChaosFault::Stop:
+            m_fault.stopped = m_supervisor.pauseTree(child.pid, "chaos");
+            m_fault.resume_ns = now + static_cast<uint64_t>(m_options.stop_ms) * 1000000ULL;
+            break;
+        case ChaosFault::Close:
+        {
+            const std::vector<pid_t> writers = findWriters(child.pid, m_targets[child.name].outputs);
+            for (pid_t pid : writers) kill(pid, SIGUSR2);
+            if (writers.empty()) finish("no-writer", now);
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief Processes of pid's tree with one of outputs open for writing.
+     */
+    static std::vector<pid_t> findWriters(pid_t pid, const std::vector<std::string> &outputs)
+    {
+        std::set<std::string> paths;
+        for (const auto &output : outputs)
+        {
+            if (output.rfind("file:", 0) == 0) paths.insert(output.substr(5));
+            else paths.insert(output.rfind("/dev/", 0) == 0 ? output : findVideoDeviceByLabel(output));
+        }
+        std::vector<pid_t> writers;
+        for (pid_t member : processTree(pid))
+        {
+            const std::string base = "/proc/" + std::to_string(member);
+            DIR *fds = opendir((base + "/fd").c_str());
+            if (!fds) continue;
+            bool writes = false;
+            while (struct dirent *fd = readdir(fds))
+            {
+                char target[PATH_MAX];
+                const ssize_t n = readlink((base + "/fd/" + fd->d_name).c_str(), target, sizeof(target) - 1);
+                if (n <= 0) continue;
+                target[n] = '\0';
+                char resolved[PATH_MAX];
+                if (!paths.count(target) && !(realpath(target, resolved) && paths.count(resolved))) continue;
+                // "flags:" of fdinfo is octal; O_WRONLY or O_RDWR
+                std::ifstream info(base + "/fdinfo/" + fd->d_name);
+                std::string key;
+                unsigned flags = 0;
+                while (info >> key)
+                {
+                    if (key == "flags:" && info >> std::oct >> flags) break;
+                }
+                writes = writes || (flags & O_ACCMODE) != O_RDONLY;
+            }
+            closedir(fds);
+            if (writes) writers.push_back(member);
+        }
+        return writers;
+    }
+
+    /**
+     * @brief The target is running again; the fault ends now, or with its next frame.
+     */
+    void back(uint64_t now)
+    {
+        if (m_fault.back_ns) return;
+        m_fault.back_ns = now;
+        if (!m_fault.has_frames) finish("recovered", now);
+    }
+
+    void finish(const std::string &outcome, uint64_t now)
+    {
+        if (!m_active) return;
+        m_active = false;
+        m_fault.outcome = outcome;
+        m_fault.recovered_ns = outcome == "recovered" ? now : 0;
+        m_results.push_back(m_fault);
+        const Fault &fault = m_results.back();
+        std::cout << "Chaos: fault #" << fault.number << " " << chaosFaultName(fault.kind) << " " << fault.target << ": " << outcome
+                  << std::fixed << std::setprecision(1);
+        if (fault.detected_ns) std::cout << ", detected in " << ms(fault.injected_ns, fault.detected_ns) << " ms";
+        if (fault.recovered_ns) std::cout << ", recovered in " << ms(fault.injected_ns, fault.recovered_ns) << " ms";
+        if (fault.last_frame_ns && fault.first_frame_ns) std::cout << ", frame gap " << ms(fault.last_frame_ns, fault.first_frame_ns) << " ms";
+        std::cout << std::defaultfloat << std::endl;
+        writeReport();
+        m_next_ns = now + CHAOS_SETTLE_MS * 1000000ULL + nextInterval();
+    }
+
+    static double ms(uint64_t from, uint64_t to) { return to >= from ? (to - from) / 1e6 : 0.0; }
+
+    struct Stats
+    {
+        int faults = 0, recovered = 0, detected = 0;
+        std::vector<double> detect, recover, gap;
+    };
+
+    std::map<std::string, Stats> summarise() const
+    {
+        std::map<std::string, Stats> stats;
+        for (const auto &fault : m_results)
+        {
+            Stats &entry = stats[std::string(chaosFaultName(fault.kind)) + " " + fault.target];
+            ++entry.faults;
+            if (fault.detected_ns)
+            {
+                ++entry.detected;
+                entry.detect.push_back(ms(fault.injected_ns, fault.detected_ns));
+            }
+            if (fault.recovered_ns)
+            {
+                ++entry.recovered;
+                entry.recover.push_back(ms(fault.injected_ns, fault.recovered_ns));
+            }
+            if (fault.last_frame_ns && fault.first_frame_ns) entry.gap.push_back(ms(fault.last_frame_ns, fault.first_frame_ns));
+        }
+        return stats;
+    }
+
+    /**
+     * @brief mean/p95/max of values, "-" if there are none.
+     */
+    static std::string spread(std::vector<double> values)
+    {
+        if (values.empty()) return "-";
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (double value : values) sum += value;
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1) << sum / values.size() << "/" << values[(values.size() * 95 + 99) / 100 - 1] << "/" << values.back();
+        return out.str();
+    }
+
+    static std::string key(std::string name)
+    {
+        std::replace(name.begin(), name.end(), ' ', '-');
+        return name;
+    }
+
+    /**
+     * @brief One summary line per fault kind and target, then one line per fault; replaced atomically.
+     */
+    void writeReport() const
+    {
+        writeStatusFile(m_options.report_path, [&](std::ostream &out) {
+            out << std::fixed << std::setprecision(1);
+            for (const auto &item : summarise())
+            {
+                const Stats &stats = item.second;
+                const size_t space = item.first.find(' ');
+                out << "summary fault=" << item.first.substr(0, space) << " target=" << key(item.first.substr(space + 1)) << " count=" << stats.faults
+                    << " recovered=" << stats.recovered << " detected=" << stats.detected << " detect_ms=" << spread(stats.detect)
+                    << " recover_ms=" << spread(stats.recover) << " gap_ms=" << spread(stats.gap) << "\n";
+            }
+            for (const auto &fault : m_results)
+            {
+                out << "fault n=" << fault.number << " kind=" << chaosFaultName(fault.kind) << " target=" << key(fault.target) << " pid=" << fault.pid
+                    << " at_s=" << ms(m_started_ns, fault.injected_ns) / 1000.0 << " detect_ms=";
+                if (fault.detected_ns) out << ms(fault.injected_ns, fault.detected_ns);
+                else out << "-";
+                out << " recover_ms=";
+                if (fault.recovered_ns) out << ms(fault.injected_ns, fault.recovered_ns);
+                else out << "-";
+                out << " gap_ms=";
+                if (fault.last_frame_ns && fault.first_frame_ns) out << ms(fault.last_frame_ns, fault.first_frame_ns);
+                else out << "-";
+                out << " outcome=" << fault.outcome << "\n";
+            }
+        });
+    }
+
+    void printSummary() const
+    {
+        std::cout << "Chaos: " << m_results.size() << " fault(s); times in ms as mean/p95/max, report in " << m_options.report_path << std::endl;
+        std::cout << "  " << std::left << std::setw(30) << "fault" << std::right << std::setw(6) << "count" << std::setw(10) << "recovered"
+                  << std::setw(20) << "detection" << std::setw(24) << "recovery" << std::setw(24) << "frame gap" << std::endl;
+        for (const auto &item : summarise())
+        {
+            const Stats &stats = item.second;
+            std::cout << "  " << std::left << std::setw(30) << item.first << std::right << std::setw(6) << stats.faults << std::setw(10)
+                      << stats.recovered << std::setw(20) << spread(stats.detect) << std::setw(24) << spread(stats.recover) << std::setw(24)
+                      << spread(stats.gap) << std::endl;
+        }
+    }
+
+    ChildSupervisor &m_supervisor;
+    ChaosOptions m_options;
+    std::mt19937 m_random;
+    std::map<std::string, ChaosTarget> m_targets;
+    std::deque<Source> m_sources;
+    std::vector<Fault> m_results;
+    Fault m_fault;
+    bool m_active = false;
+    bool m_done = false;
+    uint64_t m_started_ns = 0;
+    uint64_t m_next_ns = 0;
+};
+
+#endif // DE_CHAOS_HPP
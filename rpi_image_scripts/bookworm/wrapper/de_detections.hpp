@@ -0,0 +1,261 @@
+//***************************************************************************** */
+//  IMX500 on-sensor detections as a shared-memory channel
+//
+//  With an IMX500 post-process file (e.g. imx500_mobilenet_ssd.json) the
+//  sensor runs the network itself and libcamera returns its output tensor
+//  in every frame's metadata (CnnOutputTensor). Only pixels reached the
+//  loopback device, so de_tracker had to detect again on the CPU. The
+//  wrapper now decodes the tensor from rpicam-vid's metadata stream (see
+//  de_frame_meta.hpp) and publishes one record per frame:
+//
+//      /dev/shm/de_rpi_detections   DetectionFrame + up to DETECTION_MAX Detection
+//
+//  Each record carries the same frame_seq and capture_ns as the frame's
+//  FrameMeta record, and the seq of the frame in the H.264 ring when
+//  --rpi-encoded is used, so detections can be joined with either.
+//
+//***************************************************************************** */
+
+#ifndef DE_DETECTIONS_HPP
+#define DE_DETECTIONS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "de_shm_ring.hpp"
+#include "de_frame_meta.hpp"
+
+#define DETECTION_DEFAULT_RING "de_rpi_detections"
+#define DETECTION_SLOTS 64
+#define DETECTION_MAX 32 // per frame; more are dropped lowest score first
+
+/**
+ * @brief One object. Coordinates are normalised to the network input, 0..1, with
+ *        (0, 0) at the top left; the input covers the sensor's full field of view.
+ */
+struct Detection
+{
+    float x0, y0, x1, y1;
+    float score;
+    uint32_t class_id; // index into the network's label file
+};
+static_assert(sizeof(Detection) == 24, "Detection layout is part of the ring format");
+
+/**
+ * @brief Header of one ring slot, followed by count Detection entries.
+ */
+struct DetectionFrame
+{
+    uint64_t frame_seq;  // FrameMeta::frame_seq of the same frame (de_meta_rpi), counted even without --frame-meta
+    uint64_t data_seq;   // seq of the frame in the H.264 ring, 0 if none
+    uint64_t capture_ns; // CLOCK_MONOTONIC, the same value as FrameMeta::capture_ns
+    uint32_t count;
+    uint32_t tensor_floats; // size of the tensor it was decoded from, for diagnostics
+};
+static_assert(sizeof(DetectionFrame) == 32, "DetectionFrame layout is part of the ring format");
+
+#define DETECTION_SLOT_BYTES (sizeof(DetectionFrame) + DETECTION_MAX * sizeof(Detection))
+
+/**
+ * @brief Settings of the imx500_object_detection stage, read from the post-process file.
+ */
+struct Imx500DetectionOptions
+{
+    float threshold = 0.5f;
+    int max_detections = DETECTION_MAX;
+    bool xy_order = false; // boxes as x0,y0,x1,y1 instead of the SSD order y0,x0,y1,x1
+};
+
+/**
+ * @brief Reads a post-process file.
+ * @return True if it runs an imx500_object_detection stage, i.e. the sensor detects.
+ */
+inline bool imx500ReadPostProcess(const std::string &path, Imx500DetectionOptions &options)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+    const size_t stage = text.find("\"imx500_object_detection\"");
+    if (stage == std::string::npos) return false;
+    const std::string body = text.substr(stage);
+    options.threshold = static_cast<float>(metadataJsonNumber(body, "threshold", options.threshold));
+    options.max_detections = std::max(1, std::min(DETECTION_MAX, static_cast<int>(metadataJsonNumber(body, "max_detections", options.max_detections))));
+    const size_t order = metadataJsonValue(body, "bbox_order");
+    if (order != std::string::npos)
+    {
+        const size_t value = body.find('"', order);
+        options.xy_order = value != std::string::npos && body.compare(value, 4, "\"xy\"") == 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Floats of the JSON array after "key": in a metadata object
+ *        (rpicam-vid writes libcamera float arrays as [ a, b, ... ]).
+ * @return False if the key is not there.
+ */
+inline bool detectionJsonArray(const std::string &object, const char *key, std::vector<float> &out)
+{
+    out.clear();
+    size_t at = metadataJsonValue(object, key);
+    if (at == std::string::npos) return false;
+    at = object.find('[', at);
+    const size_t end = at == std::string::npos ? std::string::npos : object.find(']', at);
+    if (end == std::string::npos) return false;
+    const char *p = object.c_str() + at + 1;
+    const char *stop = object.c_str() + end;
+    while (p < stop)
+    {
+        char *next = nullptr;
+        const float value = std::strtof(p, &next);
+        if (next == p)
+        {
+            ++p; // separator
+            continue;
+        }
+        out.push_back(value);
+        p = next;
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes the output tensor of an SSD-style detection network, the layout of
+ *        the IMX500 object detection models shipped with rpicam-apps:
+ *
+ *            boxes[N][4] | scores[N] | classes[N] | count
+ *
+ *        so the tensor has 6N+1 floats. Tensors of any other size are rejected.
+ */
+class Imx500DetectionDecoder
+{
+public:
+    explicit Imx500DetectionDecoder(const Imx500DetectionOptions &options = Imx500DetectionOptions()) : m_options(options) {}
+
+    /**
+     * @return False if the tensor does not have the expected layout.
+     */
+    bool decode(const std::vector<float> &tensor, std::vector<Detection> &out) const
+    {
+        out.clear();
+        if (tensor.size() < 7 || (tensor.size() - 1) % 6 != 0) return false;
+        const size_t n = (tensor.size() - 1) / 6;
+        const float *boxes = tensor.data();
+        const float *scores = boxes + 4 * n;
+        const float *classes = scores + n;
+        const size_t count = std::min(n, static_cast<size_t>(std::max(0.0f, tensor[6 * n])));
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (scores[i] < m_options.threshold) continue;
+            const float *box = boxes + 4 * i;
+            Detection detection;
+            detection.x0 = clamp01(m_options.xy_order ? box[0] : box[1]);
+            detection.y0 = clamp01(m_options.xy_order ? box[1] : box[0]);
+            detection.x1 = clamp01(m_options.xy_order ? box[2] : box[3]);
+            detection.y1 = clamp01(m_options.xy_order ? box[3] : box[2]);
+            detection.score = scores[i];
+            detection.class_id = static_cast<uint32_t>(std::max(0.0f, classes[i]));
+            out.push_back(detection);
+        }
+        if (out.size() > static_cast<size_t>(m_options.max_detections))
+        {
+            std::partial_sort(out.begin(), out.begin() + m_options.max_detections, out.end(),
+                              [](const Detection &a, const Detection &b) { return a.score > b.score; });
+            out.resize(m_options.max_detections);
+        }
+        return true;
+    }
+
+private:
+    static float clamp01(float value) { return std::max(0.0f, std::min(1.0f, value)); }
+
+    Imx500DetectionOptions m_options;
+};
+
+/**
+ * @brief Producer side of the detections ring.
+ */
+class DetectionWriter
+{
+public:
+    bool create(const std::string &name)
+    {
+        ShmRingFormat format;
+        format.format = SHM_FORMAT_DETS;
+        return m_ring.create(name, DETECTION_SLOTS, DETECTION_SLOT_BYTES, format);
+    }
+
+    bool isOpen() const { return m_ring.isOpen(); }
+
+    void publish(const DetectionFrame &frame, const std::vector<Detection> &detections)
+    {
+        if (!m_ring.isOpen()) return;
+        uint8_t *slot = m_ring.begin();
+        DetectionFrame header = frame;
+        header.count = static_cast<uint32_t>(std::min(detections.size(), static_cast<size_t>(DETECTION_MAX)));
+        std::memcpy(slot, &header, sizeof(header));
+        std::memcpy(slot + sizeof(header), detections.data(), header.count * sizeof(Detection));
+        m_ring.publish(static_cast<uint32_t>(sizeof(header) + header.count * sizeof(Detection)), header.capture_ns);
+    }
+
+private:
+    ShmRingWriter m_ring;
+};
+
+/**
+ * @brief Consumer side: what a tracker uses in place of its own detector.
+ *
+ *        DetectionReader reader;
+ *        reader.open("de_rpi_detections");
+ *        for (uint64_t next = reader.latest() + 1; ; ++next)
+ *        {
+ *            if (!reader.waitFor(next, 1000)) continue;
+ *            DetectionFrame frame; std::vector<Detection> objects;
+ *            if (reader.read(next, frame, objects)) ... objects of frame.frame_seq
+ *        }
+ */
+class DetectionReader
+{
+public:
+    bool open(const std::string &name)
+    {
+        if (!m_ring.open(name)) return false;
+        if (m_ring.info().format != SHM_FORMAT_DETS || m_ring.info().slot_size < sizeof(DetectionFrame))
+        {
+            m_ring.close();
+            return false;
+        }
+        m_buffer.resize(m_ring.info().slot_size);
+        return true;
+    }
+
+    bool isOpen() const { return m_ring.isOpen(); }
+    uint64_t latest() const { return m_ring.isOpen() ? m_ring.latest() : 0; }
+    bool waitFor(uint64_t seq, int timeout_ms) { return m_ring.isOpen() && m_ring.waitFor(seq, timeout_ms); }
+
+    bool read(uint64_t seq, DetectionFrame &frame, std::vector<Detection> &detections)
+    {
+        ShmFrameInfo info;
+        if (!m_ring.isOpen() || !m_ring.read(seq, m_buffer.data(), m_buffer.size(), info) || info.bytes < sizeof(DetectionFrame)) return false;
+        std::memcpy(&frame, m_buffer.data(), sizeof(frame));
+        const size_t count = std::min<size_t>(frame.count, (info.bytes - sizeof(frame)) / sizeof(Detection));
+        detections.resize(count);
+        std::memcpy(detections.data(), m_buffer.data() + sizeof(frame), count * sizeof(Detection));
+        return true;
+    }
+
+private:
+    ShmRingReader m_ring;
+    std::vector<uint8_t> m_buffer;
+};
+
+#endif // DE_DETECTIONS_HPP
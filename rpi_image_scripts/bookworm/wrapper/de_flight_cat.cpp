@@ -0,0 +1,266 @@
+//***************************************************************************** */
+//  Decodes the supervisor flight recorder file (--flight-recorder)
+//
+//      de_flight_cat /home/pi/drone_engage/de_flight.rec
+//      de_flight_cat /home/pi/drone_engage/de_flight.rec --last 50
+//      de_flight_cat /home/pi/drone_engage/de_flight.rec --summary
+//
+//  Without --summary, one line per record, oldest first. --summary prints
+//  one line per wrapper boot (how long it ran and how it ended) and one per
+//  module: starts, failures, failures per hour, restart latency (failure to
+//  next start) and uptime between failures. The file can be read while the
+//  wrapper writes it, or after it was copied off the drone.
+//
+//***************************************************************************** */
+
+// g++ de_flight_cat.cpp -o de_flight_cat -O2
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include "de_flight_recorder.hpp"
+
+static std::string wallTime(uint64_t wall_ns)
+{
+    const time_t seconds = static_cast<time_t>(wall_ns / 1000000000ULL);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03u", static_cast<unsigned>(wall_ns / 1000000ULL % 1000));
+    return std::string(text) + millis;
+}
+
+static std::string duration(double seconds)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (seconds < 120) out << seconds << " s";
+    else if (seconds < 7200) out << seconds / 60 << " min";
+    else out << seconds / 3600 << " h";
+    return out.str();
+}
+
+static void printEntry(const FlightEntry &entry)
+{
+    std::cout << "#" << entry.seq << " boot " << entry.boot << " " << wallTime(entry.wall_ns) << " " << std::left << std::setw(8)
+              << supervisorEventName(entry.event) << std::right << " " << entry.name;
+    if (entry.pid > 0) std::cout << " (PID " << entry.pid << ")";
+    switch (entry.event)
+    {
+    case SupervisorEvent::Boot:
+        std::cout << " version " << entry.value / 10000 << "." << entry.value / 100 % 100 << "." << entry.value % 100;
+        break;
+    case SupervisorEvent::Spawn:
+        if (entry.value > 0) std::cout << " restart #" << entry.value;
+        break;
+    case SupervisorEvent::Exit:
+        std::cout << " " << describeExitStatus(entry.value) << " after " << duration(entry.arg / 1000.0);
+        break;
+    case SupervisorEvent::Crash:
+        std::cout << " " << describeExitStatus(entry.value);
+        break;
+    case SupervisorEvent::Restart:
+        std::cout << " in " << entry.value << " ms";
+        break;
+    case SupervisorEvent::Promote:
+        std::cout << " replaces PID " << entry.value;
+        break;
+    case SupervisorEvent::Stall:
+        std::cout << " " << entry.value << " ms late";
+        break;
+    case SupervisorEvent::Level:
+        std::cout << " " << entry.arg << " -> " << entry.value;
+        break;
+    case SupervisorEvent::Shed:
+        std::cout << " at " << entry.value / 10.0 << "% stall";
+        break;
+    case SupervisorEvent::Shutdown:
+        std::cout << " signal " << entry.value;
+        break;
+    case SupervisorEvent::Fault:
+    {
+        static const char *const kinds[] = {"?", "kill", "stop", "close", "delay"};
+        std::cout << " " << kinds[entry.value >= 1 && entry.value <= 4 ? entry.value : 0];
+        break;
+    }
+    default:
+        break;
+    }
+    std::cout << std::endl;
+}
+
+struct ModuleStats
+{
+    int starts = 0;
+    int failures = 0;     // exits that were not asked for
+    int promotions = 0;
+    int wrapper_crashes = 0;
+    std::vector<double> latency_ms; // failure -> next start
+    std::vector<double> uptime_s;   // start -> failure
+    double last_failure_ns = -1;    // mono time, within the current boot
+    bool expected_exit = false;     // replace / chaos fault pending
+};
+
+static void printSummary(const std::vector<FlightEntry> &entries, uint32_t boots)
+{
+    struct Boot
+    {
+        uint32_t number = 0;
+        uint64_t start_wall = 0, first_mono = 0, last_mono = 0;
+        std::string end;
+        int stalls = 0, max_stall_ms = 0;
+    };
+    std::vector<Boot> boot_list;
+    std::map<std::string, ModuleStats> modules;
+    double total_seconds = 0;
+
+    for (const auto &entry : entries)
+    {
+        if (boot_list.empty() || boot_list.back().number != entry.boot)
+        {
+            for (auto &module : modules)
+            {
+                module.second.last_failure_ns = -1;
+                module.second.expected_exit = false;
+            }
+            Boot boot;
+            boot.number = entry.boot;
+            boot.start_wall = entry.wall_ns;
+            boot.first_mono = entry.mono_ns;
+            boot_list.push_back(boot);
+        }
+        Boot &boot = boot_list.back();
+        boot.last_mono = entry.mono_ns;
+        ModuleStats &module = modules[entry.name];
+        switch (entry.event)
+        {
+        case SupervisorEvent::Spawn:
+            ++module.starts;
+            if (module.last_failure_ns >= 0) module.latency_ms.push_back((entry.mono_ns - module.last_failure_ns) / 1e6);
+            module.last_failure_ns = -1;
+            module.expected_exit = false;
+            break;
+        case SupervisorEvent::Promote:
+            ++module.promotions;
+            if (module.last_failure_ns >= 0) module.latency_ms.push_back((entry.mono_ns - module.last_failure_ns) / 1e6);
+            module.last_failure_ns = -1;
+            break;
+        case SupervisorEvent::Replace:
+            module.expected_exit = true;
+            break;
+        case SupervisorEvent::Fault:
+            module.expected_exit = entry.value != 2; // exits induced by --chaos are in its own report; a stop does not exit
+            break;
+        case SupervisorEvent::Exit:
+            if (module.expected_exit || !boot.end.empty())
+            {
+                module.expected_exit = false;
+                break;
+            }
+            ++module.failures;
+            module.uptime_s.push_back(entry.arg / 1000.0);
+            module.last_failure_ns = static_cast<double>(entry.mono_ns);
+            break;
+        case SupervisorEvent::Crash:
+            ++module.wrapper_crashes;
+            boot.end = "crash: " + entry.name + " " + describeExitStatus(entry.value);
+            break;
+        case SupervisorEvent::Shutdown:
+            boot.end = "shutdown on signal " + std::to_string(entry.value);
+            break;
+        case SupervisorEvent::Stall:
+            ++boot.stalls;
+            boot.max_stall_ms = std::max(boot.max_stall_ms, entry.value);
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::cout << "Boots (" << boot_list.size() << " in the file, " << boots << " recorded):" << std::endl;
+    for (size_t i = 0; i < boot_list.size(); ++i)
+    {
+        const Boot &boot = boot_list[i];
+        const double seconds = (boot.last_mono - boot.first_mono) / 1e9;
+        total_seconds += seconds;
+        std::string end = boot.end;
+        if (end.empty()) end = i + 1 == boot_list.size() ? "running, or stopped without a record" : "no end record: power loss or SIGKILL";
+        std::cout << "  boot " << boot.number << "  " << wallTime(boot.start_wall) << "  ran " << std::setw(9) << duration(seconds) << "  " << end;
+        if (boot.stalls) std::cout << "  (" << boot.stalls << " stall(s), worst " << boot.max_stall_ms << " ms)";
+        std::cout << std::endl;
+    }
+
+    std::cout << "Modules (" << duration(total_seconds) << " recorded):" << std::endl;
+    std::cout << "  " << std::left << std::setw(24) << "module" << std::right << std::setw(7) << "starts" << std::setw(9) << "failures"
+              << std::setw(8) << "per h" << std::setw(10) << "promoted" << std::setw(14) << "restart ms" << std::setw(14) << "max ms"
+              << std::setw(14) << "mean uptime" << std::endl;
+    auto mean = [](const std::vector<double> &values) {
+        double sum = 0;
+        for (double value : values) sum += value;
+        return values.empty() ? 0.0 : sum / values.size();
+    };
+    auto millis = [](const std::vector<double> &values, double value) {
+        if (values.empty()) return std::string("-");
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1) << value;
+        return out.str();
+    };
+    for (const auto &item : modules)
+    {
+        const ModuleStats &module = item.second;
+        if (module.starts == 0 && module.failures == 0) continue; // wrapper, governor, supervisor
+        const double max_latency = module.latency_ms.empty() ? 0.0 : *std::max_element(module.latency_ms.begin(), module.latency_ms.end());
+        std::cout << "  " << std::left << std::setw(24) << item.first << std::right << std::setw(7) << module.starts << std::setw(9)
+                  << module.failures << std::fixed << std::setprecision(2) << std::setw(8)
+                  << (total_seconds > 0 ? module.failures * 3600.0 / total_seconds : 0.0) << std::defaultfloat << std::setw(10) << module.promotions
+                  << std::setw(14) << millis(module.latency_ms, mean(module.latency_ms)) << std::setw(14) << millis(module.latency_ms, max_latency)
+                  << std::setw(14) << (module.uptime_s.empty() ? std::string("-") : duration(mean(module.uptime_s)));
+        if (module.wrapper_crashes) std::cout << "  crashed the wrapper " << module.wrapper_crashes << "x";
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path;
+    bool summary = false, help = false;
+    size_t last = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--summary") summary = true;
+        else if (arg == "--last" && i + 1 < argc) last = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "-h" || arg == "--help") help = true;
+        else path = arg;
+    }
+    if (path.empty() || help)
+    {
+        std::cerr << "Usage: " << argv[0] << " <recorder file> [--last n] [--summary]" << std::endl;
+        std::cerr << "  Prints the records of a --flight-recorder file; --summary, the boots and per-module failures and restart latency." << std::endl;
+        return help ? 0 : 1;
+    }
+
+    std::vector<FlightEntry> entries;
+    uint32_t boots = 0;
+    if (!readFlightRecords(path, entries, &boots))
+    {
+        std::cerr << path << " is not a flight recorder file." << std::endl;
+        return 1;
+    }
+    if (summary)
+    {
+        printSummary(entries, boots);
+        return 0;
+    }
+    const size_t first = last > 0 && entries.size() > last ? entries.size() - last : 0;
+    for (size_t i = first; i < entries.size(); ++i) printEntry(entries[i]);
+    return 0;
+}
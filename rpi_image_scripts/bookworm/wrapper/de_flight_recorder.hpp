@@ -0,0 +1,292 @@
+//***************************************************************************** */
+//  Supervisor flight recorder
+//
+//  When the wrapper crashed, the only evidence left was what journald kept.
+//  With --flight-recorder <file>, every supervisor event (spawns, exits,
+//  restarts, promotions, stalls, governor levels, PSI shedding, crashes) is
+//  also written as a 64-byte record into a ring file that is memory-mapped
+//  MAP_SHARED:
+//
+//      header (64 bytes) | record[capacity]
+//
+//  The file is kept across wrapper restarts and reboots; each start appends
+//  a Boot record. A write takes a slot with one atomic add and guards it
+//  with a seqlock word like the frame rings (2*seq-1 while writing, 2*seq
+//  once complete), so it never blocks and can run from the signal handler.
+//  The pages are flushed with msync every --flight-recorder-sync seconds,
+//  and at once on a crash or shutdown. After a power loss, at most that
+//  many seconds are lost, and torn records are skipped by the reader.
+//
+//  de_flight_cat decodes the file and summarises it per module and per boot.
+//
+//***************************************************************************** */
+
+#ifndef DE_FLIGHT_RECORDER_HPP
+#define DE_FLIGHT_RECORDER_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "de_supervisor.hpp"
+
+#define FLIGHT_RECORDER_MAGIC "DEFLIGHT"
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_DEFAULT_RECORDS 16384 // 1 MB
+#define FLIGHT_RECORDER_NAME_LEN 24
+
+struct FlightRecorderHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    std::atomic<uint32_t> boots;   // wrapper starts since the file was created
+    std::atomic<uint64_t> head;    // last seq taken; may lag the records after a power loss
+    uint64_t created_ns;           // CLOCK_REALTIME
+    uint64_t reserved[3];
+};
+static_assert(sizeof(FlightRecorderHeader) == 64, "FlightRecorderHeader layout is part of the file format");
+
+struct FlightRecord
+{
+    std::atomic<uint64_t> lock; // seqlock: 2*seq-1 while writing record seq, 2*seq when complete
+    uint64_t wall_ns;           // CLOCK_REALTIME, comparable across boots
+    uint64_t mono_ns;           // CLOCK_MONOTONIC, for durations within one boot
+    uint16_t boot;              // FlightRecorderHeader::boots when it was written, modulo 65536
+    uint16_t event;             // SupervisorEvent
+    int32_t pid;
+    int32_t value;              // see SupervisorEvent
+    int32_t arg;                // see SupervisorEvent; durations in ms saturate at about 24 days
+    char name[FLIGHT_RECORDER_NAME_LEN]; // child name, truncated, not always terminated
+};
+static_assert(sizeof(FlightRecord) == 64, "FlightRecord layout is part of the file format");
+
+/**
+ * @brief A decoded record.
+ */
+struct FlightEntry
+{
+    uint64_t seq = 0;
+    uint64_t wall_ns = 0;
+    uint64_t mono_ns = 0;
+    uint32_t boot = 0; // modulo 65536
+    SupervisorEvent event = SupervisorEvent::Boot;
+    pid_t pid = 0;
+    int32_t value = 0;
+    int64_t arg = 0;
+    std::string name;
+};
+
+inline uint64_t flightClockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Writer side, owned by the wrapper.
+ */
+class FlightRecorder
+{
+public:
+    ~FlightRecorder() { close(); }
+
+    /**
+     * @brief Maps path, creating it with capacity records if it is missing or not a
+     *        recorder file. An existing file keeps its own capacity.
+     */
+    bool open(const std::string &path, uint32_t capacity = FLIGHT_RECORDER_DEFAULT_RECORDS, int sync_sec = 5)
+    {
+        close();
+        m_sync_sec = sync_sec;
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd == -1)
+        {
+            perror(("open " + path).c_str());
+            return false;
+        }
+        struct stat st;
+        FlightRecorderHeader existing;
+        bool valid = fstat(m_fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(existing) &&
+                     pread(m_fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing)) &&
+                     std::memcmp(existing.magic, FLIGHT_RECORDER_MAGIC, 8) == 0 && existing.version == FLIGHT_RECORDER_VERSION &&
+                     existing.record_size == sizeof(FlightRecord) && existing.capacity > 0 &&
+                     static_cast<size_t>(st.st_size) == sizeof(existing) + static_cast<size_t>(existing.capacity) * sizeof(FlightRecord);
+        const uint32_t records = valid ? existing.capacity : std::max<uint32_t>(capacity, 64);
+        m_size = sizeof(FlightRecorderHeader) + static_cast<size_t>(records) * sizeof(FlightRecord);
+        if (!valid && (ftruncate(m_fd, 0) == -1 || ftruncate(m_fd, m_size) == -1))
+        {
+            perror(("ftruncate " + path).c_str());
+            close();
+            return false;
+        }
+        void *map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED)
+        {
+            perror(("mmap " + path).c_str());
+            m_map = nullptr;
+            close();
+            return false;
+        }
+        m_map = static_cast<uint8_t *>(map);
+        m_header = reinterpret_cast<FlightRecorderHeader *>(m_map);
+        m_records = reinterpret_cast<FlightRecord *>(m_map + sizeof(FlightRecorderHeader));
+        if (!valid)
+        {
+            // A fresh file reads as zeros: no records
+            std::memcpy(m_header->magic, FLIGHT_RECORDER_MAGIC, 8);
+            m_header->version = FLIGHT_RECORDER_VERSION;
+            m_header->record_size = sizeof(FlightRecord);
+            m_header->capacity = records;
+            m_header->created_ns = flightClockNs(CLOCK_REALTIME);
+        }
+        else
+        {
+            // The header page may have reached the disk before the last records did
+            uint64_t newest = m_header->head.load();
+            for (uint32_t i = 0; i < records; ++i) newest = std::max(newest, m_records[i].lock.load(std::memory_order_relaxed) / 2);
+            m_header->head.store(newest);
+        }
+        m_boot = m_header->boots.fetch_add(1) + 1;
+        m_last_sync = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    bool isOpen() const { return m_header != nullptr; }
+    uint32_t capacity() const { return m_header ? m_header->capacity : 0; }
+    uint32_t boot() const { return m_boot; }
+
+    void close()
+    {
+        if (m_map)
+        {
+            msync(m_map, m_size, MS_SYNC);
+            munmap(m_map, m_size);
+        }
+        if (m_fd != -1) ::close(m_fd);
+        m_map = nullptr;
+        m_header = nullptr;
+        m_records = nullptr;
+        m_fd = -1;
+    }
+
+    /**
+     * @brief Appends one record. Lock-free and safe from any thread, forked child or signal handler.
+     */
+    void record(SupervisorEvent event, const std::string &name, pid_t pid, int32_t value, int64_t arg = 0)
+    {
+        if (!m_header) return;
+        const uint64_t seq = m_header->head.fetch_add(1, std::memory_order_acq_rel) + 1;
+        FlightRecord &record = m_records[(seq - 1) % m_header->capacity];
+        record.lock.store(2 * seq - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        record.wall_ns = flightClockNs(CLOCK_REALTIME);
+        record.mono_ns = flightClockNs(CLOCK_MONOTONIC);
+        record.boot = static_cast<uint16_t>(m_boot);
+        record.event = static_cast<uint16_t>(event);
+        record.pid = pid;
+        record.value = value;
+        record.arg = static_cast<int32_t>(std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, arg)));
+        std::memset(record.name, 0, sizeof(record.name));
+        std::memcpy(record.name, name.data(), std::min(name.size(), sizeof(record.name)));
+        record.lock.store(2 * seq, std::memory_order_release);
+        m_written.store(seq, std::memory_order_relaxed);
+        if (event == SupervisorEvent::Crash || event == SupervisorEvent::Shutdown) sync();
+    }
+
+    /**
+     * @brief Supervisor tick: flushes the new records every sync interval.
+     */
+    void tick()
+    {
+        if (!m_header || m_sync_sec <= 0 || m_written.load(std::memory_order_relaxed) == m_synced) return;
+        if (std::chrono::steady_clock::now() - m_last_sync < std::chrono::seconds(m_sync_sec)) return;
+        sync();
+    }
+
+    void sync()
+    {
+        if (!m_map) return;
+        m_synced = m_written.load(std::memory_order_relaxed);
+        m_last_sync = std::chrono::steady_clock::now();
+        msync(m_map, m_size, MS_SYNC); // only the dirty pages are written
+    }
+
+private:
+    int m_fd = -1;
+    uint8_t *m_map = nullptr;
+    size_t m_size = 0;
+    FlightRecorderHeader *m_header = nullptr;
+    FlightRecord *m_records = nullptr;
+    uint32_t m_boot = 0;
+    int m_sync_sec = 5;
+    std::atomic<uint64_t> m_written{0};
+    uint64_t m_synced = 0;
+    std::chrono::steady_clock::time_point m_last_sync;
+};
+
+/**
+ * @brief Reads every complete record of a recorder file, oldest first. Works on a
+ *        file the wrapper is writing and on one copied off a crashed drone.
+ * @return False if path is not a recorder file.
+ */
+inline bool readFlightRecords(const std::string &path, std::vector<FlightEntry> &entries, uint32_t *boots = nullptr)
+{
+    entries.clear();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FlightRecorderHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+    const auto *header = static_cast<const FlightRecorderHeader *>(map);
+    const bool valid = std::memcmp(header->magic, FLIGHT_RECORDER_MAGIC, 8) == 0 && header->version == FLIGHT_RECORDER_VERSION &&
+                       header->record_size == sizeof(FlightRecord) &&
+                       static_cast<size_t>(st.st_size) >= sizeof(FlightRecorderHeader) + static_cast<size_t>(header->capacity) * sizeof(FlightRecord);
+    if (valid)
+    {
+        if (boots) *boots = header->boots.load();
+        const auto *records = reinterpret_cast<const FlightRecord *>(static_cast<const uint8_t *>(map) + sizeof(FlightRecorderHeader));
+        for (uint32_t i = 0; i < header->capacity; ++i)
+        {
+            const FlightRecord &record = records[i];
+            const uint64_t before = record.lock.load(std::memory_order_acquire);
+            if (before == 0 || before % 2 != 0) continue; // empty, or being (or torn while) written
+            FlightEntry entry;
+            entry.seq = before / 2;
+            entry.wall_ns = record.wall_ns;
+            entry.mono_ns = record.mono_ns;
+            entry.boot = record.boot;
+            entry.event = static_cast<SupervisorEvent>(record.event);
+            entry.pid = record.pid;
+            entry.value = record.value;
+            entry.arg = record.arg;
+            entry.name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (record.lock.load(std::memory_order_relaxed) != before) continue; // overwritten while copied
+            entries.push_back(entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const FlightEntry &a, const FlightEntry &b) { return a.seq < b.seq; });
+    }
+    munmap(map, st.st_size);
+    return valid;
+}
+
+#endif // DE_FLIGHT_RECORDER_HPP
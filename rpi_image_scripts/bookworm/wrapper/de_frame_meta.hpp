@@ -0,0 +1,418 @@
+//***************************************************************************** */
+//  Per-frame metadata side channel shared by all capture pipelines
+//
+//  DE-RPI, DE-GIMBAL and DE-THERMAL reach their consumers through
+//  v4l2loopback with no common clock. With --frame-meta every capture stage
+//  also publishes one FrameMeta record per frame to its own ring:
+//
+//      /dev/shm/de_meta_rpi       rpicam-vid --metadata (sensor timestamp, exposure, gains)
+//      /dev/shm/de_meta_gimbal    RTP timestamp mapped to the local clock
+//      /dev/shm/de_meta_thermal   time the frame was read from the sensor driver
+//
+//  All capture times are CLOCK_MONOTONIC nanoseconds, so records of
+//  different cameras can be compared directly. FrameMetaSync finds, for a
+//  given time, the nearest frame of each channel within a tolerance; that
+//  is how thermal and visual frames (or detections) are paired.
+//
+//***************************************************************************** */
+
+#ifndef DE_FRAME_META_HPP
+#define DE_FRAME_META_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+
+#include "de_shm_ring.hpp"
+
+#define FRAME_META_SLOTS 256 // about 8 s at 30 fps
+#define RPICAM_METADATA_MAX_OBJECT (1024 * 1024) // output tensors of large networks included
+
+// FrameMeta::source_id
+#define FRAME_SOURCE_RPI 1
+#define FRAME_SOURCE_GIMBAL 2
+#define FRAME_SOURCE_THERMAL 3
+
+// FrameMeta::flags
+#define FRAME_META_SENSOR_TIME 0x1    // capture_ns is the sensor's start of exposure
+#define FRAME_META_ESTIMATED_TIME 0x2 // capture_ns derived from a remote media clock (RTP)
+#define FRAME_META_KEYFRAME 0x4
+#define FRAME_META_DISCONTINUITY 0x8  // frames were lost or the source restarted before this one
+
+/**
+ * @brief One frame of one camera. 64 bytes, one per ring slot.
+ */
+struct FrameMeta
+{
+    uint32_t source_id;          // FRAME_SOURCE_*
+    uint32_t flags;              // FRAME_META_*
+    uint64_t frame_seq;          // frame counter of this source, from 1
+    uint64_t data_seq;           // seq of the same frame in the source's data ring, 0 if none
+    uint64_t capture_ns;         // CLOCK_MONOTONIC at capture
+    int64_t pts;                 // 90 kHz media clock of encoded streams, 0 if none
+    uint32_t exposure_us;        // 0 = unknown
+    float analogue_gain;         // 0 = unknown
+    float digital_gain;
+    uint32_t frame_duration_us;
+    uint32_t colour_temperature; // K, 0 = unknown
+    float lux;
+};
+static_assert(sizeof(FrameMeta) == 64, "FrameMeta is one cache line");
+
+inline const char *frameSourceName(uint32_t source_id)
+{
+    switch (source_id)
+    {
+    case FRAME_SOURCE_RPI: return "rpi";
+    case FRAME_SOURCE_GIMBAL: return "gimbal";
+    case FRAME_SOURCE_THERMAL: return "thermal";
+    default: return "unknown";
+    }
+}
+
+/**
+ * @brief Producer side: a stage's metadata ring.
+ */
+class FrameMetaWriter
+{
+public:
+    bool create(const std::string &name, uint32_t source_id)
+    {
+        ShmRingFormat format;
+        format.format = SHM_FORMAT_META;
+        m_source_id = source_id;
+        m_frames = 0;
+        return m_ring.create(name, FRAME_META_SLOTS, sizeof(FrameMeta), format);
+    }
+
+    bool isOpen() const { return m_ring.isOpen(); }
+    void close() { m_ring.close(); }
+
+    /**
+     * @brief Fills in source_id and frame_seq and publishes the record. Frames are
+     *        counted even without a ring, so other channels can use the same numbers.
+     * @return The record's frame_seq.
+     */
+    uint64_t publish(FrameMeta meta)
+    {
+        meta.source_id = m_source_id;
+        meta.frame_seq = ++m_frames;
+        if (!m_ring.isOpen()) return meta.frame_seq;
+        m_ring.write(&meta, sizeof(meta), meta.capture_ns, (meta.flags & FRAME_META_KEYFRAME) ? SHM_SLOT_KEYFRAME : 0, meta.pts);
+        return meta.frame_seq;
+    }
+
+private:
+    ShmRingWriter m_ring;
+    uint32_t m_source_id = 0;
+    uint64_t m_frames = 0;
+};
+
+/**
+ * @brief Consumer side of one metadata ring.
+ */
+class FrameMetaReader
+{
+public:
+    bool open(const std::string &name)
+    {
+        m_name = name;
+        m_inode = inode();
+        if (!m_ring.open(name)) return false;
+        if (m_ring.info().format != SHM_FORMAT_META || m_ring.info().slot_size < sizeof(FrameMeta))
+        {
+            m_ring.close();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const { return m_ring.isOpen(); }
+    const std::string &name() const { return m_name; }
+    uint64_t latest() const { return m_ring.isOpen() ? m_ring.latest() : 0; }
+
+    bool read(uint64_t seq, FrameMeta &meta) const
+    {
+        ShmFrameInfo info;
+        return m_ring.isOpen() && m_ring.read(seq, &meta, sizeof(meta), info) && info.bytes == sizeof(meta);
+    }
+
+    /**
+     * @brief Reopens the ring if its producer restarted (the file was replaced) or it was not there yet.
+     */
+    void refresh()
+    {
+        if (m_name.empty()) return;
+        if (!m_ring.isOpen() || inode() != m_inode) open(m_name);
+    }
+
+    /**
+     * @brief Record with capture_ns closest to ns, if it is within tolerance_ns.
+     *        Binary search over the records still in the ring (capture times only grow).
+     */
+    bool nearest(uint64_t ns, uint64_t tolerance_ns, FrameMeta &out) const
+    {
+        const uint64_t newest = latest();
+        if (newest == 0) return false;
+        const uint64_t slots = m_ring.info().slot_count;
+        // Leave a margin at the old end: those slots may be overwritten while we search
+        uint64_t lo = newest > slots - 2 ? newest - (slots - 2) : 1, hi = newest;
+        FrameMeta meta;
+        while (lo < hi)
+        {
+            const uint64_t mid = lo + (hi - lo) / 2;
+            if (!read(mid, meta))
+            {
+                lo = mid + 1; // overwritten meanwhile: only newer records are left
+                continue;
+            }
+            if (meta.capture_ns < ns) lo = mid + 1;
+            else hi = mid;
+        }
+        // lo is the first record at or after ns (or the newest); its predecessor may be closer
+        bool found = false;
+        uint64_t best = 0;
+        for (uint64_t seq = lo > 1 ? lo - 1 : lo; seq <= lo; ++seq)
+        {
+            if (!read(seq, meta)) continue;
+            const uint64_t distance = meta.capture_ns > ns ? meta.capture_ns - ns : ns - meta.capture_ns;
+            if (distance <= tolerance_ns && (!found || distance < best))
+            {
+                out = meta;
+                best = distance;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+private:
+    ino_t inode() const
+    {
+        struct stat st;
+        return stat(("/dev/shm/" + m_name).c_str(), &st) == 0 ? st.st_ino : 0;
+    }
+
+    ShmRingReader m_ring;
+    std::string m_name;
+    ino_t m_inode = 0;
+};
+
+/**
+ * @brief Result of FrameMetaSync::match() for one channel.
+ */
+struct FrameMetaMatch
+{
+    bool found = false;
+    FrameMeta meta;
+    int64_t offset_ns = 0; // meta.capture_ns - requested time
+};
+
+/**
+ * @brief Nearest frames across several channels for one point in time.
+ *
+ *        FrameMetaSync sync({"de_meta_rpi", "de_meta_thermal"});
+ *        FrameMeta visual;
+ *        if (sync.reader(0).read(sync.reader(0).latest(), visual))
+ *        {
+ *            std::vector<FrameMetaMatch> match = sync.match(visual.capture_ns, 50000000); // 50 ms
+ *            if (match[1].found) ... match[1].meta.data_seq is the thermal frame to pair with
+ *        }
+ */
+class FrameMetaSync
+{
+public:
+    explicit FrameMetaSync(const std::vector<std::string> &rings)
+    {
+        m_readers.resize(rings.size());
+        for (size_t i = 0; i < rings.size(); ++i) m_readers[i].open(rings[i]);
+    }
+
+    size_t size() const { return m_readers.size(); }
+    FrameMetaReader &reader(size_t i) { return m_readers[i]; }
+
+    /**
+     * @brief One entry per channel, in the order the rings were given.
+     */
+    std::vector<FrameMetaMatch> match(uint64_t ns, uint64_t tolerance_ns)
+    {
+        std::vector<FrameMetaMatch> result(m_readers.size());
+        for (size_t i = 0; i < m_readers.size(); ++i)
+        {
+            m_readers[i].refresh();
+            FrameMetaMatch &entry = result[i];
+            entry.found = m_readers[i].nearest(ns, tolerance_ns, entry.meta);
+            if (entry.found) entry.offset_ns = static_cast<int64_t>(entry.meta.capture_ns) - static_cast<int64_t>(ns);
+        }
+        return result;
+    }
+
+private:
+    std::vector<FrameMetaReader> m_readers;
+};
+
+/**
+ * @brief CLOCK_BOOTTIME minus CLOCK_MONOTONIC (time spent suspended). libcamera's
+ *        SensorTimestamp is on CLOCK_BOOTTIME.
+ */
+inline int64_t frameMetaBoottimeOffsetNs()
+{
+    struct timespec boot, mono;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    return (static_cast<int64_t>(boot.tv_sec) - mono.tv_sec) * 1000000000ll + (boot.tv_nsec - mono.tv_nsec);
+}
+
+/**
+ * @brief Offset just past the ':' after the first "key" in JSON text, or npos. A text
+ *        search, not a parse: the keys read with it occur once per object.
+ */
+inline size_t metadataJsonValue(const std::string &text, const char *key)
+{
+    const std::string quoted = std::string("\"") + key + "\"";
+    size_t at = text.find(quoted);
+    if (at == std::string::npos) return std::string::npos;
+    at = text.find(':', at + quoted.size());
+    return at == std::string::npos ? std::string::npos : at + 1;
+}
+
+/**
+ * @brief Number after the first "key": in JSON text, or def if missing.
+ */
+inline double metadataJsonNumber(const std::string &text, const char *key, double def)
+{
+    const size_t at = metadataJsonValue(text, key);
+    if (at == std::string::npos) return def;
+    const char *start = text.c_str() + at;
+    char *end = nullptr;
+    const double value = std::strtod(start, &end);
+    return end == start ? def : value;
+}
+
+/**
+ * @brief Splits rpicam-vid's "--metadata-format json" output (a JSON array of one
+ *        object per frame) into FrameMeta records. Only the fields FrameMeta keeps
+ *        are read; the object's text is passed on for the rest (e.g. the IMX500
+ *        output tensor, see de_detections.hpp).
+ */
+class RpicamMetadataParser
+{
+public:
+    typedef std::function<void(const FrameMeta &, const std::string &object)> Callback;
+
+    explicit RpicamMetadataParser(Callback callback) : m_callback(callback) {}
+
+    void feed(const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            const char c = data[i];
+            if (m_in_string)
+            {
+                if (m_depth > 0) m_object += c;
+                if (m_escape) m_escape = false;
+                else if (c == '\\') m_escape = true;
+                else if (c == '"') m_in_string = false;
+                continue;
+            }
+            if (c == '"') m_in_string = true;
+            if (c == '{') ++m_depth;
+            if (m_depth > 0) m_object += c;
+            if (c == '}' && m_depth > 0 && --m_depth == 0)
+            {
+                parseObject();
+                m_object.clear();
+            }
+            if (m_object.size() > RPICAM_METADATA_MAX_OBJECT) // not rpicam metadata; resynchronise
+            {
+                m_object.clear();
+                m_depth = 0;
+            }
+        }
+    }
+
+private:
+    /**
+     * @brief Number after the first "key": in the object, or def if missing. The
+     *        fields read here only occur once per frame.
+     */
+    double number(const char *key, double def) const
+    {
+        return metadataJsonNumber(m_object, key, def);
+    }
+
+    void parseObject()
+    {
+        FrameMeta meta;
+        std::memset(&meta, 0, sizeof(meta));
+        const double sensor_ns = number("SensorTimestamp", -1.0);
+        if (sensor_ns > 0)
+        {
+            meta.capture_ns = static_cast<uint64_t>(static_cast<int64_t>(sensor_ns) - frameMetaBoottimeOffsetNs());
+            meta.flags |= FRAME_META_SENSOR_TIME;
+        }
+        else
+        {
+            meta.capture_ns = shmRingNowNs();
+        }
+        meta.exposure_us = static_cast<uint32_t>(number("ExposureTime", 0));
+        meta.analogue_gain = static_cast<float>(number("AnalogueGain", 0));
+        meta.digital_gain = static_cast<float>(number("DigitalGain", 0));
+        meta.frame_duration_us = static_cast<uint32_t>(number("FrameDuration", 0));
+        meta.colour_temperature = static_cast<uint32_t>(number("ColourTemperature", 0));
+        meta.lux = static_cast<float>(number("Lux", 0));
+        m_callback(meta, m_object);
+    }
+
+    Callback m_callback;
+    std::string m_object;
+    int m_depth = 0;
+    bool m_in_string = false;
+    bool m_escape = false;
+};
+
+/**
+ * @brief Maps a remote 90 kHz media clock (RTP) onto CLOCK_MONOTONIC. The offset is
+ *        the smallest arrival - pts seen, i.e. the packet that was delayed least;
+ *        it is re-learned every window so clock drift does not accumulate.
+ */
+class MediaClockMapper
+{
+public:
+    uint64_t map(int64_t pts, uint64_t arrival_ns)
+    {
+        const int64_t pts_ns = pts * 100000 / 9;
+        const int64_t offset = static_cast<int64_t>(arrival_ns) - pts_ns;
+        if (!m_valid || arrival_ns - m_window_start >= MEDIA_CLOCK_WINDOW_NS)
+        {
+            // Start a new window from the best offset of the last one
+            if (m_valid && m_window_valid) m_offset = m_window_min;
+            else m_offset = offset;
+            m_window_start = arrival_ns;
+            m_window_valid = false;
+            m_valid = true;
+        }
+        if (!m_window_valid || offset < m_window_min) m_window_min = offset;
+        m_window_valid = true;
+        if (offset < m_offset) m_offset = offset;
+        return static_cast<uint64_t>(pts_ns + m_offset);
+    }
+
+    void reset() { m_valid = false; }
+
+private:
+    static constexpr uint64_t MEDIA_CLOCK_WINDOW_NS = 10000000000ull;
+    bool m_valid = false, m_window_valid = false;
+    int64_t m_offset = 0, m_window_min = 0;
+    uint64_t m_window_start = 0;
+};
+
+#endif // DE_FRAME_META_HPP
@@ -0,0 +1,186 @@
+//***************************************************************************** */
+//  Frame output to a v4l2loopback virtual camera
+//
+//  Native replacement for the "ffmpeg ... -f v4l2 /dev/videoN" tail of the
+//  camera scripts. The target is resolved the same way the scripts do it,
+//  by the card label in /sys/devices/virtual/video4linux/video*/name, so a
+//  pipeline can be pointed at "DE-THERMAL" instead of a device number.
+//
+//  Targets:
+//      DE-THERMAL        v4l2loopback device with this label
+//      /dev/video5       explicit device
+//      file:/tmp/out.yuv raw frames appended to a file (testing without v4l2loopback)
+//
+//  SIGUSR2 to a process that writes through a FrameSink closes the output,
+//  as if the device had gone away: the next write fails and the pipeline
+//  exits. The chaos mode (de_chaos.hpp) uses it; an external writer such
+//  as ffmpeg is terminated by the same signal.
+//
+//***************************************************************************** */
+
+#ifndef DE_FRAME_SINK_HPP
+#define DE_FRAME_SINK_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#define V4L2_SYSFS_DIR "/sys/devices/virtual/video4linux"
+#define FRAME_SINK_FINISH_MS 1000 // longest wait for the rest of a frame that was partly written
+
+static volatile sig_atomic_t g_frame_sink_close = 0; // set by SIGUSR2
+
+/**
+ * @brief Finds the /dev/videoN of the v4l2loopback device with the given card label.
+ * @return The device path, or an empty string if no device has this label.
+ */
+inline std::string findVideoDeviceByLabel(const std::string &label)
+{
+    DIR *dir = opendir(V4L2_SYSFS_DIR);
+    if (!dir) return "";
+    std::string device;
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (std::strncmp(entry->d_name, "video", 5) != 0) continue;
+        const std::string base = std::string(V4L2_SYSFS_DIR "/") + entry->d_name;
+        std::ifstream name_file(base + "/name");
+        std::string name;
+        if (!std::getline(name_file, name))
+        {
+            std::ifstream card_file(base + "/card"); // older kernels
+            std::getline(card_file, name);
+        }
+        // ignore leading/trailing whitespace like the scripts do
+        const size_t first = name.find_first_not_of(" \t\r\n");
+        const size_t last = name.find_last_not_of(" \t\r\n");
+        if (first == std::string::npos || name.substr(first, last - first + 1) != label) continue;
+        device = std::string("/dev/") + entry->d_name;
+        break;
+    }
+    closedir(dir);
+    return device;
+}
+
+/**
+ * @brief Writes fixed-size frames to a v4l2loopback output device or a file.
+ */
+class FrameSink
+{
+public:
+    ~FrameSink() { close(); }
+
+    /**
+     * @brief Opens target (label, /dev/videoN or file:path) for width x height frames
+     *        of the V4L2 pixel format pixel_format.
+     */
+    bool open(const std::string &target, uint32_t width, uint32_t height, uint32_t pixel_format, uint32_t frame_bytes)
+    {
+        close();
+        m_frame_bytes = frame_bytes;
+        g_frame_sink_close = 0;
+        signal(SIGUSR2, [](int) { g_frame_sink_close = 1; });
+        if (target.rfind("file:", 0) == 0)
+        {
+            m_path = target.substr(5);
+            m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (m_fd == -1)
+            {
+                perror(("open " + m_path).c_str());
+                return false;
+            }
+            return true;
+        }
+
+        m_path = target.rfind("/dev/", 0) == 0 ? target : findVideoDeviceByLabel(target);
+        if (m_path.empty())
+        {
+            std::cerr << "Virtual camera '" << target << "' not found. Is v4l2loopback loaded with this card_label?" << std::endl;
+            return false;
+        }
+        m_fd = ::open(m_path.c_str(), O_WRONLY | O_NONBLOCK); // a full buffer drops the frame, see write()
+        if (m_fd == -1)
+        {
+            perror(("open " + m_path).c_str());
+            return false;
+        }
+
+        struct v4l2_format fmt;
+        std::memset(&fmt, 0, sizeof(fmt));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        fmt.fmt.pix.width = width;
+        fmt.fmt.pix.height = height;
+        fmt.fmt.pix.pixelformat = pixel_format;
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+        fmt.fmt.pix.bytesperline = pixel_format == V4L2_PIX_FMT_YUV420 ? width : 0;
+        fmt.fmt.pix.sizeimage = frame_bytes;
+        fmt.fmt.pix.colorspace = V4L2_COLORSPACE_SMPTE170M;
+        if (ioctl(m_fd, VIDIOC_S_FMT, &fmt) == -1)
+        {
+            perror(("VIDIOC_S_FMT " + m_path).c_str());
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (m_fd != -1) ::close(m_fd);
+        m_fd = -1;
+    }
+
+    const std::string &path() const { return m_path; }
+
+    /**
+     * @brief Writes one frame. A full loopback buffer (EAGAIN) drops the frame instead of blocking;
+     *        a frame that was partly written is finished, waiting up to FRAME_SINK_FINISH_MS.
+     */
+    bool write(const uint8_t *frame)
+    {
+        if (g_frame_sink_close)
+        {
+            close();
+            std::cerr << "write " << m_path << ": output closed (SIGUSR2)" << std::endl;
+            return false;
+        }
+        size_t done = 0;
+        while (done < m_frame_bytes)
+        {
+            const ssize_t n = ::write(m_fd, frame + done, m_frame_bytes - done);
+            if (n > 0)
+            {
+                done += n;
+                continue;
+            }
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && errno == EAGAIN)
+            {
+                if (done == 0) return true; // dropped whole
+                struct pollfd pfd = {m_fd, POLLOUT, 0};
+                const int ready = poll(&pfd, 1, FRAME_SINK_FINISH_MS);
+                if (ready > 0 || (ready == -1 && errno == EINTR)) continue;
+                std::cerr << "write " << m_path << ": frame not finished within " << FRAME_SINK_FINISH_MS << " ms" << std::endl;
+                return false;
+            }
+            perror(("write " + m_path).c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string m_path;
+    int m_fd = -1;
+    uint32_t m_frame_bytes = 0;
+};
+
+#endif // DE_FRAME_SINK_HPP
@@ -0,0 +1,296 @@
+//***************************************************************************** */
+//  Native low-latency gimbal RTSP ingest
+//
+//  Replaces sh_camera_run_gimbal_camera.sh ("ffmpeg -rtsp_transport tcp -i
+//  rtsp://... -f v4l2") when --gimbal-native is given. ffmpeg's default
+//  probing and demuxer buffering cost hundreds of milliseconds, and every
+//  link drop ended the script and crashed the wrapper. Here:
+//
+//      RtspSession --RTP--> RtpJitterBuffer --> H264Depacketizer --AU--> H264DecoderPipe --> DE-GIMBAL
+//                                                                    \--> shm ring (optional H.264 passthrough)
+//
+//  - The codec and SPS/PPS come from the SDP, so nothing is probed. The
+//    decoder runs with -probesize 32 -analyzeduration 0 -fflags nobuffer.
+//  - UDP packets wait in the jitter buffer for at most --gimbal-jitter-ms.
+//    TCP packets are never held.
+//  - Link loss or a stalled stream is handled in-process: reconnect with
+//    backoff (250 ms doubling to 5 s). The decoder and the loopback device stay
+//    open meanwhile, so consumers only see a pause.
+//
+//***************************************************************************** */
+
+#ifndef DE_GIMBAL_HPP
+#define DE_GIMBAL_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <csignal>
+
+#include "de_rtsp.hpp"
+#include "de_h264.hpp"
+#include "de_shm_ring.hpp"
+#include "de_frame_meta.hpp"
+#include "de_frame_sink.hpp"
+
+#define GIMBAL_DEFAULT_URL "rtsp://192.168.2.119:554/live/viewpro"
+#define GIMBAL_DEFAULT_DECODER H264_DEFAULT_DECODER
+#define GIMBAL_RECONNECT_MIN_MS 250
+#define GIMBAL_RECONNECT_MAX_MS 5000
+#define GIMBAL_STABLE_SEC 10          // a session that lasted this long resets the backoff
+#define GIMBAL_AU_SLOTS 16
+#define GIMBAL_AU_SLOT_BYTES (1024 * 1024)
+
+struct GimbalIngestOptions
+{
+    std::string url = GIMBAL_DEFAULT_URL;
+    bool tcp = true;
+    int jitter_ms = 30;                          // UDP reorder window
+    int timeout_ms = 2000;                       // connect/reply timeout; also the stall limit while playing
+    std::string output = "DE-GIMBAL";            // label, /dev/videoN or file:<path>; {output} in the decoder command
+    std::string decoder = GIMBAL_DEFAULT_DECODER; // empty = no decoding (passthrough only)
+    std::string passthrough;                     // shm ring name for H.264 access units, empty = off
+    std::string meta_ring;                       // FrameMeta ring (de_frame_meta.hpp), empty = off
+    int stats_sec = 30;
+};
+
+static volatile sig_atomic_t g_gimbal_stop = 0;
+
+/**
+ * @brief The ingest loop. Runs in its own process (see spawnFunction()).
+ */
+class GimbalIngest
+{
+public:
+    explicit GimbalIngest(const GimbalIngestOptions &options)
+        : m_options(options),
+          m_depacketizer([this](const std::vector<uint8_t> &au, bool key, uint32_t rtp_timestamp) { onAccessUnit(au, key, rtp_timestamp); })
+    {
+    }
+
+    /**
+     * @return Process exit code: 0 after SIGTERM, 1 on a configuration error.
+     */
+    int run()
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = [](int) { g_gimbal_stop = 1; };
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        RtspUrl url;
+        if (!url.parse(m_options.url))
+        {
+            std::cerr << "Gimbal: invalid RTSP URL " << m_options.url << std::endl;
+            return 1;
+        }
+        if (m_options.decoder.empty() && m_options.passthrough.empty())
+        {
+            std::cerr << "Gimbal: nothing to do without a decoder or a passthrough ring" << std::endl;
+            return 1;
+        }
+        if (!m_options.passthrough.empty())
+        {
+            ShmRingFormat format;
+            format.format = SHM_FORMAT_H264;
+            if (!m_ring.create(m_options.passthrough, GIMBAL_AU_SLOTS, GIMBAL_AU_SLOT_BYTES, format)) return 1;
+        }
+        if (!m_options.meta_ring.empty() && !m_meta.create(m_options.meta_ring, FRAME_SOURCE_GIMBAL)) return 1;
+        if (!m_options.decoder.empty())
+        {
+            std::string output = m_options.output;
+            if (output.rfind("file:", 0) == 0) output = output.substr(5);
+            else if (output.rfind("/dev/", 0) != 0) output = findVideoDeviceByLabel(output);
+            if (output.empty())
+            {
+                std::cerr << "Gimbal: virtual camera '" << m_options.output << "' not found. Is v4l2loopback loaded with this card_label?" << std::endl;
+                return 1;
+            }
+            std::string command = m_options.decoder;
+            const size_t placeholder = command.find("{output}");
+            if (placeholder != std::string::npos) command.replace(placeholder, 8, output);
+            if (!m_decoder.start(command)) return 1;
+        }
+
+        std::cout << "Gimbal ingest: " << url.url << " over " << (m_options.tcp ? "TCP" : "UDP")
+                  << (m_options.passthrough.empty() ? "" : ", H.264 passthrough ring /dev/shm/" + m_options.passthrough) << std::endl;
+
+        int backoff_ms = 0;
+        m_window_start = std::chrono::steady_clock::now();
+        while (!g_gimbal_stop)
+        {
+            if (backoff_ms > 0) sleepInterruptible(backoff_ms);
+            if (g_gimbal_stop) break;
+
+            const auto attempt = std::chrono::steady_clock::now();
+            std::string error;
+            RtspSession session;
+            if (!session.open(url, m_options.tcp, m_options.timeout_ms, error))
+            {
+                backoff_ms = backoff_ms == 0 ? GIMBAL_RECONNECT_MIN_MS : std::min(backoff_ms * 2, GIMBAL_RECONNECT_MAX_MS);
+                std::cerr << "Gimbal: " << error << "; retrying in " << backoff_ms << " ms" << std::endl;
+                continue;
+            }
+            if (m_sessions++ > 0) ++m_reconnects;
+            m_depacketizer.setParameterSets(session.video().parameter_sets);
+            std::cout << "Gimbal: playing (payload " << session.video().payload_type << ", "
+                      << session.video().parameter_sets.size() << " parameter set(s) from SDP) after "
+                      << elapsedMs(attempt) << " ms" << std::endl;
+            m_connected_at = std::chrono::steady_clock::now();
+            m_first_au_logged = false;
+            m_discontinuity = true;
+            m_clock.reset(); // a new session may start a new RTP clock
+
+            stream(session);
+            session.close();
+
+            const bool stable = std::chrono::steady_clock::now() - m_connected_at >= std::chrono::seconds(GIMBAL_STABLE_SEC);
+            backoff_ms = stable ? GIMBAL_RECONNECT_MIN_MS : std::min(std::max(backoff_ms * 2, GIMBAL_RECONNECT_MIN_MS), GIMBAL_RECONNECT_MAX_MS);
+            if (!g_gimbal_stop) std::cerr << "Gimbal: reconnecting in " << backoff_ms << " ms" << std::endl;
+        }
+        m_decoder.stop();
+        printStats();
+        return 0;
+    }
+
+private:
+    void stream(RtspSession &session)
+    {
+        RtpJitterBuffer jitter(m_options.tcp ? 0 : m_options.jitter_ms);
+        std::vector<uint8_t> packet;
+        auto last_data = std::chrono::steady_clock::now();
+        while (!g_gimbal_stop)
+        {
+            const int gap_wait = jitter.waitMs();
+            const int wait = gap_wait >= 0 ? std::min(gap_wait, 100) : 100;
+            const int got = session.readRtp(packet, wait);
+            const auto now = std::chrono::steady_clock::now();
+            if (got < 0)
+            {
+                std::cerr << "Gimbal: connection lost" << std::endl;
+                break;
+            }
+            if (got > 0)
+            {
+                last_data = now;
+                m_bytes += packet.size();
+                jitter.push(packet);
+            }
+            else if (now - last_data > std::chrono::milliseconds(m_options.timeout_ms))
+            {
+                std::cerr << "Gimbal: no RTP for " << m_options.timeout_ms << " ms" << std::endl;
+                break;
+            }
+
+            bool lost_before = false;
+            while (jitter.pop(packet, lost_before))
+            {
+                if (lost_before) m_discontinuity = true;
+                m_depacketizer.push(packet.data(), packet.size(), lost_before);
+            }
+
+            if (m_options.stats_sec > 0 && now - m_window_start >= std::chrono::seconds(m_options.stats_sec))
+            {
+                m_lost += jitter.lost() - m_window_lost_base;
+                m_window_lost_base = jitter.lost();
+                printStats();
+            }
+        }
+        m_lost += jitter.lost() - m_window_lost_base;
+        m_window_lost_base = 0;
+    }
+
+    void onAccessUnit(const std::vector<uint8_t> &au, bool key, uint32_t rtp_timestamp)
+    {
+        // Unwrapped 32-bit RTP clock (90 kHz) as the slot pts
+        m_pts = m_have_pts ? m_pts + static_cast<int32_t>(rtp_timestamp - m_last_rtp_timestamp) : rtp_timestamp;
+        m_last_rtp_timestamp = rtp_timestamp;
+        m_have_pts = true;
+        ++m_aus;
+        if (key) ++m_keyframes;
+        if (!m_first_au_logged && key)
+        {
+            m_first_au_logged = true;
+            std::cout << "Gimbal: first keyframe " << elapsedMs(m_connected_at) << " ms after PLAY" << std::endl;
+        }
+        if (!m_options.decoder.empty()) m_decoder.push(au, key);
+        const uint64_t arrival_ns = shmRingNowNs();
+        const bool discontinuity = m_discontinuity;
+        uint64_t seq = 0;
+        if (m_ring.isOpen())
+        {
+            if (au.size() > m_ring.slotSize())
+            {
+                ++m_oversized;
+                m_discontinuity = true;
+            }
+            else
+            {
+                seq = m_ring.write(au.data(), au.size(), arrival_ns, (key ? SHM_SLOT_KEYFRAME : 0) | (m_discontinuity ? SHM_SLOT_DISCONTINUITY : 0), m_pts);
+                m_discontinuity = false;
+            }
+        }
+        if (m_meta.isOpen())
+        {
+            FrameMeta meta;
+            std::memset(&meta, 0, sizeof(meta));
+            meta.capture_ns = m_clock.map(m_pts, arrival_ns);
+            meta.flags = FRAME_META_ESTIMATED_TIME | (key ? FRAME_META_KEYFRAME : 0) | (discontinuity ? FRAME_META_DISCONTINUITY : 0);
+            meta.data_seq = seq;
+            meta.pts = m_pts;
+            m_meta.publish(meta);
+            if (!m_ring.isOpen()) m_discontinuity = false;
+        }
+    }
+
+    void printStats()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::max(1e-3, std::chrono::duration<double>(now - m_window_start).count());
+        std::cout << "Gimbal: " << std::fixed << std::setprecision(1) << (m_aus - m_window_aus) / seconds << " fps, "
+                  << (m_bytes - m_window_bytes) * 8 / seconds / 1000.0 << " kbit/s, " << m_keyframes << " keyframes, "
+                  << m_lost << " packets lost, " << m_reconnects << " reconnects, decoder dropped " << m_decoder.dropped()
+                  << (m_oversized ? ", " + std::to_string(m_oversized) + " AUs too large for the ring" : "") << std::defaultfloat << std::endl;
+        m_window_start = now;
+        m_window_aus = m_aus;
+        m_window_bytes = m_bytes;
+    }
+
+    static long elapsedMs(std::chrono::steady_clock::time_point since)
+    {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count());
+    }
+
+    static void sleepInterruptible(int ms)
+    {
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (!g_gimbal_stop && std::chrono::steady_clock::now() < until)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    GimbalIngestOptions m_options;
+    H264Depacketizer m_depacketizer;
+    H264DecoderPipe m_decoder;
+    ShmRingWriter m_ring;
+    FrameMetaWriter m_meta;
+    MediaClockMapper m_clock;
+    std::chrono::steady_clock::time_point m_connected_at;
+    std::chrono::steady_clock::time_point m_window_start;
+    bool m_first_au_logged = false;
+    bool m_discontinuity = true;
+    bool m_have_pts = false;
+    uint32_t m_last_rtp_timestamp = 0;
+    int64_t m_pts = 0;
+    uint64_t m_sessions = 0, m_reconnects = 0;
+    uint64_t m_aus = 0, m_keyframes = 0, m_bytes = 0, m_lost = 0, m_oversized = 0;
+    uint64_t m_window_aus = 0, m_window_bytes = 0, m_window_lost_base = 0;
+};
+
+#endif // DE_GIMBAL_HPP
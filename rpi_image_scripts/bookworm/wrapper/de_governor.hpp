@@ -0,0 +1,330 @@
+//***************************************************************************** */
+//  Thermal- and power-aware load governor
+//
+//  When the SoC gets hot (or the firmware throttles, or the battery runs
+//  low) every module slows down at once, the capture pipeline included.
+//  The governor runs as a tick hook of the wrapper's ChildSupervisor and
+//  sheds the least important work first, one level at a time:
+//
+//      0 normal
+//      1 ai-reduced       AI modules are asked to process 50 % of their frames
+//      2 capture-reduced  + the camera pipeline is restarted at the reduced
+//                           resolution and frame rate (with the modules
+//                           reading DE-RPI, see restartCapture), AI at 25 %
+//      3 scripts-paused   + --execute scripts are stopped (SIGSTOP)
+//
+//  The AI rate is an opt-in module contract: a module that declares
+//  "ai_rate_support": true in its config reads ai_rate_pct from the
+//  governor's status file while it runs (and DE_AI_RATE_PCT at start-up).
+//  The governor never restarts or stops a module for it, so level 1 costs
+//  no model reload; it sheds nothing if no module declares it.
+//
+//  A level is entered after the pressure lasted the "up" hold time and left
+//  after it has been gone for the "down" hold time (--governor-hold), with
+//  separate hot and cool temperatures, so the stack does not oscillate
+//  around a threshold.
+//
+//  All inputs are read below --governor-sysfs-root (default "/"), so the
+//  governor can be driven by fake files in a test directory.
+//
+//***************************************************************************** */
+
+#ifndef DE_GOVERNOR_HPP
+#define DE_GOVERNOR_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <csignal>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "de_supervisor.hpp"
+#include "de_adaptive.hpp"
+
+#define GOVERNOR_LEVELS 4
+#define GOVERNOR_AI_RATE_ENV "DE_AI_RATE_PCT"            // the rate at a module's start, unset = all frames
+#define GOVERNOR_AI_RATE_CONFIG_KEY "ai_rate_support" // "ai_rate_support": true in the module's config
+
+// get_throttled bits that mean "right now" (the 0x10000+ bits are "has happened since boot")
+#define GOVERNOR_THROTTLED_UNDERVOLT 0x1
+#define GOVERNOR_THROTTLED_CAPPED 0x2
+#define GOVERNOR_THROTTLED_THROTTLED 0x4
+#define GOVERNOR_THROTTLED_SOFT_LIMIT 0x8
+#define GOVERNOR_THROTTLED_NOW 0xf
+
+static const char *const GOVERNOR_LEVEL_NAMES[GOVERNOR_LEVELS] = {"normal", "ai-reduced", "capture-reduced", "scripts-paused"};
+
+struct GovernorOptions
+{
+    std::string sysfs_root = "/";
+    std::string thermal_zone = "sys/class/thermal/thermal_zone0/temp";         // millidegrees C
+    std::string throttled = "sys/devices/platform/soc/soc:firmware/get_throttled"; // hex bit field, Pi firmware
+    std::string power_supply = "sys/class/power_supply";                        // scanned for a Battery
+    std::string battery_file;                 // optional: plain percentage written by another process (absolute path)
+    double hot_c = 75.0;                      // pressure at or above
+    double cool_c = 68.0;                     // relief below
+    int battery_low_pct = 20;                 // pressure at or below while discharging
+    int up_sec = 5;                           // pressure must last this long to shed one more level
+    int down_sec = 30;                        // relief must last this long to restore one level
+    int max_level = GOVERNOR_LEVELS - 1;
+    std::string reduced_size = "1280x720";    // capture at level >= 2
+    std::string capture_output = "DE-RPI";     // the pipeline's virtual camera, see restartCapture
+    int reduced_fps = 10;
+    std::string status_path = "/dev/shm/de_governor";
+    std::vector<std::string> ai_modules;      // supervised modules declaring GOVERNOR_AI_RATE_CONFIG_KEY
+};
+
+/**
+ * @brief One reading of the inputs.
+ */
+struct GovernorSample
+{
+    double temp_c = -1000.0; // -1000 = no sensor
+    unsigned long throttled = 0;
+    int battery_pct = -1;    // -1 = no battery input
+    bool discharging = false;
+};
+
+/**
+ * @brief Decides the level and applies it to the supervised children.
+ */
+class Governor
+{
+public:
+    Governor(ChildSupervisor &supervisor, const GovernorOptions &options) : m_supervisor(supervisor), m_options(options)
+    {
+        if (m_options.sysfs_root.empty() || m_options.sysfs_root.back() != '/') m_options.sysfs_root += "/";
+        m_options.max_level = std::max(0, std::min(m_options.max_level, GOVERNOR_LEVELS - 1));
+        m_pressure_since = m_relief_since = m_last_change = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Supervisor tick: reads inputs once per second.
+     */
+    void tick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_sample >= std::chrono::seconds(1))
+        {
+            m_last_sample = now;
+            m_sample = read();
+            evaluate(now);
+        }
+    }
+
+    int level() const { return m_level; }
+
+    /**
+     * @brief Resumes everything the governor stopped. Called before the wrapper
+     *        stops its children, since a stopped process would not act on SIGTERM.
+     */
+    void release() { m_supervisor.resumeAll("governor"); }
+
+    /**
+     * @brief Reads the inputs below the sysfs root.
+     */
+    GovernorSample read() const
+    {
+        GovernorSample sample;
+        std::string text;
+        if (readFile(m_options.sysfs_root + m_options.thermal_zone, text)) sample.temp_c = std::atof(text.c_str()) / 1000.0;
+        if (readFile(m_options.sysfs_root + m_options.throttled, text)) sample.throttled = std::strtoul(text.c_str(), nullptr, 16);
+
+        if (!m_options.battery_file.empty())
+        {
+            if (readFile(m_options.battery_file, text))
+            {
+                sample.battery_pct = std::atoi(text.c_str());
+                sample.discharging = true; // an external gauge only reports flight batteries
+            }
+            return sample;
+        }
+        const std::string dir_path = m_options.sysfs_root + m_options.power_supply;
+        DIR *dir = opendir(dir_path.c_str());
+        if (!dir) return sample;
+        while (struct dirent *entry = readdir(dir))
+        {
+            if (entry->d_name[0] == '.') continue;
+            const std::string supply = dir_path + "/" + entry->d_name;
+            if (!readFile(supply + "/type", text) || text != "Battery") continue;
+            if (readFile(supply + "/capacity", text)) sample.battery_pct = std::atoi(text.c_str());
+            if (readFile(supply + "/status", text)) sample.discharging = text == "Discharging";
+            break;
+        }
+        closedir(dir);
+        return sample;
+    }
+
+private:
+    static bool readFile(const std::string &path, std::string &text)
+    {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::getline(in, text);
+        while (!text.empty() && (text.back() == '\n' || text.back() == ' ' || text.back() == '\r')) text.pop_back();
+        return !text.empty();
+    }
+
+    /**
+     * @brief Hysteresis: "pressure" and "relief" are not complements; between cool_c
+     *        and hot_c neither holds and the level stays where it is.
+     */
+    void evaluate(std::chrono::steady_clock::time_point now)
+    {
+        const GovernorSample &s = m_sample;
+        const bool battery_low = s.battery_pct >= 0 && s.discharging && s.battery_pct <= m_options.battery_low_pct;
+        const bool battery_ok = s.battery_pct < 0 || !s.discharging || s.battery_pct > m_options.battery_low_pct + 5;
+        std::string reason;
+        if (s.temp_c >= m_options.hot_c) reason = "temperature";
+        else if (s.throttled & GOVERNOR_THROTTLED_NOW) reason = "firmware throttling";
+        else if (battery_low) reason = "battery";
+        const bool pressure = !reason.empty();
+        const bool relief = !pressure && s.temp_c < m_options.cool_c && battery_ok;
+
+        if (!pressure) m_pressure_since = now;
+        if (!relief) m_relief_since = now;
+
+        // Each step restarts both timers, so levels are taken one at a time
+        if (pressure && m_level < m_options.max_level && now - m_pressure_since >= std::chrono::seconds(m_options.up_sec) &&
+            now - m_last_change >= std::chrono::seconds(m_options.up_sec))
+        {
+            setLevel(m_level + 1, reason, now);
+        }
+        else if (relief && m_level > 0 && now - m_relief_since >= std::chrono::seconds(m_options.down_sec) &&
+                 now - m_last_change >= std::chrono::seconds(m_options.down_sec))
+        {
+            setLevel(m_level - 1, "headroom", now);
+        }
+        writeStatus();
+    }
+
+    void setLevel(int level, const std::string &reason, std::chrono::steady_clock::time_point now)
+    {
+        const int previous = m_level;
+        m_level = level;
+        m_last_change = m_pressure_since = m_relief_since = now;
+        std::cout << "Governor: level " << level << " (" << GOVERNOR_LEVEL_NAMES[level] << ") on " << reason
+                  << ", SoC " << std::fixed << std::setprecision(1) << m_sample.temp_c << " C, throttled 0x" << std::hex
+                  << m_sample.throttled << std::dec << std::defaultfloat
+                  << (m_sample.battery_pct >= 0 ? ", battery " + std::to_string(m_sample.battery_pct) + "%" : "") << std::endl;
+        m_supervisor.notify(SupervisorEvent::Level, "governor", getpid(), level, previous);
+
+        if (aiRate(previous) != aiRate(level)) applyAiRate(aiRate(level));
+        // Capture resolution changes at the level 1/2 boundary
+        if ((previous < 2) != (level < 2)) applyCapture(level >= 2);
+        // Scripts at the level 2/3 boundary
+        if ((previous < 3) != (level < 3)) applyScripts(level >= 3);
+    }
+
+    /**
+     * @brief DE_VIDEO_WIDTH x DE_VIDEO_HEIGHT as set; "x" for the script's defaults.
+     */
+    static std::string captureSize()
+    {
+        const char *width = getenv("DE_VIDEO_WIDTH");
+        const char *height = getenv("DE_VIDEO_HEIGHT");
+        return std::string(width ? width : "") + "x" + (height ? height : "");
+    }
+
+    void applyCapture(bool reduced)
+    {
+        static const char *const variables[] = {"DE_VIDEO_WIDTH", "DE_VIDEO_HEIGHT", "DE_VIDEO_FRAMERATE", "DE_VIDEO_MODE"};
+        const std::string size_before = captureSize();
+        unsigned width = 0, height = 0;
+        if (reduced && std::sscanf(m_options.reduced_size.c_str(), "%ux%u", &width, &height) == 2)
+        {
+            // Whatever was set before (--adapt-capture's mode) comes back with the full level
+            m_saved_capture.clear();
+            for (const char *variable : variables)
+            {
+                const char *value = getenv(variable);
+                m_saved_capture.push_back(value ? value : "");
+            }
+            // Read by sh_camera_run_rpi_camera.sh; inherited by the relaunched pipeline
+            setenv("DE_VIDEO_WIDTH", std::to_string(width).c_str(), 1);
+            setenv("DE_VIDEO_HEIGHT", std::to_string(height).c_str(), 1);
+            setenv("DE_VIDEO_FRAMERATE", std::to_string(m_options.reduced_fps).c_str(), 1);
+            unsetenv("DE_VIDEO_MODE"); // a sensor mode planned for the full size would be read out for nothing
+        }
+        else
+        {
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (i < m_saved_capture.size() && !m_saved_capture[i].empty()) setenv(variables[i], m_saved_capture[i].c_str(), 1);
+                else unsetenv(variables[i]);
+            }
+        }
+        if (restartCapture(m_supervisor, "camera pipeline", m_options.capture_output, captureSize() != size_before))
+        {
+            std::cout << "Governor: restarting camera pipeline at " << (reduced ? m_options.reduced_size + "@" + std::to_string(m_options.reduced_fps) : "its previous mode") << std::endl;
+        }
+    }
+
+    void applyScripts(bool paused)
+    {
+        for (auto &child : m_supervisor.children())
+        {
+            if (child.name != "script" || child.pid <= 0) continue;
+            setStopped(child.pid, paused);
+            std::cout << "Governor: " << (paused ? "paused" : "resumed") << " script (PID " << child.pid << ")" << std::endl;
+        }
+    }
+
+    static int aiRate(int level) { return level == 0 ? 100 : (level == 1 ? 50 : 25); }
+
+    /**
+     * @brief Publishes the rate in the status file for the modules that declared they follow
+     *        it, and in the environment for every module started from now on.
+     */
+    void applyAiRate(int rate)
+    {
+        m_ai_rate = rate;
+        if (rate >= 100) unsetenv(GOVERNOR_AI_RATE_ENV);
+        else setenv(GOVERNOR_AI_RATE_ENV, std::to_string(rate).c_str(), 1);
+        if (m_options.ai_modules.empty())
+        {
+            std::cout << "Governor: no module declares " GOVERNOR_AI_RATE_CONFIG_KEY "; the AI rate of " << rate << " % sheds nothing" << std::endl;
+            return;
+        }
+        std::cout << "Governor: AI rate " << rate << " % for";
+        for (const auto &module : m_options.ai_modules) std::cout << " " << module;
+        std::cout << std::endl;
+    }
+
+    void setStopped(pid_t pid, bool stopped)
+    {
+        if (stopped) m_supervisor.pause(pid, "governor");
+        else m_supervisor.resume(pid, "governor");
+    }
+
+    /**
+     * @brief key=value lines for modules and scripts; replaced atomically.
+     */
+    void writeStatus() const
+    {
+        writeStatusFile(m_options.status_path, [this](std::ostream &out) {
+            out << "level=" << m_level << "\nname=" << GOVERNOR_LEVEL_NAMES[m_level] << "\ntemp_c=" << std::fixed << std::setprecision(1)
+                << m_sample.temp_c << "\nthrottled=0x" << std::hex << m_sample.throttled << std::dec << "\nbattery_pct=" << m_sample.battery_pct
+                << "\nai_rate_pct=" << m_ai_rate << "\n";
+        });
+    }
+
+    ChildSupervisor &m_supervisor;
+    GovernorOptions m_options;
+    GovernorSample m_sample;
+    int m_level = 0;
+    int m_ai_rate = 100;
+    std::vector<std::string> m_saved_capture; // DE_VIDEO_* before the capture-reduced level
+    std::chrono::steady_clock::time_point m_last_sample;
+    std::chrono::steady_clock::time_point m_pressure_since, m_relief_since, m_last_change;
+};
+
+#endif // DE_GOVERNOR_HPP
@@ -0,0 +1,480 @@
+//***************************************************************************** */
+//  H.264 helpers for the wrapper's native video stages
+//
+//  - H264Depacketizer: RTP payloads (RFC 6184 single NAL, STAP-A, FU-A) to
+//    Annex-B access units, with SPS/PPS put in front of every IDR so a
+//    consumer can start decoding at any keyframe.
+//  - H264AnnexBSplitter: an Annex-B byte stream (rpicam-vid --codec h264)
+//    cut into access units. The last NAL of a frame has no following start
+//    code, so a frame is also closed once the stream has been idle for a
+//    moment; with one write per frame from the encoder that costs no frame
+//    of latency.
+//  - H264DecoderPipe: a persistent decoder child (ffmpeg by default) fed
+//    access units through its stdin by a writer thread. It outlives
+//    reconnects of the source, so the v4l2loopback output is never closed,
+//    and it drops to the next keyframe instead of blocking the ingest when
+//    it falls behind.
+//
+//***************************************************************************** */
+
+#ifndef DE_H264_HPP
+#define DE_H264_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR 5
+#define H264_NAL_SEI 6
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H264_NAL_AUD 9
+#define H264_NAL_STAP_A 24
+#define H264_NAL_FU_A 28
+
+// Low-latency decode of an Annex-B stream on stdin to a v4l2loopback device ({output})
+#define H264_DEFAULT_DECODER "ffmpeg -hide_banner -loglevel warning -probesize 32 -analyzeduration 0 -fflags nobuffer -flags low_delay -f h264 -i pipe:0 -pix_fmt yuv420p -f v4l2 {output}"
+// The same through the V4L2 memory-to-memory decoder (bcm2835-codec on a Pi 4; the Pi 5 has no H.264 decoder block)
+#define H264_V4L2M2M_DECODER "ffmpeg -hide_banner -loglevel warning -probesize 32 -analyzeduration 0 -fflags nobuffer -flags low_delay -c:v h264_v4l2m2m -f h264 -i pipe:0 -pix_fmt yuv420p -f v4l2 {output}"
+#define H264_DECODER_QUEUE 8 // access units waiting for the decoder before dropping to the next keyframe
+
+static const uint8_t H264_START_CODE[4] = {0, 0, 0, 1};
+
+/**
+ * @brief RTP payload to Annex-B access unit reassembly.
+ */
+class H264Depacketizer
+{
+public:
+    /** @brief au is Annex-B; key if it holds an IDR slice; rtp_timestamp of its packets. */
+    typedef std::function<void(const std::vector<uint8_t> &au, bool key, uint32_t rtp_timestamp)> AccessUnitCallback;
+
+    explicit H264Depacketizer(AccessUnitCallback callback) : m_callback(callback) {}
+
+    /**
+     * @brief Sets SPS/PPS known out of band (SDP sprop-parameter-sets). In-band ones replace them.
+     */
+    void setParameterSets(const std::vector<std::vector<uint8_t>> &sets)
+    {
+        for (const auto &nal : sets)
+        {
+            if (nal.empty()) continue;
+            if ((nal[0] & 0x1f) == H264_NAL_SPS) m_sps = nal;
+            if ((nal[0] & 0x1f) == H264_NAL_PPS) m_pps = nal;
+        }
+    }
+
+    /**
+     * @brief Feeds one RTP packet (header included), in sequence order.
+     * @param lost_before True if packets were lost right before this one.
+     */
+    void push(const uint8_t *packet, size_t length, bool lost_before)
+    {
+        if (length < 12 || (packet[0] >> 6) != 2) return;
+        const bool marker = packet[1] & 0x80;
+        const uint32_t timestamp = (uint32_t(packet[4]) << 24) | (uint32_t(packet[5]) << 16) | (uint32_t(packet[6]) << 8) | packet[7];
+        size_t offset = 12 + 4 * (packet[0] & 0x0f);
+        if (packet[0] & 0x10) // header extension
+        {
+            if (offset + 4 > length) return;
+            offset += 4 + 4 * ((packet[offset + 2] << 8) | packet[offset + 3]);
+        }
+        if (packet[0] & 0x20) // padding
+        {
+            const size_t padding = packet[length - 1];
+            if (padding > length) return;
+            length -= padding;
+        }
+        if (offset >= length) return;
+
+        if (lost_before)
+        {
+            ++m_lost_events;
+            m_fragment.clear(); // a fragment missing its middle is useless
+            m_in_fragment = false;
+        }
+        if (m_have_timestamp && timestamp != m_timestamp) flush();
+        m_timestamp = timestamp;
+        m_have_timestamp = true;
+
+        const uint8_t *payload = packet + offset;
+        const size_t size = length - offset;
+        const uint8_t type = payload[0] & 0x1f;
+        if (type >= 1 && type <= 23)
+        {
+            addNal(payload, size);
+        }
+        else if (type == H264_NAL_STAP_A)
+        {
+            size_t pos = 1;
+            while (pos + 2 <= size)
+            {
+                const size_t nal_size = (payload[pos] << 8) | payload[pos + 1];
+                pos += 2;
+                if (nal_size == 0 || pos + nal_size > size) break;
+                addNal(payload + pos, nal_size);
+                pos += nal_size;
+            }
+        }
+        else if (type == H264_NAL_FU_A && size >= 2)
+        {
+            const bool start = payload[1] & 0x80;
+            const bool end = payload[1] & 0x40;
+            if (start)
+            {
+                m_fragment.assign(1, static_cast<uint8_t>((payload[0] & 0xe0) | (payload[1] & 0x1f)));
+                m_in_fragment = true;
+            }
+            if (m_in_fragment)
+            {
+                m_fragment.insert(m_fragment.end(), payload + 2, payload + size);
+                if (end)
+                {
+                    addNal(m_fragment.data(), m_fragment.size());
+                    m_fragment.clear();
+                    m_in_fragment = false;
+                }
+            }
+            else
+            {
+                ++m_dropped_fragments;
+            }
+        }
+        if (marker) flush();
+    }
+
+    uint64_t lostEvents() const { return m_lost_events; }
+    uint64_t droppedFragments() const { return m_dropped_fragments; }
+
+private:
+    void addNal(const uint8_t *nal, size_t size)
+    {
+        const uint8_t type = nal[0] & 0x1f;
+        if (type == H264_NAL_SPS) { m_sps.assign(nal, nal + size); m_au_has_sps = true; }
+        else if (type == H264_NAL_PPS) { m_pps.assign(nal, nal + size); m_au_has_pps = true; }
+        else if (type == H264_NAL_IDR) m_au_key = true;
+        else if (type == H264_NAL_AUD) return; // re-added by consumers that need it
+        m_nals.push_back(std::vector<uint8_t>(nal, nal + size));
+    }
+
+    void flush()
+    {
+        m_have_timestamp = false;
+        if (m_nals.empty()) return;
+        m_au.clear();
+        if (m_au_key)
+        {
+            if (!m_au_has_sps && !m_sps.empty()) appendNal(m_sps);
+            if (!m_au_has_pps && !m_pps.empty()) appendNal(m_pps);
+        }
+        for (const auto &nal : m_nals) appendNal(nal);
+        m_callback(m_au, m_au_key, m_timestamp);
+        m_nals.clear();
+        m_au_key = m_au_has_sps = m_au_has_pps = false;
+    }
+
+    void appendNal(const std::vector<uint8_t> &nal)
+    {
+        m_au.insert(m_au.end(), H264_START_CODE, H264_START_CODE + 4);
+        m_au.insert(m_au.end(), nal.begin(), nal.end());
+    }
+
+    AccessUnitCallback m_callback;
+    std::vector<uint8_t> m_sps, m_pps;
+    std::vector<std::vector<uint8_t>> m_nals;
+    std::vector<uint8_t> m_fragment;
+    std::vector<uint8_t> m_au;
+    bool m_in_fragment = false;
+    bool m_au_key = false, m_au_has_sps = false, m_au_has_pps = false;
+    bool m_have_timestamp = false;
+    uint32_t m_timestamp = 0;
+    uint64_t m_lost_events = 0;
+    uint64_t m_dropped_fragments = 0;
+};
+
+/**
+ * @brief Annex-B byte stream to access units.
+ */
+class H264AnnexBSplitter
+{
+public:
+    typedef std::function<void(const std::vector<uint8_t> &au, bool key)> AccessUnitCallback;
+
+    explicit H264AnnexBSplitter(AccessUnitCallback callback) : m_callback(callback) {}
+
+    void feed(const uint8_t *data, size_t size)
+    {
+        if (m_resync)
+        {
+            // Data after an idle flush must start a new NAL, otherwise that flush cut a frame
+            size_t zeros = 0;
+            while (zeros < size && data[zeros] == 0) ++zeros;
+            if (zeros < size && !(zeros >= 2 && data[zeros] == 1)) ++m_split_frames;
+            m_resync = false;
+        }
+        m_buffer.insert(m_buffer.end(), data, data + size);
+
+        size_t pos = m_scan;
+        while (pos + 3 <= m_buffer.size())
+        {
+            if (m_buffer[pos + 2] > 1) { pos += 3; continue; }
+            if (m_buffer[pos] != 0 || m_buffer[pos + 1] != 0 || m_buffer[pos + 2] != 1) { ++pos; continue; }
+            if (m_nal_start >= 0)
+            {
+                size_t end = pos;
+                while (end > static_cast<size_t>(m_nal_start) && m_buffer[end - 1] == 0) --end; // 4-byte start code / trailing zeros
+                addNal(m_buffer.data() + m_nal_start, end - m_nal_start);
+            }
+            m_nal_start = pos + 3;
+            pos += 3;
+        }
+        // Drop everything before the current NAL and continue scanning where we stopped
+        if (m_nal_start > 0)
+        {
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_nal_start);
+            pos -= m_nal_start;
+            m_nal_start = 0;
+        }
+        else if (m_nal_start < 0)
+        {
+            // No start code yet: garbage before the stream, keep a possible partial start code
+            if (m_buffer.size() > 2) m_buffer.erase(m_buffer.begin(), m_buffer.end() - 2);
+            pos = m_buffer.size();
+        }
+        m_scan = pos > 2 ? pos - 2 : 0;
+    }
+
+    /**
+     * @brief True if a frame's slice data is waiting for the next start code.
+     */
+    bool pending() const { return m_nal_start >= 0 && m_buffer.size() > static_cast<size_t>(m_nal_start) + 1; }
+
+    /**
+     * @brief Called when the stream went idle: the pending NAL is complete, emit its frame.
+     */
+    void flushIdle()
+    {
+        if (!pending()) return;
+        size_t end = m_buffer.size();
+        while (end > static_cast<size_t>(m_nal_start) && m_buffer[end - 1] == 0) --end;
+        addNal(m_buffer.data() + m_nal_start, end - m_nal_start);
+        m_buffer.clear();
+        m_nal_start = -1;
+        m_scan = 0;
+        emit();
+        m_resync = true;
+    }
+
+    uint64_t splitFrames() const { return m_split_frames; }
+
+private:
+    void addNal(const uint8_t *nal, size_t size)
+    {
+        if (size == 0) return;
+        const uint8_t type = nal[0] & 0x1f;
+        const bool vcl = type == H264_NAL_SLICE || type == H264_NAL_IDR;
+        // A new access unit starts with AUD/SEI/SPS/PPS or a slice with first_mb_in_slice == 0
+        const bool starts_au = (type >= H264_NAL_SEI && type <= H264_NAL_AUD) || (vcl && size > 1 && (nal[1] & 0x80));
+        if (starts_au && m_au_has_vcl) emit();
+        if (type == H264_NAL_IDR) m_au_key = true;
+        if (vcl) m_au_has_vcl = true;
+        m_au.insert(m_au.end(), H264_START_CODE, H264_START_CODE + 4);
+        m_au.insert(m_au.end(), nal, nal + size);
+    }
+
+    void emit()
+    {
+        if (m_au_has_vcl) m_callback(m_au, m_au_key);
+        m_au.clear();
+        m_au_has_vcl = m_au_key = false;
+    }
+
+    AccessUnitCallback m_callback;
+    std::vector<uint8_t> m_buffer;
+    long m_nal_start = -1; // offset of the current NAL's first byte in m_buffer, -1 before the first start code
+    size_t m_scan = 0;
+    std::vector<uint8_t> m_au;
+    bool m_au_has_vcl = false;
+    bool m_au_key = false;
+    bool m_resync = false;
+    uint64_t m_split_frames = 0;
+};
+
+/**
+ * @brief Persistent decoder process fed Annex-B access units on stdin.
+ */
+class H264DecoderPipe
+{
+public:
+    ~H264DecoderPipe() { stop(); }
+
+    /**
+     * @brief Starts `sh -c command` and the writer thread.
+     */
+    bool start(const std::string &command)
+    {
+        m_command = command;
+        m_stop = false;
+        if (!launch()) return false;
+        m_thread = std::thread(&H264DecoderPipe::writerLoop, this);
+        return true;
+    }
+
+    /**
+     * @brief Queues an access unit. Never blocks: when the decoder falls behind the
+     *        queue is dropped and feeding resumes at the next keyframe.
+     */
+    void push(const std::vector<uint8_t> &au, bool key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_need_key && !key)
+        {
+            ++m_dropped;
+            return;
+        }
+        if (m_queue.size() >= H264_DECODER_QUEUE)
+        {
+            m_dropped += m_queue.size() + 1;
+            m_queue.clear();
+            m_need_key = true;
+            if (!key) return;
+        }
+        m_need_key = false;
+        m_queue.push_back(au);
+        m_cv.notify_one();
+    }
+
+    /**
+     * @brief Closes the decoder's stdin, then stops it.
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop && !m_thread.joinable()) return;
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable()) m_thread.join();
+        terminate();
+    }
+
+    uint64_t dropped() const { return m_dropped; }
+    int restarts() const { return m_restarts; }
+
+private:
+    bool launch()
+    {
+        int fds[2];
+        if (pipe(fds) == -1)
+        {
+            perror("decoder pipe");
+            return false;
+        }
+        m_pid = fork();
+        if (m_pid == -1)
+        {
+            perror("decoder fork");
+            ::close(fds[0]);
+            ::close(fds[1]);
+            return false;
+        }
+        if (m_pid == 0)
+        {
+            dup2(fds[0], STDIN_FILENO);
+            ::close(fds[0]);
+            ::close(fds[1]);
+            signal(SIGPIPE, SIG_DFL);
+            execl("/bin/sh", "sh", "-c", m_command.c_str(), (char *)NULL);
+            _exit(127);
+        }
+        ::close(fds[0]);
+        m_fd = fds[1];
+        fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+        std::cout << "Decoder started (PID " << m_pid << "): " << m_command << std::endl;
+        return true;
+    }
+
+    void terminate()
+    {
+        if (m_fd != -1) ::close(m_fd);
+        m_fd = -1;
+        if (m_pid <= 0) return;
+        for (int i = 0; i < 20 && waitpid(m_pid, nullptr, WNOHANG) == 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50)); // EOF on stdin lets it flush and exit
+        }
+        if (waitpid(m_pid, nullptr, WNOHANG) == 0)
+        {
+            kill(m_pid, SIGTERM);
+            waitpid(m_pid, nullptr, 0);
+        }
+        m_pid = -1;
+    }
+
+    void writerLoop()
+    {
+        std::vector<uint8_t> au;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+                if (m_stop) return;
+                au.swap(m_queue.front());
+                m_queue.pop_front();
+            }
+            size_t done = 0;
+            while (done < au.size())
+            {
+                const ssize_t n = ::write(m_fd, au.data() + done, au.size() - done);
+                if (n > 0) done += n;
+                else if (n == -1 && errno == EINTR) continue;
+                else break;
+            }
+            if (done == au.size()) continue;
+
+            // Decoder died: restart it and resume at the next keyframe
+            std::cerr << "Decoder (PID " << m_pid << ") stopped accepting input; restarting." << std::endl;
+            terminate();
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.clear();
+                m_need_key = true;
+                if (m_stop) return;
+            }
+            ++m_restarts;
+            if (!launch()) std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    std::string m_command;
+    pid_t m_pid = -1;
+    int m_fd = -1;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::vector<uint8_t>> m_queue;
+    bool m_need_key = true;
+    bool m_stop = true;
+    uint64_t m_dropped = 0;
+    int m_restarts = 0;
+};
+
+#endif // DE_H264_HPP
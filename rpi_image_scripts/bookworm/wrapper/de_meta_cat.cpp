@@ -0,0 +1,147 @@
+//***************************************************************************** */
+//  Prints the per-frame metadata rings of the wrapper (--frame-meta)
+//
+//      de_meta_cat de_meta_rpi
+//      de_meta_cat de_meta_rpi de_meta_thermal --match 50
+//      de_meta_cat --detections de_rpi_detections
+//
+//  One line per new frame of the first ring. With --match, each line also
+//  shows the nearest frame of every other ring within the tolerance (ms)
+//  and its offset, which is how a consumer pairs frames of two cameras
+//  (see FrameMetaSync in de_frame_meta.hpp). --detections prints the IMX500
+//  detections ring instead (see DetectionReader in de_detections.hpp).
+//
+//***************************************************************************** */
+
+// g++ de_meta_cat.cpp -o de_meta_cat -O2
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+
+#include "de_frame_meta.hpp"
+#include "de_detections.hpp"
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void printMeta(const FrameMeta &meta)
+{
+    std::cout << frameSourceName(meta.source_id) << " #" << meta.frame_seq << " t=" << meta.capture_ns / 1000000 << "."
+              << std::setw(3) << std::setfill('0') << meta.capture_ns / 1000 % 1000 << std::setfill(' ') << " ms";
+    if (meta.data_seq) std::cout << " data=" << meta.data_seq;
+    if (meta.exposure_us) std::cout << " exp=" << meta.exposure_us << "us";
+    if (meta.analogue_gain > 0) std::cout << " gain=" << std::fixed << std::setprecision(2) << meta.analogue_gain << std::defaultfloat;
+    if (meta.flags & FRAME_META_SENSOR_TIME) std::cout << " sensor-time";
+    if (meta.flags & FRAME_META_ESTIMATED_TIME) std::cout << " estimated-time";
+    if (meta.flags & FRAME_META_KEYFRAME) std::cout << " key";
+    if (meta.flags & FRAME_META_DISCONTINUITY) std::cout << " discontinuity";
+}
+
+/**
+ * @brief One line per frame of a detections ring, from the newest frame on.
+ */
+static int printDetections(const std::string &name)
+{
+    DetectionReader reader;
+    uint64_t next = 0;
+    while (!g_stop)
+    {
+        if (!reader.isOpen())
+        {
+            if (!reader.open(name))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
+            next = reader.latest() + 1;
+        }
+        if (!reader.waitFor(next, 1000)) continue;
+        DetectionFrame frame;
+        std::vector<Detection> objects;
+        if (!reader.read(next, frame, objects))
+        {
+            next = reader.latest(); // overwritten: skip to the newest
+            continue;
+        }
+        ++next;
+        std::cout << "frame #" << frame.frame_seq << " t=" << frame.capture_ns / 1000000 << " ms";
+        if (frame.data_seq) std::cout << " data=" << frame.data_seq;
+        std::cout << " objects=" << frame.count << std::fixed << std::setprecision(3);
+        for (const auto &object : objects)
+        {
+            std::cout << " [class " << object.class_id << " " << object.score << " " << object.x0 << "," << object.y0 << "-" << object.x1 << ","
+                      << object.y1 << "]";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> rings;
+    double match_ms = -1.0;
+    std::string detections;
+    bool help = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--match" && i + 1 < argc) match_ms = std::atof(argv[++i]);
+        else if (arg == "--detections" && i + 1 < argc) detections = argv[++i];
+        else if (arg == "-h" || arg == "--help") help = true;
+        else rings.push_back(arg);
+    }
+    if ((rings.empty() && detections.empty()) || help)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ring name> [<ring name>...] [--match ms] | --detections <ring name>" << std::endl;
+        std::cerr << "  Prints the FrameMeta records of /dev/shm/<ring name>; with --match, the nearest frames of the other rings." << std::endl;
+        return help ? 0 : 1;
+    }
+
+    signal(SIGINT, [](int) { g_stop = 1; });
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    if (!detections.empty()) return printDetections(detections);
+
+    FrameMetaSync sync(rings);
+    FrameMetaReader &primary = sync.reader(0);
+    uint64_t next = 0;
+    while (!g_stop)
+    {
+        primary.refresh();
+        const uint64_t latest = primary.latest();
+        if (latest == 0 || latest < next)
+        {
+            if (latest + 1 < next) next = 0; // producer restarted
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        if (next == 0 || latest - next >= FRAME_META_SLOTS / 2) next = latest; // start (or resume) at the newest record
+        for (; next <= latest; ++next)
+        {
+            FrameMeta meta;
+            if (!primary.read(next, meta)) continue;
+            printMeta(meta);
+            if (match_ms >= 0.0)
+            {
+                const std::vector<FrameMetaMatch> match = sync.match(meta.capture_ns, static_cast<uint64_t>(match_ms * 1000000.0));
+                for (size_t i = 1; i < match.size(); ++i)
+                {
+                    std::cout << " | " << rings[i] << ": ";
+                    if (!match[i].found)
+                    {
+                        std::cout << "none";
+                        continue;
+                    }
+                    std::cout << "#" << match[i].meta.frame_seq << " " << std::showpos << std::fixed << std::setprecision(1)
+                              << match[i].offset_ns / 1e6 << std::noshowpos << std::defaultfloat << " ms";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+//***************************************************************************** */
+//  Demand-driven capture pipelines
+//
+//  Without --on-demand every enabled producer (RPI camera, gimbal, thermal)
+//  runs at full rate from boot, even when nothing reads DE-GIMBAL or
+//  DE-THERMAL. With it, the wrapper looks for readers of each producer's
+//  outputs (its v4l2loopback device and its shared-memory rings) every
+//  --on-demand-poll-ms:
+//
+//      readers            -> the producer runs
+//      none for grace sec -> the producer is paused (SIGSTOP)
+//      a reader appears   -> the producer is resumed
+//
+//  A reader is any process, other than the producer and its descendants,
+//  with the device open or the ring mapped. Producers are paused, never
+//  stopped: the loopback devices are created with exclusive_caps=1, so a
+//  device without a writer loses its CAPTURE capability and a consumer
+//  cannot open it to show up as a reader. A stopped producer would also
+//  remove its rings. A paused producer keeps both and resumes within one
+//  poll interval.
+//
+//***************************************************************************** */
+
+#ifndef DE_ON_DEMAND_HPP
+#define DE_ON_DEMAND_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "de_supervisor.hpp"
+#include "de_frame_sink.hpp"
+
+/**
+ * @brief One producer and the outputs whose readers keep it running.
+ */
+struct OnDemandChannel
+{
+    std::string name;                // rpi, gimbal, thermal
+    std::string child;               // supervised child name of the producer
+    std::vector<std::string> devices; // v4l2loopback labels or /dev/videoN
+    std::vector<std::string> rings;   // shm ring names
+};
+
+struct OnDemandOptions
+{
+    int grace_sec = 10;               // no readers this long = idle
+    int poll_ms = 500;
+    std::string status_path = "/dev/shm/de_on_demand";
+};
+
+/**
+ * @brief Pauses and resumes producers according to their readers.
+ */
+class OnDemand
+{
+public:
+    OnDemand(ChildSupervisor &supervisor, const OnDemandOptions &options) : m_supervisor(supervisor), m_options(options) {}
+
+    void addChannel(const OnDemandChannel &channel)
+    {
+        State state;
+        state.channel = channel;
+        state.last_reader = std::chrono::steady_clock::now(); // a grace period from start-up
+        m_channels.push_back(state);
+    }
+
+    size_t channelCount() const { return m_channels.size(); }
+
+    /**
+     * @brief Supervisor tick: looks for readers every poll interval.
+     */
+    void tick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_poll < std::chrono::milliseconds(m_options.poll_ms)) return;
+        m_last_poll = now;
+
+        resolveDevices();
+        std::vector<Reader> readers = scanReaders();
+        bool changed = false;
+        for (auto &state : m_channels)
+        {
+            const int index = childIndex(state.channel.child);
+            if (index < 0) continue;
+            SupervisedChild &child = m_supervisor.children()[index];
+
+            // The producer's own tree writes the device and maps the ring
+            std::set<pid_t> own;
+            if (child.pid > 0)
+            {
+                for (pid_t pid : processTree(child.pid)) own.insert(pid);
+            }
+            const Reader *first = nullptr;
+            int count = 0;
+            for (const auto &reader : readers)
+            {
+                if (own.count(reader.pid) || !readsChannel(reader, state)) continue;
+                if (!first) first = &reader;
+                ++count;
+            }
+            changed = changed || count != state.readers;
+            state.readers = count;
+
+            if (count > 0)
+            {
+                state.last_reader = now;
+                if (state.idle)
+                {
+                    wake(state, static_cast<size_t>(index), *first);
+                    changed = true;
+                }
+            }
+            else if (!state.idle && child.pid > 0 && now - state.last_reader >= std::chrono::seconds(m_options.grace_sec))
+            {
+                idle(state, static_cast<size_t>(index));
+                changed = true;
+            }
+        }
+        if (changed) writeStatus();
+    }
+
+    /**
+     * @brief Resumes paused producers. Called before the wrapper stops its children.
+     */
+    void release()
+    {
+        m_supervisor.resumeAll("on-demand");
+        for (auto &state : m_channels) state.paused.clear();
+    }
+
+private:
+    struct State
+    {
+        OnDemandChannel channel;
+        std::vector<std::string> device_paths; // resolved /dev/videoN
+        bool idle = false;
+        std::vector<pid_t> paused;
+        int readers = 0;
+        std::chrono::steady_clock::time_point last_reader;
+    };
+
+    struct Reader
+    {
+        pid_t pid;
+        std::string comm;
+        std::set<std::string> devices; // /dev/videoN it has open
+        std::set<std::string> rings;   // ring names it has mapped
+    };
+
+    int childIndex(const std::string &name)
+    {
+        auto &children = m_supervisor.children();
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (children[i].name == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void resolveDevices()
+    {
+        for (auto &state : m_channels)
+        {
+            if (state.device_paths.size() == state.channel.devices.size()) continue;
+            state.device_paths.clear();
+            for (const auto &device : state.channel.devices)
+            {
+                const std::string path = device.rfind("/dev/", 0) == 0 ? device : findVideoDeviceByLabel(device);
+                if (!path.empty()) state.device_paths.push_back(path);
+            }
+        }
+    }
+
+    static bool readsChannel(const Reader &reader, const State &state)
+    {
+        for (const auto &path : state.device_paths)
+        {
+            if (reader.devices.count(path)) return true;
+        }
+        for (const auto &ring : state.channel.rings)
+        {
+            if (reader.rings.count(ring)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Every process with a watched device open (fd links) or a watched ring
+     *        mapped (ShmRingReader closes its fd after mmap, so /proc/<pid>/maps).
+     */
+    std::vector<Reader> scanReaders() const
+    {
+        std::set<std::string> devices, rings;
+        for (const auto &state : m_channels)
+        {
+            devices.insert(state.device_paths.begin(), state.device_paths.end());
+            rings.insert(state.channel.rings.begin(), state.channel.rings.end());
+        }
+        std::vector<Reader> readers;
+        DIR *proc = opendir("/proc");
+        if (!proc) return readers;
+        const pid_t self = getpid();
+        while (struct dirent *entry = readdir(proc))
+        {
+            const pid_t pid = static_cast<pid_t>(std::atoi(entry->d_name));
+            if (pid <= 0 || pid == self) continue;
+            Reader reader;
+            reader.pid = pid;
+            const std::string base = "/proc/" + std::to_string(pid);
+            if (!devices.empty())
+            {
+                DIR *fds = opendir((base + "/fd").c_str());
+                if (fds)
+                {
+                    while (struct dirent *fd = readdir(fds))
+                    {
+                        char target[256];
+                        const ssize_t n = readlink((base + "/fd/" + fd->d_name).c_str(), target, sizeof(target) - 1);
+                        if (n <= 0) continue;
+                        target[n] = '\0';
+                        if (devices.count(target)) reader.devices.insert(target);
+                    }
+                    closedir(fds);
+                }
+            }
+            if (!rings.empty())
+            {
+                std::ifstream maps(base + "/maps");
+                std::string line;
+                while (std::getline(maps, line))
+                {
+                    const size_t at = line.find("/dev/shm/");
+                    if (at == std::string::npos) continue;
+                    std::string name = line.substr(at + 9);
+                    const size_t deleted = name.find(" (deleted)");
+                    if (deleted != std::string::npos) continue; // an old ring the producer has replaced
+                    if (rings.count(name)) reader.rings.insert(name);
+                }
+            }
+            if (reader.devices.empty() && reader.rings.empty()) continue;
+            std::ifstream comm(base + "/comm");
+            std::getline(comm, reader.comm);
+            readers.push_back(reader);
+        }
+        closedir(proc);
+        return readers;
+    }
+
+    void idle(State &state, size_t index)
+    {
+        SupervisedChild &child = m_supervisor.children()[index];
+        state.paused = m_supervisor.pauseTree(child.pid, "on-demand");
+        std::cout << "On-demand: pausing " << state.channel.name << " (" << child.name << ", " << state.paused.size()
+                  << " process(es)), no readers for " << m_options.grace_sec << " s" << std::endl;
+        state.idle = true;
+    }
+
+    void wake(State &state, size_t index, const Reader &reader)
+    {
+        SupervisedChild &child = m_supervisor.children()[index];
+        m_supervisor.resume(state.paused, "on-demand");
+        state.paused.clear();
+        std::cout << "On-demand: resuming " << state.channel.name << " (" << child.name << ") for " << reader.comm
+                  << " (PID " << reader.pid << ")" << std::endl;
+        state.idle = false;
+    }
+
+    /**
+     * @brief One line per channel; replaced atomically.
+     */
+    void writeStatus() const
+    {
+        writeStatusFile(m_options.status_path, [this](std::ostream &out) {
+            for (const auto &state : m_channels)
+            {
+                out << "channel=" << state.channel.name << " state=" << (state.idle ? "paused" : "running") << " readers=" << state.readers << "\n";
+            }
+        });
+    }
+
+    ChildSupervisor &m_supervisor;
+    OnDemandOptions m_options;
+    std::vector<State> m_channels;
+    std::chrono::steady_clock::time_point m_last_poll;
+};
+
+#endif // DE_ON_DEMAND_HPP
@@ -0,0 +1,125 @@
+//***************************************************************************** */
+//  Writes the H.264 access units of a wrapper ring to stdout
+//
+//  Reference consumer of the encoded rings (--rpi-encoded, --gimbal-passthrough):
+//
+//      de_ring_cat de_rpi_h264 | ffmpeg -f h264 -i - -c copy -f rtsp rtsp://...
+//
+//  Output starts at the newest keyframe still in the ring, so the first
+//  bytes are decodable. When frames are missed (slow pipe) or the producer
+//  flags a discontinuity, output resumes at the next keyframe. If the
+//  producer restarts, the new ring is picked up.
+//
+//***************************************************************************** */
+
+// g++ de_ring_cat.cpp -o de_ring_cat -O2
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "de_shm_ring.hpp"
+
+static volatile sig_atomic_t g_stop = 0;
+
+/**
+ * @brief Inode of /dev/shm/<name>, 0 if it does not exist. Changes when the producer recreates the ring.
+ */
+static ino_t ringInode(const std::string &name)
+{
+    struct stat st;
+    return stat(("/dev/shm/" + name).c_str(), &st) == 0 ? st.st_ino : 0;
+}
+
+static bool writeAll(const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        std::cerr << "Usage: " << argv[0] << " <ring name> [--frames N]" << std::endl;
+        std::cerr << "  Writes the Annex-B access units of /dev/shm/<ring name> to stdout." << std::endl;
+        return argc < 2 ? 1 : 0;
+    }
+    const std::string name = argv[1];
+    long frames = -1;
+    if (argc >= 4 && std::string(argv[2]) == "--frames") frames = std::atol(argv[3]);
+
+    signal(SIGINT, [](int) { g_stop = 1; });
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGPIPE, SIG_IGN);
+
+    ShmRingReader ring;
+    std::vector<uint8_t> buffer;
+    ino_t inode = 0;
+    uint64_t next = 0;
+    bool need_key = true;
+    uint64_t written = 0, skipped = 0;
+    while (!g_stop && frames != 0)
+    {
+        if (!ring.isOpen())
+        {
+            inode = ringInode(name);
+            if (!ring.open(name) || ring.info().format != SHM_FORMAT_H264)
+            {
+                ring.close();
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
+            buffer.resize(ring.info().slot_size);
+            const uint64_t key = ring.latestKeyframe();
+            next = key ? key : ring.latest() + 1;
+            need_key = true;
+            std::cerr << "de_ring_cat: reading /dev/shm/" << name << " from frame " << next << std::endl;
+        }
+
+        if (!ring.waitFor(next, 1000))
+        {
+            if (ringInode(name) != inode) ring.close(); // producer restarted or went away
+            continue;
+        }
+
+        ShmFrameInfo frame;
+        if (!ring.read(next, buffer.data(), buffer.size(), frame))
+        {
+            // Overwritten before we got to it: jump to the newest keyframe
+            ++skipped;
+            const uint64_t key = ring.latestKeyframe();
+            next = key > next ? key : ring.latest();
+            need_key = true;
+            continue;
+        }
+        ++next;
+        if (frame.flags & SHM_SLOT_DISCONTINUITY) need_key = true;
+        if (need_key && !(frame.flags & SHM_SLOT_KEYFRAME))
+        {
+            ++skipped;
+            continue;
+        }
+        need_key = false;
+        if (!writeAll(buffer.data(), frame.bytes)) break;
+        ++written;
+        if (frames > 0) --frames;
+    }
+    std::cerr << "de_ring_cat: " << written << " access units written, " << skipped << " skipped" << std::endl;
+    return 0;
+}
@@ -0,0 +1,472 @@
+//***************************************************************************** */
+//  Encoded Raspberry Pi camera pipeline
+//
+//  With --rpi-encoded the camera pipeline no longer ends in raw yuv420p:
+//
+//      sh_camera_run_rpi_camera.sh (DE_RPI_ENCODED=1, rpicam-vid --codec h264)
+//          --stdout--> H264AnnexBSplitter --AU--> shm ring (H.264 access units)
+//                                              \--> H264DecoderPipe --> DE-RPI
+//
+//  The hardware encoder on the Pi does the compression once. Consumers that
+//  stream to the ground station read the ring and forward the access units
+//  as they are (see de_ring_cat.cpp); modules that need pixels still get them
+//  from DE-RPI through one decode, which replaces the raw copy ffmpeg made
+//  before. That decode uses the Pi's V4L2 H.264 decoder (h264_v4l2m2m) by
+//  default; --rpi-decoder replaces the command (e.g. with the software
+//  H264_DEFAULT_DECODER on a Pi 5) and --rpi-no-decode drops DE-RPI.
+//
+//  The script's exit code is passed through, so 3 still means "no camera".
+//
+//  With a metadata ring (--frame-meta) rpicam-vid also writes its per-frame
+//  metadata to a FIFO (DE_RPI_METADATA); the k-th record belongs to the k-th
+//  access unit, and the pair is published as one FrameMeta record. With an
+//  IMX500 network the same record's output tensor becomes the frame's
+//  detections (de_detections.hpp).
+//
+//***************************************************************************** */
+
+#ifndef DE_RPI_ENCODED_HPP
+#define DE_RPI_ENCODED_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "de_h264.hpp"
+#include "de_shm_ring.hpp"
+#include "de_frame_meta.hpp"
+#include "de_detections.hpp"
+#include "de_frame_sink.hpp"
+#include "de_supervisor.hpp"
+
+#define RPI_ENCODED_DEFAULT_RING "de_rpi_h264"
+#define RPI_ENCODED_DEFAULT_DECODER H264_V4L2M2M_DECODER // the camera's own stream: decode it in hardware too
+#define RPI_ENCODED_SLOTS 16
+#define RPI_ENCODED_SLOT_BYTES (1024 * 1024)
+#define RPI_ENCODED_PIPE_BYTES (1024 * 1024) // room for a 1080p keyframe in one write
+#define RPI_ENCODED_IDLE_MS 2                // stream idle this long = frame complete
+#define RPI_METADATA_MAX_PENDING 16          // unpaired frames before metadata is given up on
+
+/**
+ * @brief Channels fed from rpicam-vid's metadata stream. Either one makes the
+ *        camera script write its metadata (DE_RPI_METADATA).
+ */
+struct RpiMetadataOptions
+{
+    std::string meta_ring;      // FrameMeta ring (de_frame_meta.hpp), empty = off
+    std::string detection_ring; // IMX500 detections (de_detections.hpp), empty = off
+    Imx500DetectionOptions imx500;
+
+    bool enabled() const { return !meta_ring.empty() || !detection_ring.empty(); }
+};
+
+/**
+ * @brief One frame's metadata and, with an IMX500 network, its detections.
+ */
+struct RpiFrameMetadata
+{
+    FrameMeta meta;
+    bool has_tensor = false;
+    uint32_t tensor_floats = 0;
+    std::vector<Detection> detections;
+};
+
+/**
+ * @brief Decodes rpicam-vid metadata records and writes the metadata and detections rings.
+ */
+class RpiMetadataPublisher
+{
+public:
+    bool open(const RpiMetadataOptions &options)
+    {
+        m_decoder = Imx500DetectionDecoder(options.imx500);
+        if (!options.meta_ring.empty() && !m_meta.create(options.meta_ring, FRAME_SOURCE_RPI)) return false;
+        if (!options.detection_ring.empty() && !m_detections.create(options.detection_ring)) return false;
+        return true;
+    }
+
+    RpiFrameMetadata decode(const FrameMeta &meta, const std::string &object)
+    {
+        RpiFrameMetadata frame;
+        frame.meta = meta;
+        if (m_detections.isOpen() && detectionJsonArray(object, "CnnOutputTensor", m_tensor))
+        {
+            frame.tensor_floats = static_cast<uint32_t>(m_tensor.size());
+            frame.has_tensor = m_decoder.decode(m_tensor, frame.detections);
+            if (!frame.has_tensor && !m_layout_warned)
+            {
+                std::cerr << "IMX500: output tensor of " << m_tensor.size() << " floats is not an SSD detection layout, no detections published." << std::endl;
+                m_layout_warned = true;
+            }
+        }
+        return frame;
+    }
+
+    /**
+     * @brief Frames without a tensor (the network is still loading) get no detections record.
+     */
+    void publish(const RpiFrameMetadata &frame)
+    {
+        const uint64_t frame_seq = m_meta.publish(frame.meta);
+        if (!frame.has_tensor) return;
+        DetectionFrame header;
+        std::memset(&header, 0, sizeof(header));
+        header.frame_seq = frame_seq;
+        header.data_seq = frame.meta.data_seq;
+        header.capture_ns = frame.meta.capture_ns;
+        header.tensor_floats = frame.tensor_floats;
+        m_detections.publish(header, frame.detections);
+        ++m_detection_frames;
+    }
+
+    uint64_t detectionFrames() const { return m_detection_frames; }
+
+private:
+    FrameMetaWriter m_meta; // also numbers the frames when there is no metadata ring
+    DetectionWriter m_detections;
+    Imx500DetectionDecoder m_decoder;
+    std::vector<float> m_tensor;
+    bool m_layout_warned = false;
+    uint64_t m_detection_frames = 0;
+};
+
+struct RpiEncodedOptions
+{
+    std::string script;                         // sh_camera_run_rpi_camera.sh
+    std::string post_process_file;
+    std::string ring = RPI_ENCODED_DEFAULT_RING;
+    std::string output = "DE-RPI";              // label, /dev/videoN or file:<path>
+    std::string decoder = RPI_ENCODED_DEFAULT_DECODER; // {output} = the device; empty = ring only
+    RpiMetadataOptions metadata;
+    int stats_sec = 30;
+};
+
+static volatile sig_atomic_t g_rpi_encoded_stop = 0;
+
+/**
+ * @brief Creates the FIFO rpicam-vid writes its metadata to and opens it for reading.
+ *        O_RDWR keeps it open across rpicam-vid restarts and never blocks.
+ * @return The read end, or -1. path receives the FIFO's path.
+ */
+inline int openRpicamMetadataFifo(std::string &path)
+{
+    path = "/tmp/de_rpi_metadata." + std::to_string(getpid());
+    unlink(path.c_str());
+    if (mkfifo(path.c_str(), 0600) == -1)
+    {
+        perror(("mkfifo " + path + " failed").c_str());
+        return -1;
+    }
+    const int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1)
+    {
+        perror(("open " + path + " failed").c_str());
+        unlink(path.c_str());
+    }
+    return fd;
+}
+
+/**
+ * @brief Metadata of the raw camera pipeline: publishes every record rpicam-vid writes
+ *        to fd until the process that started it exits. No data ring to pair with.
+ */
+inline int runRpicamMetadataTap(int fd, const std::string &fifo, const RpiMetadataOptions &options)
+{
+    // Stopped with the script's process group; the FIFO is removed either way
+    signal(SIGTERM, [](int) { g_rpi_encoded_stop = 1; });
+    signal(SIGINT, [](int) { g_rpi_encoded_stop = 1; });
+    const pid_t parent = getppid();
+    RpiMetadataPublisher publisher;
+    if (!publisher.open(options)) return 1;
+    RpicamMetadataParser parser([&publisher](const FrameMeta &meta, const std::string &object) { publisher.publish(publisher.decode(meta, object)); });
+    char buffer[16384];
+    while (!g_rpi_encoded_stop && getppid() == parent)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0) continue;
+        const ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got > 0) parser.feed(buffer, static_cast<size_t>(got));
+    }
+    unlink(fifo.c_str());
+    return 0;
+}
+
+/**
+ * @brief Runs the camera script and publishes its H.264 output. Runs in its own
+ *        process (see spawnFunction()).
+ */
+class RpiEncodedStage
+{
+public:
+    explicit RpiEncodedStage(const RpiEncodedOptions &options)
+        : m_options(options),
+          m_splitter([this](const std::vector<uint8_t> &au, bool key) { onAccessUnit(au, key); }),
+          m_metadata([this](const FrameMeta &meta, const std::string &object) { m_pending_metadata.push_back(m_publisher.decode(meta, object)); pairMetadata(); })
+    {
+    }
+
+    /**
+     * @return The script's exit code (3 = no camera), 0 after SIGTERM, 1 on a setup error.
+     */
+    int run()
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = [](int) { g_rpi_encoded_stop = 1; };
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        ShmRingFormat format;
+        format.format = SHM_FORMAT_H264;
+        if (!m_ring.create(m_options.ring, RPI_ENCODED_SLOTS, RPI_ENCODED_SLOT_BYTES, format)) return 1;
+        if (m_options.metadata.enabled())
+        {
+            if (!m_publisher.open(m_options.metadata)) return 1;
+            m_meta_fd = openRpicamMetadataFifo(m_meta_fifo);
+            if (m_meta_fd == -1) return 1;
+        }
+
+        int fds[2];
+        if (pipe(fds) == -1)
+        {
+            perror("pipe for encoded camera pipeline failed");
+            return 1;
+        }
+        fcntl(fds[0], F_SETPIPE_SZ, RPI_ENCODED_PIPE_BYTES); // best effort, capped by /proc/sys/fs/pipe-max-size
+
+        std::string command = m_options.script;
+        if (!m_options.post_process_file.empty()) command += " \"" + m_options.post_process_file + "\"";
+        std::cout << "Calling camera script in encoded mode: " << command << std::endl;
+        std::cout.flush();
+        m_script = fork();
+        if (m_script == -1)
+        {
+            std::cerr << "Failed to fork for camera script." << std::endl;
+            return 1;
+        }
+        if (m_script == 0)
+        {
+            setpgid(0, 0); // rpicam-vid and friends are stopped as one group
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGPIPE, SIG_DFL);
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            setenv("DE_RPI_ENCODED", "1", 1);
+            if (m_meta_fd != -1) setenv("DE_RPI_METADATA", m_meta_fifo.c_str(), 1);
+            execlp("sh", "sh", "-c", command.c_str(), (char *)NULL);
+            perror("execlp for camera script failed");
+            _exit(127);
+        }
+        setpgid(m_script, m_script);
+        close(fds[1]);
+
+        const int code = pump(fds[0]);
+        close(fds[0]);
+        if (m_meta_fd != -1)
+        {
+            close(m_meta_fd);
+            unlink(m_meta_fifo.c_str());
+        }
+        m_decoder.stop();
+        m_ring.close();
+        printStats();
+        return code;
+    }
+
+private:
+    int pump(int fd)
+    {
+        std::vector<uint8_t> buffer(256 * 1024);
+        m_window_start = std::chrono::steady_clock::now();
+        bool stopping = false;
+        while (true)
+        {
+            if (g_rpi_encoded_stop && !stopping)
+            {
+                stopping = true;
+                kill(-m_script, SIGTERM);
+            }
+            struct pollfd pfd[2] = {{fd, POLLIN, 0}, {m_meta_fd, POLLIN, 0}};
+            const int ready = poll(pfd, m_meta_fd != -1 ? 2 : 1, m_splitter.pending() ? RPI_ENCODED_IDLE_MS : 100);
+            if (ready > 0 && m_meta_fd != -1 && (pfd[1].revents & POLLIN))
+            {
+                char text[16384];
+                const ssize_t got = read(m_meta_fd, text, sizeof(text));
+                if (got > 0) m_metadata.feed(text, static_cast<size_t>(got));
+            }
+            if (ready == 0)
+            {
+                m_splitter.flushIdle();
+            }
+            else if (ready > 0 && pfd[0].revents)
+            {
+                const ssize_t got = read(fd, buffer.data(), buffer.size());
+                if (got > 0)
+                {
+                    m_bytes += got;
+                    m_splitter.feed(buffer.data(), static_cast<size_t>(got));
+                }
+                else if (got == 0 || errno != EINTR)
+                {
+                    break; // script exited (or closed its stdout)
+                }
+            }
+            else if (ready < 0 && errno != EINTR)
+            {
+                break;
+            }
+
+            if (m_options.stats_sec > 0 && std::chrono::steady_clock::now() - m_window_start >= std::chrono::seconds(m_options.stats_sec))
+            {
+                printStats();
+            }
+        }
+        m_splitter.flushIdle();
+
+        int status = 0;
+        if (!stopping) kill(-m_script, SIGTERM); // stdout closed but the group may still be alive
+        while (waitpid(m_script, &status, 0) == -1 && errno == EINTR) {}
+        if (stopping) return 0;
+        if (WIFEXITED(status)) return WEXITSTATUS(status);
+        std::cerr << "Camera script " << describeExitStatus(status) << "." << std::endl;
+        return 1;
+    }
+
+    void onAccessUnit(const std::vector<uint8_t> &au, bool key)
+    {
+        const uint64_t now_ns = shmRingNowNs();
+        ++m_aus;
+        if (key) ++m_keyframes;
+        if (m_aus == 1)
+        {
+            std::cout << "Encoded camera: first access unit" << (key ? " (keyframe)" : "") << std::endl;
+            startDecoder();
+        }
+        if (!m_options.decoder.empty()) m_decoder.push(au, key);
+        // No pts from rpicam-vid on stdout; use the arrival time on the 90 kHz media clock
+        const int64_t pts = static_cast<int64_t>(now_ns / 100000 * 9);
+        const bool discontinuity = m_discontinuity;
+        uint64_t seq = 0;
+        if (au.size() > m_ring.slotSize())
+        {
+            ++m_oversized;
+            m_discontinuity = true;
+        }
+        else
+        {
+            seq = m_ring.write(au.data(), au.size(), now_ns, (key ? SHM_SLOT_KEYFRAME : 0) | (m_discontinuity ? SHM_SLOT_DISCONTINUITY : 0), pts);
+            m_discontinuity = false;
+        }
+        if (m_meta_fd != -1)
+        {
+            FrameMeta meta;
+            std::memset(&meta, 0, sizeof(meta));
+            meta.capture_ns = now_ns; // replaced by the sensor timestamp once its metadata arrives
+            meta.flags = (key ? FRAME_META_KEYFRAME : 0) | (discontinuity ? FRAME_META_DISCONTINUITY : 0);
+            meta.data_seq = seq;
+            meta.pts = pts;
+            m_pending_frames.push_back(meta);
+            pairMetadata();
+        }
+    }
+
+    /**
+     * @brief rpicam-vid writes one metadata record per encoded frame, in order, but the
+     *        two streams arrive independently. Frames whose metadata does not come
+     *        (an rpicam-vid without --metadata) are published with their arrival time.
+     */
+    void pairMetadata()
+    {
+        while (!m_pending_frames.empty() && !m_pending_metadata.empty())
+        {
+            RpiFrameMetadata &metadata = m_pending_metadata.front();
+            const FrameMeta &frame = m_pending_frames.front();
+            metadata.meta.flags |= frame.flags;
+            metadata.meta.data_seq = frame.data_seq;
+            metadata.meta.pts = frame.pts;
+            m_publisher.publish(metadata);
+            m_pending_frames.pop_front();
+            m_pending_metadata.pop_front();
+        }
+        while (m_pending_frames.size() > RPI_METADATA_MAX_PENDING)
+        {
+            RpiFrameMetadata metadata;
+            metadata.meta = m_pending_frames.front();
+            m_publisher.publish(metadata);
+            m_pending_frames.pop_front();
+            ++m_unpaired;
+        }
+        while (m_pending_metadata.size() > RPI_METADATA_MAX_PENDING) m_pending_metadata.pop_front();
+    }
+
+    /**
+     * @brief Started with the first frame, after the script found the camera, so a
+     *        board without a camera does not need DE-RPI.
+     */
+    void startDecoder()
+    {
+        if (m_options.decoder.empty()) return;
+        std::string output = m_options.output;
+        if (output.rfind("file:", 0) == 0) output = output.substr(5);
+        else if (output.rfind("/dev/", 0) != 0) output = findVideoDeviceByLabel(output);
+        if (output.empty())
+        {
+            std::cerr << "Encoded camera: virtual camera '" << m_options.output << "' not found, publishing to the ring only." << std::endl;
+            m_options.decoder.clear();
+            return;
+        }
+        std::string command = m_options.decoder;
+        const size_t placeholder = command.find("{output}");
+        if (placeholder != std::string::npos) command.replace(placeholder, 8, output);
+        if (!m_decoder.start(command)) m_options.decoder.clear();
+    }
+
+    void printStats()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::max(1e-3, std::chrono::duration<double>(now - m_window_start).count());
+        std::cout << "Encoded camera: " << std::fixed << std::setprecision(1) << (m_aus - m_window_aus) / seconds << " fps, "
+                  << (m_bytes - m_window_bytes) * 8 / seconds / 1000.0 << " kbit/s, " << m_keyframes << " keyframes, ring /dev/shm/"
+                  << m_options.ring << ", decoder dropped " << m_decoder.dropped()
+                  << (m_splitter.splitFrames() ? ", " + std::to_string(m_splitter.splitFrames()) + " frames split by idle flush" : "")
+                  << (m_oversized ? ", " + std::to_string(m_oversized) + " AUs too large for the ring" : "")
+                  << (m_unpaired ? ", " + std::to_string(m_unpaired) + " frames without metadata" : "")
+                  << (m_publisher.detectionFrames() ? ", " + std::to_string(m_publisher.detectionFrames()) + " frames of IMX500 detections" : "") << std::defaultfloat << std::endl;
+        m_window_start = now;
+        m_window_aus = m_aus;
+        m_window_bytes = m_bytes;
+    }
+
+    RpiEncodedOptions m_options;
+    H264AnnexBSplitter m_splitter;
+    H264DecoderPipe m_decoder;
+    ShmRingWriter m_ring;
+    RpicamMetadataParser m_metadata;
+    RpiMetadataPublisher m_publisher;
+    int m_meta_fd = -1;
+    std::string m_meta_fifo;
+    std::deque<FrameMeta> m_pending_frames;
+    std::deque<RpiFrameMetadata> m_pending_metadata;
+    uint64_t m_unpaired = 0;
+    pid_t m_script = -1;
+    bool m_discontinuity = true;
+    std::chrono::steady_clock::time_point m_window_start;
+    uint64_t m_aus = 0, m_keyframes = 0, m_bytes = 0, m_oversized = 0;
+    uint64_t m_window_aus = 0, m_window_bytes = 0;
+};
+
+#endif // DE_RPI_ENCODED_HPP
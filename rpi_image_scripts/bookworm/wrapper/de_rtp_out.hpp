@@ -0,0 +1,560 @@
+//***************************************************************************** */
+//  RTP/UDP network output of a capture ring
+//
+//  Sends the frames of one shared-memory ring (see de_shm_ring.hpp) to any
+//  number of UDP receivers, local or remote, so one capture serves both the
+//  modules on the board and the ground station:
+//
+//  - H264 rings (--rpi-encoded, --gimbal-passthrough): RFC 6184 packetization
+//    mode 1 (single NAL units, FU-A above the MTU). Packets are built as an
+//    RTP header plus an iovec pointing into the ring slot itself, so the
+//    payload is never copied in user space. The slot is checked right before
+//    and right after every sendmmsg(): if the producer overwrote it, the rest
+//    of the frame is dropped and the output resumes at the next keyframe. A
+//    batch the kernel was copying at that moment may already be out, and the
+//    receiver sees one damaged frame before the keyframe.
+//  - Y16 and YU12 rings: RFC 4175 line segments. YU12 is sent as
+//    YCbCr-4:2:0 pgroups, Y16 as 16-bit big-endian samples (sampling
+//    "GRAYSCALE" in the SDP, not in RFC 4175's list; for our own receivers).
+//    Raw frames are repacked into the packet buffers.
+//
+//  Packets are sent with sendmmsg() in batches of --stream-batch (one
+//  message per packet and receiver, sharing the same iovecs). With
+//  --stream-rate-kbps a token bucket spreads each frame over time instead
+//  of bursting it into the Wi-Fi queue.
+//
+//***************************************************************************** */
+
+#ifndef DE_RTP_OUT_HPP
+#define DE_RTP_OUT_HPP
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "de_shm_ring.hpp"
+
+#define RTP_OUT_DEFAULT_MTU 1400  // UDP payload bytes per packet, fits Wi-Fi and most VPNs
+#define RTP_OUT_DEFAULT_BATCH 32  // packets per sendmmsg() call
+#define RTP_OUT_PAYLOAD_TYPE 96
+#define RTP_OUT_MAX_SEGMENTS 8    // RFC 4175 line segments per packet
+#define RTP_OUT_SNDBUF (1024 * 1024)
+
+struct RtpOutOptions
+{
+    std::string ring;                      // shm ring to send
+    std::vector<std::string> destinations; // host:port
+    int mtu = RTP_OUT_DEFAULT_MTU;
+    int batch = RTP_OUT_DEFAULT_BATCH;
+    int rate_kbps = 0;                     // pacing per receiver, 0 = send each frame at once
+    std::string sdp_path;                  // SDP for the first receiver, empty = none
+    int stats_sec = 30;
+};
+
+static volatile sig_atomic_t g_rtp_out_stop = 0;
+
+/**
+ * @brief One RTP packet: header bytes plus the payload they describe.
+ */
+struct RtpOutPacket
+{
+    uint8_t header[14];
+    size_t header_size = 0;
+    const uint8_t *payload = nullptr; // points into the ring slot (H.264) or m_raw (raw video)
+    size_t payload_size = 0;
+};
+
+/**
+ * @brief The sender loop. Runs in its own process (see spawnFunction()).
+ */
+class RtpOutput
+{
+public:
+    explicit RtpOutput(const RtpOutOptions &options) : m_options(options)
+    {
+        std::random_device random;
+        m_ssrc = random();
+        m_sequence = static_cast<uint16_t>(random());
+    }
+
+    /**
+     * @return Process exit code: 0 after SIGTERM, 1 on a configuration error.
+     */
+    int run()
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = [](int) { g_rtp_out_stop = 1; };
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+
+        if (!resolveDestinations()) return 1;
+        m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (m_socket == -1)
+        {
+            perror("RTP output socket");
+            return 1;
+        }
+        const int sndbuf = RTP_OUT_SNDBUF;
+        setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        const int tos = 0x88; // DSCP AF41, video
+        setsockopt(m_socket, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+        const int ttl = 4;
+        setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+        std::cout << "RTP output: /dev/shm/" << m_options.ring << " to";
+        for (const auto &destination : m_options.destinations) std::cout << " " << destination;
+        std::cout << (m_options.rate_kbps > 0 ? ", paced at " + std::to_string(m_options.rate_kbps) + " kbit/s" : "") << std::endl;
+
+        m_window_start = std::chrono::steady_clock::now();
+        m_bucket_time = m_window_start;
+        while (!g_rtp_out_stop)
+        {
+            if (!m_ring.isOpen() && !openRing())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
+            if (!m_ring.waitFor(m_next, 500))
+            {
+                if (ringInode() != m_inode) m_ring.close(); // producer restarted or went away
+            }
+            else
+            {
+                sendFrame();
+            }
+            if (m_options.stats_sec > 0 && std::chrono::steady_clock::now() - m_window_start >= std::chrono::seconds(m_options.stats_sec))
+            {
+                printStats();
+            }
+        }
+        printStats();
+        close(m_socket);
+        return 0;
+    }
+
+private:
+    bool resolveDestinations()
+    {
+        for (const auto &destination : m_options.destinations)
+        {
+            const size_t colon = destination.rfind(':');
+            if (colon == std::string::npos || colon == 0)
+            {
+                std::cerr << "RTP output: destination must be host:port, got " << destination << std::endl;
+                return false;
+            }
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_DGRAM;
+            struct addrinfo *result = nullptr;
+            if (getaddrinfo(destination.substr(0, colon).c_str(), destination.substr(colon + 1).c_str(), &hints, &result) != 0 || !result)
+            {
+                std::cerr << "RTP output: cannot resolve " << destination << std::endl;
+                return false;
+            }
+            m_addresses.push_back(*reinterpret_cast<struct sockaddr_in *>(result->ai_addr));
+            freeaddrinfo(result);
+        }
+        if (m_addresses.empty())
+        {
+            std::cerr << "RTP output: no destination" << std::endl;
+            return false;
+        }
+        m_options.mtu = std::max(200, std::min(m_options.mtu, 65000));
+        m_options.batch = std::max(1, std::min(m_options.batch, 1024));
+        return true;
+    }
+
+    ino_t ringInode() const
+    {
+        struct stat st;
+        return stat(("/dev/shm/" + m_options.ring).c_str(), &st) == 0 ? st.st_ino : 0;
+    }
+
+    bool openRing()
+    {
+        m_inode = ringInode();
+        if (m_inode == m_rejected_inode || !m_ring.open(m_options.ring)) return false;
+        const ShmRingHeader &info = m_ring.info();
+        if (info.format != SHM_FORMAT_H264 && info.format != SHM_FORMAT_Y16 && info.format != SHM_FORMAT_YU12)
+        {
+            std::cerr << "RTP output: unsupported format in /dev/shm/" << m_options.ring << std::endl;
+            m_rejected_inode = m_inode; // wait for the producer to recreate it
+            m_ring.close();
+            return false;
+        }
+        m_h264 = info.format == SHM_FORMAT_H264;
+        const uint64_t key = m_h264 ? m_ring.latestKeyframe() : 0;
+        m_next = key ? key : m_ring.latest() + 1;
+        m_need_key = m_h264;
+        std::cout << "RTP output: sending /dev/shm/" << m_options.ring << " from frame " << m_next << std::endl;
+        writeSdp();
+        return true;
+    }
+
+    void sendFrame()
+    {
+        ShmFrameInfo frame;
+        const uint8_t *data = m_ring.peek(m_next, frame);
+        if (!data)
+        {
+            // Overwritten before we got to it
+            ++m_skipped;
+            const uint64_t key = m_h264 ? m_ring.latestKeyframe() : 0;
+            m_next = key > m_next ? key : m_ring.latest();
+            m_need_key = m_h264;
+            return;
+        }
+        const uint64_t seq = m_next++;
+        if (m_h264)
+        {
+            if (frame.flags & SHM_SLOT_DISCONTINUITY) m_need_key = true;
+            if (m_need_key && !(frame.flags & SHM_SLOT_KEYFRAME))
+            {
+                ++m_skipped;
+                return;
+            }
+            m_need_key = false;
+        }
+
+        const uint32_t timestamp = static_cast<uint32_t>(frame.pts != 0 ? frame.pts : static_cast<int64_t>(frame.timestamp_ns / 100000 * 9));
+        m_packets.clear();
+        if (m_h264) packetizeH264(data, frame.bytes, timestamp);
+        else packetizeRaw(data, frame.bytes, timestamp);
+        if (m_packets.empty()) return;
+        m_packets.back().header[1] |= 0x80; // marker: last packet of the frame
+
+        for (size_t first = 0; first < m_packets.size() && !g_rtp_out_stop; first += m_options.batch)
+        {
+            const size_t count = std::min<size_t>(m_options.batch, m_packets.size() - first);
+            pace(first, count); // may sleep, so the slot is checked after it
+            if (torn(seq)) return;
+            sendBatch(first, count);
+            if (torn(seq)) return; // overwritten while the kernel copied the batch
+        }
+        ++m_frames;
+    }
+
+    /**
+     * @brief True (and waits for a keyframe) if the producer caught up with us mid-frame.
+     */
+    bool torn(uint64_t seq)
+    {
+        if (!m_h264 || m_ring.intact(seq)) return false;
+        ++m_torn;
+        m_need_key = true;
+        return true;
+    }
+
+    /**
+     * @brief RFC 6184 mode 1: one packet per NAL unit, FU-A if it does not fit.
+     */
+    void packetizeH264(const uint8_t *au, size_t size, uint32_t timestamp)
+    {
+        const size_t max_payload = m_options.mtu - 12;
+        size_t pos = 0;
+        while (pos < size)
+        {
+            // The next NAL runs from after its start code to the following one
+            const size_t start = findStartCode(au, pos, size) + 3;
+            if (start > size) break;
+            pos = findStartCode(au, start, size);
+            size_t end = std::min(pos, size);
+            while (end > start && au[end - 1] == 0) --end; // zero byte of a 4-byte start code
+            if (end <= start) continue;
+
+            const uint8_t *nal = au + start;
+            const size_t nal_size = end - start;
+            if ((nal[0] & 0x1f) == 9) continue; // AUD: the marker bit delimits frames in RTP
+            if (nal_size <= max_payload)
+            {
+                RtpOutPacket packet;
+                writeHeader(packet, timestamp);
+                packet.payload = nal;
+                packet.payload_size = nal_size;
+                m_packets.push_back(packet);
+                continue;
+            }
+            // FU-A: indicator (F, NRI, type 28) and header (S, E, type) in front of each fragment
+            const size_t fragment = max_payload - 2;
+            for (size_t offset = 1; offset < nal_size; offset += fragment)
+            {
+                RtpOutPacket packet;
+                writeHeader(packet, timestamp);
+                packet.header[12] = (nal[0] & 0xe0) | 28;
+                packet.header[13] = (nal[0] & 0x1f) | (offset == 1 ? 0x80 : 0) | (offset + fragment >= nal_size ? 0x40 : 0);
+                packet.header_size = 14;
+                packet.payload = nal + offset;
+                packet.payload_size = std::min(fragment, nal_size - offset);
+                m_packets.push_back(packet);
+            }
+        }
+    }
+
+    static size_t findStartCode(const uint8_t *data, size_t from, size_t size)
+    {
+        for (size_t i = from; i + 3 <= size; ++i)
+        {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) return i;
+        }
+        return size;
+    }
+
+    /**
+     * @brief RFC 4175: line segments, several per packet. The payload is
+     *        repacked into m_raw (pgroup order, network byte order).
+     */
+    void packetizeRaw(const uint8_t *frame, size_t size, uint32_t timestamp)
+    {
+        const ShmRingHeader &info = m_ring.info();
+        const bool yuv420 = info.format == SHM_FORMAT_YU12;
+        const uint32_t width = info.width, height = info.height;
+        const size_t pgroup = yuv420 ? 6 : 2;          // bytes per pgroup
+        const uint32_t pgroup_pixels = yuv420 ? 2 : 1; // pixels per pgroup along the line
+        const uint32_t line_step = yuv420 ? 2 : 1;     // a 4:2:0 pgroup covers two lines
+        const size_t needed = yuv420 ? size_t(width) * height * 3 / 2 : size_t(width) * height * 2;
+        if (width == 0 || height == 0 || size < needed) return;
+
+        std::vector<size_t> offsets;
+        size_t used = 0;
+        uint32_t line = 0, pixel = 0;
+        while (line < height)
+        {
+            // Plan the segments of one packet
+            uint32_t seg_line[RTP_OUT_MAX_SEGMENTS], seg_pixel[RTP_OUT_MAX_SEGMENTS], seg_pixels[RTP_OUT_MAX_SEGMENTS];
+            int segments = 0;
+            size_t room = m_options.mtu - 12 - 2;
+            while (line < height && segments < RTP_OUT_MAX_SEGMENTS && room >= 6 + pgroup)
+            {
+                const uint32_t fit = static_cast<uint32_t>((room - 6) / pgroup) * pgroup_pixels;
+                const uint32_t count = std::min(fit, width - pixel);
+                seg_line[segments] = line;
+                seg_pixel[segments] = pixel;
+                seg_pixels[segments] = count;
+                ++segments;
+                room -= 6 + count / pgroup_pixels * pgroup;
+                pixel += count;
+                if (pixel >= width)
+                {
+                    pixel = 0;
+                    line += line_step;
+                }
+            }
+
+            RtpOutPacket packet;
+            const uint16_t extended = m_extended;
+            writeHeader(packet, timestamp);
+            packet.header[12] = static_cast<uint8_t>(extended >> 8); // high 16 bits of the sequence number
+            packet.header[13] = static_cast<uint8_t>(extended);
+            packet.header_size = 14;
+            if (m_raw.size() < used + m_options.mtu) m_raw.resize(used + m_options.mtu + size / 4);
+            uint8_t *const begin = m_raw.data() + used;
+            uint8_t *out = begin;
+            for (int i = 0; i < segments; ++i)
+            {
+                const uint32_t length = seg_pixels[i] / pgroup_pixels * pgroup;
+                const uint32_t offset = seg_pixel[i] | (i + 1 < segments ? 0x8000 : 0); // C: another header follows
+                *out++ = length >> 8;
+                *out++ = length & 0xff;
+                *out++ = (seg_line[i] >> 8) & 0x7f;
+                *out++ = seg_line[i] & 0xff;
+                *out++ = offset >> 8;
+                *out++ = offset & 0xff;
+            }
+            for (int i = 0; i < segments; ++i)
+            {
+                const uint32_t y = seg_line[i];
+                if (yuv420)
+                {
+                    const uint8_t *y0 = frame + size_t(y) * width, *y1 = y0 + width;
+                    const uint8_t *u = frame + size_t(width) * height + size_t(y / 2) * (width / 2);
+                    const uint8_t *v = u + size_t(width / 2) * (height / 2);
+                    for (uint32_t x = seg_pixel[i]; x < seg_pixel[i] + seg_pixels[i]; x += 2)
+                    {
+                        *out++ = y0[x];
+                        *out++ = y0[x + 1];
+                        *out++ = y1[x];
+                        *out++ = y1[x + 1];
+                        *out++ = u[x / 2];
+                        *out++ = v[x / 2];
+                    }
+                }
+                else
+                {
+                    const uint8_t *row = frame + size_t(y) * width * 2;
+                    for (uint32_t x = seg_pixel[i]; x < seg_pixel[i] + seg_pixels[i]; ++x)
+                    {
+                        *out++ = row[2 * x + 1]; // little-endian in the ring, big-endian on the wire
+                        *out++ = row[2 * x];
+                    }
+                }
+            }
+            packet.payload_size = out - begin;
+            offsets.push_back(used);
+            used += packet.payload_size;
+            m_packets.push_back(packet);
+        }
+        // m_raw may have moved while growing
+        for (size_t i = 0; i < m_packets.size(); ++i) m_packets[i].payload = m_raw.data() + offsets[i];
+    }
+
+    void writeHeader(RtpOutPacket &packet, uint32_t timestamp)
+    {
+        const uint16_t sequence = m_sequence++;
+        if (sequence == 0xffff) ++m_extended;
+        packet.header[0] = 0x80;
+        packet.header[1] = RTP_OUT_PAYLOAD_TYPE;
+        packet.header[2] = sequence >> 8;
+        packet.header[3] = sequence & 0xff;
+        packet.header[4] = timestamp >> 24;
+        packet.header[5] = (timestamp >> 16) & 0xff;
+        packet.header[6] = (timestamp >> 8) & 0xff;
+        packet.header[7] = timestamp & 0xff;
+        packet.header[8] = m_ssrc >> 24;
+        packet.header[9] = (m_ssrc >> 16) & 0xff;
+        packet.header[10] = (m_ssrc >> 8) & 0xff;
+        packet.header[11] = m_ssrc & 0xff;
+        packet.header_size = 12;
+    }
+
+    /**
+     * @brief Token bucket: waits until the batch may go out at --stream-rate-kbps.
+     *        The bucket holds at most one batch, so idle time is not saved up into a burst.
+     */
+    void pace(size_t first, size_t count)
+    {
+        if (m_options.rate_kbps <= 0) return;
+        size_t bytes = 0;
+        for (size_t i = first; i < first + count; ++i) bytes += m_packets[i].header_size + m_packets[i].payload_size;
+        const double rate = m_options.rate_kbps * 1000.0 / 8.0; // bytes per second
+        const auto now = std::chrono::steady_clock::now();
+        m_tokens = std::min(m_tokens + std::chrono::duration<double>(now - m_bucket_time).count() * rate, static_cast<double>(bytes));
+        m_bucket_time = now;
+        if (m_tokens < bytes)
+        {
+            const double wait = (bytes - m_tokens) / rate;
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            m_bucket_time = std::chrono::steady_clock::now();
+            m_tokens = bytes;
+        }
+        m_tokens -= bytes;
+    }
+
+    void sendBatch(size_t first, size_t count)
+    {
+        const size_t receivers = m_addresses.size();
+        m_iov.resize(count * 2);
+        m_messages.resize(count * receivers);
+        for (size_t i = 0; i < count; ++i)
+        {
+            RtpOutPacket &packet = m_packets[first + i];
+            m_iov[2 * i].iov_base = packet.header;
+            m_iov[2 * i].iov_len = packet.header_size;
+            m_iov[2 * i + 1].iov_base = const_cast<uint8_t *>(packet.payload);
+            m_iov[2 * i + 1].iov_len = packet.payload_size;
+            for (size_t r = 0; r < receivers; ++r)
+            {
+                struct msghdr &message = m_messages[r * count + i].msg_hdr;
+                std::memset(&message, 0, sizeof(message));
+                message.msg_name = &m_addresses[r];
+                message.msg_namelen = sizeof(m_addresses[r]);
+                message.msg_iov = &m_iov[2 * i];
+                message.msg_iovlen = 2;
+            }
+        }
+        size_t sent = 0;
+        while (sent < m_messages.size())
+        {
+            const int result = sendmmsg(m_socket, m_messages.data() + sent, m_messages.size() - sent, 0);
+            if (result < 0)
+            {
+                if (errno == EINTR) continue;
+                // Unreachable receiver (ECONNREFUSED from an earlier ICMP) or full queue: skip this message
+                ++m_send_errors;
+                ++sent;
+                continue;
+            }
+            ++m_syscalls;
+            sent += result;
+        }
+        m_packets_sent += m_messages.size();
+        for (size_t i = 0; i < count; ++i) m_bytes += (m_packets[first + i].header_size + m_packets[first + i].payload_size) * receivers;
+    }
+
+    void writeSdp()
+    {
+        if (m_options.sdp_path.empty()) return;
+        const ShmRingHeader &info = m_ring.info();
+        std::ofstream sdp(m_options.sdp_path);
+        sdp << "v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=DroneEngage " << m_options.ring << "\r\n"
+            << "c=IN IP4 " << inet_ntoa(m_addresses[0].sin_addr) << "\r\nt=0 0\r\n"
+            << "m=video " << ntohs(m_addresses[0].sin_port) << " RTP/AVP " << RTP_OUT_PAYLOAD_TYPE << "\r\n";
+        if (m_h264)
+        {
+            sdp << "a=rtpmap:" << RTP_OUT_PAYLOAD_TYPE << " H264/90000\r\n"
+                << "a=fmtp:" << RTP_OUT_PAYLOAD_TYPE << " packetization-mode=1\r\n";
+        }
+        else
+        {
+            sdp << "a=rtpmap:" << RTP_OUT_PAYLOAD_TYPE << " raw/90000\r\n"
+                << "a=fmtp:" << RTP_OUT_PAYLOAD_TYPE << " sampling=" << (info.format == SHM_FORMAT_YU12 ? "YCbCr-4:2:0; depth=8" : "GRAYSCALE; depth=16")
+                << "; width=" << info.width << "; height=" << info.height << "; colorimetry=BT601-5\r\n";
+        }
+        std::cout << "RTP output: SDP written to " << m_options.sdp_path << std::endl;
+    }
+
+    void printStats()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::max(1e-3, std::chrono::duration<double>(now - m_window_start).count());
+        std::cout << "RTP output: " << std::fixed << std::setprecision(1) << (m_frames - m_window_frames) / seconds << " fps, "
+                  << (m_bytes - m_window_bytes) * 8 / seconds / 1000.0 << " kbit/s to " << m_addresses.size() << " receiver(s), "
+                  << std::setprecision(1) << (m_syscalls > 0 ? double(m_packets_sent) / m_syscalls : 0.0) << " packets per syscall, "
+                  << m_skipped << " frames skipped, " << m_torn << " overwritten while sending, " << m_send_errors << " send errors"
+                  << std::defaultfloat << std::endl;
+        m_window_start = now;
+        m_window_frames = m_frames;
+        m_window_bytes = m_bytes;
+    }
+
+    RtpOutOptions m_options;
+    ShmRingReader m_ring;
+    ino_t m_inode = 0, m_rejected_inode = 0;
+    uint64_t m_next = 0;
+    bool m_h264 = false;
+    bool m_need_key = true;
+    int m_socket = -1;
+    std::vector<struct sockaddr_in> m_addresses;
+    std::vector<RtpOutPacket> m_packets;
+    std::vector<uint8_t> m_raw;
+    std::vector<struct iovec> m_iov;
+    std::vector<struct mmsghdr> m_messages;
+    uint32_t m_ssrc = 0;
+    uint16_t m_sequence = 0;
+    uint16_t m_extended = 0;
+    double m_tokens = 0.0;
+    std::chrono::steady_clock::time_point m_bucket_time;
+    std::chrono::steady_clock::time_point m_window_start;
+    uint64_t m_frames = 0, m_bytes = 0, m_packets_sent = 0, m_syscalls = 0;
+    uint64_t m_skipped = 0, m_torn = 0, m_send_errors = 0;
+    uint64_t m_window_frames = 0, m_window_bytes = 0;
+};
+
+#endif // DE_RTP_OUT_HPP
@@ -0,0 +1,712 @@
+//***************************************************************************** */
+//  Minimal RTSP client for H.264 camera streams
+//
+//  Just enough RTSP (RFC 2326) for gimbal and IP cameras: OPTIONS, DESCRIBE,
+//  SETUP of the first H.264 video track, PLAY, keepalive and TEARDOWN. RTP
+//  comes either interleaved on the RTSP connection (TCP) or on a UDP port
+//  pair. There is no probing: the codec and SPS/PPS come from the SDP, and
+//  every packet is handed on as soon as it is in order.
+//
+//  RtpJitterBuffer restores sequence order for UDP, waiting at most a few
+//  milliseconds for a missing packet before skipping it. TCP delivers in
+//  order, so there it passes packets straight through.
+//
+//  Authentication: Basic only (user:password@ in the URL).
+//
+//***************************************************************************** */
+
+#ifndef DE_RTSP_HPP
+#define DE_RTSP_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define RTSP_USER_AGENT "DroneEngage-camera-wrapper"
+#define RTSP_DEFAULT_PORT 554
+#define RTSP_UDP_FIRST_PORT 50000
+#define RTSP_UDP_LAST_PORT 50998
+#define RTSP_MAX_HEADER 16384
+#define RTP_JITTER_MAX_PACKETS 256
+
+/**
+ * @brief rtsp://[user:password@]host[:port]/path
+ */
+struct RtspUrl
+{
+    std::string url; // without credentials, as sent in requests
+    std::string host;
+    int port = RTSP_DEFAULT_PORT;
+    std::string user;
+    std::string password;
+
+    bool parse(const std::string &text)
+    {
+        if (text.rfind("rtsp://", 0) != 0) return false;
+        std::string rest = text.substr(7);
+        const size_t slash = rest.find('/');
+        std::string authority = rest.substr(0, slash);
+        const std::string path = slash == std::string::npos ? "/" : rest.substr(slash);
+        const size_t at = authority.rfind('@');
+        if (at != std::string::npos)
+        {
+            const std::string credentials = authority.substr(0, at);
+            authority = authority.substr(at + 1);
+            const size_t colon = credentials.find(':');
+            user = credentials.substr(0, colon);
+            password = colon == std::string::npos ? "" : credentials.substr(colon + 1);
+        }
+        const size_t colon = authority.rfind(':');
+        host = authority.substr(0, colon);
+        if (colon != std::string::npos) port = std::atoi(authority.c_str() + colon + 1);
+        if (host.empty() || port <= 0) return false;
+        url = "rtsp://" + authority + path;
+        return true;
+    }
+};
+
+inline std::string base64Encode(const std::string &in)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3)
+    {
+        const uint32_t v = (uint8_t(in[i]) << 16) | (uint8_t(in[i + 1]) << 8) | uint8_t(in[i + 2]);
+        out += table[v >> 18];
+        out += table[(v >> 12) & 63];
+        out += table[(v >> 6) & 63];
+        out += table[v & 63];
+    }
+    if (i < in.size())
+    {
+        const uint32_t v = (uint8_t(in[i]) << 16) | (i + 1 < in.size() ? uint8_t(in[i + 1]) << 8 : 0);
+        out += table[v >> 18];
+        out += table[(v >> 12) & 63];
+        out += i + 1 < in.size() ? table[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+inline std::vector<uint8_t> base64Decode(const std::string &in)
+{
+    std::vector<uint8_t> out;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in)
+    {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else continue;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back(static_cast<uint8_t>(acc >> bits));
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief The H.264 video track of an SDP description.
+ */
+struct SdpVideo
+{
+    int payload_type = -1;
+    int clock_rate = 90000;
+    std::string control;
+    std::vector<std::vector<uint8_t>> parameter_sets; // from sprop-parameter-sets
+};
+
+inline bool parseSdpVideo(const std::string &sdp, SdpVideo &video)
+{
+    std::istringstream in(sdp);
+    std::string line;
+    bool in_video = false;
+    std::vector<int> payload_types;
+    std::map<int, std::string> fmtp;
+    std::map<int, std::string> rtpmap;
+    std::string control;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.rfind("m=", 0) == 0)
+        {
+            if (in_video) break; // only the first video track
+            in_video = line.rfind("m=video", 0) == 0;
+            if (!in_video) continue;
+            std::istringstream fields(line);
+            std::string media, port, proto;
+            int pt;
+            fields >> media >> port >> proto;
+            while (fields >> pt) payload_types.push_back(pt);
+            continue;
+        }
+        if (!in_video) continue;
+        if (line.rfind("a=rtpmap:", 0) == 0) rtpmap[std::atoi(line.c_str() + 9)] = line.substr(line.find(' ') + 1);
+        else if (line.rfind("a=fmtp:", 0) == 0) fmtp[std::atoi(line.c_str() + 7)] = line.substr(line.find(' ') + 1);
+        else if (line.rfind("a=control:", 0) == 0) control = line.substr(10);
+    }
+    for (int pt : payload_types)
+    {
+        const auto map = rtpmap.find(pt);
+        if (map == rtpmap.end() || strncasecmp(map->second.c_str(), "H264/", 5) != 0) continue;
+        video.payload_type = pt;
+        video.clock_rate = std::atoi(map->second.c_str() + 5);
+        video.control = control;
+        const std::string params = fmtp[pt];
+        const size_t sprop = params.find("sprop-parameter-sets=");
+        if (sprop != std::string::npos)
+        {
+            std::string sets = params.substr(sprop + 21);
+            sets = sets.substr(0, sets.find(';'));
+            size_t start = 0;
+            while (start <= sets.size())
+            {
+                const size_t comma = sets.find(',', start);
+                video.parameter_sets.push_back(base64Decode(sets.substr(start, comma - start)));
+                if (comma == std::string::npos) break;
+                start = comma + 1;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+struct RtspResponse
+{
+    int status = 0;
+    std::map<std::string, std::string> headers; // lower-case names
+    std::string body;
+
+    std::string header(const std::string &name) const
+    {
+        const auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+};
+
+/**
+ * @brief One RTSP session playing the H.264 track of a URL.
+ */
+class RtspSession
+{
+public:
+    ~RtspSession() { close(); }
+
+    /**
+     * @brief Connects, negotiates and starts playback.
+     */
+    bool open(const RtspUrl &url, bool tcp, int timeout_ms, std::string &error)
+    {
+        close();
+        m_url = url;
+        m_tcp = tcp;
+        m_timeout_ms = timeout_ms;
+        m_cseq = 0;
+        m_session.clear();
+        m_buffer.clear();
+        m_pending.clear();
+        m_video = SdpVideo();
+
+        if (!connectTcp(error)) return false;
+        RtspResponse response;
+        if (!request("OPTIONS", url.url, "", response, error)) return false;
+        if (!request("DESCRIBE", url.url, "Accept: application/sdp\r\n", response, error)) return false;
+        if (!parseSdpVideo(response.body, m_video))
+        {
+            error = "no H.264 video track in the SDP";
+            return false;
+        }
+
+        std::string base = response.header("content-base");
+        if (base.empty()) base = response.header("content-location");
+        if (base.empty()) base = url.url;
+        std::string track = base;
+        if (m_video.control.rfind("rtsp://", 0) == 0) track = m_video.control;
+        else if (!m_video.control.empty() && m_video.control != "*") track = (base.back() == '/' ? base : base + "/") + m_video.control;
+
+        std::string transport;
+        if (m_tcp)
+        {
+            transport = "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n";
+        }
+        else
+        {
+            if (!bindUdpPair(error)) return false;
+            transport = "Transport: RTP/AVP;unicast;client_port=" + std::to_string(m_udp_port) + "-" + std::to_string(m_udp_port + 1) + "\r\n";
+        }
+        if (!request("SETUP", track, transport, response, error)) return false;
+        m_session = response.header("session");
+        const size_t semicolon = m_session.find(';');
+        if (semicolon != std::string::npos)
+        {
+            const size_t timeout = m_session.find("timeout=", semicolon);
+            if (timeout != std::string::npos) m_session_timeout_sec = std::max(5, std::atoi(m_session.c_str() + timeout + 8));
+            m_session = m_session.substr(0, semicolon);
+        }
+        const std::string reply_transport = response.header("transport");
+        const size_t interleaved = reply_transport.find("interleaved=");
+        if (interleaved != std::string::npos) m_rtp_channel = std::atoi(reply_transport.c_str() + interleaved + 12);
+
+        if (!request("PLAY", base, "Range: npt=0.000-\r\n", response, error)) return false;
+        m_last_keepalive = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    /**
+     * @brief Sends TEARDOWN (best effort) and closes the sockets.
+     */
+    void close()
+    {
+        if (m_sock != -1 && !m_session.empty())
+        {
+            const std::string text = "TEARDOWN " + m_url.url + " RTSP/1.0\r\nCSeq: " + std::to_string(++m_cseq) + "\r\nSession: " + m_session + "\r\n\r\n";
+            (void)::send(m_sock, text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+        for (int *fd : {&m_sock, &m_rtp_sock, &m_rtcp_sock})
+        {
+            if (*fd != -1) ::close(*fd);
+            *fd = -1;
+        }
+        m_session.clear();
+    }
+
+    const SdpVideo &video() const { return m_video; }
+
+    /**
+     * @brief Waits up to timeout_ms for the next RTP packet of the video track.
+     * @return 1 with a packet, 0 on timeout, -1 if the connection failed.
+     */
+    int readRtp(std::vector<uint8_t> &packet, int timeout_ms)
+    {
+        keepAlive();
+        if (!m_pending.empty())
+        {
+            packet.swap(m_pending.front());
+            m_pending.pop_front();
+            return 1;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true)
+        {
+            if (m_tcp)
+            {
+                const int got = takeInterleaved(packet);
+                if (got != 0) return got;
+            }
+            const int remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+            if (remaining <= 0) return 0;
+
+            struct pollfd fds[2];
+            fds[0] = {m_sock, POLLIN, 0};
+            fds[1] = {m_rtp_sock, POLLIN, 0};
+            const int n = poll(fds, m_tcp ? 1 : 2, remaining);
+            if (n < 0 && errno != EINTR) return -1;
+            if (n <= 0) continue;
+            if (fds[0].revents)
+            {
+                if (!receive()) return -1;
+                if (!m_tcp) m_buffer.clear(); // keepalive replies
+            }
+            if (!m_tcp && (fds[1].revents & POLLIN))
+            {
+                packet.resize(65536);
+                const ssize_t len = recv(m_rtp_sock, packet.data(), packet.size(), 0);
+                if (len < 12) continue;
+                packet.resize(len);
+                if ((packet[1] & 0x7f) != m_video.payload_type) continue;
+                return 1;
+            }
+        }
+    }
+
+private:
+    bool connectTcp(std::string &error)
+    {
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(m_url.host.c_str(), std::to_string(m_url.port).c_str(), &hints, &result) != 0 || !result)
+        {
+            error = "cannot resolve " + m_url.host;
+            return false;
+        }
+        m_sock = socket(result->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        m_peer_family = result->ai_family;
+        std::memcpy(&m_peer, result->ai_addr, result->ai_addrlen);
+        m_peer_len = result->ai_addrlen;
+        freeaddrinfo(result);
+        if (m_sock == -1)
+        {
+            error = std::string("socket: ") + strerror(errno);
+            return false;
+        }
+
+        // Non-blocking connect so a dead gimbal link fails within timeout_ms
+        fcntl(m_sock, F_SETFL, O_NONBLOCK);
+        if (::connect(m_sock, reinterpret_cast<struct sockaddr *>(&m_peer), m_peer_len) == -1 && errno != EINPROGRESS)
+        {
+            error = std::string("connect: ") + strerror(errno);
+            return false;
+        }
+        struct pollfd pfd = {m_sock, POLLOUT, 0};
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        if (poll(&pfd, 1, m_timeout_ms) != 1 || getsockopt(m_sock, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1 || so_error != 0)
+        {
+            error = "connect to " + m_url.host + ":" + std::to_string(m_url.port) + " failed" + (so_error ? std::string(": ") + strerror(so_error) : " (timeout)");
+            return false;
+        }
+        const int one = 1;
+        setsockopt(m_sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    bool bindUdpPair(std::string &error)
+    {
+        for (int port = RTSP_UDP_FIRST_PORT; port <= RTSP_UDP_LAST_PORT; port += 2)
+        {
+            const int rtp = socket(m_peer_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            const int rtcp = socket(m_peer_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            struct sockaddr_storage addr;
+            std::memset(&addr, 0, sizeof(addr));
+            socklen_t len;
+            if (m_peer_family == AF_INET6)
+            {
+                reinterpret_cast<struct sockaddr_in6 &>(addr).sin6_family = AF_INET6;
+                len = sizeof(struct sockaddr_in6);
+            }
+            else
+            {
+                reinterpret_cast<struct sockaddr_in &>(addr).sin_family = AF_INET;
+                len = sizeof(struct sockaddr_in);
+            }
+            auto bindPort = [&](int fd, int p) {
+                if (m_peer_family == AF_INET6) reinterpret_cast<struct sockaddr_in6 &>(addr).sin6_port = htons(p);
+                else reinterpret_cast<struct sockaddr_in &>(addr).sin_port = htons(p);
+                return fd != -1 && bind(fd, reinterpret_cast<struct sockaddr *>(&addr), len) == 0;
+            };
+            if (bindPort(rtp, port) && bindPort(rtcp, port + 1))
+            {
+                const int size = 4 * 1024 * 1024; // absorb keyframe bursts; capped by net.core.rmem_max
+                setsockopt(rtp, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+                m_rtp_sock = rtp;
+                m_rtcp_sock = rtcp;
+                m_udp_port = port;
+                return true;
+            }
+            if (rtp != -1) ::close(rtp);
+            if (rtcp != -1) ::close(rtcp);
+        }
+        error = "no free UDP port pair for RTP";
+        return false;
+    }
+
+    // Reads more bytes from the RTSP connection into m_buffer
+    bool receive()
+    {
+        char chunk[65536];
+        const ssize_t n = recv(m_sock, chunk, sizeof(chunk), 0);
+        if (n > 0)
+        {
+            m_buffer.append(chunk, n);
+            return true;
+        }
+        return n == -1 && (errno == EAGAIN || errno == EINTR);
+    }
+
+    /**
+     * @brief Takes the '$' frame at the front of m_buffer.
+     * @return 1 = video packet, 2 = other channel (RTCP) skipped, 0 = incomplete.
+     */
+    int takeFrame(std::vector<uint8_t> &packet)
+    {
+        if (m_buffer.size() < 4) return 0;
+        const int channel = static_cast<uint8_t>(m_buffer[1]);
+        const size_t length = (static_cast<uint8_t>(m_buffer[2]) << 8) | static_cast<uint8_t>(m_buffer[3]);
+        if (m_buffer.size() < 4 + length) return 0;
+        const bool video = channel == m_rtp_channel && length >= 12;
+        if (video) packet.assign(m_buffer.begin() + 4, m_buffer.begin() + 4 + length);
+        m_buffer.erase(0, 4 + length);
+        return video ? 1 : 2;
+    }
+
+    /**
+     * @brief Takes the next video packet from m_buffer, skipping other channels and
+     *        RTSP (keepalive) replies. 1 = packet, 0 = need more data, -1 = bad stream.
+     */
+    int takeInterleaved(std::vector<uint8_t> &packet)
+    {
+        while (!m_buffer.empty())
+        {
+            if (m_buffer[0] == '$')
+            {
+                const int got = takeFrame(packet);
+                if (got != 2) return got;
+                continue;
+            }
+            if (m_buffer[0] == 'R')
+            {
+                RtspResponse ignored;
+                const int parsed = parseResponse(ignored);
+                if (parsed <= 0) return parsed; // keepalive reply incomplete, or garbage
+                continue;
+            }
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Parses one RTSP reply from the front of m_buffer. 1 = done, 0 = incomplete, -1 = bad.
+     */
+    int parseResponse(RtspResponse &response)
+    {
+        const size_t end = m_buffer.find("\r\n\r\n");
+        if (end == std::string::npos) return m_buffer.size() > RTSP_MAX_HEADER ? -1 : 0;
+        std::istringstream head(m_buffer.substr(0, end));
+        std::string line;
+        std::getline(head, line);
+        if (line.rfind("RTSP/", 0) != 0) return -1;
+        response.status = std::atoi(line.c_str() + line.find(' ') + 1);
+        response.headers.clear();
+        while (std::getline(head, line))
+        {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            const size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            const size_t value = line.find_first_not_of(' ', colon + 1);
+            response.headers[name] = value == std::string::npos ? "" : line.substr(value);
+        }
+        const size_t length = std::strtoul(response.header("content-length").c_str(), nullptr, 10);
+        if (m_buffer.size() < end + 4 + length) return 0;
+        response.body = m_buffer.substr(end + 4, length);
+        m_buffer.erase(0, end + 4 + length);
+        return 1;
+    }
+
+    bool request(const std::string &method, const std::string &url, const std::string &headers, RtspResponse &response, std::string &error)
+    {
+        std::string text = method + " " + url + " RTSP/1.0\r\nCSeq: " + std::to_string(++m_cseq) + "\r\nUser-Agent: " RTSP_USER_AGENT "\r\n";
+        if (!m_url.user.empty()) text += "Authorization: Basic " + base64Encode(m_url.user + ":" + m_url.password) + "\r\n";
+        if (!m_session.empty()) text += "Session: " + m_session + "\r\n";
+        text += headers + "\r\n";
+        if (!sendAll(text))
+        {
+            error = method + ": send failed";
+            return false;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout_ms);
+        while (true)
+        {
+            // RTP may already arrive interleaved before the PLAY reply
+            while (!m_buffer.empty() && m_buffer[0] == '$')
+            {
+                std::vector<uint8_t> packet;
+                const int got = takeFrame(packet);
+                if (got == 0) break;
+                if (got == 1) m_pending.push_back(packet);
+            }
+            if (m_buffer.empty() || m_buffer[0] != '$')
+            {
+                const int parsed = parseResponse(response);
+                if (parsed < 0)
+                {
+                    error = method + ": malformed reply";
+                    return false;
+                }
+                if (parsed > 0) break;
+            }
+            const int remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+            struct pollfd pfd = {m_sock, POLLIN, 0};
+            if (remaining <= 0 || poll(&pfd, 1, remaining) <= 0 || !receive())
+            {
+                error = method + ": no reply";
+                return false;
+            }
+        }
+        if (response.status == 401)
+        {
+            error = method + ": unauthorized" + (m_url.user.empty() ? " (credentials required)" : " (only Basic authentication is supported)");
+            return false;
+        }
+        if (response.status != 200)
+        {
+            error = method + ": status " + std::to_string(response.status);
+            return false;
+        }
+        return true;
+    }
+
+    bool sendAll(const std::string &text)
+    {
+        size_t done = 0;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout_ms);
+        while (done < text.size())
+        {
+            const ssize_t n = ::send(m_sock, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                done += n;
+                continue;
+            }
+            if (n == -1 && errno != EAGAIN && errno != EINTR) return false;
+            struct pollfd pfd = {m_sock, POLLOUT, 0};
+            if (std::chrono::steady_clock::now() >= deadline || poll(&pfd, 1, 100) < 0) return false;
+        }
+        return true;
+    }
+
+    // OPTIONS every half session timeout keeps servers from dropping us; the reply is skipped when read
+    void keepAlive()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_keepalive < std::chrono::seconds(m_session_timeout_sec / 2)) return;
+        m_last_keepalive = now;
+        sendAll("OPTIONS " + m_url.url + " RTSP/1.0\r\nCSeq: " + std::to_string(++m_cseq) + "\r\nSession: " + m_session + "\r\n\r\n");
+    }
+
+    RtspUrl m_url;
+    bool m_tcp = true;
+    int m_timeout_ms = 3000;
+    int m_sock = -1;
+    int m_rtp_sock = -1;
+    int m_rtcp_sock = -1;
+    int m_udp_port = 0;
+    int m_peer_family = AF_INET;
+    struct sockaddr_storage m_peer;
+    socklen_t m_peer_len = 0;
+    int m_cseq = 0;
+    std::string m_session;
+    int m_session_timeout_sec = 60;
+    int m_rtp_channel = 0;
+    std::string m_buffer;
+    std::deque<std::vector<uint8_t>> m_pending;
+    SdpVideo m_video;
+    std::chrono::steady_clock::time_point m_last_keepalive;
+};
+
+/**
+ * @brief Reorders RTP packets by sequence number with a bounded wait for gaps.
+ */
+class RtpJitterBuffer
+{
+public:
+    explicit RtpJitterBuffer(int max_delay_ms = 0) : m_max_delay(std::chrono::milliseconds(max_delay_ms)) {}
+
+    void reset()
+    {
+        m_packets.clear();
+        m_started = false;
+        m_delivered = false;
+    }
+
+    void push(std::vector<uint8_t> &packet)
+    {
+        const uint16_t seq = (packet[2] << 8) | packet[3];
+        if (!m_started)
+        {
+            m_next = seq;
+            m_started = true;
+        }
+        const int64_t ext = m_next + static_cast<int16_t>(seq - static_cast<uint16_t>(m_next));
+        if (ext < m_next && !m_delivered && m_next - ext < RTP_JITTER_MAX_PACKETS)
+        {
+            m_next = ext; // the stream's first packets arrived out of order
+        }
+        else if (ext < m_next || m_packets.count(ext))
+        {
+            ++m_late; // already skipped or duplicate
+            return;
+        }
+        Entry &entry = m_packets[ext];
+        entry.packet.swap(packet);
+        entry.arrived = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Takes the next packet in order. Skips a gap once the oldest waiting
+     *        packet is older than the maximum delay.
+     * @param lost_before Set if packets were skipped right before this one.
+     */
+    bool pop(std::vector<uint8_t> &packet, bool &lost_before)
+    {
+        if (m_packets.empty()) return false;
+        auto first = m_packets.begin();
+        if (!m_delivered && std::chrono::steady_clock::now() - first->second.arrived < m_max_delay) return false;
+        if (first->first != m_next)
+        {
+            const bool expired = std::chrono::steady_clock::now() - first->second.arrived >= m_max_delay;
+            if (!expired && m_packets.size() < RTP_JITTER_MAX_PACKETS) return false;
+            m_lost += first->first - m_next;
+            lost_before = true;
+        }
+        else
+        {
+            lost_before = false;
+        }
+        packet.swap(first->second.packet);
+        m_next = first->first + 1;
+        m_delivered = true;
+        m_packets.erase(first);
+        return true;
+    }
+
+    /** @brief Milliseconds until pop() may skip a gap, -1 if nothing is waiting. */
+    int waitMs() const
+    {
+        if (m_packets.empty()) return -1;
+        const auto left = m_max_delay - (std::chrono::steady_clock::now() - m_packets.begin()->second.arrived);
+        return std::max(0, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(left).count()));
+    }
+
+    uint64_t lost() const { return m_lost; }
+    uint64_t late() const { return m_late; }
+
+private:
+    struct Entry
+    {
+        std::vector<uint8_t> packet;
+        std::chrono::steady_clock::time_point arrived;
+    };
+    std::map<int64_t, Entry> m_packets;
+    std::chrono::steady_clock::duration m_max_delay;
+    int64_t m_next = 0;
+    bool m_started = false;
+    bool m_delivered = false;
+    uint64_t m_lost = 0;
+    uint64_t m_late = 0;
+};
+
+#endif // DE_RTSP_HPP
@@ -0,0 +1,431 @@
+//***************************************************************************** */
+//  Shared-memory frame rings between wrapper pipelines and the modules
+//
+//  A ring is one file in /dev/shm: a header followed by slot_count fixed-size
+//  slots. A single producer writes slot (seq - 1) % slot_count for frame seq
+//  and publishes it; any number of readers map the file read-only and copy
+//  frames out. There is no lock and no back-pressure: a slow reader simply
+//  misses frames, the producer never waits for it.
+//
+//  Every slot carries a seqlock word: 2*seq-1 while frame seq is being
+//  written, 2*seq once it is complete. A reader checks the word before and
+//  after its copy, so a frame overwritten mid-copy is detected and dropped
+//  instead of being returned torn. Readers can block on a futex in the header
+//  that the producer wakes after each publish.
+//
+//  Encoded streams (one H.264 access unit per slot) also get a keyframe index
+//  in the header, so a consumer that joins late can start at the newest
+//  keyframe still in the ring instead of waiting for the next one.
+//
+//***************************************************************************** */
+
+#ifndef DE_SHM_RING_HPP
+#define DE_SHM_RING_HPP
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_RING_MAGIC 0x474e5244u // "DRNG"
+#define SHM_RING_VERSION 2
+#define SHM_RING_ALIGN 64
+#define SHM_RING_KEY_INDEX 8 // recent keyframes remembered in the header
+
+// Pixel / payload formats stored in ShmRingHeader::format
+#define SHM_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define SHM_FORMAT_Y16 SHM_FOURCC('Y', '1', '6', ' ')  // 16-bit little-endian samples, one per pixel
+#define SHM_FORMAT_YU12 SHM_FOURCC('Y', 'U', '1', '2') // planar YUV 4:2:0
+#define SHM_FORMAT_H264 SHM_FOURCC('H', '2', '6', '4') // one Annex-B access unit per slot
+#define SHM_FORMAT_META SHM_FOURCC('M', 'E', 'T', 'A') // one FrameMeta record per slot (de_frame_meta.hpp)
+#define SHM_FORMAT_DETS SHM_FOURCC('D', 'E', 'T', 'S') // one DetectionFrame and its Detection entries per slot (de_detections.hpp)
+
+// ShmSlotHeader::flags
+#define SHM_SLOT_KEYFRAME 0x1
+#define SHM_SLOT_DISCONTINUITY 0x2 // data was lost (or the source reconnected) before this frame
+
+/**
+ * @brief Layout of the first bytes of a ring file. Written once by the producer,
+ *        except write_seq and futex_word.
+ */
+struct ShmRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;   // payload bytes per slot
+    uint32_t format;      // SHM_FORMAT_*
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;      // bytes per row, 0 if not an image
+    float unit_scale;     // for raw sensor formats: physical value = sample * unit_scale + unit_offset
+    float unit_offset;
+    int32_t producer_pid;
+    uint32_t reserved;
+    std::atomic<uint64_t> write_seq;  // last published frame, 0 = none yet
+    std::atomic<uint32_t> futex_word; // bumped and woken on every publish
+    std::atomic<uint64_t> key_count;  // frames published with SHM_SLOT_KEYFRAME
+    std::atomic<uint64_t> key_seqs[SHM_RING_KEY_INDEX]; // seq of keyframe n at [n % SHM_RING_KEY_INDEX]
+};
+
+/**
+ * @brief Per-slot header in front of each payload.
+ */
+struct ShmSlotHeader
+{
+    std::atomic<uint64_t> lock; // seqlock: 2*seq-1 while writing frame seq, 2*seq when published
+    uint64_t seq;
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC at capture
+    int64_t pts;                // encoded streams: 90 kHz media clock (RTP timestamp or capture time), 0 if none
+    uint32_t bytes;             // used payload bytes
+    uint32_t flags;             // SHM_SLOT_*
+};
+
+/**
+ * @brief Frame geometry and format of a new ring.
+ */
+struct ShmRingFormat
+{
+    uint32_t format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    float unit_scale = 1.0f;
+    float unit_offset = 0.0f;
+};
+
+inline uint64_t shmRingNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+inline size_t shmRingHeaderBytes()
+{
+    return (sizeof(ShmRingHeader) + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+}
+
+inline size_t shmRingSlotStride(uint32_t slot_size)
+{
+    return (sizeof(ShmSlotHeader) + slot_size + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+}
+
+/**
+ * @brief Producer side of a ring. Creates (or recreates) /dev/shm/<name>.
+ */
+class ShmRingWriter
+{
+public:
+    ~ShmRingWriter() { close(); }
+
+    bool create(const std::string &name, uint32_t slot_count, uint32_t slot_size, const ShmRingFormat &format)
+    {
+        close();
+        const std::string path = "/" + name;
+        shm_unlink(path.c_str()); // readers still holding the old ring keep their mapping
+        const int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd == -1)
+        {
+            perror(("shm_open " + name).c_str());
+            return false;
+        }
+        m_size = shmRingHeaderBytes() + static_cast<size_t>(slot_count) * shmRingSlotStride(slot_size);
+        if (ftruncate(fd, m_size) == -1)
+        {
+            perror(("ftruncate " + name).c_str());
+            ::close(fd);
+            shm_unlink(path.c_str());
+            return false;
+        }
+        void *map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            perror(("mmap " + name).c_str());
+            shm_unlink(path.c_str());
+            return false;
+        }
+        m_base = static_cast<uint8_t *>(map);
+        m_name = name;
+
+        ShmRingHeader *header = this->header();
+        header->version = SHM_RING_VERSION;
+        header->slot_count = slot_count;
+        header->slot_size = slot_size;
+        header->format = format.format;
+        header->width = format.width;
+        header->height = format.height;
+        header->stride = format.stride;
+        header->unit_scale = format.unit_scale;
+        header->unit_offset = format.unit_offset;
+        header->producer_pid = getpid();
+        header->write_seq.store(0, std::memory_order_relaxed);
+        header->futex_word.store(0, std::memory_order_relaxed);
+        header->key_count.store(0, std::memory_order_relaxed);
+        for (auto &key : header->key_seqs) key.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = SHM_RING_MAGIC; // readers refuse the ring until this is set
+        m_seq = 0;
+        return true;
+    }
+
+    /**
+     * @brief Removes the ring file and unmaps it.
+     */
+    void close()
+    {
+        if (!m_base) return;
+        munmap(m_base, m_size);
+        shm_unlink(("/" + m_name).c_str());
+        m_base = nullptr;
+    }
+
+    bool isOpen() const { return m_base != nullptr; }
+    uint32_t slotSize() const { return header()->slot_size; }
+    uint64_t lastSeq() const { return m_seq; }
+
+    /**
+     * @brief Starts writing the next frame and returns its payload buffer (slotSize() bytes).
+     *        The slot is marked busy until publish().
+     */
+    uint8_t *begin()
+    {
+        const uint64_t seq = m_seq + 1;
+        ShmSlotHeader *slot = slotFor(seq);
+        slot->lock.store(2 * seq - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return reinterpret_cast<uint8_t *>(slot + 1);
+    }
+
+    /**
+     * @brief Publishes the frame started by begin() and wakes blocked readers.
+     * @return The sequence number of the published frame.
+     */
+    uint64_t publish(uint32_t bytes, uint64_t timestamp_ns, uint32_t flags = 0, int64_t pts = 0)
+    {
+        const uint64_t seq = ++m_seq;
+        ShmSlotHeader *slot = slotFor(seq);
+        slot->seq = seq;
+        slot->timestamp_ns = timestamp_ns;
+        slot->pts = pts;
+        slot->bytes = bytes;
+        slot->flags = flags;
+        slot->lock.store(2 * seq, std::memory_order_release);
+
+        ShmRingHeader *header = this->header();
+        if (flags & SHM_SLOT_KEYFRAME)
+        {
+            const uint64_t key = header->key_count.load(std::memory_order_relaxed);
+            header->key_seqs[key % SHM_RING_KEY_INDEX].store(seq, std::memory_order_relaxed);
+            header->key_count.store(key + 1, std::memory_order_release);
+        }
+        header->write_seq.store(seq, std::memory_order_release);
+        header->futex_word.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&header->futex_word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        return seq;
+    }
+
+    /**
+     * @brief Copies a complete frame into the ring.
+     */
+    uint64_t write(const void *data, uint32_t bytes, uint64_t timestamp_ns, uint32_t flags = 0, int64_t pts = 0)
+    {
+        if (bytes > slotSize()) bytes = slotSize();
+        std::memcpy(begin(), data, bytes);
+        return publish(bytes, timestamp_ns, flags, pts);
+    }
+
+private:
+    ShmRingHeader *header() const { return reinterpret_cast<ShmRingHeader *>(m_base); }
+
+    ShmSlotHeader *slotFor(uint64_t seq) const
+    {
+        const ShmRingHeader *header = this->header();
+        const size_t index = (seq - 1) % header->slot_count;
+        return reinterpret_cast<ShmSlotHeader *>(m_base + shmRingHeaderBytes() + index * shmRingSlotStride(header->slot_size));
+    }
+
+    std::string m_name;
+    uint8_t *m_base = nullptr;
+    size_t m_size = 0;
+    uint64_t m_seq = 0;
+};
+
+/**
+ * @brief Metadata of a frame copied out of a ring.
+ */
+struct ShmFrameInfo
+{
+    uint64_t seq = 0;
+    uint64_t timestamp_ns = 0;
+    int64_t pts = 0;
+    uint32_t bytes = 0;
+    uint32_t flags = 0;
+};
+
+/**
+ * @brief Reader side of a ring. Maps /dev/shm/<name> read-only.
+ */
+class ShmRingReader
+{
+public:
+    ~ShmRingReader() { close(); }
+
+    bool open(const std::string &name)
+    {
+        close();
+        const int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+        if (fd == -1) return false;
+        struct stat st;
+        if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < shmRingHeaderBytes())
+        {
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return false;
+        m_base = static_cast<const uint8_t *>(map);
+        m_size = st.st_size;
+
+        const ShmRingHeader *header = this->header();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION || header->slot_count == 0 ||
+            shmRingHeaderBytes() + static_cast<size_t>(header->slot_count) * shmRingSlotStride(header->slot_size) > m_size)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (!m_base) return;
+        munmap(const_cast<uint8_t *>(m_base), m_size);
+        m_base = nullptr;
+    }
+
+    bool isOpen() const { return m_base != nullptr; }
+    const ShmRingHeader &info() const { return *header(); }
+    uint64_t latest() const { return header()->write_seq.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Newest keyframe at or before seq that has not been overwritten yet.
+     * @return Its sequence number, or 0 if the ring holds none.
+     */
+    uint64_t keyframeAtOrBefore(uint64_t seq) const
+    {
+        const ShmRingHeader *header = this->header();
+        const uint64_t newest = latest();
+        const uint64_t oldest = newest >= header->slot_count ? newest - header->slot_count + 1 : 1;
+        uint64_t found = 0;
+        for (const auto &key : header->key_seqs)
+        {
+            const uint64_t candidate = key.load(std::memory_order_acquire);
+            if (candidate >= oldest && candidate <= seq && candidate > found) found = candidate;
+        }
+        return found;
+    }
+
+    /**
+     * @brief Where a late-joining consumer of an encoded stream should start.
+     */
+    uint64_t latestKeyframe() const { return keyframeAtOrBefore(latest()); }
+
+    /**
+     * @brief Copies frame seq into buffer (at most capacity bytes).
+     * @return False if the frame was not published yet, was already overwritten,
+     *         or was overwritten while being copied.
+     */
+    bool read(uint64_t seq, void *buffer, size_t capacity, ShmFrameInfo &frame) const
+    {
+        if (seq == 0 || seq > latest()) return false;
+        const ShmSlotHeader *slot = slotFor(seq);
+        const uint64_t before = slot->lock.load(std::memory_order_acquire);
+        if (before != 2 * seq) return false;
+        frame.seq = slot->seq;
+        frame.timestamp_ns = slot->timestamp_ns;
+        frame.pts = slot->pts;
+        frame.flags = slot->flags;
+        frame.bytes = std::min<uint32_t>(slot->bytes, header()->slot_size);
+        std::memcpy(buffer, slot + 1, std::min<size_t>(frame.bytes, capacity));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->lock.load(std::memory_order_relaxed) == before;
+    }
+
+    /**
+     * @brief Zero-copy access to frame seq in the mapping. The payload can be
+     *        overwritten at any time; check intact(seq) after using it.
+     * @return The payload, or nullptr if the frame is not published or already overwritten.
+     */
+    const uint8_t *peek(uint64_t seq, ShmFrameInfo &frame) const
+    {
+        if (seq == 0 || seq > latest()) return nullptr;
+        const ShmSlotHeader *slot = slotFor(seq);
+        if (slot->lock.load(std::memory_order_acquire) != 2 * seq) return nullptr;
+        frame.seq = slot->seq;
+        frame.timestamp_ns = slot->timestamp_ns;
+        frame.pts = slot->pts;
+        frame.flags = slot->flags;
+        frame.bytes = std::min<uint32_t>(slot->bytes, header()->slot_size);
+        if (!intact(seq)) return nullptr;
+        return reinterpret_cast<const uint8_t *>(slot + 1);
+    }
+
+    /**
+     * @brief True if frame seq has not been overwritten since peek().
+     */
+    bool intact(uint64_t seq) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slotFor(seq)->lock.load(std::memory_order_relaxed) == 2 * seq;
+    }
+
+    /**
+     * @brief Blocks until frame seq (or a later one) is published or timeout_ms passes.
+     * @return True if latest() >= seq.
+     */
+    bool waitFor(uint64_t seq, int timeout_ms) const
+    {
+        const ShmRingHeader *header = this->header();
+        const uint64_t deadline = shmRingNowNs() + static_cast<uint64_t>(timeout_ms) * 1000000ull;
+        while (true)
+        {
+            const uint32_t word = header->futex_word.load(std::memory_order_acquire);
+            if (latest() >= seq) return true;
+            const uint64_t now = shmRingNowNs();
+            if (now >= deadline) return false;
+            struct timespec remaining;
+            remaining.tv_sec = (deadline - now) / 1000000000ull;
+            remaining.tv_nsec = (deadline - now) % 1000000000ull;
+            syscall(SYS_futex, const_cast<uint32_t *>(reinterpret_cast<const uint32_t *>(&header->futex_word)), FUTEX_WAIT, word, &remaining, nullptr, 0);
+        }
+    }
+
+private:
+    const ShmRingHeader *header() const { return reinterpret_cast<const ShmRingHeader *>(m_base); }
+
+    const ShmSlotHeader *slotFor(uint64_t seq) const
+    {
+        const ShmRingHeader *header = this->header();
+        const size_t index = (seq - 1) % header->slot_count;
+        return reinterpret_cast<const ShmSlotHeader *>(m_base + shmRingHeaderBytes() + index * shmRingSlotStride(header->slot_size));
+    }
+
+    const uint8_t *m_base = nullptr;
+    size_t m_size = 0;
+};
+
+#endif // DE_SHM_RING_HPP
@@ -0,0 +1,380 @@
+//***************************************************************************** */
+//  Simulator fleet mode for the wrapper: N supervised SITL + de_comm + de_ardupilot groups
+//
+//  Replaces sh_start_simulators.sh's fixed two instances and sleeps. Each group
+//  gets its own port block and working directory and starts in stages, each
+//  stage waiting for the previous process to bind its socket:
+//
+//      arducopter (TCP base port listening) -> de_comm (UDP bound) -> de_ardupilot (UDP bound)
+//
+//  All groups progress in parallel from the supervisor tick. Crashed members
+//  are restarted on their own with backoff and a resource report is printed
+//  periodically.
+//
+//  The generated configs tie an instance's ports to its number, so an instance
+//  whose port block is busy is skipped and the group takes the next instance
+//  number (and its configs) instead. de_comm and de_ardupilot starts are spaced
+//  by --sim-start-stagger across the fleet, like the script's one second sleeps,
+//  so the modules generate different PartyIDs.
+//
+//***************************************************************************** */
+
+#ifndef DE_SIM_FLEET_HPP
+#define DE_SIM_FLEET_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "de_supervisor.hpp"
+
+// Ports checked to be free in each instance's block: SITL uses base port .. base port + 9
+#define SIM_FLEET_PORTS_PER_INSTANCE 10
+
+struct SimFleetOptions
+{
+    int count = 0;                 // number of instance groups
+    int first = 1;                 // instance number (and SITL sysid) of the first group
+    std::string simulator_path = "/home/pi/simulator/";
+    std::string instances_dir;     // empty = <simulator_path>sim_de_mavlink_instances/
+    std::string drone_engage_path = "/home/pi/drone_engage/";
+    std::string log_dir;           // empty = discard member output like sh_start_simulators.sh
+    int base_port = 7500;          // SITL --base-port of the first group
+    int port_stride = 100;         // distance between the port blocks of consecutive groups
+    int speedup = 1;
+    int ready_timeout_sec = 30;    // per stage; the group continues with a warning afterwards
+    int report_sec = 30;           // 0 = no periodic resource report
+    int max_starting = 0;          // groups allowed in their startup stages at once, 0 = all
+    int start_stagger_ms = 1000;   // least time between two de_comm / de_ardupilot starts, 0 = none
+};
+
+/**
+ * @brief Launches and supervises a fleet of simulated drones.
+ */
+class SimFleet
+{
+public:
+    SimFleet(const SimFleetOptions &options, ChildSupervisor &supervisor)
+        : m_options(options), m_supervisor(supervisor)
+    {
+        if (m_options.instances_dir.empty()) m_options.instances_dir = m_options.simulator_path + "sim_de_mavlink_instances/";
+    }
+
+    /**
+     * @brief Checks binaries, configs and ports and hooks the fleet into the supervisor.
+     * @return False if nothing can be started at all.
+     */
+    bool prepare()
+    {
+        m_sitl_binary = m_options.simulator_path + "ardupilot/build/sitl/bin/arducopter";
+        m_sitl_defaults = m_options.simulator_path + "ardupilot/Tools/autotest/default_params/copter.parm";
+        m_comm_binary = m_options.drone_engage_path + "de_comm/de_comm";
+        m_mavlink_binary = m_options.drone_engage_path + "de_mavlink/de_ardupilot";
+
+        for (const std::string &binary : {m_sitl_binary, m_comm_binary, m_mavlink_binary})
+        {
+            if (access(binary.c_str(), X_OK) != 0)
+            {
+                std::cerr << "ERROR: Simulator fleet executable not found: " << binary << std::endl;
+                return false;
+            }
+        }
+        if (!m_options.log_dir.empty()) mkdir(m_options.log_dir.c_str(), 0755);
+        mkdir((m_options.simulator_path + "sitl_instances").c_str(), 0755);
+
+        std::set<int> bound;
+        boundLocalPorts(bound);
+
+        int instance = m_options.first;
+        for (int n = 0; n < m_options.count; ++instance)
+        {
+            const int base_port = m_options.base_port + (instance - m_options.first) * m_options.port_stride;
+            if (base_port + SIM_FLEET_PORTS_PER_INSTANCE > 65536)
+            {
+                std::cerr << "ERROR: Simulator fleet: no free port block left for " << m_options.count - n << " more instance(s)." << std::endl;
+                break;
+            }
+            const int busy = busyPort(bound, base_port);
+            if (busy != 0)
+            {
+                std::cerr << "WARNING: Simulator instance " << instance << " skipped: port " << busy << " already in use." << std::endl;
+                continue;
+            }
+            ++n;
+
+            SimGroup group;
+            group.instance = instance;
+            group.base_port = base_port;
+            group.working_dir = m_options.simulator_path + "sitl_instances/" + std::to_string(group.instance) + "/";
+            group.comm_config = instanceFile("de_comm", group.instance, ".config.module.json");
+            group.comm_bconfig = instanceFile("de_comm", group.instance, ".config.module.bconfig.local");
+            group.mavlink_config = instanceFile("de_mavlink", group.instance, ".config.module.json");
+            group.mavlink_bconfig = instanceFile("de_mavlink", group.instance, ".bconfig.module.local");
+
+            for (const std::string &config : {group.comm_config, group.mavlink_config})
+            {
+                if (group.stage != Stage::Failed && access(config.c_str(), R_OK) != 0)
+                {
+                    group.stage = Stage::Failed;
+                    group.problem = "missing " + config + " (generate it with updateConfig --generate)";
+                }
+            }
+            if (group.stage == Stage::Failed)
+            {
+                std::cerr << "ERROR: Simulator instance " << group.instance << " not started: " << group.problem << std::endl;
+            }
+            else
+            {
+                mkdir(group.working_dir.c_str(), 0755);
+            }
+            m_groups.push_back(group);
+        }
+
+        m_started_at = std::chrono::steady_clock::now();
+        m_last_report = m_started_at;
+        m_supervisor.addTickHook([this]() { tick(); });
+        return true;
+    }
+
+    /**
+     * @brief Advances every group's startup and prints the periodic report. Called each supervisor tick.
+     */
+    void tick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        int starting = 0;
+        for (const auto &group : m_groups)
+        {
+            if (group.stage != Stage::Pending && group.stage != Stage::Running && group.stage != Stage::Failed) ++starting;
+        }
+        for (auto &group : m_groups)
+        {
+            if (group.stage == Stage::Pending && m_options.max_starting > 0 && starting >= m_options.max_starting) continue;
+            if (group.stage == Stage::Pending) ++starting;
+            advance(group, now);
+        }
+
+        if (m_options.report_sec > 0 && now - m_last_report >= std::chrono::seconds(m_options.report_sec))
+        {
+            m_last_report = now;
+            report(std::cout);
+        }
+    }
+
+    /**
+     * @brief Prints state, CPU and memory use of every fleet member.
+     */
+    void report(std::ostream &out)
+    {
+        int running = 0;
+        for (const auto &group : m_groups)
+        {
+            if (group.stage == Stage::Running) ++running;
+        }
+        const long uptime = static_cast<long>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_started_at).count());
+        out << "Simulator fleet: " << running << "/" << m_groups.size() << " instance(s) running, uptime " << uptime << "s" << std::endl;
+        out << "  inst  port   member        pid      cpu%    rss MB  restarts  state" << std::endl;
+        double total_cpu = 0.0;
+        long total_rss = 0;
+        for (const auto &group : m_groups)
+        {
+            const size_t members[] = {group.sitl, group.comm, group.mavlink};
+            const char *labels[] = {"arducopter", "de_comm", "de_ardupilot"};
+            for (int m = 0; m < 3; ++m)
+            {
+                out << "  " << std::left << std::setw(5) << group.instance << " " << std::setw(6) << group.base_port
+                    << " " << std::setw(13) << labels[m];
+                if (members[m] == NO_CHILD)
+                {
+                    out << "-" << std::endl;
+                    continue;
+                }
+                SupervisedChild &child = m_supervisor.children()[members[m]];
+                ChildSupervisor::sample(child);
+                if (child.pid > 0)
+                {
+                    total_cpu += child.cpu_percent;
+                    total_rss += child.rss_kb;
+                }
+                out << std::setw(8) << child.pid << std::right << std::fixed << std::setprecision(1)
+                    << std::setw(6) << child.cpu_percent << std::setw(10) << child.rss_kb / 1024.0
+                    << std::setw(10) << child.restarts << "  " << std::left
+                    << (child.pid > 0 ? stageName(group.stage) : ("down: " + child.last_exit)) << std::endl;
+            }
+            if (group.stage == Stage::Failed) out << "        " << group.problem << std::endl;
+        }
+        out << "  total cpu " << std::fixed << std::setprecision(1) << total_cpu << "%, rss "
+            << total_rss / 1024.0 << " MB" << std::endl;
+    }
+
+private:
+    enum class Stage
+    {
+        Pending,
+        WaitSitl,
+        WaitComm,
+        WaitMavlink,
+        Running,
+        Failed
+    };
+
+    static constexpr size_t NO_CHILD = static_cast<size_t>(-1);
+
+    struct SimGroup
+    {
+        int instance = 0;
+        int base_port = 0;
+        Stage stage = Stage::Pending;
+        std::string problem;
+        std::string working_dir;
+        std::string comm_config, comm_bconfig, mavlink_config, mavlink_bconfig;
+        size_t sitl = NO_CHILD, comm = NO_CHILD, mavlink = NO_CHILD;
+        std::chrono::steady_clock::time_point stage_deadline;
+    };
+
+    static const char *stageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case Stage::Pending: return "pending";
+        case Stage::WaitSitl: return "waiting for SITL";
+        case Stage::WaitComm: return "waiting for de_comm";
+        case Stage::WaitMavlink: return "waiting for de_ardupilot";
+        case Stage::Running: return "running";
+        default: return "failed";
+        }
+    }
+
+    // First bound port of the block starting at base_port, 0 if the block is free
+    static int busyPort(const std::set<int> &bound, int base_port)
+    {
+        for (int port = base_port; port < base_port + SIM_FLEET_PORTS_PER_INSTANCE; ++port)
+        {
+            if (bound.count(port)) return port;
+        }
+        return 0;
+    }
+
+    // True once the stagger since the last de_comm / de_ardupilot start has passed
+    bool staggerDone(const std::chrono::steady_clock::time_point &now) const
+    {
+        return now >= m_next_module_start;
+    }
+
+    void staggerNext(const std::chrono::steady_clock::time_point &now)
+    {
+        m_next_module_start = now + std::chrono::milliseconds(m_options.start_stagger_ms);
+    }
+
+    std::string instanceFile(const std::string &module, int instance, const std::string &suffix) const
+    {
+        return m_options.instances_dir + module + "." + std::to_string(instance) + suffix;
+    }
+
+    std::string logPathFor(const std::string &member, int instance) const
+    {
+        if (m_options.log_dir.empty()) return "/dev/null";
+        return m_options.log_dir + "/" + member + "." + std::to_string(instance) + ".log";
+    }
+
+    std::vector<std::pair<std::string, std::string>> environmentFor(const SimGroup &group, const std::string &config) const
+    {
+        std::vector<std::pair<std::string, std::string>> env = {
+            {"DE_SIM_INSTANCE", std::to_string(group.instance)},
+            {"DE_SIM_BASE_PORT", std::to_string(group.base_port)}};
+        const std::string snapshot = config + ".snap";
+        if (!config.empty() && access(snapshot.c_str(), R_OK) == 0) env.push_back({"DE_CONFIG_SNAPSHOT", snapshot});
+        return env;
+    }
+
+    // Registers a member with the supervisor and starts it
+    size_t startMember(const SimGroup &group, const std::string &member, const std::vector<std::string> &args, const std::string &config)
+    {
+        const std::string working_dir = group.working_dir;
+        const std::string log_path = logPathFor(member, group.instance);
+        const auto env = environmentFor(group, config);
+        const size_t index = m_supervisor.add(member + "." + std::to_string(group.instance), -1, RestartPolicy::Restart,
+                                              [args, working_dir, env, log_path]() { return spawnProcess(args, working_dir, env, log_path); });
+        if (m_supervisor.launch(index))
+        {
+            std::cout << "Simulator instance " << group.instance << ": " << member << " started with PID "
+                      << m_supervisor.children()[index].pid << std::endl;
+        }
+        return index;
+    }
+
+    // True once the member is up and has bound its socket; a restarting member is not ready
+    bool memberReady(size_t index, bool udp, int port)
+    {
+        const pid_t pid = m_supervisor.children()[index].pid;
+        return pid > 0 && processHasBoundSocket(pid, udp, port);
+    }
+
+    bool stageDone(SimGroup &group, size_t index, bool udp, int port, const char *member,
+                   const std::chrono::steady_clock::time_point &now)
+    {
+        if (memberReady(index, udp, port)) return true;
+        if (now < group.stage_deadline) return false;
+        std::cerr << "WARNING: Simulator instance " << group.instance << ": " << member << " not ready after "
+                  << m_options.ready_timeout_sec << "s, continuing." << std::endl;
+        return true;
+    }
+
+    void advance(SimGroup &group, const std::chrono::steady_clock::time_point &now)
+    {
+        const auto timeout = std::chrono::seconds(m_options.ready_timeout_sec);
+        switch (group.stage)
+        {
+        case Stage::Pending:
+            group.sitl = startMember(group, "arducopter",
+                                     {m_sitl_binary, "--model", "+", "--speedup", std::to_string(m_options.speedup),
+                                      "--sysid", std::to_string(group.instance), "--slave", "0",
+                                      "--defaults", m_sitl_defaults, "--sim-address", "127.0.0.1",
+                                      "--base-port", std::to_string(group.base_port)},
+                                     "");
+            group.stage = Stage::WaitSitl;
+            group.stage_deadline = now + timeout;
+            break;
+        case Stage::WaitSitl:
+            if (!staggerDone(now) || !stageDone(group, group.sitl, false, group.base_port, "arducopter", now)) break;
+            group.comm = startMember(group, "de_comm",
+                                     {m_comm_binary, "--config", group.comm_config, "--bconfig", group.comm_bconfig},
+                                     group.comm_config);
+            staggerNext(now);
+            group.stage = Stage::WaitComm;
+            group.stage_deadline = now + timeout;
+            break;
+        case Stage::WaitComm:
+            if (!staggerDone(now) || !stageDone(group, group.comm, true, 0, "de_comm", now)) break;
+            group.mavlink = startMember(group, "de_ardupilot",
+                                        {m_mavlink_binary, "--config", group.mavlink_config, "--bconfig", group.mavlink_bconfig},
+                                        group.mavlink_config);
+            staggerNext(now);
+            group.stage = Stage::WaitMavlink;
+            group.stage_deadline = now + timeout;
+            break;
+        case Stage::WaitMavlink:
+            if (!stageDone(group, group.mavlink, true, 0, "de_ardupilot", now)) break;
+            group.stage = Stage::Running;
+            std::cout << "Simulator instance " << group.instance << " running (base port " << group.base_port << ", "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(now - m_started_at).count()
+                      << " ms after fleet start)" << std::endl;
+            break;
+        default:
+            break;
+        }
+    }
+
+    SimFleetOptions m_options;
+    ChildSupervisor &m_supervisor;
+    std::vector<SimGroup> m_groups;
+    std::string m_sitl_binary, m_sitl_defaults, m_comm_binary, m_mavlink_binary;
+    std::chrono::steady_clock::time_point m_started_at, m_last_report, m_next_module_start;
+};
+
+#endif // DE_SIM_FLEET_HPP
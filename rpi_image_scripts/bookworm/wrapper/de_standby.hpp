@@ -0,0 +1,254 @@
+//***************************************************************************** */
+//  Warm-standby spares for slow-to-start modules
+//
+//  de_yolo_generic and de_ai_tracker.so spend many seconds loading their
+//  models, so a crash used to mean a long blind gap (or a full restart of
+//  the stack). With --standby, a second instance of each listed module is
+//  started in the background with DE_STANDBY=1 in its environment:
+//
+//      loading  -> the spare loads its model like a normal instance
+//      ready    -> it stopped itself (raise(SIGSTOP) once loaded)
+//      promoted -> the active instance died: the spare gets SIGCONT and
+//                  takes over its supervised entry; a new spare is built
+//                  --standby-respawn seconds later
+//
+//  A module that knows about DE_STANDBY loads everything, then stops itself
+//  before it opens the camera or talks to de_comm, and says so with
+//  "standby_support": true in its config. Spares are only built for such
+//  modules: any other module would run twice, camera and de_comm included.
+//  A spare that has not stopped itself after --standby-warmup seconds is
+//  paused where it is and reported.
+//
+//***************************************************************************** */
+
+#ifndef DE_STANDBY_HPP
+#define DE_STANDBY_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <csignal>
+#include <unistd.h>
+
+#include "de_supervisor.hpp"
+
+#define STANDBY_ENV "DE_STANDBY"
+#define STANDBY_SUFFIX " standby" // supervised name of a spare: "<module> standby"
+#define STANDBY_CONFIG_KEY "standby_support" // "standby_support": true in the module's config
+
+/**
+ * @brief True if the module config declares "standby_support": true, i.e. the module
+ *        stops itself under DE_STANDBY=1 once loaded.
+ */
+inline bool standbyDeclared(const std::string &config)
+{
+    return moduleConfigDeclares(config, STANDBY_CONFIG_KEY);
+}
+
+struct StandbyOptions
+{
+    std::set<std::string> modules;   // supervised names, e.g. de_yolo_generic
+    int warmup_sec = 30;             // pause a spare that has not stopped itself by then
+    int respawn_sec = 5;             // delay before a spare is (re)built
+    std::string status_path = "/dev/shm/de_standby";
+};
+
+/**
+ * @brief Keeps one paused spare per module and hands it over when the module dies.
+ */
+class StandbyPool
+{
+public:
+    StandbyPool(ChildSupervisor &supervisor, const StandbyOptions &options) : m_supervisor(supervisor), m_options(options) {}
+
+    /**
+     * @brief Adds a spare for the supervised child named module. start launches an
+     *        instance with DE_STANDBY=1. The first spare is built after the respawn delay.
+     * @param promoted Told the new PID of the module after a takeover.
+     * @return False if module is not supervised.
+     */
+    bool addModule(const std::string &module, std::function<pid_t()> start, std::function<void(pid_t)> promoted = nullptr)
+    {
+        auto &children = m_supervisor.children();
+        size_t active = children.size();
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (children[i].name == module) active = i;
+        }
+        if (active == children.size()) return false;
+
+        Spare spare;
+        spare.module = module;
+        spare.active = active;
+        // A spare that dies while loading is restarted with backoff like any Restart child
+        spare.index = m_supervisor.add(module + STANDBY_SUFFIX, -1, RestartPolicy::Restart, start);
+        spare.build_at = std::chrono::steady_clock::now() + std::chrono::seconds(m_options.respawn_sec);
+        spare.promoted = promoted;
+        m_spares.push_back(spare);
+        // children() may have moved; the takeover hook refers to the spare by position
+        const size_t n = m_spares.size() - 1;
+        m_supervisor.children()[active].takeover = [this, n]() { return takeover(n); };
+        return true;
+    }
+
+    size_t size() const { return m_spares.size(); }
+
+    /**
+     * @brief Supervisor tick: builds spares and pauses the ones that finished loading.
+     */
+    void tick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        bool changed = m_promoted;
+        m_promoted = false;
+        for (auto &spare : m_spares)
+        {
+            SupervisedChild &child = m_supervisor.children()[spare.index];
+            if (child.pid <= 0)
+            {
+                spare.state = State::None;
+                if (child.restart_pending || now < spare.build_at) continue;
+                if (m_supervisor.launch(spare.index))
+                {
+                    std::cout << "Standby: building a spare of " << spare.module << " (PID " << child.pid << ")" << std::endl;
+                }
+                else
+                {
+                    std::cerr << "Standby: failed to start a spare of " << spare.module << "; retrying." << std::endl;
+                    spare.build_at = now + std::chrono::seconds(m_options.respawn_sec);
+                }
+                changed = true;
+                continue;
+            }
+            if (child.pid != spare.pid)
+            {
+                // Launched by us or restarted by the supervisor after a crash while loading
+                spare.pid = child.pid;
+                spare.state = State::Loading;
+                spare.loading_since = now;
+                changed = true;
+            }
+            if (spare.state != State::Loading) continue;
+            const double seconds = std::chrono::duration<double>(now - spare.loading_since).count();
+            if (processState(child.pid) == 'T')
+            {
+                m_supervisor.pause(child.pid, "standby"); // registered, so no other feature's resume wakes it
+                spare.state = State::Ready;
+                spare.ready_sec = seconds;
+                std::cout << "Standby: spare of " << spare.module << " (PID " << child.pid << ") ready after " << static_cast<int>(seconds) << " s" << std::endl;
+                changed = true;
+            }
+            else if (seconds >= m_options.warmup_sec)
+            {
+                // Declared, but it did not stop itself: pause it where it is so it does not keep working next to the module
+                m_supervisor.pauseTree(child.pid, "standby");
+                spare.state = State::Ready;
+                spare.ready_sec = seconds;
+                std::cerr << "Standby: spare of " << spare.module << " (PID " << child.pid << ") did not stop itself under " STANDBY_ENV "=1 within "
+                          << m_options.warmup_sec << " s although its config declares " STANDBY_CONFIG_KEY "; paused it." << std::endl;
+                changed = true;
+            }
+        }
+        if (changed) writeStatus();
+    }
+
+    /**
+     * @brief Stops the spares. A paused process does not act on SIGTERM until it is
+     *        continued, so it gets SIGCONT right after. Called before the wrapper stops its children.
+     */
+    void release()
+    {
+        for (auto &spare : m_spares)
+        {
+            const pid_t pid = m_supervisor.children()[spare.index].pid;
+            if (pid <= 0) continue;
+            m_supervisor.children()[spare.index].restart_pending = false;
+            signalTree(pid, SIGTERM);
+            m_supervisor.wakeTree(pid);
+        }
+    }
+
+private:
+    enum class State
+    {
+        None,
+        Loading,
+        Ready
+    };
+
+    struct Spare
+    {
+        std::string module;
+        size_t active = 0; // index of the module in the supervisor
+        size_t index = 0;  // index of the spare in the supervisor
+        pid_t pid = -1;
+        State state = State::None;
+        std::chrono::steady_clock::time_point loading_since;
+        std::chrono::steady_clock::time_point build_at;
+        double ready_sec = 0.0;
+        int promotions = 0;
+        std::function<void(pid_t)> promoted;
+    };
+
+    static const char *stateName(State state)
+    {
+        switch (state)
+        {
+        case State::Loading: return "loading";
+        case State::Ready: return "ready";
+        default: return "none";
+        }
+    }
+
+    /**
+     * @brief Called by the supervisor when the active instance died.
+     * @return The promoted spare's PID, or -1 if none is ready.
+     */
+    pid_t takeover(size_t n)
+    {
+        Spare &spare = m_spares[n];
+        SupervisedChild &child = m_supervisor.children()[spare.index];
+        if (spare.state != State::Ready || child.pid <= 0)
+        {
+            std::cerr << "Standby: no ready spare of " << spare.module << " (" << stateName(spare.state) << ")." << std::endl;
+            return -1;
+        }
+        const pid_t pid = child.pid;
+        m_supervisor.wakeTree(pid); // whoever else paused it: it is the module now
+        child.pid = -1;
+        child.restart_pending = false;
+        spare.pid = -1;
+        spare.state = State::None;
+        spare.build_at = std::chrono::steady_clock::now() + std::chrono::seconds(m_options.respawn_sec);
+        ++spare.promotions;
+        if (spare.promoted) spare.promoted(pid);
+        m_promoted = true; // status on the next tick, once the supervisor has the new PID
+        return pid;
+    }
+
+    /**
+     * @brief One line per module; replaced atomically.
+     */
+    void writeStatus() const
+    {
+        writeStatusFile(m_options.status_path, [this](std::ostream &out) {
+            const auto &children = m_supervisor.children();
+            for (const auto &spare : m_spares)
+            {
+                out << "module=" << spare.module << " active=" << children[spare.active].pid << " spare=" << children[spare.index].pid
+                    << " state=" << stateName(spare.state) << " ready_sec=" << static_cast<int>(spare.ready_sec) << " promotions=" << spare.promotions << "\n";
+            }
+        });
+    }
+
+    ChildSupervisor &m_supervisor;
+    StandbyOptions m_options;
+    std::vector<Spare> m_spares;
+    bool m_promoted = false;
+};
+
+#endif // DE_STANDBY_HPP
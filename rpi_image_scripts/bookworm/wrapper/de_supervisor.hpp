@@ -0,0 +1,875 @@
+//***************************************************************************** */
+//  Process supervision core shared by the wrapper's camera stack and simulator fleet
+//
+//  Every child the wrapper starts is registered in a ChildSupervisor table with
+//  a policy for what happens when it exits: crash the wrapper so systemd
+//  restarts the whole stack (the camera default), or restart just that child
+//  with exponential backoff. run() replaces a blocking waitpid() with a short
+//  WNOHANG tick so tick hooks (startup state machines, reports) can run too.
+//
+//***************************************************************************** */
+
+#ifndef DE_SUPERVISOR_HPP
+#define DE_SUPERVISOR_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Restart backoff: doubles from MIN to MAX, reset once a child stayed up for STABLE seconds
+#define SUPERVISOR_BACKOFF_MIN_MS 1000
+#define SUPERVISOR_BACKOFF_MAX_MS 30000
+#define SUPERVISOR_STABLE_SEC 60
+#define SUPERVISOR_TICK_MS 200
+#define SUPERVISOR_STALL_MS 1000 // a tick this late is reported as a Stall event
+
+enum class RestartPolicy
+{
+    CrashWrapper, // exit the wrapper and let systemd restart everything
+    Restart       // restart only this child
+};
+
+/**
+ * @brief What the supervisor (and the features on its tick) tell their event hooks.
+ *        The values are stored in the flight recorder file, so only append.
+ */
+enum class SupervisorEvent : uint16_t
+{
+    Boot = 1,         // the wrapper started (pid = wrapper)
+    Spawn = 2,        // child started (value = restarts so far)
+    Exit = 3,         // child exited (value = wait status, arg = uptime ms)
+    Restart = 4,      // restart scheduled (value = backoff ms)
+    Replace = 5,      // stopped on purpose to be relaunched
+    Promote = 6,      // a warm standby took over (pid = new, value = old PID)
+    Crash = 7,        // the wrapper exits to let systemd restart everything
+    Stall = 8,        // the supervisor loop was late (value = ms since the previous tick)
+    Level = 9,        // governor level or adaptive capture rung change (value = new, arg = previous)
+    Shed = 10,        // cgroup: module frozen under PSI pressure (value = larger stall, 0.1 %)
+    Restore = 11,     // cgroup: module thawed
+    Shutdown = 12,    // the wrapper stops on a signal (value = signal)
+    Fault = 13        // chaos mode injected a fault (value = ChaosFault: 1 kill, 2 stop, 3 close, 4 delay)
+};
+
+inline const char *supervisorEventName(SupervisorEvent event)
+{
+    switch (event)
+    {
+    case SupervisorEvent::Boot: return "boot";
+    case SupervisorEvent::Spawn: return "spawn";
+    case SupervisorEvent::Exit: return "exit";
+    case SupervisorEvent::Restart: return "restart";
+    case SupervisorEvent::Replace: return "replace";
+    case SupervisorEvent::Promote: return "promote";
+    case SupervisorEvent::Crash: return "crash";
+    case SupervisorEvent::Stall: return "stall";
+    case SupervisorEvent::Level: return "level";
+    case SupervisorEvent::Shed: return "shed";
+    case SupervisorEvent::Restore: return "restore";
+    case SupervisorEvent::Shutdown: return "shutdown";
+    case SupervisorEvent::Fault: return "fault";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief One supervised child process and its restart and resource bookkeeping.
+ */
+struct SupervisedChild
+{
+    std::string name;
+    pid_t pid = -1;
+    RestartPolicy policy = RestartPolicy::CrashWrapper;
+    std::function<pid_t()> start; // relaunches the child; required for RestartPolicy::Restart
+    std::function<pid_t()> takeover; // optional: PID of a process that takes over at once when the child dies (a warm standby), -1 if none
+
+    int restarts = 0;
+    int backoff_ms = 0;
+    bool replacing = false; // stopped on purpose by replace(); relaunched at once whatever the policy
+    bool chained = false;   // stopped by replaceChain(); relaunched in order once the whole chain is down
+    bool restart_pending = false;
+    std::chrono::steady_clock::time_point started_at;
+    std::chrono::steady_clock::time_point restart_at;
+    std::string last_exit;
+
+    // Filled by ChildSupervisor::sample()
+    unsigned long long cpu_ticks = 0;
+    std::chrono::steady_clock::time_point sampled_at;
+    double cpu_percent = 0.0;
+    long rss_kb = 0;
+};
+
+/**
+ * @brief Forks and execs args[0] with args, optionally in workingDir, with extra
+ *        environment variables and stdout/stderr redirected to logPath.
+ * @return The PID of the child, or -1 if fork failed.
+ */
+inline pid_t spawnProcess(const std::vector<std::string> &args, const std::string &workingDir,
+                          const std::vector<std::pair<std::string, std::string>> &env, const std::string &logPath)
+{
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "Failed to fork for " << args[0] << "." << std::endl;
+        return -1;
+    }
+    if (pid == 0)
+    {
+        if (!workingDir.empty() && chdir(workingDir.c_str()) == -1)
+        {
+            perror(("chdir for " + args[0] + " failed").c_str());
+            _exit(1);
+        }
+        for (const auto &var : env)
+        {
+            setenv(var.first.c_str(), var.second.c_str(), 1);
+        }
+        if (!logPath.empty())
+        {
+            int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd != -1)
+            {
+                dup2(fd, STDOUT_FILENO);
+                dup2(fd, STDERR_FILENO);
+                close(fd);
+            }
+        }
+        std::vector<char *> argv;
+        for (const auto &arg : args) argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        perror(("execvp for " + args[0] + " failed").c_str());
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief Forks and runs body() in the child, which exits with its return value.
+ *        Used for pipelines implemented inside the wrapper (e.g. the thermal bridge)
+ *        so they are supervised like any other child.
+ * @return The PID of the child, or -1 if fork failed.
+ */
+inline pid_t spawnFunction(const std::string &name, const std::function<int()> &body)
+{
+    std::cout.flush(); // do not duplicate buffered output into the child
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "Failed to fork for " << name << "." << std::endl;
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // The wrapper's handlers kill the whole camera stack; the child only stops itself
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        const int code = body();
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(code);
+    }
+    return pid;
+}
+
+/**
+ * @brief Describes a waitpid() status for logs.
+ */
+inline std::string describeExitStatus(int status)
+{
+    if (WIFEXITED(status)) return "exited with status " + std::to_string(WEXITSTATUS(status));
+    if (WIFSIGNALED(status)) return "terminated by signal " + std::to_string(WTERMSIG(status));
+    return "exited for unknown reason";
+}
+
+/**
+ * @brief pid and all its descendants, parents before children.
+ */
+inline std::vector<pid_t> processTree(pid_t pid)
+{
+    std::multimap<pid_t, pid_t> by_parent;
+    DIR *dir = opendir("/proc");
+    if (dir)
+    {
+        while (struct dirent *entry = readdir(dir))
+        {
+            const pid_t child = static_cast<pid_t>(std::atoi(entry->d_name));
+            if (child <= 0) continue;
+            std::ifstream in("/proc/" + std::to_string(child) + "/stat");
+            std::string stat;
+            std::getline(in, stat);
+            const size_t comm_end = stat.rfind(')');
+            if (comm_end == std::string::npos || comm_end + 2 >= stat.size()) continue;
+            char state;
+            int parent = 0;
+            if (std::sscanf(stat.c_str() + comm_end + 2, "%c %d", &state, &parent) == 2) by_parent.insert({parent, child});
+        }
+        closedir(dir);
+    }
+    std::vector<pid_t> tree = {pid};
+    for (size_t i = 0; i < tree.size(); ++i)
+    {
+        const auto range = by_parent.equal_range(tree[i]);
+        for (auto it = range.first; it != range.second; ++it) tree.push_back(it->second);
+    }
+    return tree;
+}
+
+/**
+ * @brief Sends sig to pid and all its descendants.
+ */
+inline void signalTree(pid_t pid, int sig)
+{
+    for (pid_t member : processTree(pid)) kill(member, sig);
+}
+
+/**
+ * @brief True if pid or one of its descendants has path open.
+ */
+inline bool processTreeHolds(pid_t pid, const std::string &path)
+{
+    for (pid_t member : processTree(pid))
+    {
+        const std::string fd_dir = "/proc/" + std::to_string(member) + "/fd";
+        DIR *dir = opendir(fd_dir.c_str());
+        if (!dir) continue;
+        bool holds = false;
+        while (struct dirent *entry = readdir(dir))
+        {
+            char target[PATH_MAX];
+            const ssize_t n = readlink((fd_dir + "/" + entry->d_name).c_str(), target, sizeof(target) - 1);
+            if (n <= 0) continue;
+            target[n] = '\0';
+            if (path == target)
+            {
+                holds = true;
+                break;
+            }
+        }
+        closedir(dir);
+        if (holds) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief The state letter of /proc/<pid>/stat ('T' = stopped), 0 if it is gone.
+ */
+inline char processState(pid_t pid)
+{
+    std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    std::getline(in, stat);
+    const size_t comm_end = stat.rfind(')');
+    return comm_end == std::string::npos || comm_end + 2 >= stat.size() ? 0 : stat[comm_end + 2];
+}
+
+/**
+ * @brief True if the module config declares "key": true, the way a module opts in to a
+ *        wrapper feature that needs its cooperation (e.g. "ai_rate_support").
+ */
+inline bool moduleConfigDeclares(const std::string &config, const std::string &key)
+{
+    std::ifstream in(config);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+    const std::string quoted = "\"" + key + "\"";
+    for (size_t at = text.find(quoted); at != std::string::npos; at = text.find(quoted, at + quoted.size()))
+    {
+        size_t i = text.find_first_not_of(" \t\r\n", at + quoted.size());
+        if (i == std::string::npos || text[i] != ':') continue;
+        i = text.find_first_not_of(" \t\r\n", i + 1);
+        return i != std::string::npos && text.compare(i, 4, "true") == 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Writes a status file through "<path>.tmp" and rename(), so a reader never
+ *        sees half of it. Does nothing if path is empty.
+ */
+inline void writeStatusFile(const std::string &path, const std::function<void(std::ostream &)> &body)
+{
+    if (path.empty()) return;
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp);
+        if (!out) return;
+        body(out);
+    }
+    std::rename(temp.c_str(), path.c_str());
+}
+
+/**
+ * @brief Collects the inodes of sockets in /proc/net/<table> that are bound to a
+ *        local port. TCP sockets only count while listening.
+ * @param port If not 0, only sockets bound to this port.
+ */
+inline void boundSocketInodes(const char *table, int port, std::set<unsigned long> &inodes)
+{
+    const bool tcp = std::strncmp(table, "tcp", 3) == 0;
+    std::ifstream in(std::string("/proc/net/") + table);
+    std::string line;
+    std::getline(in, line); // header
+    while (std::getline(in, line))
+    {
+        // sl local_address rem_address st tx:rx tr:when retrnsmt uid timeout inode
+        std::istringstream ls(line);
+        std::string sl, local, remote, state, queues, timer, retr, uid, timeout;
+        unsigned long inode = 0;
+        if (!(ls >> sl >> local >> remote >> state >> queues >> timer >> retr >> uid >> timeout >> inode)) continue;
+        const size_t colon = local.find(':');
+        if (colon == std::string::npos) continue;
+        const int local_port = static_cast<int>(std::strtol(local.c_str() + colon + 1, nullptr, 16));
+        if (local_port == 0 || (port != 0 && local_port != port)) continue;
+        if (tcp && state != "0A") continue; // TCP_LISTEN
+        inodes.insert(inode);
+    }
+}
+
+/**
+ * @brief Collects every local port with a listening TCP or bound UDP socket (IPv4 and IPv6).
+ */
+inline void boundLocalPorts(std::set<int> &ports)
+{
+    static const char *tables[] = {"tcp", "tcp6", "udp", "udp6"};
+    for (const char *table : tables)
+    {
+        const bool tcp = std::strncmp(table, "tcp", 3) == 0;
+        std::ifstream in(std::string("/proc/net/") + table);
+        std::string line;
+        std::getline(in, line);
+        while (std::getline(in, line))
+        {
+            std::istringstream ls(line);
+            std::string sl, local, remote, state;
+            if (!(ls >> sl >> local >> remote >> state)) continue;
+            const size_t colon = local.find(':');
+            if (colon == std::string::npos || (tcp && state != "0A")) continue;
+            ports.insert(static_cast<int>(std::strtol(local.c_str() + colon + 1, nullptr, 16)));
+        }
+    }
+}
+
+/**
+ * @brief True if pid holds a bound UDP socket (or listening TCP socket), optionally on a given port.
+ *        Used as a readiness check instead of fixed sleeps.
+ */
+inline bool processHasBoundSocket(pid_t pid, bool udp, int port = 0)
+{
+    std::set<unsigned long> bound;
+    boundSocketInodes(udp ? "udp" : "tcp", port, bound);
+    boundSocketInodes(udp ? "udp6" : "tcp6", port, bound);
+    if (bound.empty()) return false;
+
+    const std::string fd_dir = "/proc/" + std::to_string(pid) + "/fd";
+    DIR *dir = opendir(fd_dir.c_str());
+    if (!dir) return false;
+    bool found = false;
+    while (struct dirent *entry = readdir(dir))
+    {
+        char target[64];
+        const ssize_t n = readlink((fd_dir + "/" + entry->d_name).c_str(), target, sizeof(target) - 1);
+        if (n <= 0) continue;
+        target[n] = '\0';
+        unsigned long inode = 0;
+        if (std::sscanf(target, "socket:[%lu]", &inode) == 1 && bound.count(inode))
+        {
+            found = true;
+            break;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+/**
+ * @brief Table of supervised children and the loop that reaps and restarts them.
+ */
+class ChildSupervisor
+{
+public:
+    typedef std::function<void()> TickHook;
+    typedef std::function<void(SupervisedChild &, int status)> ExitHook;
+    typedef std::function<void(SupervisorEvent, const std::string &name, pid_t pid, int32_t value, int64_t arg)> EventHook;
+
+    /**
+     * @brief Registers a running child. Returns its index in children().
+     */
+    size_t add(const std::string &name, pid_t pid, RestartPolicy policy, std::function<pid_t()> start = nullptr)
+    {
+        SupervisedChild child;
+        child.name = name;
+        child.pid = pid;
+        child.policy = policy;
+        child.start = start;
+        child.started_at = std::chrono::steady_clock::now();
+        m_children.push_back(child);
+        if (pid > 0) notify(SupervisorEvent::Spawn, name, pid, 0);
+        return m_children.size() - 1;
+    }
+
+    std::vector<SupervisedChild> &children() { return m_children; }
+
+    SupervisedChild *find(pid_t pid)
+    {
+        for (auto &child : m_children)
+        {
+            if (child.pid == pid) return &child;
+        }
+        return nullptr;
+    }
+
+    void addTickHook(TickHook hook) { m_tick_hooks.push_back(hook); }
+    void addExitHook(ExitHook hook) { m_exit_hooks.push_back(hook); }
+    void addEventHook(EventHook hook) { m_event_hooks.push_back(hook); }
+
+    /**
+     * @brief Passes an event to the event hooks; also used by the features that act on children.
+     */
+    void notify(SupervisorEvent event, const std::string &name, pid_t pid, int32_t value, int64_t arg = 0)
+    {
+        for (auto &hook : m_event_hooks) hook(event, name, pid, value, arg);
+    }
+
+    /**
+     * @brief Starts (or restarts) child i through its start function.
+     */
+    bool launch(size_t i)
+    {
+        SupervisedChild &child = m_children[i];
+        child.restart_pending = false;
+        child.pid = child.start ? child.start() : -1;
+        child.started_at = std::chrono::steady_clock::now();
+        child.cpu_ticks = 0;
+        child.cpu_percent = 0.0;
+        child.rss_kb = 0;
+        if (child.pid > 0) notify(SupervisorEvent::Spawn, child.name, child.pid, child.restarts);
+        return child.pid > 0;
+    }
+
+    /**
+     * @brief Stops child i on purpose (e.g. to apply new settings); its exit is not a
+     *        crash and it is relaunched through its start function right away. A child
+     *        that leads its own process group is stopped with the whole group.
+     * @return False if the child is not running or cannot be relaunched.
+     */
+    bool replace(size_t i)
+    {
+        SupervisedChild &child = m_children[i];
+        if (child.pid <= 0 || !child.start) return false;
+        child.replacing = true;
+        notify(SupervisorEvent::Replace, child.name, child.pid, 0);
+        kill(getpgid(child.pid) == child.pid ? -child.pid : child.pid, SIGTERM);
+        return true;
+    }
+
+    /**
+     * @brief Replaces children as one unit: all of them are stopped, and once the last
+     *        one is down they are relaunched in the given order, gap_ms apart. For a
+     *        producer and the consumers holding its v4l2loopback device, which keeps
+     *        its format for as long as anyone has it open.
+     * @return False if a running member cannot be relaunched; nothing is stopped then.
+     */
+    bool replaceChain(std::vector<size_t> order, int gap_ms)
+    {
+        for (size_t i : order)
+        {
+            if (m_children[i].pid > 0 && !m_children[i].start) return false;
+        }
+        // A member that is down and has no start function stays down
+        order.erase(std::remove_if(order.begin(), order.end(), [this](size_t i) { return m_children[i].pid <= 0 && !m_children[i].start; }), order.end());
+        m_chain = order;
+        m_chain_gap_ms = gap_ms;
+        m_chain_down = false;
+        for (size_t i : m_chain)
+        {
+            SupervisedChild &child = m_children[i];
+            child.chained = true;
+            child.replacing = false;
+            child.restart_pending = false;
+            if (child.pid <= 0) continue;
+            notify(SupervisorEvent::Replace, child.name, child.pid, 0);
+            kill(getpgid(child.pid) == child.pid ? -child.pid : child.pid, SIGTERM);
+            wakeTree(child.pid); // a paused member would not act on SIGTERM
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reaps and restarts children until a CrashWrapper child exits or stop() is called.
+     * @return 1 if a CrashWrapper child (or an unknown child) exited, 0 after stop().
+     */
+    int run(int tick_ms = SUPERVISOR_TICK_MS)
+    {
+        m_stop = false;
+        auto last_tick = std::chrono::steady_clock::now();
+        while (!m_stop)
+        {
+            const auto tick_at = std::chrono::steady_clock::now();
+            const long long late_ms = std::chrono::duration_cast<std::chrono::milliseconds>(tick_at - last_tick).count() - tick_ms;
+            if (late_ms >= SUPERVISOR_STALL_MS) notify(SupervisorEvent::Stall, "supervisor", getpid(), static_cast<int32_t>(late_ms));
+            last_tick = tick_at;
+
+            int status;
+            pid_t exited_pid;
+            while ((exited_pid = waitpid(-1, &status, WNOHANG)) > 0)
+            {
+                if (!handleExit(exited_pid, status)) return 1;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < m_children.size(); ++i)
+            {
+                SupervisedChild &child = m_children[i];
+                if (!child.restart_pending || now < child.restart_at) continue;
+                ++child.restarts;
+                if (launch(i))
+                {
+                    std::cout << "Restarted " << child.name << " (PID " << child.pid << ", restart #" << child.restarts << ")" << std::endl;
+                }
+                else
+                {
+                    std::cerr << "Failed to restart " << child.name << "; retrying." << std::endl;
+                    scheduleRestart(child);
+                }
+            }
+
+            if (!m_chain.empty() && !advanceChain(now)) return 1;
+            if (!m_paused.empty()) prunePaused();
+            for (auto &hook : m_tick_hooks) hook();
+            std::this_thread::sleep_for(std::chrono::milliseconds(tick_ms));
+        }
+        return 0;
+    }
+
+    void stop() { m_stop = true; }
+
+    /**
+     * @brief Stops pid (SIGSTOP) on behalf of owner. Every feature that pauses
+     *        processes goes through here, so resuming for one owner does not wake
+     *        a process another owner still holds. A process that was already
+     *        stopped (a spare that stopped itself) stays stopped when its owners
+     *        resume it; only wake() continues it.
+     */
+    bool pause(pid_t pid, const std::string &owner)
+    {
+        auto it = m_paused.find(pid);
+        if (it == m_paused.end())
+        {
+            PausedProcess entry;
+            entry.self_stopped = processState(pid) == 'T';
+            if (!entry.self_stopped && kill(pid, SIGSTOP) != 0) return false;
+            it = m_paused.insert({pid, entry}).first;
+        }
+        it->second.owners.insert(owner);
+        return true;
+    }
+
+    /**
+     * @brief pause() for pid and all its descendants. Returns the paused PIDs.
+     */
+    std::vector<pid_t> pauseTree(pid_t pid, const std::string &owner)
+    {
+        std::vector<pid_t> paused;
+        for (pid_t member : processTree(pid))
+        {
+            if (pause(member, owner)) paused.push_back(member);
+        }
+        return paused;
+    }
+
+    /**
+     * @brief Drops owner's hold on pid; SIGCONT once no owner is left.
+     */
+    void resume(pid_t pid, const std::string &owner)
+    {
+        const auto it = m_paused.find(pid);
+        if (it == m_paused.end() || !it->second.owners.erase(owner) || !it->second.owners.empty()) return;
+        if (!it->second.self_stopped) kill(pid, SIGCONT);
+        m_paused.erase(it);
+    }
+
+    void resume(const std::vector<pid_t> &pids, const std::string &owner)
+    {
+        for (pid_t pid : pids) resume(pid, owner);
+    }
+
+    /**
+     * @brief Drops every hold of owner.
+     */
+    void resumeAll(const std::string &owner)
+    {
+        std::vector<pid_t> held;
+        for (const auto &entry : m_paused)
+        {
+            if (entry.second.owners.count(owner)) held.push_back(entry.first);
+        }
+        resume(held, owner);
+    }
+
+    /**
+     * @brief Continues pid whoever paused it (a promoted spare, or shutdown).
+     */
+    void wake(pid_t pid)
+    {
+        m_paused.erase(pid);
+        kill(pid, SIGCONT);
+    }
+
+    void wakeTree(pid_t pid)
+    {
+        for (pid_t member : processTree(pid)) wake(member);
+    }
+
+    /**
+     * @brief Continues every paused process. A stopped process would not act on
+     *        SIGTERM, so this runs before the wrapper stops its children.
+     */
+    void wakeAll()
+    {
+        for (const auto &entry : m_paused) kill(entry.first, SIGCONT);
+        m_paused.clear();
+    }
+
+    bool paused(pid_t pid) const { return m_paused.count(pid) > 0; }
+
+    /**
+     * @brief Sends SIGTERM to every live child, waits up to grace_ms, then SIGKILLs the rest.
+     */
+    void stopAll(int grace_ms = 3000)
+    {
+        for (auto &child : m_children)
+        {
+            child.restart_pending = false;
+            if (child.pid > 0)
+            {
+                std::cout << "Stopping " << child.name << " (PID " << child.pid << ")..." << std::endl;
+                kill(child.pid, SIGTERM);
+            }
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(grace_ms);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            bool alive = false;
+            for (auto &child : m_children)
+            {
+                if (child.pid <= 0) continue;
+                if (waitpid(child.pid, nullptr, WNOHANG) == child.pid) child.pid = -1;
+                else alive = true;
+            }
+            if (!alive) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        for (auto &child : m_children)
+        {
+            if (child.pid <= 0) continue;
+            std::cerr << child.name << " (PID " << child.pid << ") ignored SIGTERM; killing." << std::endl;
+            kill(child.pid, SIGKILL);
+            waitpid(child.pid, nullptr, 0);
+            child.pid = -1;
+        }
+    }
+
+    /**
+     * @brief Refreshes cpu_percent (since the previous sample) and rss_kb from /proc/<pid>/stat.
+     */
+    static void sample(SupervisedChild &child)
+    {
+        if (child.pid <= 0) return;
+        std::ifstream in("/proc/" + std::to_string(child.pid) + "/stat");
+        std::string text;
+        std::getline(in, text);
+        const size_t comm_end = text.rfind(')');
+        if (comm_end == std::string::npos) return;
+
+        // Fields after "pid (comm)": state is field 3, utime 14, stime 15, rss 24
+        std::istringstream fields(text.substr(comm_end + 2));
+        std::string field;
+        unsigned long long utime = 0, stime = 0;
+        long rss_pages = 0;
+        for (int n = 3; n <= 24 && fields >> field; ++n)
+        {
+            if (n == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+            else if (n == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+            else if (n == 24) rss_pages = std::strtol(field.c_str(), nullptr, 10);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        const unsigned long long ticks = utime + stime;
+        if (child.cpu_ticks != 0 && ticks >= child.cpu_ticks)
+        {
+            const double seconds = std::chrono::duration<double>(now - child.sampled_at).count();
+            if (seconds > 0) child.cpu_percent = 100.0 * (ticks - child.cpu_ticks) / (sysconf(_SC_CLK_TCK) * seconds);
+        }
+        child.cpu_ticks = ticks;
+        child.sampled_at = now;
+        child.rss_kb = rss_pages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+private:
+    struct PausedProcess
+    {
+        std::set<std::string> owners;
+        bool self_stopped = false;
+    };
+
+    /**
+     * @brief Forgets paused processes that are gone, so a reused PID is not continued.
+     */
+    void prunePaused()
+    {
+        for (auto it = m_paused.begin(); it != m_paused.end();)
+        {
+            if (kill(it->first, 0) == -1 && errno == ESRCH) it = m_paused.erase(it);
+            else ++it;
+        }
+    }
+
+    // Returns false if the wrapper must exit
+    bool handleExit(pid_t pid, int status)
+    {
+        SupervisedChild *child = find(pid);
+        const std::string reason = describeExitStatus(status);
+        if (!child)
+        {
+            std::cerr << "Child process (PID " << pid << ") " << reason << ". Crashing wrapper to force a full systemctl restart." << std::endl;
+            notify(SupervisorEvent::Crash, "unknown", pid, status);
+            return false;
+        }
+        child->pid = -1;
+        child->last_exit = reason;
+        m_paused.erase(pid);
+        notify(SupervisorEvent::Exit, child->name, pid, status,
+               std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - child->started_at).count());
+        for (auto &hook : m_exit_hooks) hook(*child, status);
+        if (child->chained)
+        {
+            std::cout << "Stopped " << child->name << " (" << reason << "), restarting it with its chain" << std::endl;
+            return true;
+        }
+        if (child->replacing)
+        {
+            child->replacing = false;
+            if (launch(child - m_children.data()))
+            {
+                std::cout << "Replaced " << child->name << " (PID " << child->pid << ")" << std::endl;
+                return true;
+            }
+            std::cerr << "Failed to relaunch " << child->name << " after replacing it." << std::endl;
+        }
+        if (child->takeover)
+        {
+            const pid_t successor = child->takeover();
+            if (successor > 0)
+            {
+                child->pid = successor;
+                child->started_at = std::chrono::steady_clock::now();
+                ++child->restarts;
+                std::cout << child->name << " (PID " << pid << ") " << reason << ". Promoted standby PID " << successor << "." << std::endl;
+                notify(SupervisorEvent::Promote, child->name, successor, pid);
+                return true;
+            }
+        }
+        if (child->policy == RestartPolicy::CrashWrapper || !child->start)
+        {
+            std::cerr << child->name << " (PID " << pid << ") " << reason << ". Crashing wrapper to force a full systemctl restart." << std::endl;
+            notify(SupervisorEvent::Crash, child->name, pid, status);
+            return false;
+        }
+        scheduleRestart(*child);
+        std::cerr << child->name << " (PID " << pid << ") " << reason << ". Restarting in " << child->backoff_ms << " ms." << std::endl;
+        notify(SupervisorEvent::Restart, child->name, pid, child->backoff_ms);
+        return true;
+    }
+
+    /**
+     * @brief Relaunches the next member of the chain once all of them are down.
+     * @return False if the wrapper must exit.
+     */
+    bool advanceChain(std::chrono::steady_clock::time_point now)
+    {
+        if (!m_chain_down)
+        {
+            for (size_t i : m_chain)
+            {
+                if (m_children[i].pid > 0) return true;
+            }
+            m_chain_down = true;
+            m_chain_next = 0;
+            m_chain_at = now;
+        }
+        if (now < m_chain_at) return true;
+        SupervisedChild &child = m_children[m_chain[m_chain_next]];
+        child.chained = false;
+        if (launch(m_chain[m_chain_next]))
+        {
+            std::cout << "Replaced " << child.name << " (PID " << child.pid << ")" << std::endl;
+        }
+        else if (child.policy == RestartPolicy::CrashWrapper)
+        {
+            std::cerr << "Failed to relaunch " << child.name << " after replacing it. Crashing wrapper to force a full systemctl restart." << std::endl;
+            notify(SupervisorEvent::Crash, child.name, -1, 0);
+            return false;
+        }
+        else
+        {
+            std::cerr << "Failed to relaunch " << child.name << " after replacing it; retrying." << std::endl;
+            scheduleRestart(child);
+        }
+        m_chain_at = now + std::chrono::milliseconds(m_chain_gap_ms);
+        if (++m_chain_next == m_chain.size()) m_chain.clear();
+        return true;
+    }
+
+    static void scheduleRestart(SupervisedChild &child)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - child.started_at > std::chrono::seconds(SUPERVISOR_STABLE_SEC) || child.backoff_ms == 0)
+        {
+            child.backoff_ms = SUPERVISOR_BACKOFF_MIN_MS;
+        }
+        else
+        {
+            child.backoff_ms = std::min(child.backoff_ms * 2, SUPERVISOR_BACKOFF_MAX_MS);
+        }
+        child.restart_pending = true;
+        child.restart_at = now + std::chrono::milliseconds(child.backoff_ms);
+    }
+
+    std::vector<SupervisedChild> m_children;
+    std::vector<TickHook> m_tick_hooks;
+    std::vector<ExitHook> m_exit_hooks;
+    std::vector<EventHook> m_event_hooks;
+    std::map<pid_t, PausedProcess> m_paused; // by pause(), with the features holding each
+    std::vector<size_t> m_chain;             // replaceChain() members still to relaunch, in order
+    size_t m_chain_next = 0;
+    int m_chain_gap_ms = 0;
+    bool m_chain_down = false;               // all members have exited; relaunching
+    std::chrono::steady_clock::time_point m_chain_at;
+    volatile bool m_stop = false;
+};
+
+#endif // DE_SUPERVISOR_HPP
@@ -0,0 +1,445 @@
+//***************************************************************************** */
+//  Native thermal camera bridge
+//
+//  Replaces "thermal_toolbox.py --stream | ffmpeg rgb24 -> v4l2" of
+//  sh_camera_senxor_thermal_run_on_vc.sh. Raw 16-bit sensor frames are read
+//  once, straight into a shared-memory ring (de_shm_ring.hpp) so AI and
+//  trackers get the radiometric values, and the same frame is colour-mapped
+//  into a YUV420 preview for the DE-THERMAL virtual camera:
+//
+//      source --raw u16--> ring "de_thermal_raw"
+//                   \--> auto-range + 8-bit index (SIMD) --> palette LUT + upscale --> DE-THERMAL
+//
+//  Sources are pluggable:
+//      file:<path>     recorded raw frames (width*height little-endian u16), looped at --thermal-fps
+//      pipe:<command>  a command that writes raw frames to stdout (the sensor driver)
+//
+//  The range and index kernels use GCC vector extensions, so the same code
+//  compiles to NEON on the Pi and SSE on x86. The palette lookup itself is a
+//  gather and stays scalar; it runs on the small sensor-resolution index map
+//  through precomputed row/column maps, never on floating point.
+//
+//***************************************************************************** */
+
+#ifndef DE_THERMAL_HPP
+#define DE_THERMAL_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+
+#include "de_shm_ring.hpp"
+#include "de_frame_meta.hpp"
+#include "de_frame_sink.hpp"
+
+#define THERMAL_RING_SLOTS 8
+#define THERMAL_RANGE_SMOOTHING 0.25f // weight of the new frame's min/max in the displayed range
+#define THERMAL_MIN_SPAN 2.0f         // degrees; stops a uniform scene from being stretched into noise
+
+struct ThermalOptions
+{
+    std::string source;                  // file:<path> or pipe:<command>
+    uint32_t width = 80;                 // sensor resolution
+    uint32_t height = 62;
+    int fps = 5;                         // pacing of file: sources
+    std::string output = "DE-THERMAL";   // label, /dev/videoN or file:<path>
+    uint32_t out_width = 640;
+    uint32_t out_height = 480;
+    std::string palette = "iron";        // iron, rainbow, white-hot, black-hot
+    std::string ring_name = "de_thermal_raw";
+    std::string meta_ring;               // FrameMeta ring (de_frame_meta.hpp), empty = off
+    float unit_scale = 0.1f;             // raw sample -> degrees C: deci-Kelvin by default
+    float unit_offset = -273.15f;
+    long max_frames = 0;                 // stop after N frames, 0 = run forever
+    int stats_sec = 30;
+};
+
+typedef uint16_t ThermalVec16 __attribute__((vector_size(16)));
+typedef uint32_t ThermalVec32 __attribute__((vector_size(32)));
+typedef uint8_t ThermalVec8 __attribute__((vector_size(8)));
+#define THERMAL_LANES (sizeof(ThermalVec16) / sizeof(uint16_t))
+
+/**
+ * @brief Minimum and maximum sample of a frame.
+ */
+inline void thermalMinMax(const uint16_t *src, size_t count, uint16_t &lo, uint16_t &hi)
+{
+    ThermalVec16 vlo, vhi;
+    for (size_t l = 0; l < THERMAL_LANES; ++l)
+    {
+        vlo[l] = 0xffff;
+        vhi[l] = 0;
+    }
+    size_t i = 0;
+    for (; i + THERMAL_LANES <= count; i += THERMAL_LANES)
+    {
+        ThermalVec16 v;
+        std::memcpy(&v, src + i, sizeof(v)); // unaligned load
+        vlo = v < vlo ? v : vlo;
+        vhi = v > vhi ? v : vhi;
+    }
+    lo = 0xffff;
+    hi = 0;
+    for (size_t l = 0; l < THERMAL_LANES; ++l)
+    {
+        lo = std::min<uint16_t>(lo, vlo[l]);
+        hi = std::max<uint16_t>(hi, vhi[l]);
+    }
+    for (; i < count; ++i)
+    {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+    }
+}
+
+/**
+ * @brief Maps samples in [lo, hi] linearly to palette indices 0..255 (clamped outside).
+ */
+inline void thermalToIndex(const uint16_t *src, size_t count, uint16_t lo, uint16_t hi, uint8_t *dst)
+{
+    const uint32_t span = std::max<uint32_t>(1, hi - lo);
+    const uint32_t k = (255u << 16) / span; // (v - lo) * k <= 255 << 16 fits 32 bits
+    ThermalVec16 vlo, vhi;
+    ThermalVec32 vk;
+    for (size_t l = 0; l < THERMAL_LANES; ++l)
+    {
+        vlo[l] = lo;
+        vhi[l] = hi;
+        vk[l] = k;
+    }
+    size_t i = 0;
+    for (; i + THERMAL_LANES <= count; i += THERMAL_LANES)
+    {
+        ThermalVec16 v;
+        std::memcpy(&v, src + i, sizeof(v));
+        v = v < vlo ? vlo : v;
+        v = v > vhi ? vhi : v;
+        const ThermalVec32 wide = __builtin_convertvector(v - vlo, ThermalVec32);
+        const ThermalVec8 index = __builtin_convertvector((wide * vk) >> 16, ThermalVec8);
+        std::memcpy(dst + i, &index, sizeof(index));
+    }
+    for (; i < count; ++i)
+    {
+        const uint16_t v = std::min(std::max(src[i], lo), hi);
+        dst[i] = static_cast<uint8_t>((static_cast<uint32_t>(v - lo) * k) >> 16);
+    }
+}
+
+/**
+ * @brief 256-entry palette in limited-range BT.601 YUV, built from RGB control points.
+ */
+struct ThermalPalette
+{
+    uint8_t y[256];
+    uint8_t u[256];
+    uint8_t v[256];
+
+    bool build(const std::string &name)
+    {
+        static const uint8_t iron[][3] = {{0, 0, 0}, {40, 0, 120}, {140, 0, 150}, {220, 60, 40}, {250, 150, 0}, {255, 220, 60}, {255, 255, 255}};
+        static const uint8_t rainbow[][3] = {{0, 0, 128}, {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}, {128, 0, 0}};
+        static const uint8_t white_hot[][3] = {{0, 0, 0}, {255, 255, 255}};
+        static const uint8_t black_hot[][3] = {{255, 255, 255}, {0, 0, 0}};
+
+        const uint8_t(*points)[3];
+        size_t count;
+        if (name == "iron") { points = iron; count = sizeof(iron) / sizeof(iron[0]); }
+        else if (name == "rainbow") { points = rainbow; count = sizeof(rainbow) / sizeof(rainbow[0]); }
+        else if (name == "white-hot") { points = white_hot; count = 2; }
+        else if (name == "black-hot") { points = black_hot; count = 2; }
+        else return false;
+
+        for (int i = 0; i < 256; ++i)
+        {
+            const float pos = i / 255.0f * (count - 1);
+            const size_t seg = std::min(static_cast<size_t>(pos), count - 2);
+            const float t = pos - seg;
+            float rgb[3];
+            for (int c = 0; c < 3; ++c) rgb[c] = points[seg][c] + t * (points[seg + 1][c] - points[seg][c]);
+            y[i] = static_cast<uint8_t>(16.0f + (65.481f * rgb[0] + 128.553f * rgb[1] + 24.966f * rgb[2]) / 255.0f + 0.5f);
+            u[i] = static_cast<uint8_t>(128.0f + (-37.797f * rgb[0] - 74.203f * rgb[1] + 112.0f * rgb[2]) / 255.0f + 0.5f);
+            v[i] = static_cast<uint8_t>(128.0f + (112.0f * rgb[0] - 93.786f * rgb[1] - 18.214f * rgb[2]) / 255.0f + 0.5f);
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief A source of raw 16-bit thermal frames.
+ */
+class ThermalSource
+{
+public:
+    virtual ~ThermalSource() {}
+    virtual bool open() = 0;
+    /** @brief Reads one frame of `bytes` bytes. False at end of stream or on error. */
+    virtual bool read(uint8_t *frame, size_t bytes) = 0;
+    /** @brief True if the source must be paced by the bridge (recordings). */
+    virtual bool needsPacing() const = 0;
+};
+
+/**
+ * @brief Recorded raw frames from a file, looped.
+ */
+class FileThermalSource : public ThermalSource
+{
+public:
+    explicit FileThermalSource(const std::string &path) : m_path(path) {}
+
+    bool open() override
+    {
+        m_in.open(m_path, std::ios::binary);
+        if (!m_in) std::cerr << "Thermal: cannot open recording " << m_path << std::endl;
+        return static_cast<bool>(m_in);
+    }
+
+    bool read(uint8_t *frame, size_t bytes) override
+    {
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            if (m_in.read(reinterpret_cast<char *>(frame), bytes)) return true;
+            m_in.clear();
+            m_in.seekg(0); // loop the recording; a trailing partial frame is skipped
+        }
+        std::cerr << "Thermal: recording " << m_path << " holds no complete frame" << std::endl;
+        return false;
+    }
+
+    bool needsPacing() const override { return true; }
+
+private:
+    std::string m_path;
+    std::ifstream m_in;
+};
+
+/**
+ * @brief Raw frames from the stdout of a driver command.
+ */
+class PipeThermalSource : public ThermalSource
+{
+public:
+    explicit PipeThermalSource(const std::string &command) : m_command(command) {}
+    ~PipeThermalSource() override
+    {
+        if (m_pipe) pclose(m_pipe);
+    }
+
+    bool open() override
+    {
+        m_pipe = popen(m_command.c_str(), "r");
+        if (!m_pipe) perror(("Thermal: popen " + m_command).c_str());
+        return m_pipe != nullptr;
+    }
+
+    bool read(uint8_t *frame, size_t bytes) override
+    {
+        return std::fread(frame, 1, bytes, m_pipe) == bytes;
+    }
+
+    bool needsPacing() const override { return false; }
+
+private:
+    std::string m_command;
+    FILE *m_pipe = nullptr;
+};
+
+inline std::unique_ptr<ThermalSource> makeThermalSource(const std::string &spec)
+{
+    if (spec.rfind("file:", 0) == 0) return std::unique_ptr<ThermalSource>(new FileThermalSource(spec.substr(5)));
+    if (spec.rfind("pipe:", 0) == 0) return std::unique_ptr<ThermalSource>(new PipeThermalSource(spec.substr(5)));
+    return nullptr;
+}
+
+static volatile sig_atomic_t g_thermal_stop = 0;
+
+/**
+ * @brief The bridge loop. Runs in its own process (see spawnFunction()).
+ */
+class ThermalBridge
+{
+public:
+    explicit ThermalBridge(const ThermalOptions &options) : m_options(options) {}
+
+    /**
+     * @return Process exit code: 0 after max_frames or SIGTERM, 1 on setup or source failure.
+     */
+    int run()
+    {
+        // No SA_RESTART: SIGTERM must interrupt a blocking read from the driver pipe
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = [](int) { g_thermal_stop = 1; };
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        const uint32_t w = m_options.width, h = m_options.height;
+        const uint32_t ow = m_options.out_width & ~1u, oh = m_options.out_height & ~1u;
+        const size_t pixels = static_cast<size_t>(w) * h;
+        const size_t raw_bytes = pixels * sizeof(uint16_t);
+        const size_t preview_bytes = static_cast<size_t>(ow) * oh * 3 / 2;
+
+        ThermalPalette palette;
+        if (!palette.build(m_options.palette))
+        {
+            std::cerr << "Thermal: unknown palette " << m_options.palette << std::endl;
+            return 1;
+        }
+        std::unique_ptr<ThermalSource> source = makeThermalSource(m_options.source);
+        if (!source)
+        {
+            std::cerr << "Thermal: source must be file:<path> or pipe:<command>, got '" << m_options.source << "'" << std::endl;
+            return 1;
+        }
+
+        ShmRingFormat format;
+        format.format = SHM_FORMAT_Y16;
+        format.width = w;
+        format.height = h;
+        format.stride = w * sizeof(uint16_t);
+        format.unit_scale = m_options.unit_scale;
+        format.unit_offset = m_options.unit_offset;
+        ShmRingWriter ring;
+        if (!ring.create(m_options.ring_name, THERMAL_RING_SLOTS, raw_bytes, format)) return 1;
+        FrameMetaWriter meta;
+        if (!m_options.meta_ring.empty() && !meta.create(m_options.meta_ring, FRAME_SOURCE_THERMAL)) return 1;
+
+        FrameSink sink;
+        if (!sink.open(m_options.output, ow, oh, V4L2_PIX_FMT_YUV420, preview_bytes)) return 1;
+        if (!source->open()) return 1;
+        std::cout << "Thermal bridge: " << m_options.source << " " << w << "x" << h << " -> " << sink.path() << " " << ow << "x" << oh
+                  << " (" << m_options.palette << "), raw ring /dev/shm/" << m_options.ring_name << std::endl;
+
+        // Nearest-neighbour upscale maps from preview to sensor coordinates
+        std::vector<uint32_t> xmap(ow), ymap(oh);
+        for (uint32_t x = 0; x < ow; ++x) xmap[x] = x * w / ow;
+        for (uint32_t y = 0; y < oh; ++y) ymap[y] = y * h / oh;
+
+        std::vector<uint8_t> index(pixels);
+        std::vector<uint8_t> preview(preview_bytes);
+        uint8_t *plane_y = preview.data();
+        uint8_t *plane_u = plane_y + static_cast<size_t>(ow) * oh;
+        uint8_t *plane_v = plane_u + static_cast<size_t>(ow) * oh / 4;
+
+        const float min_span = THERMAL_MIN_SPAN / std::max(1e-6f, m_options.unit_scale);
+        float range_lo = 0.0f, range_hi = 0.0f;
+        uint16_t lo = 0, hi = 0;
+        long frames = 0, window_frames = 0;
+        double window_kernel_us = 0.0;
+        auto window_start = std::chrono::steady_clock::now();
+        auto next_frame = window_start;
+        const auto frame_interval = std::chrono::microseconds(1000000 / std::max(1, m_options.fps));
+
+        while (!g_thermal_stop && (m_options.max_frames <= 0 || frames < m_options.max_frames))
+        {
+            if (source->needsPacing())
+            {
+                std::this_thread::sleep_until(next_frame);
+                next_frame += frame_interval;
+            }
+
+            // Read straight into the ring slot: the raw channel costs no extra copy
+            uint8_t *slot = ring.begin();
+            if (!source->read(slot, raw_bytes))
+            {
+                if (g_thermal_stop) break;
+                std::cerr << "Thermal: source ended after " << frames << " frames" << std::endl;
+                return 1;
+            }
+            const uint64_t captured_ns = shmRingNowNs();
+            const uint64_t seq = ring.publish(raw_bytes, captured_ns);
+            if (meta.isOpen())
+            {
+                FrameMeta record;
+                std::memset(&record, 0, sizeof(record));
+                record.capture_ns = captured_ns;
+                record.data_seq = seq;
+                if (source->needsPacing()) record.frame_duration_us = static_cast<uint32_t>(frame_interval.count());
+                meta.publish(record);
+            }
+            // Only this process writes the ring, so the slot stays valid until THERMAL_RING_SLOTS frames later
+            const uint16_t *samples = reinterpret_cast<const uint16_t *>(slot);
+
+            const auto kernel_start = std::chrono::steady_clock::now();
+            thermalMinMax(samples, pixels, lo, hi);
+            if (frames == 0)
+            {
+                range_lo = lo;
+                range_hi = hi;
+            }
+            else
+            {
+                range_lo += THERMAL_RANGE_SMOOTHING * (lo - range_lo);
+                range_hi += THERMAL_RANGE_SMOOTHING * (hi - range_hi);
+            }
+            float show_lo = range_lo, show_hi = range_hi;
+            if (show_hi - show_lo < min_span)
+            {
+                const float mid = (show_lo + show_hi) / 2;
+                show_lo = mid - min_span / 2;
+                show_hi = mid + min_span / 2;
+            }
+            thermalToIndex(samples, pixels, static_cast<uint16_t>(std::max(0.0f, show_lo)),
+                           static_cast<uint16_t>(std::min(65535.0f, show_hi)), index.data());
+
+            for (uint32_t y = 0; y < oh; ++y)
+            {
+                const uint8_t *row = index.data() + static_cast<size_t>(ymap[y]) * w;
+                uint8_t *out = plane_y + static_cast<size_t>(y) * ow;
+                for (uint32_t x = 0; x < ow; ++x) out[x] = palette.y[row[xmap[x]]];
+                if (y & 1) continue;
+                uint8_t *out_u = plane_u + static_cast<size_t>(y / 2) * (ow / 2);
+                uint8_t *out_v = plane_v + static_cast<size_t>(y / 2) * (ow / 2);
+                for (uint32_t x = 0; x < ow / 2; ++x)
+                {
+                    const uint8_t i = row[xmap[2 * x]];
+                    out_u[x] = palette.u[i];
+                    out_v[x] = palette.v[i];
+                }
+            }
+            window_kernel_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - kernel_start).count();
+
+            if (!sink.write(preview.data())) return 1;
+            ++frames;
+            ++window_frames;
+
+            const auto now = std::chrono::steady_clock::now();
+            const double window_sec = std::chrono::duration<double>(now - window_start).count();
+            if (m_options.stats_sec > 0 && window_sec >= m_options.stats_sec)
+            {
+                printStats(frames, window_frames / window_sec, window_kernel_us / window_frames, lo, hi);
+                window_start = now;
+                window_frames = 0;
+                window_kernel_us = 0.0;
+            }
+        }
+        if (window_frames > 0)
+        {
+            const double window_sec = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count());
+            printStats(frames, window_frames / window_sec, window_kernel_us / window_frames, lo, hi);
+        }
+        return 0;
+    }
+
+private:
+    void printStats(long frames, double fps, double kernel_us, uint16_t lo, uint16_t hi) const
+    {
+        std::cout << "Thermal: " << frames << " frames, " << std::fixed << std::setprecision(1) << fps << " fps, colour map "
+                  << kernel_us << " us/frame, scene " << lo * m_options.unit_scale + m_options.unit_offset << ".."
+                  << hi * m_options.unit_scale + m_options.unit_offset << " C" << std::defaultfloat << std::endl;
+    }
+
+    ThermalOptions m_options;
+};
+
+#endif // DE_THERMAL_HPP
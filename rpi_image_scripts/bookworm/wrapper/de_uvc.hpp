@@ -0,0 +1,640 @@
+//***************************************************************************** */
+//  Native USB (UVC) MJPEG capture for the Ubuntu wrapper
+//
+//  USB cameras deliver 1080p30 as MJPEG; decoding that in one ffmpeg thread
+//  does not keep up on small x86 boards. The UVC stage of
+//  camera_manager_wrapper_ubuntu does it in-process:
+//
+//      capture thread   V4L2 mmap streaming; each JPEG is copied out and the
+//                       buffer is queued back at once, so the driver never
+//                       runs out of buffers
+//      decode threads   one libjpeg-turbo decompressor each, raw YCbCr out
+//                       (no colour conversion) to I420
+//      writer thread    writes the frames in capture order to every output
+//                       (v4l2loopback label, /dev/videoN or file:)
+//
+//  When all decoders are busy and the queue is full, the oldest waiting
+//  frame is dropped, so the output stays current instead of falling behind.
+//
+//  Benchmark: the same pipeline fed from a recorded MJPEG file (concatenated
+//  JPEGs, e.g. ffmpeg -f v4l2 -input_format mjpeg -i /dev/video0 -c copy
+//  -f mjpeg rec.mjpeg), paced at the capture rate, with a summary at the end.
+//
+//  Build: link with -ljpeg (libjpeg-turbo; libjpeg62-turbo-dev or
+//  libturbojpeg0-dev). UVC frames usually leave out the Huffman tables;
+//  libjpeg-turbo supplies the standard ones.
+//
+//***************************************************************************** */
+
+#ifndef DE_UVC_HPP
+#define DE_UVC_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <linux/videodev2.h>
+#include <jpeglib.h>
+
+#include "de_frame_sink.hpp"
+
+#define UVC_CAPTURE_BUFFERS 4
+#define UVC_MAX_THREADS 8
+#define UVC_STATS_SEC 30
+#define UVC_REOPEN_MS 1000 // retry interval after the camera was unplugged
+
+struct UvcOptions
+{
+    std::string device = "/dev/video0";
+    unsigned width = 1920;
+    unsigned height = 1080;
+    unsigned fps = 30;                              // benchmark: 0 = as fast as the decoders go
+    std::vector<std::string> outputs = {"DE-CAM1"}; // v4l2loopback labels, /dev/videoN or file:<path>
+    int threads = 0;                                // decode threads, 0 = one per core but one, at most 4
+    int queue = 0;                                  // frames waiting for a decoder before the oldest is dropped, 0 = threads
+    std::string benchmark_file;                     // recorded MJPEG; set = benchmark mode
+    int benchmark_sec = 20;
+};
+
+inline uint64_t uvcNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Offsets and sizes of the JPEGs (SOI .. EOI) in a recorded MJPEG stream.
+ */
+inline std::vector<std::pair<size_t, size_t>> splitMjpeg(const std::vector<uint8_t> &data)
+{
+    std::vector<std::pair<size_t, size_t>> frames;
+    size_t i = 0;
+    while (i + 1 < data.size())
+    {
+        if (data[i] != 0xff || data[i + 1] != 0xd8)
+        {
+            ++i;
+            continue;
+        }
+        // 0xff in entropy-coded data is always followed by 0x00, so the first EOI ends the frame
+        size_t end = i + 2;
+        while (end + 1 < data.size() && !(data[end] == 0xff && data[end + 1] == 0xd9)) ++end;
+        if (end + 1 >= data.size()) break;
+        frames.emplace_back(i, end + 2 - i);
+        i = end + 2;
+    }
+    return frames;
+}
+
+/**
+ * @brief One libjpeg-turbo decompressor: JPEG in, I420 out. Not thread-safe; one per thread.
+ */
+class MjpegDecoder
+{
+public:
+    MjpegDecoder()
+    {
+        m_cinfo.err = jpeg_std_error(&m_error.pub);
+        m_error.pub.error_exit = [](j_common_ptr cinfo) { longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1); };
+        m_error.pub.output_message = [](j_common_ptr) {};
+        jpeg_create_decompress(&m_cinfo);
+    }
+
+    ~MjpegDecoder() { jpeg_destroy_decompress(&m_cinfo); }
+
+    MjpegDecoder(const MjpegDecoder &) = delete;
+    MjpegDecoder &operator=(const MjpegDecoder &) = delete;
+
+    /**
+     * @brief Decodes into i420 (width * height luma, then the quarter-size U and V planes).
+     * @return False for corrupt data, another size or an unsupported colour space.
+     */
+    bool decode(const uint8_t *jpeg, size_t size, uint8_t *i420, unsigned width, unsigned height)
+    {
+        if (setjmp(m_error.jump))
+        {
+            jpeg_abort_decompress(&m_cinfo);
+            return false;
+        }
+        jpeg_mem_src(&m_cinfo, jpeg, static_cast<unsigned long>(size));
+        jpeg_read_header(&m_cinfo, TRUE);
+        const int components = m_cinfo.num_components;
+        if (m_cinfo.image_width != width || m_cinfo.image_height != height || (components != 1 && components != 3) ||
+            (components == 3 && m_cinfo.jpeg_color_space != JCS_YCbCr))
+        {
+            jpeg_abort_decompress(&m_cinfo);
+            return false;
+        }
+        // Raw DCT output: the planes come out in the JPEG's own sampling, no upsampling or colour conversion
+        m_cinfo.raw_data_out = TRUE;
+        m_cinfo.dct_method = JDCT_IFAST;
+        jpeg_start_decompress(&m_cinfo);
+
+        const int max_v = m_cinfo.max_v_samp_factor;
+        JSAMPROW rows[3][4 * DCTSIZE];
+        JSAMPARRAY planes[3] = {rows[0], rows[1], rows[2]};
+        for (int c = 0; c < components; ++c)
+        {
+            const jpeg_component_info &comp = m_cinfo.comp_info[c];
+            m_stride[c] = m_cinfo.MCUs_per_row * comp.h_samp_factor * DCTSIZE;
+            m_rows[c] = m_cinfo.total_iMCU_rows * comp.v_samp_factor * DCTSIZE;
+            if (m_plane[c].size() < static_cast<size_t>(m_stride[c]) * m_rows[c]) m_plane[c].resize(static_cast<size_t>(m_stride[c]) * m_rows[c]);
+        }
+        for (unsigned imcu = 0; imcu < m_cinfo.total_iMCU_rows; ++imcu)
+        {
+            for (int c = 0; c < components; ++c)
+            {
+                const int v = m_cinfo.comp_info[c].v_samp_factor * DCTSIZE;
+                for (int r = 0; r < v; ++r) rows[c][r] = &m_plane[c][(static_cast<size_t>(imcu) * v + r) * m_stride[c]];
+            }
+            jpeg_read_raw_data(&m_cinfo, planes, max_v * DCTSIZE);
+        }
+
+        // Luma as is; chroma from whatever sampling the camera used (4:2:2 is common for UVC) to 4:2:0
+        for (unsigned y = 0; y < height; ++y) std::memcpy(i420 + static_cast<size_t>(y) * width, &m_plane[0][static_cast<size_t>(y) * m_stride[0]], width);
+        const unsigned chroma_w = (width + 1) / 2, chroma_h = (height + 1) / 2;
+        for (int c = 1; c < 3; ++c)
+        {
+            uint8_t *out = i420 + static_cast<size_t>(width) * height + static_cast<size_t>(c - 1) * chroma_w * chroma_h;
+            if (components == 1)
+            {
+                std::memset(out, 128, static_cast<size_t>(chroma_w) * chroma_h);
+                continue;
+            }
+            const jpeg_component_info &comp = m_cinfo.comp_info[c];
+            const int hs = m_cinfo.max_h_samp_factor / comp.h_samp_factor, vs = max_v / comp.v_samp_factor;
+            const uint8_t *plane = m_plane[c].data();
+            const size_t stride = m_stride[c];
+            for (unsigned y = 0; y < chroma_h; ++y)
+            {
+                uint8_t *row = out + static_cast<size_t>(y) * chroma_w;
+                if (hs == 2 && vs == 2) std::memcpy(row, plane + y * stride, chroma_w);
+                else if (hs == 2 && vs == 1)
+                {
+                    const uint8_t *a = plane + 2 * y * stride, *b = a + (2 * y + 1 < static_cast<unsigned>(m_rows[c]) ? stride : 0);
+                    for (unsigned x = 0; x < chroma_w; ++x) row[x] = static_cast<uint8_t>((a[x] + b[x] + 1) >> 1);
+                }
+                else
+                {
+                    const uint8_t *src = plane + (2 * y / vs) * stride;
+                    for (unsigned x = 0; x < chroma_w; ++x) row[x] = src[2 * x / hs];
+                }
+            }
+        }
+        jpeg_finish_decompress(&m_cinfo);
+        return true;
+    }
+
+private:
+    struct ErrorManager
+    {
+        jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+
+    jpeg_decompress_struct m_cinfo;
+    ErrorManager m_error;
+    std::vector<uint8_t> m_plane[3];
+    int m_stride[3] = {0, 0, 0};
+    int m_rows[3] = {0, 0, 0};
+};
+
+/**
+ * @brief Capture, parallel decode and in-order output of one UVC camera.
+ */
+class UvcCapture
+{
+public:
+    explicit UvcCapture(const UvcOptions &options) : m_options(options)
+    {
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        if (m_options.threads <= 0) m_options.threads = std::max(1, std::min(4, cores - 1));
+        m_options.threads = std::min(m_options.threads, UVC_MAX_THREADS);
+        if (m_options.queue <= 0) m_options.queue = m_options.threads;
+        m_frame_bytes = static_cast<size_t>(m_options.width) * m_options.height + 2 * static_cast<size_t>((m_options.width + 1) / 2) * ((m_options.height + 1) / 2);
+    }
+
+    /**
+     * @brief Runs until the process is stopped (camera) or for the benchmark time.
+     * @return Process exit code: 0, 1 on setup errors, 2 if a benchmark did not keep up.
+     */
+    int run()
+    {
+        std::vector<std::string> outputs = m_options.outputs;
+        if (!m_options.benchmark_file.empty() && outputs == UvcOptions().outputs) outputs.clear(); // decode only, unless asked
+        m_sinks.resize(outputs.size());
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            m_sinks[i].reset(new FrameSink());
+            if (!m_sinks[i]->open(outputs[i], m_options.width, m_options.height, V4L2_PIX_FMT_YUV420, static_cast<uint32_t>(m_frame_bytes))) return 1;
+        }
+
+        std::vector<uint8_t> recording;
+        std::vector<std::pair<size_t, size_t>> frames;
+        if (!m_options.benchmark_file.empty())
+        {
+            std::ifstream in(m_options.benchmark_file, std::ios::binary);
+            recording.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            frames = splitMjpeg(recording);
+            if (frames.empty())
+            {
+                std::cerr << "UVC benchmark: no JPEG frames in " << m_options.benchmark_file << std::endl;
+                return 1;
+            }
+        }
+
+        for (int i = 0; i < m_options.threads; ++i) m_workers.emplace_back([this]() { decodeLoop(); });
+        m_writer = std::thread([this]() { writeLoop(); });
+        std::cout << "UVC: " << m_options.width << "x" << m_options.height << "@" << m_options.fps << " MJPEG from "
+                  << (m_options.benchmark_file.empty() ? m_options.device : m_options.benchmark_file + " (" + std::to_string(frames.size()) + " frames)")
+                  << ", " << m_options.threads << " decode thread(s), " << outputs.size() << " output(s)" << std::endl;
+
+        int result = 0;
+        if (m_options.benchmark_file.empty()) captureLoop();
+        else result = benchmark(recording, frames);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_job_ready.notify_all();
+        m_result_ready.notify_all();
+        for (auto &worker : m_workers) worker.join();
+        m_writer.join();
+        return result;
+    }
+
+private:
+    struct Job
+    {
+        uint64_t seq = 0;
+        uint64_t capture_ns = 0;
+        std::vector<uint8_t> jpeg;
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        uint64_t capture_ns = 0;
+        std::vector<uint8_t> frame;
+    };
+
+    /**
+     * @brief Queues one JPEG for decoding; drops the oldest waiting one if the queue is full.
+     */
+    void submit(const uint8_t *data, size_t size, uint64_t capture_ns)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_captured;
+        if (m_jobs.size() >= static_cast<size_t>(m_options.queue))
+        {
+            Job &oldest = m_jobs.front();
+            m_done[oldest.seq] = Result(); // skipped by the writer
+            m_free_jpeg.push_back(std::move(oldest.jpeg));
+            m_jobs.pop_front();
+            ++m_dropped;
+            m_result_ready.notify_all();
+        }
+        Job job;
+        job.seq = ++m_seq;
+        job.capture_ns = capture_ns;
+        if (!m_free_jpeg.empty())
+        {
+            job.jpeg = std::move(m_free_jpeg.back());
+            m_free_jpeg.pop_back();
+        }
+        job.jpeg.assign(data, data + size);
+        m_jobs.push_back(std::move(job));
+        m_job_ready.notify_one();
+    }
+
+    void decodeLoop()
+    {
+        MjpegDecoder decoder;
+        while (true)
+        {
+            Job job;
+            Result result;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_job_ready.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+                if (m_jobs.empty()) return;
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                if (!m_free_frames.empty())
+                {
+                    result.frame = std::move(m_free_frames.back());
+                    m_free_frames.pop_back();
+                }
+            }
+            result.frame.resize(m_frame_bytes);
+            const uint64_t started = uvcNowNs();
+            result.ok = decoder.decode(job.jpeg.data(), job.jpeg.size(), result.frame.data(), m_options.width, m_options.height);
+            const double decode_ms = (uvcNowNs() - started) / 1e6;
+            result.capture_ns = job.capture_ns;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (result.ok)
+                {
+                    m_decode_ms_sum += decode_ms;
+                    m_decode_ms_max = std::max(m_decode_ms_max, decode_ms);
+                    if (m_keep_samples) m_decode_samples.push_back(decode_ms);
+                }
+                else
+                {
+                    ++m_corrupt;
+                }
+                m_free_jpeg.push_back(std::move(job.jpeg));
+                m_done[job.seq] = std::move(result);
+            }
+            m_result_ready.notify_all();
+        }
+    }
+
+    /**
+     * @brief Writes frames in capture order; dropped and corrupt frames are skipped.
+     */
+    void writeLoop()
+    {
+        uint64_t next = 1;
+        while (true)
+        {
+            Result result;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_result_ready.wait(lock, [this, next]() { return m_stop || m_done.count(next); });
+                auto it = m_done.find(next);
+                if (it == m_done.end()) return;
+                result = std::move(it->second);
+                m_done.erase(it);
+            }
+            ++next;
+            if (result.ok)
+            {
+                for (auto &sink : m_sinks) sink->write(result.frame.data());
+                const double latency_ms = (uvcNowNs() - result.capture_ns) / 1e6;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_written;
+                m_latency_ms_sum += latency_ms;
+                if (m_keep_samples) m_latency_samples.push_back(latency_ms);
+            }
+            m_result_ready.notify_all(); // the benchmark waits for the frames in flight
+            if (!result.frame.empty())
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free_frames.push_back(std::move(result.frame));
+            }
+        }
+    }
+
+    /**
+     * @brief Opens and starts streaming the camera. Returns the fd, or -1.
+     */
+    int openCamera(std::vector<std::pair<void *, size_t>> &buffers)
+    {
+        const int fd = ::open(m_options.device.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd == -1)
+        {
+            perror(("open " + m_options.device).c_str());
+            return -1;
+        }
+        auto fail = [&](const char *what) {
+            perror((std::string(what) + " " + m_options.device).c_str());
+            for (auto &buffer : buffers) munmap(buffer.first, buffer.second);
+            buffers.clear();
+            ::close(fd);
+            return -1;
+        };
+        struct v4l2_capability cap;
+        if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) return fail("VIDIOC_QUERYCAP");
+        const uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING))
+        {
+            errno = ENOTTY;
+            return fail("not a streaming capture device:");
+        }
+
+        struct v4l2_format fmt;
+        std::memset(&fmt, 0, sizeof(fmt));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = m_options.width;
+        fmt.fmt.pix.height = m_options.height;
+        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_MJPEG;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+        if (ioctl(fd, VIDIOC_S_FMT, &fmt) == -1) return fail("VIDIOC_S_FMT");
+        if (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_MJPEG || fmt.fmt.pix.width != m_options.width || fmt.fmt.pix.height != m_options.height)
+        {
+            std::cerr << "UVC: " << m_options.device << " has no " << m_options.width << "x" << m_options.height << " MJPEG mode (offers "
+                      << fmt.fmt.pix.width << "x" << fmt.fmt.pix.height << "); see v4l2-ctl --list-formats-ext" << std::endl;
+            errno = EINVAL;
+            return fail("VIDIOC_S_FMT");
+        }
+
+        struct v4l2_streamparm parm;
+        std::memset(&parm, 0, sizeof(parm));
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = m_options.fps;
+        if (ioctl(fd, VIDIOC_S_PARM, &parm) == -1) perror(("VIDIOC_S_PARM " + m_options.device).c_str()); // keep the camera's own rate
+
+        struct v4l2_requestbuffers req;
+        std::memset(&req, 0, sizeof(req));
+        req.count = UVC_CAPTURE_BUFFERS;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(fd, VIDIOC_REQBUFS, &req) == -1 || req.count < 2) return fail("VIDIOC_REQBUFS");
+        for (uint32_t i = 0; i < req.count; ++i)
+        {
+            struct v4l2_buffer buf;
+            std::memset(&buf, 0, sizeof(buf));
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (ioctl(fd, VIDIOC_QUERYBUF, &buf) == -1) return fail("VIDIOC_QUERYBUF");
+            void *map = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+            if (map == MAP_FAILED) return fail("mmap");
+            buffers.emplace_back(map, buf.length);
+            if (ioctl(fd, VIDIOC_QBUF, &buf) == -1) return fail("VIDIOC_QBUF");
+        }
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (ioctl(fd, VIDIOC_STREAMON, &type) == -1) return fail("VIDIOC_STREAMON");
+        return fd;
+    }
+
+    /**
+     * @brief Camera mode. The outputs stay open while the camera is reopened after an unplug.
+     */
+    void captureLoop()
+    {
+        uint64_t stats_ns = uvcNowNs();
+        while (true)
+        {
+            std::vector<std::pair<void *, size_t>> buffers;
+            const int fd = openCamera(buffers);
+            if (fd == -1)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(UVC_REOPEN_MS));
+                continue;
+            }
+            std::cout << "UVC: streaming from " << m_options.device << std::endl;
+            while (true)
+            {
+                struct pollfd pfd = {fd, POLLIN, 0};
+                const int ready = poll(&pfd, 1, 1000);
+                if (ready == -1 && errno == EINTR) continue;
+                if (ready == 0)
+                {
+                    std::cerr << "UVC: no frame from " << m_options.device << " for 1 s" << std::endl;
+                    continue;
+                }
+                struct v4l2_buffer buf;
+                std::memset(&buf, 0, sizeof(buf));
+                buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                buf.memory = V4L2_MEMORY_MMAP;
+                if (ioctl(fd, VIDIOC_DQBUF, &buf) == -1)
+                {
+                    if (errno == EAGAIN || errno == EINTR) continue;
+                    perror(("VIDIOC_DQBUF " + m_options.device).c_str()); // ENODEV: unplugged
+                    break;
+                }
+                const bool monotonic = (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+                const uint64_t capture_ns = monotonic ? static_cast<uint64_t>(buf.timestamp.tv_sec) * 1000000000ull + buf.timestamp.tv_usec * 1000ull : uvcNowNs();
+                if (!(buf.flags & V4L2_BUF_FLAG_ERROR) && buf.bytesused > 0) submit(static_cast<const uint8_t *>(buffers[buf.index].first), buf.bytesused, capture_ns);
+                if (ioctl(fd, VIDIOC_QBUF, &buf) == -1)
+                {
+                    perror(("VIDIOC_QBUF " + m_options.device).c_str());
+                    break;
+                }
+                if (uvcNowNs() - stats_ns >= UVC_STATS_SEC * 1000000000ull)
+                {
+                    printStats((uvcNowNs() - stats_ns) / 1e9);
+                    stats_ns = uvcNowNs();
+                }
+            }
+            enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            ioctl(fd, VIDIOC_STREAMOFF, &type);
+            for (auto &buffer : buffers) munmap(buffer.first, buffer.second);
+            ::close(fd);
+            std::cerr << "UVC: lost " << m_options.device << "; reopening." << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(UVC_REOPEN_MS));
+        }
+    }
+
+    /**
+     * @brief Periodic line; the counters restart after each.
+     */
+    void printStats(double seconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t decoded = m_written;
+        std::cout << std::fixed << std::setprecision(1) << "UVC: " << m_captured / seconds << " fps in, " << decoded / seconds << " fps out, "
+                  << m_dropped << " dropped, " << m_corrupt << " corrupt, decode " << (decoded ? m_decode_ms_sum / decoded : 0.0) << " ms mean / "
+                  << m_decode_ms_max << " ms max, latency " << (decoded ? m_latency_ms_sum / decoded : 0.0) << " ms" << std::defaultfloat << std::endl;
+        m_captured = m_written = m_dropped = m_corrupt = 0;
+        m_decode_ms_sum = m_decode_ms_max = m_latency_ms_sum = 0.0;
+    }
+
+    /**
+     * @brief Replays the recording at the capture rate (fps 0: as fast as the queue takes it).
+     */
+    int benchmark(const std::vector<uint8_t> &recording, const std::vector<std::pair<size_t, size_t>> &frames)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_keep_samples = true;
+        }
+        struct rusage usage_start;
+        getrusage(RUSAGE_SELF, &usage_start);
+        const uint64_t start = uvcNowNs(), end = start + static_cast<uint64_t>(m_options.benchmark_sec) * 1000000000ull;
+        const uint64_t interval = m_options.fps ? 1000000000ull / m_options.fps : 0;
+        uint64_t due = start;
+        for (size_t i = 0; uvcNowNs() < end; i = (i + 1) % frames.size())
+        {
+            if (interval)
+            {
+                due += interval;
+                const uint64_t now = uvcNowNs();
+                if (due > now) std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            }
+            else
+            {
+                // Unpaced: keep the queue full without dropping, to measure the decoders alone
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_result_ready.wait(lock, [this]() { return m_jobs.size() < static_cast<size_t>(m_options.queue) && m_done.size() < 64; });
+            }
+            submit(recording.data() + frames[i].first, frames[i].second, uvcNowNs());
+        }
+        const double seconds = (uvcNowNs() - start) / 1e9;
+        // Let the frames in flight finish
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_result_ready.wait_for(lock, std::chrono::seconds(5), [this]() { return m_written + m_dropped + m_corrupt >= m_captured; });
+        }
+        struct rusage usage_end;
+        getrusage(RUSAGE_SELF, &usage_end);
+        auto cpu = [](const struct rusage &u) { return u.ru_utime.tv_sec + u.ru_stime.tv_sec + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e6; };
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto percentile = [](std::vector<double> values, int p) {
+            if (values.empty()) return 0.0;
+            std::sort(values.begin(), values.end());
+            return values[(values.size() * p + 99) / 100 - 1];
+        };
+        const double out_fps = m_written / seconds;
+        const bool kept_up = m_dropped == 0 && m_corrupt == 0 && (m_options.fps == 0 || out_fps >= 0.98 * m_options.fps);
+        std::cout << std::fixed << std::setprecision(1) << "UVC benchmark: " << m_captured << " frames in " << seconds << " s, " << m_written
+                  << " decoded (" << out_fps << " fps), " << m_dropped << " dropped, " << m_corrupt << " corrupt" << std::endl
+                  << "  decode ms   mean " << (m_written ? m_decode_ms_sum / m_written : 0.0) << "  p95 " << percentile(m_decode_samples, 95)
+                  << "  max " << m_decode_ms_max << "  (" << m_options.threads << " thread(s))" << std::endl
+                  << "  latency ms  mean " << (m_written ? m_latency_ms_sum / m_written : 0.0) << "  p95 " << percentile(m_latency_samples, 95)
+                  << "  (queued to written)" << std::endl
+                  << "  CPU " << 100.0 * (cpu(usage_end) - cpu(usage_start)) / seconds << "% of one core" << std::endl
+                  << "  " << (m_options.fps ? (kept_up ? "keeps up with " : "does NOT keep up with ") + std::to_string(m_options.width) + "x" +
+                                                  std::to_string(m_options.height) + "@" + std::to_string(m_options.fps)
+                                            : std::string("unpaced: the rate above is the decoders' maximum"))
+                  << std::defaultfloat << std::endl;
+        return kept_up ? 0 : 2;
+    }
+
+    UvcOptions m_options;
+    size_t m_frame_bytes = 0;
+    std::vector<std::unique_ptr<FrameSink>> m_sinks;
+    std::vector<std::thread> m_workers;
+    std::thread m_writer;
+
+    std::mutex m_mutex; // guards everything below
+    std::condition_variable m_job_ready, m_result_ready;
+    bool m_stop = false;
+    uint64_t m_seq = 0;
+    std::deque<Job> m_jobs;
+    std::map<uint64_t, Result> m_done;
+    std::vector<std::vector<uint8_t>> m_free_jpeg, m_free_frames;
+    uint64_t m_captured = 0, m_written = 0, m_dropped = 0, m_corrupt = 0;
+    double m_decode_ms_sum = 0.0, m_decode_ms_max = 0.0, m_latency_ms_sum = 0.0;
+    bool m_keep_samples = false;
+    std::vector<double> m_decode_samples, m_latency_samples;
+};
+
+#endif // DE_UVC_HPP